@@ -0,0 +1,87 @@
+#pragma once
+
+#include "compiler/compiler.h"
+#include "parser/ast.h"
+#include "utils/json.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace sdl {
+
+class FunctionLookup;
+
+// Operation counts of a piece of code and the cycles they are estimated to take
+struct CostEstimate {
+    int64_t aluOps = 0;
+    int64_t transcendentalOps = 0;
+    int64_t textureFetches = 0;
+    int64_t branches = 0;
+    double cycles = 0.0;
+    
+    CostEstimate& operator+=(const CostEstimate& other);
+    CostEstimate scaled(int64_t times) const;
+};
+
+struct LoopCost {
+    size_t line = 0;
+    int64_t tripCount = -1;  // -1 when not known statically (body counted once)
+    CostEstimate iteration;  // One trip through the body
+};
+
+struct FunctionCost {
+    std::string name;
+    size_t line = 0;
+    CostEstimate cost;       // One call, callees included
+    std::vector<LoopCost> loops;
+};
+
+struct ShaderCost {
+    std::string name;
+    ShaderDeclaration::ShaderType stage = ShaderDeclaration::ShaderType::VERTEX;
+    CostEstimate cost;       // One invocation of main()
+    std::vector<FunctionCost> functions;
+};
+
+// Static cost estimate of every shader in an analyzed program (expression
+// result types decide how many components an operation works on).
+// Branches cost their condition plus the more expensive side; loops cost
+// their trip count times one iteration when the count is known.
+class CostModel {
+public:
+    explicit CostModel(TargetLanguage target);
+    
+    std::vector<ShaderCost> analyze(Program& program);
+    
+    static void writeJSON(JsonWriter& json, const CostEstimate& cost);
+    // Writes the fields of `shader` into the object currently open in `json`,
+    // so other analyses can add their own fields to the same shader entry
+    static void writeJSON(JsonWriter& json, const ShaderCost& shader);
+    
+private:
+    // Cycles per operation class on the selected target
+    struct Weights {
+        double alu;
+        double divide;   // Reciprocal part of a division
+        double texture;
+        double branch;
+    };
+    
+    TargetLanguage target_;
+    Weights weights_;
+    
+    const FunctionLookup* lookup_ = nullptr; // Shader being analyzed
+    std::unordered_map<const FunctionDeclaration*, FunctionCost> costs_;
+    std::unordered_set<const FunctionDeclaration*> inProgress_;
+    std::vector<LoopCost>* loops_ = nullptr;
+    
+    const FunctionCost& functionCost(FunctionDeclaration& func);
+    
+    CostEstimate cost(Statement* stmt);
+    CostEstimate cost(Expression* expr);
+    CostEstimate alu(int64_t ops) const;
+};
+
+} // namespace sdl
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "parser/ast.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sdl {
+
+// Functions callable from inside one shader: its own functions plus the
+// program-level functions it does not hide
+class FunctionLookup {
+public:
+    FunctionLookup(Program& program, ShaderDeclaration& shader);
+    
+    // Overload whose parameter types match the argument result types; falls
+    // back to the first overload. Null for builtins and constructors.
+    FunctionDeclaration* resolve(FunctionCallExpression& call) const;
+    
+    // The shader's entry point, or null
+    FunctionDeclaration* entryPoint() const { return entryPoint_; }
+    
+private:
+    std::unordered_map<std::string, std::vector<FunctionDeclaration*>> functions_;
+    FunctionDeclaration* entryPoint_ = nullptr;
+};
+
+} // namespace sdl
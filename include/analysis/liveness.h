@@ -0,0 +1,78 @@
+#pragma once
+
+#include "analysis/name_resolution.h"
+#include "parser/ast.h"
+#include "utils/json.h"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace sdl {
+
+class FunctionLookup;
+
+// Peak register pressure of one function, callees included
+struct FunctionPressure {
+    std::string name;
+    size_t line = 0;
+    int peakScalars = 0;
+    size_t peakLine = 0; // Statement where the peak occurs (call site for callee peaks)
+};
+
+struct RegisterPressure {
+    std::string shader;
+    ShaderDeclaration::ShaderType stage = ShaderDeclaration::ShaderType::VERTEX;
+    int peakScalars = 0; // Peak of main()
+    size_t peakLine = 0;
+    std::vector<FunctionPressure> functions;
+};
+
+// Live-variable analysis over function bodies. Locals and parameters are
+// counted by scalar components (a vec4 is 4, a mat3 is 9); a statement's
+// pressure is the larger of what is live before and after it, and a call
+// adds the callee's peak to everything live across it.
+class LivenessAnalysis {
+public:
+    // Scalars a fragment shader can keep live on common mobile GPUs before
+    // the driver starts spilling to memory
+    static constexpr int MOBILE_SCALAR_BUDGET = 64;
+    
+    std::vector<RegisterPressure> analyze(Program& program);
+    
+    // Registers per CUDA thread: live scalars plus indexing and addressing
+    static int estimatedCudaRegisters(int peakScalars);
+    
+    // Fraction of an SM's warp slots (65536 registers, 64 warps) a kernel
+    // using `registers` per thread can occupy
+    static double estimatedCudaOccupancy(int registers);
+    
+    static void writeJSON(JsonWriter& json, const RegisterPressure& pressure);
+    
+private:
+    using LiveSet = std::unordered_set<const VariableDeclaration*>;
+    
+    const FunctionLookup* lookup_ = nullptr;
+    std::unordered_map<const FunctionDeclaration*, FunctionPressure> results_;
+    std::unordered_set<const FunctionDeclaration*> inProgress_;
+    
+    NameResolution names_;
+    
+    // Per-function state
+    FunctionPressure* current_ = nullptr;
+    bool recording_ = false;
+    
+    const FunctionPressure& functionPressure(FunctionDeclaration& func);
+    
+    LiveSet transfer(Statement* stmt, const LiveSet& liveOut);
+    LiveSet transferList(std::vector<StatementPtr>& statements, const LiveSet& liveOut);
+    LiveSet loopHead(Expression* condition, Statement* body, Statement* update, const LiveSet& liveOut);
+    void record(Statement& stmt, const LiveSet& liveIn, const LiveSet& liveOut);
+    
+    void addUses(Expression* expr, LiveSet& live) const;
+    const VariableDeclaration* definedVariable(Expression* target) const;
+    int calleePeak(Statement& stmt);
+    static int scalars(const LiveSet& live);
+};
+
+} // namespace sdl
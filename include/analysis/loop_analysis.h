@@ -0,0 +1,23 @@
+#pragma once
+
+#include "parser/ast.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace sdl {
+
+// A counted loop of the form
+//     for (int i = start; i <op> bound; i = i +/- step) body
+// where start, bound and step are integer literals and body never assigns i
+struct CountedLoop {
+    std::string variable;
+    int64_t start = 0;
+    int64_t step = 0;
+    int64_t tripCount = 0;
+};
+
+// Recognizes counted loops; returns nullopt for anything else
+std::optional<CountedLoop> analyzeCountedLoop(ForStatement& loop);
+
+} // namespace sdl
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "parser/ast.h"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace sdl {
+
+// Binds every identifier in a program to the variable declaration it names,
+// following the analyzer's scoping: program-level globals, then shader-level
+// declarations, then parameters and block-scoped locals. Builtin variables
+// (gl_Position, idx, true, ...) are left unresolved.
+class NameResolution {
+public:
+    void resolve(Program& program);
+    
+    // Null for builtins and unknown names
+    const VariableDeclaration* find(const IdentifierExpression& identifier) const;
+    
+    // Parameters and variables declared inside a function body
+    bool isLocal(const VariableDeclaration* var) const { return locals_.count(var) > 0; }
+    
+private:
+    using Scope = std::unordered_map<std::string, const VariableDeclaration*>;
+    
+    std::unordered_map<const IdentifierExpression*, const VariableDeclaration*> bindings_;
+    std::unordered_set<const VariableDeclaration*> locals_;
+    
+    friend class NameResolver;
+};
+
+} // namespace sdl
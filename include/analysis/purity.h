@@ -0,0 +1,55 @@
+#pragma once
+
+#include "analysis/name_resolution.h"
+#include "parser/ast.h"
+#include "semantic/builtins.h"
+#include <unordered_map>
+#include <unordered_set>
+
+namespace sdl {
+
+// Effects summarized as the most restrictive category that applies
+enum class Purity {
+    PURE,             // Result depends only on the arguments
+    READS_UNIFORMS,   // ... and uniforms; safe to hoist out of per-invocation code
+    READS_INPUTS,     // ... and per-invocation inputs; safe to CSE within one invocation
+    SAMPLES_TEXTURES, // Must stay in uniform control flow; CSE only under the same branch
+    READS_MUTABLE,    // Can only be reused while nothing writes what it reads
+    WRITES_OUTPUTS,   // Must run exactly as often as written
+    SIDE_EFFECTS      // Writes globals or out parameters
+};
+
+const char* purityName(Purity purity);
+
+// Interprocedural side-effect analysis. Each function is summarized by the
+// effects of its own body plus those of everything it calls; writes to
+// locals and to copies of in parameters are not effects. Program-level
+// functions are merged over every shader that calls them, since a shader
+// can hide a callee with its own overload.
+class PurityAnalysis {
+public:
+    void analyze(Program& program);
+    
+    unsigned effectsOf(const FunctionDeclaration* func) const;
+    // Builtins included: texture() and dFdx() sample, everything else is pure
+    unsigned effectsOf(const FunctionCallExpression& call) const;
+    
+    Purity purityOf(const FunctionDeclaration* func) const { return classify(effectsOf(func)); }
+    Purity purityOf(const FunctionCallExpression& call) const { return classify(effectsOf(call)); }
+    
+    static Purity classify(unsigned effects);
+    // Whether dropping an unused call or evaluating it once instead of twice
+    // is unobservable (nothing is written)
+    static bool isRemovable(unsigned effects);
+    
+private:
+    NameResolution names_;
+    std::unordered_map<const FunctionDeclaration*, unsigned> functions_;
+    std::unordered_map<const FunctionCallExpression*, unsigned> calls_;
+    std::unordered_set<const VariableDeclaration*> writtenGlobals_;
+    bool changed_ = false;
+    
+    friend class EffectCollector;
+};
+
+} // namespace sdl
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "parser/ast.h"
+#include "utils/error_handler.h"
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace sdl {
+
+// A value passed from a vertex shader output to fragment shader inputs
+struct Varying {
+    std::string name;
+    Type::Kind type = Type::Kind::FLOAT;
+    bool written = false; // Assigned somewhere in the vertex shader
+    bool read = false;    // Read by at least one fragment shader
+    bool shadowed = false; // A local or parameter reuses the name; never packed
+    
+    // Interpolator location after packing; `packedName` is empty when the
+    // varying kept its own declaration
+    int slot = -1;
+    int component = 0;
+    std::string packedName;
+};
+
+// A vertex shader together with the fragment shaders that consume its outputs
+struct StageLink {
+    ShaderDeclaration* vertex = nullptr;
+    std::vector<ShaderDeclaration*> fragments;
+    std::vector<Varying> varyings;
+    
+    // Filled in by StageInterface::optimize()
+    std::vector<std::string> dropped;
+    int slotsBefore = 0;
+    int slotsAfter = 0;
+};
+
+// Cross-stage interface analysis. Every fragment shader is linked to the
+// closest vertex shader declared before it; vertex outputs are matched to
+// fragment inputs by name and type.
+class StageInterface {
+public:
+    // Builds the links and checks that the stages agree. Returns false if
+    // any error was found. The program must outlive this object.
+    bool link(Program& program);
+    
+    // Demotes vertex outputs no fragment shader reads to private globals and
+    // packs the remaining float, vec2 and vec3 varyings into as few vec4
+    // slots as possible, rewriting accesses in both stages
+    void optimize();
+    
+    const std::vector<StageLink>& getLinks() const { return links_; }
+    const std::vector<Diagnostic>& getDiagnostics() const { return diagnostics_; }
+    bool hasErrors() const;
+    
+private:
+    std::vector<StageLink> links_;
+    std::vector<Diagnostic> diagnostics_;
+    std::unordered_set<std::string> reservedNames_;
+    
+    void checkLink(StageLink& link);
+    void packVaryings(StageLink& link);
+};
+
+} // namespace sdl
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "analysis/name_resolution.h"
+#include "parser/ast.h"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace sdl {
+
+class FunctionLookup;
+
+// A texture fetch executed under control flow that differs between threads
+struct DivergentFetch {
+    const FunctionCallExpression* call = nullptr;
+    const Statement* branch = nullptr; // Innermost divergent if/loop; null when the
+                                       // whole function is called divergently
+    std::string shader;
+    ShaderDeclaration::ShaderType stage = ShaderDeclaration::ShaderType::VERTEX;
+};
+
+// Uniformity analysis. A value is uniform when every invocation of a draw or
+// dispatch computes the same one (literals, constants, uniforms, work group
+// IDs) and divergent when it can differ between threads (stage inputs,
+// invocation IDs, idx/idy, derivatives). Divergence flows through
+// assignments, parameters and return values, and anything assigned under a
+// divergent branch or loop becomes divergent too. Program-level functions are
+// merged over every shader that calls them.
+class UniformityAnalysis {
+public:
+    void analyze(Program& program);
+    
+    // Expressions the analysis did not reach are reported as divergent
+    bool isUniform(const Expression* expr) const;
+    
+    // True when the condition of an if, for or while statement is uniform
+    bool isUniformBranch(const Statement* stmt) const;
+    
+    const std::vector<DivergentFetch>& getDivergentFetches() const { return fetches_; }
+    
+private:
+    NameResolution names_;
+    
+    std::unordered_set<const VariableDeclaration*> divergentVariables_;
+    std::unordered_set<const FunctionDeclaration*> divergentReturns_;
+    std::unordered_set<const FunctionDeclaration*> divergentCalls_; // Called under divergent control
+    std::unordered_map<const Expression*, bool> expressions_;       // true = uniform
+    std::unordered_map<const Statement*, bool> branches_;
+    std::vector<DivergentFetch> fetches_;
+    
+    // Walk state
+    const FunctionLookup* lookup_ = nullptr;
+    ShaderDeclaration* shader_ = nullptr;
+    FunctionDeclaration* function_ = nullptr;
+    std::vector<const Statement*> divergentBranches_;
+    bool divergentExit_ = false; // A return was taken by only some threads
+    bool recording_ = false;
+    std::unordered_set<const FunctionCallExpression*> recordedFetches_;
+    
+    void walkShader(Program& program, ShaderDeclaration& shader);
+    void walkFunction(FunctionDeclaration& func);
+    void walkStatements(std::vector<StatementPtr>& statements, bool divergent);
+    void walkStatement(Statement* stmt, bool divergent);
+    void walkBranchBody(Statement& branch, Statement* body, bool divergent, bool conditionDivergent);
+    void assign(Expression* target, bool divergent);
+    
+    bool divergent(Expression* expr, bool control);
+    bool evaluate(Expression* expr, bool control);
+    size_t stateSize() const;
+};
+
+} // namespace sdl
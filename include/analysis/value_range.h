@@ -0,0 +1,119 @@
+#pragma once
+
+#include "analysis/name_resolution.h"
+#include "analysis/purity.h"
+#include "parser/ast.h"
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace sdl {
+
+class FunctionLookup;
+
+// Closed interval containing every value an expression can take. For vectors
+// and matrices it bounds every component. An empty range (low > high) means
+// no value reaches the expression yet.
+struct ValueRange {
+    double low;
+    double high;
+    bool unit = false; // A vector of length 1 (result of normalize)
+    
+    static ValueRange full();
+    static ValueRange empty();
+    static ValueRange exactly(double value);
+    static ValueRange between(double low, double high);
+    
+    bool isEmpty() const { return low > high; }
+    bool isFull() const;
+    bool within(double min, double max) const { return !isEmpty() && low >= min && high <= max; }
+    
+    // Smallest range containing both
+    ValueRange join(const ValueRange& other) const;
+    bool operator==(const ValueRange& other) const;
+};
+
+// Interval arithmetic, componentwise; an empty operand gives an empty result
+ValueRange operator+(const ValueRange& a, const ValueRange& b);
+ValueRange operator-(const ValueRange& a, const ValueRange& b);
+ValueRange operator*(const ValueRange& a, const ValueRange& b);
+ValueRange operator/(const ValueRange& a, const ValueRange& b);
+ValueRange operator-(const ValueRange& a);
+
+// Range of a builtin's result given those of its arguments; `components` is
+// the component count of the first argument (for dot and length)
+ValueRange builtinRange(BuiltinId id, const std::vector<ValueRange>& args, int components);
+
+// `[[range(min, max)]]` on a uniform or input, unbounded without one
+ValueRange annotatedRange(const VariableDeclaration& var);
+
+// Operations removed by ValueRangeAnalysis::eliminateRedundantChecks()
+struct RangeEliminations {
+    int clamps = 0;          // clamp, min, max and saturate calls that could not change their argument
+    int decidedBranches = 0; // if statements whose condition is always true or always false
+};
+
+// Interval analysis over all functions of a program. Ranges come from
+// literals, `[[range(min, max)]]` on uniforms and inputs, builtin results
+// (sin is in [-1, 1], dot of two normalized vectors too, give or take
+// rounding) and counted loop indices, and flow through arithmetic, locals
+// and return values. A variable's range is the union of everything assigned
+// to it anywhere; ranges that keep growing are widened to unbounded.
+// Parameters are unbounded.
+class ValueRangeAnalysis {
+public:
+    // Consts whose value -D overrides after this analysis; their
+    // initializers are not trusted
+    void setOverriddenConsts(const std::unordered_set<std::string>& names) { overriddenConsts_ = names; }
+    
+    void analyze(Program& program);
+    
+    // Unbounded for expressions the analysis did not reach
+    ValueRange rangeOf(const Expression* expr) const;
+    
+    // Whether a comparison (possibly combined with &&, || and !) always holds
+    // or never does; nullopt when it depends on the values
+    std::optional<bool> decide(const Expression* condition) const;
+    
+    // Replaces clamp/min/max/saturate calls that return their argument
+    // unchanged by the argument, and if statements with a decided condition
+    // by the branch that runs. Uses the ranges of the last analyze() call on
+    // the same program.
+    RangeEliminations eliminateRedundantChecks(Program& program);
+    
+private:
+    NameResolution names_;
+    PurityAnalysis purity_; // Calls that write nothing can be dropped with their clamp
+    
+    std::unordered_map<const VariableDeclaration*, ValueRange> variables_;
+    std::unordered_map<const void*, int> widenings_; // Growth count per variable or function
+    std::unordered_map<const FunctionDeclaration*, ValueRange> returns_;
+    std::unordered_map<const Expression*, ValueRange> ranges_;
+    std::unordered_set<const VariableDeclaration*> loopCounters_; // Set from the loop header only
+    std::unordered_set<std::string> userFunctions_;
+    std::unordered_set<std::string> overriddenConsts_;
+    bool changed_ = false;
+    
+    // Walk state
+    const FunctionLookup* lookup_ = nullptr;
+    FunctionDeclaration* function_ = nullptr;
+    
+    void walkShader(Program& program, ShaderDeclaration& shader);
+    void walkStatement(Statement* stmt);
+    void walkFor(ForStatement& loop);
+    void assign(Expression* target, const ValueRange& range);
+    void joinInto(ValueRange& slot, const void* key, const ValueRange& range);
+    
+    ValueRange range(Expression* expr);
+    ValueRange evaluate(Expression* expr);
+    ValueRange evaluateCall(FunctionCallExpression& call);
+    
+    bool hasSideEffects(Expression* expr) const;
+    void simplify(ExpressionPtr& expr, RangeEliminations& removed);
+    void simplify(StatementPtr& stmt, RangeEliminations& removed);
+    void simplifyStatements(std::vector<StatementPtr>& statements, RangeEliminations& removed);
+};
+
+} // namespace sdl
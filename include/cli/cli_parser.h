@@ -13,7 +13,18 @@ public:
         std::string outputFile;
         std::vector<std::string> includePaths;
         std::vector<std::string> defines;
+        std::string permutations; // JSON matrix of define values
         bool verbose = false;
+        std::string stats; // "", "text" or "json"
+        std::string optimization = "2"; // 0, 1, 2, 3 or s
+        std::string passes;
+        bool timePasses = false;
+        bool fastMath = false;
+        bool glslES = false;
+        bool foldUniforms = false;
+        bool preshader = false;
+        std::string printBefore;
+        std::string printAfter;
         bool showHelp = false;
         bool showVersion = false;
     };
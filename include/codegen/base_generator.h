@@ -2,8 +2,10 @@
 
 #include "parser/ast.h"
 #include "parser/ast_visitor.h"
+#include "semantic/builtins.h"
 #include <string>
 #include <sstream>
+#include <unordered_set>
 
 namespace sdl {
 
@@ -16,6 +18,7 @@ public:
 protected:
     std::stringstream output_;
     int indentLevel_ = 0;
+    std::unordered_set<std::string> userFunctions_; // Hide builtins of the same name
     
     void indent();
     void writeLine(const std::string& line = "");
@@ -23,6 +26,11 @@ protected:
     void increaseIndent();
     void decreaseIndent();
     
+    // Generates an expression into a string instead of the output
+    std::string capture(Expression& expr);
+    // Writes a call, lowering builtins through getBuiltinTemplate()
+    void generateCall(FunctionCallExpression& node);
+    
     // Helper methods for different targets
     virtual std::string getTypeString(const Type& type) = 0;
     virtual std::string getQualifierString(VariableDeclaration::Qualifier qualifier) = 0;
@@ -34,6 +42,7 @@ protected:
     virtual void generatePostamble() = 0;
     virtual std::string getFunctionCallString(const std::string& name, 
                                              const std::vector<std::string>& args) = 0;
+    virtual const char* getBuiltinTemplate(const BuiltinInfo& builtin) = 0;
 };
 
 } // namespace sdl
@@ -4,10 +4,15 @@
 
 namespace sdl {
 
+class UniformityAnalysis;
+
 class CUDAGenerator : public BaseCodeGenerator {
 public:
     CUDAGenerator();
     
+    // Optional; when set, branches are annotated as uniform or divergent
+    void setUniformity(const UniformityAnalysis* uniformity) { uniformity_ = uniformity; }
+    
     // ASTVisitor interface
     void visit(Type& node) override;
     void visit(IdentifierExpression& node) override;
@@ -35,15 +40,16 @@ protected:
     std::string getUnaryOperatorString(UnaryExpression::Operator op) override;
     std::string getFunctionCallString(const std::string& name, 
                                      const std::vector<std::string>& args) override;
+    const char* getBuiltinTemplate(const BuiltinInfo& builtin) override;
     
     void generatePreamble() override;
     void generatePostamble() override;
     
 private:
     bool inKernel_ = false;
+    const UniformityAnalysis* uniformity_ = nullptr;
     
     void generateCUDAIncludes();
-    std::string getCUDABuiltinFunction(const std::string& name);
     std::string mapGLSLTypeToCUDA(const std::string& glslType);
     std::string generateKernelSignature(const ShaderDeclaration& shader);
 };
@@ -35,6 +35,7 @@ protected:
     std::string getUnaryOperatorString(UnaryExpression::Operator op) override;
     std::string getFunctionCallString(const std::string& name, 
                                      const std::vector<std::string>& args) override;
+    const char* getBuiltinTemplate(const BuiltinInfo& builtin) override;
     
     void generatePreamble() override;
     void generatePostamble() override;
@@ -44,7 +45,6 @@ private:
     ShaderDeclaration::ShaderType currentShaderType_;
     
     void generateGLSLVersion();
-    std::string getGLSLBuiltinFunction(const std::string& name);
 };
 
 } // namespace sdl
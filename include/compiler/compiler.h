@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
@@ -11,14 +12,56 @@ enum class TargetLanguage {
     CUDA
 };
 
+// Pipelines are listed in PassManager::pipeline()
+enum class OptimizationLevel {
+    O0, // Lowering only: fastest turnaround for hot reload
+    O1, // Cheap cleanups
+    O2, // Default for shipping shaders
+    O3, // O2 plus transformations that trade code size for speed
+    OS  // O2 without transformations that grow the code
+};
+
+enum class StatsFormat {
+    NONE,
+    TEXT,
+    JSON
+};
+
 struct CompilerOptions {
     std::vector<TargetLanguage> targets;
     std::string inputFile;
     std::string outputFile;
     std::vector<std::string> includePaths;
-    std::vector<std::string> defines;
+    std::vector<std::string> defines; // NAME[=VALUE]: overrides the scalar const NAME (value defaults to 1)
     bool verbose = false;
-    bool optimizeOutput = true;
+    OptimizationLevel optimization = OptimizationLevel::O2;
+    std::string passes;      // Comma-separated IR passes replacing the pipeline of the level
+    bool timePasses = false;
+    bool fastMath = false;   // Every function as if marked [[fast]]
+    bool glslES = false;     // GLSL ES 3.00 instead of GLSL 330 (IR output only)
+    bool foldUniforms = false; // Products of uniform matrices become uniforms the host computes
+    bool preshader = false;    // So does any expression of uniforms alone (implies foldUniforms)
+    std::string printBefore; // IR pass whose input is dumped, or "all"
+    std::string printAfter;  // IR pass whose output is dumped, or "all"
+    StatsFormat stats = StatsFormat::NONE;
+};
+
+// One combination of define values from a --permutations matrix
+struct Permutation {
+    std::string key;                  // "FOG=1,LIGHTS=4", defines in matrix order
+    std::vector<std::string> defines; // As -D takes them
+};
+
+// Every combination of the values of a matrix {"NAME": [value, ...], ...};
+// values are numbers or booleans. Throws std::runtime_error on anything else.
+std::vector<Permutation> expandPermutations(const std::string& matrix);
+
+// One distinct output of Compiler::compilePermutations()
+struct PermutationVariant {
+    uint64_t hash = 0; // hashIR() of the final IR; permutations share a variant when it and the outputs match
+    std::string glslOutput;
+    std::string cudaOutput;
+    std::string hostUniformsOutput;
 };
 
 class Compiler {
@@ -27,10 +70,28 @@ public:
     ~Compiler();
     
     bool compile(const CompilerOptions& options);
+    // Parses, analyzes and lowers once, then specializes every permutation
+    // (its defines after options.defines) and optimizes and prints it in
+    // parallel. Needs the IR path; the AST fallback is not per permutation.
+    bool compilePermutations(const CompilerOptions& options, const std::vector<Permutation>& permutations);
     
     // Get compilation results
     std::string getGLSLOutput() const;
     std::string getCUDAOutput() const;
+    // C++ preshaders computing the uniforms --fold-uniforms and --preshader
+    // introduced; empty if none
+    std::string getHostUniformsOutput() const;
+    
+    // After compilePermutations(): the distinct outputs, and the index among
+    // them of each permutation
+    const std::vector<PermutationVariant>& getVariants() const;
+    const std::vector<size_t>& getPermutationVariants() const;
+    
+    // Static cost report per target (empty unless CompilerOptions::stats is set)
+    std::string getStatsOutput() const;
+    
+    // IR dumps and pass timings requested in the options
+    std::string getPassOutput() const;
     
     // Error handling
     bool hasErrors() const;
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "ir/ir.h"
+#include <vector>
+
+namespace sdl {
+
+// Rewrite rules of the simplify-algebra pass. Each rule looks at one
+// instruction of the op it is registered for and returns the value to use
+// instead, or IR_NONE to leave it alone. The table lives in
+// ir/algebraic_rules.def; adding a rule means adding an entry there and its
+// function to ir/algebraic_rules.cpp, without touching the pass itself.
+
+// Helpers for matching and for building the replacement. Instructions made
+// here are placed right before the one being rewritten.
+class RewriteBuilder {
+public:
+    RewriteBuilder(IRModule& module, IRFunction& function) : module_(module), function_(function) {}
+    
+    void setPosition(IRValue before) { position_ = before; }
+    
+    const IRInstruction& inst(IRValue value) const { return function_.instructions[value]; }
+    Type::Kind type(IRValue value) const { return function_.instructions[value].type; }
+    IRValue operand(IRValue value, size_t index) const { return function_.operand(value, index); }
+    bool isBuiltin(IRValue value, BuiltinId id) const;
+    
+    // A constant whose components all equal one value: `splat` receives it
+    bool splat(IRValue value, double& result) const;
+    bool isSplat(IRValue value, double scalar) const;
+    
+    // A constant of `type` with every component `scalar`, rounded to single
+    // precision for float types
+    IRValue constant(Type::Kind type, double scalar);
+    IRValue emit(IROp op, Type::Kind type, const std::vector<IRValue>& args, uint32_t imm = 0);
+    IRValue builtin(BuiltinId id, Type::Kind type, const std::vector<IRValue>& args);
+    
+private:
+    IRModule& module_;
+    IRFunction& function_;
+    IRValue position_ = IR_NONE;
+};
+
+using RewriteRule = IRValue (*)(RewriteBuilder& builder, IRValue value);
+
+enum class RuleKind : uint8_t {
+    EXACT,    // Same result for every input, NaN, infinity and -0.0 included
+    FAST_MATH // Rounds differently or assumes finite values and no -0.0
+};
+
+struct AlgebraicRule {
+    const char* name;
+    IROp op;
+    BuiltinId builtin; // For BUILTIN rules; NONE otherwise
+    RuleKind kind;
+    RewriteRule rewrite;
+    const char* description;
+};
+
+// Every rule, in the order tried
+const std::vector<AlgebraicRule>& algebraicRules();
+
+} // namespace sdl
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ir/printer.h"
+#include <map>
+
+namespace sdl {
+
+// CUDA from IR. Each shader becomes a __global__ kernel running the body of
+// its main(); its other functions become __device__ functions. Uniforms and
+// constants live at file scope. Stage inputs, outputs and private globals are
+// per-thread, so they are locals of the kernel and are passed to the device
+// functions that use them, by reference when written. Additions,
+// subtractions, products and negations of MEDIUM precision on float and
+// vec2 run on __half and __half2.
+class CUDAPrinter : public IRPrinter {
+protected:
+    void printModule() override;
+    
+    std::string typeName(Type::Kind type) const override;
+    std::string constant(const IRConstant& constant) const override;
+    std::string construct(Type::Kind type, const std::vector<std::string>& args) const override;
+    const char* builtinTemplate(const BuiltinInfo& builtin) const override;
+    const char* fastBuiltinTemplate(const BuiltinInfo& builtin, Type::Kind argument) const override;
+    const char* fastDivisionTemplate(Type::Kind dividend, Type::Kind divisor) const override;
+    std::string swizzle(const std::string& value, uint32_t swizzle) const override;
+    std::string assignComponents(const std::string& target, uint32_t mask, const std::string& value) const override;
+    bool needsName(const IRInstruction& inst, size_t operand) const override;
+    std::vector<std::string> extraArguments(uint32_t function) const override;
+    std::string branchComment(uint32_t hint) const override;
+    std::string loopPragma(uint32_t unroll) const override;
+    bool isReserved(const std::string& name) const override;
+    std::string variableType(const IRFunction& function, IRValue value) const override;
+    bool halfArithmetic(const IRFunction& function, IRValue value) const override;
+    std::string halfConversion(const std::string& value, Type::Kind type, bool toHalf) const override;
+    
+private:
+    // Per function: the per-thread globals it touches, callees included, and
+    // whether it writes them
+    std::vector<std::map<uint32_t, bool>> threadGlobals_;
+    
+    bool isPerThread(const IRGlobal& global) const;
+    bool usesHalf() const;
+    void collectThreadGlobals();
+    void printFileScopeGlobal(uint32_t global);
+    void printDeviceFunction(uint32_t function);
+    void printKernel(uint32_t shader);
+};
+
+} // namespace sdl
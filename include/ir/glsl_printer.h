@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ir/printer.h"
+
+namespace sdl {
+
+// GLSL 330 from IR, laid out like GLSLGenerator: one file, each shader's
+// declarations under a `// Shader:` comment. The GLSL ES 3.00 dialect
+// defaults to highp and declares values of MEDIUM precision mediump.
+class GLSLPrinter : public IRPrinter {
+public:
+    explicit GLSLPrinter(bool es = false) : es_(es) {}
+    
+protected:
+    void printModule() override;
+    
+    std::string typeName(Type::Kind type) const override;
+    std::string constant(const IRConstant& constant) const override;
+    std::string construct(Type::Kind type, const std::vector<std::string>& args) const override;
+    const char* builtinTemplate(const BuiltinInfo& builtin) const override;
+    const char* fastBuiltinTemplate(const BuiltinInfo& builtin, Type::Kind argument) const override;
+    std::string variableType(const IRFunction& function, IRValue value) const override;
+    
+private:
+    bool es_;
+    
+    void printItem(const IRItem& item);
+};
+
+} // namespace sdl
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "ir/printer.h"
+
+namespace sdl {
+
+// C++ for the host from the preshaders of a module (IRShader::preshader).
+// Each shader gets a struct of the uniforms its preshader reads, one of the
+// uniforms it derives, and an inline function computing the second from the
+// first once per draw. Values are scalarized into float, int and bool
+// arrays, matrices column-major as glUniformMatrix*fv expects without
+// transposition. Prints nothing for a module without preshaders.
+class HostPrinter : public IRPrinter {
+protected:
+    void printModule() override;
+    
+    std::string typeName(Type::Kind type) const override;
+    std::string constant(const IRConstant& constant) const override;
+    std::string construct(Type::Kind type, const std::vector<std::string>& args) const override;
+    const char* builtinTemplate(const BuiltinInfo& builtin) const override;
+    
+private:
+    void printPreshader(const IRShader& shader);
+    void printInstruction(IRValue value);
+    // Local holding a value, one initializer per component
+    void printTemporary(IRValue value, const std::vector<std::string>& elements);
+    // Declaration of a struct member or local holding a value of the type
+    std::string declaration(Type::Kind type, const std::string& name) const;
+    std::string literal(const IRConstant& constant, int component) const;
+    // Component of a value; arguments repeat a scalar for every component
+    std::string element(IRValue value, int component) const;
+    std::string argument(IRValue value, int component) const;
+    // Components of a value converted to the element type of `type`
+    std::vector<std::string> convertedElements(IRValue value, Type::Kind type) const;
+    // Components of a builtin call, possibly after helper statements; none
+    // when those already declared the value
+    std::vector<std::string> builtinElements(IRValue value);
+};
+
+} // namespace sdl
@@ -0,0 +1,279 @@
+#pragma once
+
+#include "parser/ast.h"
+#include "semantic/builtins.h"
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sdl {
+
+// Typed SSA form of a program. Every value is an instruction, referred to by
+// its 32-bit index in IRFunction::instructions; operands live in one pool per
+// function. Values are whole vectors and matrices, so `a * b` on vec3 is one
+// instruction.
+//
+// Control flow stays structured so the printers can rebuild if/while without
+// gotos: a block whose terminator opens a selection or loop records where it
+// merges, and a loop header records its latch (the only block branching back).
+
+using IRValue = uint32_t;
+constexpr uint32_t IR_NONE = 0xFFFFFFFFu;
+
+enum class IROp : uint8_t {
+    // Leaves
+    CONSTANT,  // imm: index into IRModule::constants
+    PARAMETER, // imm: parameter index
+    LOAD,      // imm: global index
+    PHI,       // One operand per entry of the block's predecessors, in that order
+    
+    // Componentwise; a scalar operand is applied to every component. MUL of
+    // a matrix with a matrix or vector is the linear-algebra product.
+    ADD, SUB, MUL, DIV, MOD, NEG,
+    EQ, NE, LT, LE, GT, GE, // EQ/NE compare whole vectors
+    AND, OR, NOT,
+    SELECT,    // operands: condition, value if true, value if false
+    
+    CONSTRUCT, // Type constructor or conversion over the operands (vec3(a, b), float(i))
+    EXTRACT,   // Column imm of a matrix
+    SWIZZLE,   // imm: packed swizzle, see packSwizzle()
+    INSERT,    // operands: vector, value; imm: packed swizzle of the written components
+    BUILTIN,   // imm: BuiltinId
+    CALL,      // imm: function index
+    STORE,     // operand: value; imm: global index; aux: packed written components, 0 = all
+    
+    // Terminators; the targets are IRBlock::successors
+    BRANCH,
+    COND_BRANCH, // operand: condition, true goes to successors[0]; aux: IRBranchHint; imm: IRBranchControl
+    RETURN       // Optional operand
+};
+
+// What is known about a conditional branch across the threads of a warp
+enum IRBranchHint : uint32_t {
+    BRANCH_UNKNOWN = 0,
+    BRANCH_UNIFORM = 1,
+    BRANCH_DIVERGENT = 2,
+};
+
+// Precision a float value is computed and kept at. The infer-precision
+// pass lowers values it proves need no more than 16 bits to MEDIUM.
+enum class IRPrecision : uint8_t {
+    HIGH,  // 32-bit float
+    MEDIUM // Half precision: 11-bit significand, magnitudes below 2^14
+};
+
+// What [[branch]] and [[flatten]] on an if ask of if-conversion
+enum class IRBranchControl : uint32_t {
+    DEFAULT, // Flattened when cheap and not uniform
+    BRANCH,  // Always stays a branch
+    FLATTEN  // Flattened whenever that is possible
+};
+
+struct IRInstruction {
+    IROp op;
+    Type::Kind type;           // VOID for stores, void calls and terminators
+    uint32_t block = IR_NONE;  // IR_NONE once removed from its block
+    uint32_t firstOperand = 0; // Into IRFunction::operands
+    uint32_t operandCount = 0;
+    uint32_t imm = 0;
+    uint32_t aux = 0;
+    uint32_t name = 0;         // Into IRFunction::names; 0 = unnamed temporary
+    IRPrecision precision = IRPrecision::HIGH;
+    uint32_t line = 0;         // Source position of a builtin call, for diagnostics
+    uint32_t column = 0;       // after the passes; 0 = unknown
+};
+
+enum class IRStructure : uint8_t {
+    NONE,
+    SELECTION, // COND_BRANCH into two arms that meet again at merge
+    LOOP       // Loop header: COND_BRANCH into the body or out to merge
+};
+
+struct IRBlock {
+    std::vector<IRValue> instructions; // Phis first, terminator last
+    std::vector<uint32_t> predecessors;
+    uint32_t successors[2] = {IR_NONE, IR_NONE};
+    IRStructure structure = IRStructure::NONE;
+    uint32_t merge = IR_NONE;          // IR_NONE when no path leaves the construct
+    uint32_t continueTarget = IR_NONE; // Latch of a loop header
+    uint32_t unroll = 0;               // Loop header: unroll factor left to the target compiler, 0 = none
+};
+
+// What [[inline]] and [[noinline]] ask of the inliner
+enum class IRInlineHint : uint8_t {
+    DEFAULT,
+    ALWAYS,
+    NEVER
+};
+
+struct IRParameter {
+    std::string name;
+    Type::Kind type;
+};
+
+struct IRFunction {
+    std::string name;
+    Type::Kind returnType = Type::Kind::VOID;
+    std::vector<IRParameter> parameters;
+    uint32_t shader = IR_NONE;  // Owning shader, IR_NONE for program-level functions
+    bool entryPoint = false;    // main() of its shader
+    bool initializer = false;   // Computes the initial value of a global
+    IRInlineHint inlineHint = IRInlineHint::DEFAULT;
+    bool fastMath = false;      // [[fast]] or --fast-math: may reassociate and approximate
+    
+    std::vector<IRInstruction> instructions;
+    std::vector<IRValue> operands;
+    std::vector<IRBlock> blocks; // Entry block is 0
+    std::vector<std::string> names{""};
+    
+    uint32_t addBlock();
+    
+    // Creates an instruction without placing it in a block
+    IRValue create(IROp op, Type::Kind type, const std::vector<IRValue>& args = {}, uint32_t imm = 0);
+    // Creates an instruction at the end of a block
+    IRValue append(uint32_t block, IROp op, Type::Kind type, const std::vector<IRValue>& args = {},
+                   uint32_t imm = 0);
+    // Places an existing instruction before position `index` of a block
+    void insert(uint32_t block, size_t index, IRValue value);
+    // Takes an instruction out of its block; its index stays valid
+    void remove(IRValue value);
+    
+    IRValue* operandsOf(IRValue value) { return operands.data() + instructions[value].firstOperand; }
+    const IRValue* operandsOf(IRValue value) const { return operands.data() + instructions[value].firstOperand; }
+    IRValue operand(IRValue value, size_t index) const { return operandsOf(value)[index]; }
+    void setOperands(IRValue value, const std::vector<IRValue>& args);
+    
+    // Null when the block has no terminator yet
+    const IRInstruction* terminatorOf(uint32_t block) const;
+    IRValue terminator(uint32_t block) const;
+    
+    void branch(uint32_t from, uint32_t to);
+    void condBranch(uint32_t from, IRValue condition, uint32_t ifTrue, uint32_t ifFalse, uint32_t hint = BRANCH_UNKNOWN);
+    
+    uint32_t internName(const std::string& name);
+    const std::string& nameOf(IRValue value) const { return names[instructions[value].name]; }
+    
+    // Rewrites every operand referring to `from`
+    void replaceAllUses(IRValue from, IRValue to);
+    // Number of operands referring to each instruction, over placed instructions
+    std::vector<uint32_t> useCounts() const;
+};
+
+struct IRGlobal {
+    std::string name;
+    Type::Kind type;
+    VariableDeclaration::Qualifier qualifier;
+    uint32_t shader = IR_NONE;      // IR_NONE for program-level globals
+    bool builtin = false;           // gl_Position, idx, ...: provided by the target, never declared
+    uint32_t initializer = IR_NONE; // Function returning the initial value
+    // [[range(min, max)]] of a uniform or input; unbounded without one
+    double rangeLow = -std::numeric_limits<double>::infinity();
+    double rangeHigh = std::numeric_limits<double>::infinity();
+};
+
+struct IRConstant {
+    Type::Kind type;
+    std::vector<double> components; // Column-major for matrices; bools are 0/1
+};
+
+// A declaration of the program or of a shader, in source order
+struct IRItem {
+    enum class Kind { GLOBAL, FUNCTION, SHADER };
+    Kind kind;
+    uint32_t index;
+};
+
+struct IRShader {
+    std::string name;
+    ShaderDeclaration::ShaderType stage;
+    std::vector<IRItem> items;
+    uint32_t entryPoint = IR_NONE;
+    // Runs on the host once per draw: loads uniforms of the shader and stores
+    // the uniforms passes derived from them. No blocks when there are none.
+    IRFunction preshader;
+};
+
+struct IRModule {
+    std::vector<IRGlobal> globals;
+    std::vector<IRFunction> functions;
+    std::vector<IRConstant> constants;
+    std::vector<IRShader> shaders;
+    std::vector<IRItem> items;
+    // Declared globals taken out of the items because nothing reads them;
+    // the runtime need not upload or bind the uniforms and inputs among them
+    std::vector<uint32_t> strippedGlobals;
+    
+    // Index of the constant, adding it on first use
+    uint32_t constant(Type::Kind type, const std::vector<double>& components);
+    
+private:
+    std::map<std::pair<Type::Kind, std::vector<uint64_t>>, uint32_t> constantIndex_; // Keyed by bit pattern
+};
+
+bool isTerminator(IROp op);
+const char* irOpName(IROp op);
+
+// Swizzles are packed as a component count in bits 0-2 followed by two bits
+// per component, so `.zyx` is 3 | 2 << 3 | 1 << 5 | 0 << 7
+uint32_t packSwizzle(const std::vector<int>& components);
+int swizzleCount(uint32_t swizzle);
+int swizzleComponent(uint32_t swizzle, int index);
+
+// Effect bits (semantic/builtins.h) of calling each function, callees included
+std::vector<unsigned> functionEffects(const IRModule& module);
+
+// Operations an instruction expands to, counted the way CostModel counts
+// them: per component, builtins by their cost table entry. Passes weigh code
+// growth with it.
+int operationCount(const IRFunction& function, IRValue value);
+
+// Blocks reachable from the entry, each after all its predecessors except
+// along back edges
+std::vector<uint32_t> reversePostorder(const IRFunction& function);
+
+// Immediate dominator of every block; IR_NONE for the entry and for
+// unreachable blocks
+std::vector<uint32_t> immediateDominators(const IRFunction& function);
+
+// Drops blocks no path from the entry reaches and renumbers the rest. Phi
+// operands of removed edges go too; a loop whose latch is unreachable runs
+// its body at most once and becomes a selection.
+void removeUnreachableBlocks(IRFunction& function);
+
+// Replaces phis whose operands are all the same value (or the phi itself)
+void removeTrivialPhis(IRFunction& function);
+
+// Places a new instruction before the return of a shader's preshader,
+// creating the preshader on first use. Returns the equal instruction
+// instead when the preshader already computes the value.
+IRValue appendToPreshader(IRModule& module, uint32_t shader, IROp op, Type::Kind type,
+                          const std::vector<IRValue>& args = {}, uint32_t imm = 0, uint32_t aux = 0);
+
+// Declares a uniform of the shader, after its other uniforms, that its
+// preshader stores `value` to, or returns the one it already stores it to.
+// The name is `name`, or when empty the distinct uniforms and builtins
+// `value` combines joined by '_' (<shader>_derived_N when there are none or
+// the result is too long), made unique among the globals.
+uint32_t addDerivedUniform(IRModule& module, uint32_t shader, const std::string& name, IRValue value);
+
+// Makes every scalar const global named `name` (the program's, or one per
+// shader) start out as `value`, converted to its type, so constant folding
+// specializes the code reading it. Returns how many globals changed.
+int specializeConstant(IRModule& module, const std::string& name, double value);
+
+// Hash of what the printers emit: the declarations left in the module and
+// shader items, the functions among them and the preshaders. Values are
+// numbered in block order, so modules that print the same hash the same.
+uint64_t hashIR(const IRModule& module);
+
+// Checks the structural invariants above. Returns an empty string or the first problem found.
+std::string verifyIR(const IRModule& module);
+
+// Readable listing, one instruction per line
+std::string dumpIR(const IRModule& module);
+std::string dumpIR(const IRModule& module, const IRFunction& function);
+
+} // namespace sdl
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "ir/ir.h"
+#include "parser/ast.h"
+#include <string>
+
+namespace sdl {
+
+class UniformityAnalysis;
+
+// Builds the SSA module of an analyzed program. Locals and parameters become
+// SSA values as they are assigned (Braun et al., "Simple and Efficient
+// Construction of Static Single Assignment Form"); globals, stage variables
+// and uniforms are loaded and stored. Implicit int to float conversions are
+// made explicit. Global initializers become functions returning the value.
+class IRLowering {
+public:
+    // Returns false when the program uses something the IR does not model
+    // (out parameters, structs, arrays, strings); error() says what. Branch
+    // hints are taken from `uniformity` when given.
+    bool lower(Program& program, IRModule& module, const UniformityAnalysis* uniformity = nullptr);
+    
+    const std::string& error() const { return error_; }
+    
+private:
+    std::string error_;
+};
+
+} // namespace sdl
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "compiler/compiler.h"
+#include "ir/ir.h"
+#include "ir/passes.h"
+#include <string>
+#include <vector>
+
+namespace sdl {
+
+// One run of a pass over the module
+struct PassTiming {
+    std::string pass;
+    double milliseconds = 0.0;
+    size_t instructionsBefore = 0; // Instructions placed in blocks, all functions
+    size_t instructionsAfter = 0;
+    size_t blocksBefore = 0;
+    size_t blocksAfter = 0;
+    bool changed = false;
+};
+
+// Runs a pipeline of IR passes (ir/passes.def) over a module, verifying the
+// IR after each one. Dumps requested with setPrintBefore()/setPrintAfter()
+// are collected in getDumps().
+class PassManager {
+public:
+    // Comma-separated pass names run at each optimization level
+    static const char* pipeline(OptimizationLevel level);
+    static std::vector<std::string> passNames();
+    
+    explicit PassManager(OptimizationLevel level = OptimizationLevel::O2);
+    
+    // Replaces the pipeline by a comma-separated list of pass names; returns
+    // false and sets error() if one is unknown
+    bool setPipeline(const std::string& passes);
+    // Dump the module before or after every run of the named pass, or of
+    // every pass for "all"
+    bool setPrintBefore(const std::string& pass);
+    bool setPrintAfter(const std::string& pass);
+    void setTiming(bool timing) { timing_ = timing; }
+    void setFoldUniformProducts(bool fold) { context_.foldUniformProducts = fold; }
+    void setExtractPreshader(bool extract) { context_.extractPreshader = extract; }
+    
+    // Returns false if a pass left invalid IR; error() names the pass
+    bool run(IRModule& module);
+    
+    const std::vector<std::string>& getPipeline() const { return pipeline_; }
+    const std::vector<PassTiming>& getTimings() const { return timings_; }
+    std::string formatTimings() const;
+    // Counters the passes reported in the last run()
+    const PassStatistics& getStatistics() const { return context_.statistics; }
+    std::string formatStatistics() const;
+    const std::string& getDumps() const { return dumps_; }
+    const std::string& error() const { return error_; }
+    
+private:
+    std::vector<std::string> pipeline_;
+    std::string printBefore_;
+    std::string printAfter_;
+    bool timing_ = false;
+    std::vector<PassTiming> timings_;
+    std::string dumps_;
+    PassContext context_;
+    std::string error_;
+    
+    bool checkPassName(const std::string& pass);
+};
+
+} // namespace sdl
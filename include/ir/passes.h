@@ -0,0 +1,39 @@
+#pragma once
+
+#include "compiler/compiler.h"
+#include "ir/ir.h"
+#include <map>
+#include <string>
+
+namespace sdl {
+
+// Counters the passes add to, keyed "<pass>.<what>" (gvn.eliminated)
+using PassStatistics = std::map<std::string, int>;
+
+// What passes may consult besides the module, and where they report
+struct PassContext {
+    OptimizationLevel level = OptimizationLevel::O2;
+    bool foldUniformProducts = false; // Products of uniform matrices may become uniforms the preshader computes
+    bool extractPreshader = false;    // Any expression of uniforms may (IRShader::preshader)
+    PassStatistics statistics;
+};
+
+// Entry points of the IR passes listed in ir/passes.def. Each transforms the
+// whole module in place and returns whether it changed anything.
+
+bool simplifyCFG(IRModule& module, PassContext& context);
+bool foldConstants(IRModule& module, PassContext& context);
+bool eliminateCommonSubexpressions(IRModule& module, PassContext& context);
+bool eliminateDeadCode(IRModule& module, PassContext& context);
+bool stripUnusedGlobals(IRModule& module, PassContext& context);
+bool inlineFunctions(IRModule& module, PassContext& context);
+bool unrollLoops(IRModule& module, PassContext& context);
+bool hoistLoopInvariants(IRModule& module, PassContext& context);
+bool simplifyAlgebra(IRModule& module, PassContext& context);
+bool convertBranchesToSelects(IRModule& module, PassContext& context);
+bool reassociateMatrixChains(IRModule& module, PassContext& context);
+bool extractPreshader(IRModule& module, PassContext& context);
+bool hoistToVertexShader(IRModule& module, PassContext& context);
+bool inferPrecision(IRModule& module, PassContext& context);
+
+} // namespace sdl
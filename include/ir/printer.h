@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ir/ir.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace sdl {
+
+// Turns an IR module back into source code. Structured control flow becomes
+// nested if/while statements again; phis become variables assigned at the
+// end of each incoming edge. A value used once, in the block that computes
+// it, is written straight into its use unless something in between writes
+// what it reads; everything else gets a variable named after the source
+// variable it came from.
+class IRPrinter {
+public:
+    virtual ~IRPrinter() = default;
+    
+    // Throws std::runtime_error if the control flow is not structured
+    std::string print(const IRModule& module);
+    
+protected:
+    const IRModule* module_ = nullptr;
+    const IRFunction* function_ = nullptr; // Whose body is being printed
+    std::vector<unsigned> effects_; // functionEffects() of the module
+    std::ostringstream out_;
+    
+    virtual void printModule() = 0;
+    
+    void writeLine(int indent, const std::string& line);
+    // Statements of a function body, without the enclosing braces
+    void printBody(const IRFunction& function, int indent);
+    // The value returned by a global's initializer function, as one expression
+    std::string initializerExpression(const IRGlobal& global);
+    
+    // Target spelling
+    virtual std::string typeName(Type::Kind type) const = 0;
+    virtual std::string constant(const IRConstant& constant) const = 0;
+    virtual std::string construct(Type::Kind type, const std::vector<std::string>& args) const = 0;
+    virtual const char* builtinTemplate(const BuiltinInfo& builtin) const = 0;
+    // Replacements used in fast-math functions, by the type of the first
+    // argument or the operands; null keeps the regular spelling
+    virtual const char* fastBuiltinTemplate(const BuiltinInfo& builtin, Type::Kind argument) const;
+    virtual const char* fastDivisionTemplate(Type::Kind dividend, Type::Kind divisor) const;
+    // The template a builtin call is printed with in the current function
+    const char* templateFor(const IRInstruction& inst) const;
+    // Type a variable holding the value is declared with; typeName() unless
+    // the target spells IRInstruction::precision
+    virtual std::string variableType(const IRFunction& function, IRValue value) const;
+    // Whether the target computes the value in half-precision arithmetic,
+    // and the call converting an expression to half or back
+    virtual bool halfArithmetic(const IRFunction& function, IRValue value) const;
+    virtual std::string halfConversion(const std::string& value, Type::Kind type, bool toHalf) const;
+    // `value` is a primary expression
+    virtual std::string swizzle(const std::string& value, uint32_t swizzle) const;
+    // Statement writing `value` into the components `mask` of `target`
+    virtual std::string assignComponents(const std::string& target, uint32_t mask, const std::string& value) const;
+    // Operands the target spells more than once, which must not be expressions
+    virtual bool needsName(const IRInstruction& inst, size_t operand) const;
+    // Arguments appended to every call of a function
+    virtual std::vector<std::string> extraArguments(uint32_t function) const;
+    virtual std::string branchComment(uint32_t hint) const;
+    // Line before a loop the target compiler should unroll by `unroll`
+    // (IRBlock::unroll); empty for none
+    virtual std::string loopPragma(uint32_t unroll) const;
+    // Identifiers temporaries must not take
+    virtual bool isReserved(const std::string& name) const;
+    
+    // Shortest decimal spelling that reads back as the same value, always
+    // with a '.' or exponent so it stays a float literal
+    static std::string formatFloat(double value);
+    // Decimal int literal; INT_MIN has none, as 2147483648 itself overflows
+    static std::string formatInt(double value);
+    static std::string swizzleSuffix(uint32_t swizzle);
+    
+    friend class BodyPrinter;
+};
+
+} // namespace sdl
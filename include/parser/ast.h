@@ -11,6 +11,7 @@ class ASTNode;
 class Expression;
 class Statement;
 class Type;
+enum class BuiltinId : unsigned char; // semantic/builtins.h
 
 using ASTNodePtr = std::unique_ptr<ASTNode>;
 using ExpressionPtr = std::unique_ptr<Expression>;
@@ -20,6 +21,10 @@ using TypePtr = std::unique_ptr<Type>;
 // Base AST Node
 class ASTNode {
 public:
+    // Source position of the token that starts this node (1-based, 0 = unknown)
+    size_t line = 0;
+    size_t column = 0;
+    
     virtual ~ASTNode() = default;
     virtual void accept(class ASTVisitor& visitor) = 0;
 };
@@ -105,6 +110,7 @@ class FunctionCallExpression : public Expression {
 public:
     std::string functionName;
     std::vector<ExpressionPtr> arguments;
+    BuiltinId builtin{}; // Set by SemanticAnalyzer; a user function of the same name hides it
     
     explicit FunctionCallExpression(const std::string& name) 
         : functionName(name) {}
@@ -121,8 +127,21 @@ public:
     void accept(ASTVisitor& visitor) override;
 };
 
+// `[[name]]` or `[[name(arg, ...)]]` written in front of a declaration or statement
+struct Attribute {
+    std::string name;
+    std::vector<std::string> arguments; // Literal spellings, sign included
+    size_t line = 0;
+    size_t column = 0;
+};
+
 // Statements
 class Statement : public ASTNode {
+public:
+    std::vector<Attribute> attributes;
+    
+    // Null if the attribute is not present
+    const Attribute* findAttribute(const std::string& name) const;
 };
 
 class ExpressionStatement : public Statement {
@@ -183,6 +202,9 @@ public:
     void accept(ASTVisitor& visitor) override;
 };
 
+// Stage keyword as written in the source ("vertex", "fragment", "compute")
+const char* shaderStageName(ShaderDeclaration::ShaderType type);
+
 class BlockStatement : public Statement {
 public:
     std::vector<StatementPtr> statements;
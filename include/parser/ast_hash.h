@@ -0,0 +1,14 @@
+#pragma once
+
+#include "parser/ast.h"
+#include <cstdint>
+
+namespace sdl {
+
+// Hash of the shape and contents of a subtree: node kinds, names, literal
+// values, operators, qualifiers and types. Source positions and analysis
+// annotations are ignored, so moving a declaration within the file or
+// re-analyzing it does not change its hash.
+uint64_t structuralHash(ASTNode& node);
+
+} // namespace sdl
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "parser/ast_visitor.h"
+
+namespace sdl {
+
+// Visitor that walks the whole tree in source order. Analyses override the
+// nodes they care about and call the base implementation to keep descending.
+class ASTWalker : public ASTVisitor {
+public:
+    void visit(Type& node) override;
+    void visit(IdentifierExpression& node) override;
+    void visit(LiteralExpression& node) override;
+    void visit(BinaryExpression& node) override;
+    void visit(UnaryExpression& node) override;
+    void visit(FunctionCallExpression& node) override;
+    void visit(MemberAccessExpression& node) override;
+    void visit(ExpressionStatement& node) override;
+    void visit(AssignmentStatement& node) override;
+    void visit(VariableDeclaration& node) override;
+    void visit(FunctionDeclaration& node) override;
+    void visit(ShaderDeclaration& node) override;
+    void visit(BlockStatement& node) override;
+    void visit(IfStatement& node) override;
+    void visit(ForStatement& node) override;
+    void visit(WhileStatement& node) override;
+    void visit(ReturnStatement& node) override;
+    void visit(Program& node) override;
+    
+protected:
+    // Null-safe accept
+    void walk(ASTNode* node);
+};
+
+} // namespace sdl
@@ -52,10 +52,12 @@ private:
     ExpressionPtr parsePostfix();
     ExpressionPtr parseFunctionCall(const std::string& name);
     
+    std::vector<Attribute> parseAttributes();
     TypePtr parseType();
     VariableDeclaration::Qualifier parseQualifier();
     ShaderDeclaration::ShaderType parseShaderType();
     
+    void setLocation(ASTNode& node, const Token& token);
     void synchronize();
     void reportError(const std::string& message);
 };
@@ -1,10 +1,44 @@
 #pragma once
 
+#include "semantic/dependency_graph.h"
+#include "utils/error_handler.h"
+#include <vector>
+
 namespace sdl {
 
 class SemanticAnalyzer {
 public:
+    // Resolves names, type-checks every declaration and annotates each
+    // Expression with its resultType. Returns false if any error was found.
+    //
+    // Top-level globals and functions are checked once and then frozen into
+    // an immutable scope that every ShaderDeclaration shares; shader bodies
+    // are independent of each other and are checked on worker threads.
     bool analyze(class Program& program);
+    
+    // Maximum number of worker threads (0 = one per hardware thread, 1 = serial)
+    void setThreadCount(unsigned count) { threadCount_ = count; }
+    
+    // When enabled, analyze() reuses the results of the previous call for
+    // every declaration whose structural hash and dependencies are unchanged
+    void setIncremental(bool enabled) { incremental_ = enabled; }
+    
+    // Diagnostics of the last analyze() call, in source order
+    const std::vector<Diagnostic>& getDiagnostics() const { return diagnostics_; }
+    bool hasErrors() const;
+    
+    // Dependency graph built by the last analyze() call
+    const DependencyGraph& getDependencyGraph() const { return graph_; }
+    size_t getReanalyzedCount() const { return reanalyzedCount_; }
+    size_t getReusedCount() const { return reusedCount_; }
+    
+private:
+    unsigned threadCount_ = 0;
+    bool incremental_ = false;
+    std::vector<Diagnostic> diagnostics_;
+    DependencyGraph graph_;
+    size_t reanalyzedCount_ = 0;
+    size_t reusedCount_ = 0;
 };
 
 } // namespace sdl
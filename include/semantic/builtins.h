@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace sdl {
+
+// What evaluating a function or call depends on and changes, as bit flags
+namespace Effect {
+enum : unsigned {
+    NONE = 0,
+    READS_UNIFORMS = 1u << 0,   // Uniforms: the same for every invocation of a draw
+    READS_INPUTS = 1u << 1,     // Stage inputs and invocation IDs
+    SAMPLES_TEXTURES = 1u << 2, // texture(), derivatives: depend on neighbouring invocations
+    READS_MUTABLE = 1u << 3,    // Globals or outputs that some function writes
+    WRITES_OUTPUTS = 1u << 4,   // out variables, gl_Position, gl_FragDepth
+    WRITES_GLOBALS = 1u << 5,   // Private globals
+    WRITES_ARGUMENTS = 1u << 6, // out parameters
+};
+}
+
+// Builtin functions, interned by the parser into FunctionCallExpression::builtin
+enum class BuiltinId : unsigned char {
+    NONE, // Not a builtin name
+#define SDL_BUILTIN(id, ...) id,
+#include "semantic/builtins.def"
+#undef SDL_BUILTIN
+};
+
+// How the result type of a builtin call is derived from its arguments
+enum class ResultRule {
+    SAME_AS_FIRST,  // genType f(genType, ...)
+    SAME_AS_LAST,   // step(edge, x), smoothstep(e0, e1, x)
+    FLOAT,          // dot, length, distance, determinant
+    VEC3,           // cross
+    VEC4            // texture lookups
+};
+
+namespace BuiltinFlag {
+enum : unsigned {
+    INT_RESULT = 1u << 0,    // Has int overloads: int arguments give an int result
+    TEXTURE_FETCH = 1u << 1, // First argument is a sampler
+    DERIVATIVE = 1u << 2,    // Result differs between neighbouring invocations
+};
+}
+
+// Cost of one call of a builtin. Counts are per component of the first
+// argument plus a fixed part, so sin(vec3) costs three transcendental ops.
+struct BuiltinCost {
+    int aluPerComponent;
+    int aluFixed;
+    int transcendentalPerComponent;
+    int transcendentalFixed;
+    int textureFetches;
+    // Cycles of one transcendental op of this builtin on each target
+    double glslTranscendentalCycles;
+    double cudaTranscendentalCycles;
+};
+
+// Evaluates the builtin on scalar constants in single precision; vector
+// calls apply it per component
+using BuiltinFold = double (*)(const double* args, size_t count);
+
+struct BuiltinInfo {
+    BuiltinId id;
+    const char* name;
+    // Overloads: every count in [minArgs, maxArgs] over float, vecN and, with
+    // INT_RESULT, int arguments; samplers only where TEXTURE_FETCH says so
+    int minArgs;
+    int maxArgs;
+    ResultRule rule;
+    unsigned flags;
+    BuiltinCost cost;
+    unsigned effects;  // Effect bits of every call
+    BuiltinFold fold;  // Null when not componentwise (dot, texture, ...)
+    // Lowering templates, see builtins.def
+    const char* glsl;
+    const char* cuda;
+    const char* cpu;   // Null when there is no scalar host equivalent
+    
+    bool has(unsigned flag) const { return (flags & flag) != 0; }
+};
+
+// Interns a call name; BuiltinId::NONE for anything that is not a builtin
+BuiltinId findBuiltinId(const std::string& name);
+
+// Table entry of an interned id, null for BuiltinId::NONE
+const BuiltinInfo* builtinInfo(BuiltinId id);
+
+inline const BuiltinInfo* findBuiltin(const std::string& name) {
+    return builtinInfo(findBuiltinId(name));
+}
+
+// Expands a lowering template over the already generated argument
+// expressions. Returns an empty string for a null template.
+std::string lowerBuiltin(const char* pattern, const std::vector<std::string>& args, int minArgs);
+
+} // namespace sdl
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "parser/ast.h"
+#include "utils/error_handler.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sdl {
+
+// A name a declaration refers to and what it resolved to when checked
+struct Dependency {
+    std::string name;
+    std::string key;   // Key of the resolved declaration, empty if unresolved
+    uint64_t hash = 0; // Structural hash of the resolved declaration(s)
+};
+
+// Analysis results of one program-level or shader-level declaration
+struct DeclarationRecord {
+    // "::name" at program level, "shader::name" inside a shader; functions
+    // append their parameter types so overloads get distinct keys
+    std::string key;
+    uint64_t hash = 0;
+    size_t line = 0;
+    std::vector<Dependency> dependencies;
+    std::vector<Diagnostic> diagnostics;
+    // resultType of every expression in the declaration, in pre-order
+    std::vector<std::optional<Type::Kind>> expressionTypes;
+};
+
+// Function-level dependency graph: which functions, globals and uniforms
+// every declaration depends on, together with the results of checking it
+class DependencyGraph {
+public:
+    void add(DeclarationRecord record);
+    const DeclarationRecord* find(const std::string& key) const;
+    
+    // Keys of the declarations that directly depend on `key`
+    std::vector<std::string> dependents(const std::string& key) const;
+    
+    size_t size() const { return records_.size(); }
+    bool empty() const { return records_.empty(); }
+    
+private:
+    std::unordered_map<std::string, DeclarationRecord> records_;
+};
+
+} // namespace sdl
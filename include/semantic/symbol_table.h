@@ -1,15 +1,64 @@
 #pragma once
 
+#include "parser/ast.h"
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace sdl {
 
+struct Symbol {
+    enum class Kind { VARIABLE, FUNCTION, BUILTIN_VARIABLE };
+    
+    Kind kind = Kind::VARIABLE;
+    Type::Kind type = Type::Kind::VOID; // Variable type or function return type
+    VariableDeclaration::Qualifier qualifier = VariableDeclaration::Qualifier::NONE;
+    const VariableDeclaration* variable = nullptr;
+    std::vector<const FunctionDeclaration*> overloads;
+    size_t depth = 0; // Scope depth the symbol was defined at (0 = outermost)
+};
+
+// An immutable, flattened view of a set of scopes. Snapshots are shared
+// between threads, so nothing may modify them after creation.
+class FrozenScope {
+public:
+    FrozenScope(std::unordered_map<std::string, Symbol> symbols, size_t depth,
+                std::shared_ptr<const FrozenScope> parent)
+        : symbols_(std::move(symbols)), depth_(depth), parent_(std::move(parent)) {}
+    
+    const Symbol* lookup(const std::string& name) const;
+    // Number of scope levels covered by this snapshot and its parents
+    size_t depth() const { return depth_; }
+
+private:
+    std::unordered_map<std::string, Symbol> symbols_;
+    size_t depth_;
+    std::shared_ptr<const FrozenScope> parent_;
+};
+
 class SymbolTable {
 public:
+    SymbolTable();
+    // Starts with a read-only base; new scopes are opened on top of it
+    explicit SymbolTable(std::shared_ptr<const FrozenScope> base);
+    
     void enterScope();
     void exitScope();
-    void define(const std::string& name, const std::string& type);
-    bool lookup(const std::string& name);
+    
+    // Returns false if the name already exists in the innermost scope
+    bool define(const std::string& name, const Symbol& symbol);
+    const Symbol* lookup(const std::string& name) const;
+    Symbol* lookupCurrentScope(const std::string& name);
+    
+    size_t depth() const;
+    
+    // Snapshot of every visible symbol, usable as the base of other tables
+    std::shared_ptr<const FrozenScope> freeze() const;
+
+private:
+    std::shared_ptr<const FrozenScope> base_;
+    std::vector<std::unordered_map<std::string, Symbol>> scopes_;
 };
 
 } // namespace sdl
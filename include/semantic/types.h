@@ -0,0 +1,34 @@
+#pragma once
+
+#include "parser/ast.h"
+#include <string>
+
+namespace sdl {
+
+// Helpers for reasoning about the built-in value types of the DSL
+
+// Number of scalar components (vec3 = 3, mat4 = 16, samplers/void = 0)
+int componentCount(Type::Kind kind);
+
+// Number of columns of a square matrix type (mat3 = 3), 0 for non-matrices
+int matrixDimension(Type::Kind kind);
+
+bool isScalar(Type::Kind kind);
+bool isNumeric(Type::Kind kind);
+bool isFloatVector(Type::Kind kind);
+bool isMatrix(Type::Kind kind);
+bool isSampler(Type::Kind kind);
+
+// float for n == 1, vecN for 2..4, VOID otherwise
+Type::Kind floatVectorType(int components);
+
+// matN for n in 2..4, VOID otherwise
+Type::Kind matrixType(int dimension);
+
+// Spelling of the type in the DSL (and GLSL), e.g. "vec3"
+std::string typeName(Type::Kind kind);
+
+// Parses a type keyword used as a constructor name ("vec3" -> VEC3)
+bool typeFromName(const std::string& name, Type::Kind& kind);
+
+} // namespace sdl
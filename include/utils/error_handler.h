@@ -1,12 +1,34 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 namespace sdl {
 
+// A single message produced by an analysis, tied to a source position
+struct Diagnostic {
+    enum class Severity { ERROR, WARNING, NOTE };
+    
+    Severity severity = Severity::ERROR;
+    std::string message;
+    size_t line = 0;
+    size_t column = 0;
+    
+    Diagnostic() = default;
+    Diagnostic(Severity s, const std::string& msg, size_t l = 0, size_t c = 0)
+        : severity(s), message(msg), line(l), column(c) {}
+    
+    // "line 3, column 7: message" (position omitted when unknown)
+    std::string format() const;
+};
+
 class ErrorHandler {
 public:
     static void report(const std::string& message);
+    
+    // Stable-sorts diagnostics by source position so that messages produced
+    // by independent workers read in the same order as the input file
+    static void sortBySourceOrder(std::vector<Diagnostic>& diagnostics);
 };
 
 } // namespace sdl
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace sdl {
+
+// Streaming writer for machine-readable reports. Output is pretty-printed
+// with two-space indentation; keys appear in the order they are written.
+class JsonWriter {
+public:
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+    
+    // Must be followed by exactly one value, object or array
+    JsonWriter& key(const std::string& name);
+    
+    JsonWriter& value(const std::string& text);
+    JsonWriter& number(double value);
+    JsonWriter& integer(long long value);
+    JsonWriter& boolean(bool value);
+    JsonWriter& null();
+    
+    std::string str() const { return out_.str(); }
+    
+    static std::string escape(const std::string& text);
+    
+private:
+    std::ostringstream out_;
+    std::vector<bool> hasElements_; // One entry per open object/array
+    bool afterKey_ = false;
+    
+    void beginValue();
+    void newline();
+};
+
+// Document read by parseJson(). Objects keep their members in file order.
+struct JsonValue {
+    enum class Kind { NULL_VALUE, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+    
+    Kind kind = Kind::NULL_VALUE;
+    bool boolean = false;
+    double number = 0;
+    std::string text;
+    std::vector<JsonValue> elements; // Array elements or object member values
+    std::vector<std::string> keys;   // Object member names, parallel to elements
+};
+
+// Parses a complete document. Throws std::runtime_error naming the line of
+// the first syntax error.
+JsonValue parseJson(const std::string& text);
+
+} // namespace sdl
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace sdl {
+
+class Parallel {
+public:
+    // Number of workers to use when the caller asks for "auto" (0)
+    static unsigned defaultThreadCount();
+    
+    // Runs task(i) for every i in [0, count) on up to maxThreads workers.
+    // Tasks must not touch shared mutable state; results should be written
+    // to per-index slots. Exceptions are rethrown on the calling thread.
+    static void forEach(size_t count, unsigned maxThreads,
+                        const std::function<void(size_t)>& task);
+};
+
+} // namespace sdl
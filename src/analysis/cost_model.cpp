@@ -0,0 +1,314 @@
+#include "analysis/cost_model.h"
+#include "analysis/function_lookup.h"
+#include "analysis/loop_analysis.h"
+#include "semantic/builtins.h"
+#include "semantic/types.h"
+#include <algorithm>
+
+namespace sdl {
+
+namespace {
+
+// Scalar components an expression works on (1 when untyped)
+int components(const Expression* expr) {
+    if (!expr || !expr->resultType) {
+        return 1;
+    }
+    return std::max(1, componentCount(expr->resultType->kind));
+}
+
+Type::Kind kindOf(const Expression* expr) {
+    return expr && expr->resultType ? expr->resultType->kind : Type::Kind::VOID;
+}
+
+} // anonymous namespace
+
+CostEstimate& CostEstimate::operator+=(const CostEstimate& other) {
+    aluOps += other.aluOps;
+    transcendentalOps += other.transcendentalOps;
+    textureFetches += other.textureFetches;
+    branches += other.branches;
+    cycles += other.cycles;
+    return *this;
+}
+
+CostEstimate CostEstimate::scaled(int64_t times) const {
+    CostEstimate result;
+    result.aluOps = aluOps * times;
+    result.transcendentalOps = transcendentalOps * times;
+    result.textureFetches = textureFetches * times;
+    result.branches = branches * times;
+    result.cycles = cycles * static_cast<double>(times);
+    return result;
+}
+
+CostModel::CostModel(TargetLanguage target) : target_(target) {
+    if (target == TargetLanguage::CUDA) {
+        // IEEE division and texture reads through the texture path are
+        // slower relative to ALU than on graphics pipelines; a diverging
+        // warp pays for both sides of a branch
+        weights_ = Weights{1.0, 8.0, 8.0, 4.0};
+    } else {
+        weights_ = Weights{1.0, 4.0, 4.0, 2.0};
+    }
+}
+
+std::vector<ShaderCost> CostModel::analyze(Program& program) {
+    std::vector<ShaderCost> result;
+    for (auto& decl : program.declarations) {
+        auto shader = dynamic_cast<ShaderDeclaration*>(decl.get());
+        if (!shader) {
+            continue;
+        }
+        
+        FunctionLookup lookup(program, *shader);
+        lookup_ = &lookup;
+        costs_.clear();
+        
+        ShaderCost shaderCost;
+        shaderCost.name = shader->name;
+        shaderCost.stage = shader->shaderType;
+        for (auto& stmt : shader->body) {
+            if (auto func = dynamic_cast<FunctionDeclaration*>(stmt.get())) {
+                functionCost(*func);
+            }
+        }
+        if (FunctionDeclaration* main = lookup.entryPoint()) {
+            shaderCost.cost = functionCost(*main).cost;
+        }
+        lookup_ = nullptr;
+        
+        // Shader functions plus the program-level functions they reach
+        for (auto& entry : costs_) {
+            shaderCost.functions.push_back(entry.second);
+        }
+        std::sort(shaderCost.functions.begin(), shaderCost.functions.end(),
+                  [](const FunctionCost& a, const FunctionCost& b) { return a.line < b.line; });
+        
+        result.push_back(std::move(shaderCost));
+    }
+    return result;
+}
+
+const FunctionCost& CostModel::functionCost(FunctionDeclaration& func) {
+    auto it = costs_.find(&func);
+    if (it != costs_.end()) {
+        return it->second;
+    }
+    
+    // Recursion is not allowed in shaders; do not loop forever on it
+    static const FunctionCost recursive;
+    if (!inProgress_.insert(&func).second) {
+        return recursive;
+    }
+    
+    FunctionCost result;
+    result.name = func.name;
+    result.line = func.line;
+    
+    std::vector<LoopCost>* outerLoops = loops_;
+    loops_ = &result.loops;
+    for (auto& stmt : func.body) {
+        result.cost += cost(stmt.get());
+    }
+    loops_ = outerLoops;
+    inProgress_.erase(&func);
+    
+    std::sort(result.loops.begin(), result.loops.end(),
+              [](const LoopCost& a, const LoopCost& b) { return a.line < b.line; });
+    return costs_[&func] = std::move(result);
+}
+
+CostEstimate CostModel::alu(int64_t ops) const {
+    CostEstimate result;
+    result.aluOps = ops;
+    result.cycles = static_cast<double>(ops) * weights_.alu;
+    return result;
+}
+
+CostEstimate CostModel::cost(Statement* stmt) {
+    CostEstimate result;
+    if (!stmt) {
+        return result;
+    }
+    
+    if (auto exprStmt = dynamic_cast<ExpressionStatement*>(stmt)) {
+        result = cost(exprStmt->expression.get());
+    } else if (auto assignment = dynamic_cast<AssignmentStatement*>(stmt)) {
+        result = cost(assignment->target.get());
+        result += cost(assignment->value.get());
+    } else if (auto var = dynamic_cast<VariableDeclaration*>(stmt)) {
+        result = cost(var->initializer.get());
+    } else if (auto block = dynamic_cast<BlockStatement*>(stmt)) {
+        for (auto& blockStmt : block->statements) {
+            result += cost(blockStmt.get());
+        }
+    } else if (auto ifStmt = dynamic_cast<IfStatement*>(stmt)) {
+        result = cost(ifStmt->condition.get());
+        CostEstimate thenCost = cost(ifStmt->thenStatement.get());
+        CostEstimate elseCost = cost(ifStmt->elseStatement.get());
+        result += thenCost.cycles >= elseCost.cycles ? thenCost : elseCost;
+        result.branches += 1;
+        result.cycles += weights_.branch;
+    } else if (auto forStmt = dynamic_cast<ForStatement*>(stmt)) {
+        LoopCost loop;
+        loop.line = forStmt->line;
+        loop.iteration = cost(forStmt->condition.get());
+        loop.iteration += cost(forStmt->body.get());
+        loop.iteration += cost(forStmt->update.get());
+        loop.iteration.branches += 1;
+        loop.iteration.cycles += weights_.branch;
+        
+        if (auto counted = analyzeCountedLoop(*forStmt)) {
+            loop.tripCount = counted->tripCount;
+        }
+        
+        result = cost(forStmt->initialization.get());
+        result += loop.iteration.scaled(loop.tripCount >= 0 ? loop.tripCount : 1);
+        if (loops_) {
+            loops_->push_back(loop);
+        }
+    } else if (auto whileStmt = dynamic_cast<WhileStatement*>(stmt)) {
+        LoopCost loop;
+        loop.line = whileStmt->line;
+        loop.iteration = cost(whileStmt->condition.get());
+        loop.iteration += cost(whileStmt->body.get());
+        loop.iteration.branches += 1;
+        loop.iteration.cycles += weights_.branch;
+        
+        result = loop.iteration;
+        if (loops_) {
+            loops_->push_back(loop);
+        }
+    } else if (auto returnStmt = dynamic_cast<ReturnStatement*>(stmt)) {
+        result = cost(returnStmt->value.get());
+    }
+    return result;
+}
+
+CostEstimate CostModel::cost(Expression* expr) {
+    CostEstimate result;
+    if (!expr) {
+        return result;
+    }
+    
+    if (auto binary = dynamic_cast<BinaryExpression*>(expr)) {
+        result = cost(binary->left.get());
+        result += cost(binary->right.get());
+        
+        int n = components(expr);
+        switch (binary->op) {
+            case BinaryExpression::Operator::ASSIGN:
+                break;
+            case BinaryExpression::Operator::MULTIPLY: {
+                Type::Kind left = kindOf(binary->left.get());
+                Type::Kind right = kindOf(binary->right.get());
+                if (isMatrix(left) || isMatrix(right)) {
+                    // Matrix products cost a dot product per result component
+                    int dim = matrixDimension(isMatrix(left) ? left : right);
+                    bool bothMatrices = isMatrix(left) && isMatrix(right);
+                    result += alu(bothMatrices ? dim * dim * dim : dim * dim);
+                } else {
+                    result += alu(n);
+                }
+                break;
+            }
+            case BinaryExpression::Operator::DIVIDE:
+            case BinaryExpression::Operator::MODULO:
+                // Reciprocal followed by a multiply
+                result += alu(n);
+                result.transcendentalOps += n;
+                result.cycles += n * weights_.divide;
+                break;
+            case BinaryExpression::Operator::ADD:
+            case BinaryExpression::Operator::SUBTRACT:
+                result += alu(n);
+                break;
+            default:
+                result += alu(1);
+                break;
+        }
+    } else if (auto unary = dynamic_cast<UnaryExpression*>(expr)) {
+        result = cost(unary->operand.get());
+        // Negation is a free source modifier
+        if (unary->op == UnaryExpression::Operator::LOGICAL_NOT) {
+            result += alu(1);
+        }
+    } else if (auto call = dynamic_cast<FunctionCallExpression*>(expr)) {
+        for (auto& arg : call->arguments) {
+            result += cost(arg.get());
+        }
+        
+        Type::Kind constructed;
+        if (typeFromName(call->functionName, constructed)) {
+            // Constructors are register moves
+            return result;
+        }
+        
+        if (FunctionDeclaration* callee = lookup_->resolve(*call)) {
+            result += functionCost(*callee).cost;
+        } else if (const BuiltinInfo* info = builtinInfo(call->builtin)) {
+            const BuiltinCost& builtin = info->cost;
+            int n = call->arguments.empty() ? 1 : components(call->arguments[0].get());
+            int64_t transcendental = builtin.transcendentalPerComponent * n + builtin.transcendentalFixed;
+            double transcendentalCycles = target_ == TargetLanguage::CUDA
+                ? builtin.cudaTranscendentalCycles : builtin.glslTranscendentalCycles;
+            
+            result += alu(builtin.aluPerComponent * n + builtin.aluFixed);
+            result.transcendentalOps += transcendental;
+            result.textureFetches += builtin.textureFetches;
+            result.cycles += transcendental * transcendentalCycles +
+                             builtin.textureFetches * weights_.texture;
+        }
+    } else if (auto member = dynamic_cast<MemberAccessExpression*>(expr)) {
+        // Swizzles and constant indexing are free
+        result = cost(member->object.get());
+    }
+    return result;
+}
+
+void CostModel::writeJSON(JsonWriter& json, const CostEstimate& cost) {
+    json.beginObject();
+    json.key("alu").integer(cost.aluOps);
+    json.key("transcendental").integer(cost.transcendentalOps);
+    json.key("texture").integer(cost.textureFetches);
+    json.key("branches").integer(cost.branches);
+    json.key("cycles").number(cost.cycles);
+    json.endObject();
+}
+
+void CostModel::writeJSON(JsonWriter& json, const ShaderCost& shader) {
+    json.key("name").value(shader.name);
+    json.key("stage").value(shaderStageName(shader.stage));
+    json.key("cost");
+    writeJSON(json, shader.cost);
+    
+    json.key("functions").beginArray();
+    for (const FunctionCost& func : shader.functions) {
+        json.beginObject();
+        json.key("name").value(func.name);
+        json.key("line").integer(static_cast<long long>(func.line));
+        json.key("cost");
+        writeJSON(json, func.cost);
+        
+        json.key("loops").beginArray();
+        for (const LoopCost& loop : func.loops) {
+            json.beginObject();
+            json.key("line").integer(static_cast<long long>(loop.line));
+            json.key("tripCount");
+            if (loop.tripCount >= 0) {
+                json.integer(loop.tripCount);
+            } else {
+                json.null();
+            }
+            json.key("iteration");
+            writeJSON(json, loop.iteration);
+            json.endObject();
+        }
+        json.endArray();
+        json.endObject();
+    }
+    json.endArray();
+}
+
+} // namespace sdl
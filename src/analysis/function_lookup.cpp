@@ -0,0 +1,50 @@
+#include "analysis/function_lookup.h"
+
+namespace sdl {
+
+FunctionLookup::FunctionLookup(Program& program, ShaderDeclaration& shader) {
+    std::unordered_map<std::string, std::vector<FunctionDeclaration*>> local;
+    for (auto& stmt : shader.body) {
+        if (auto func = dynamic_cast<FunctionDeclaration*>(stmt.get())) {
+            local[func->name].push_back(func);
+            if (func->name == "main" && !entryPoint_) {
+                entryPoint_ = func;
+            }
+        }
+    }
+    
+    for (auto& decl : program.declarations) {
+        auto func = dynamic_cast<FunctionDeclaration*>(decl.get());
+        if (func && !local.count(func->name)) {
+            functions_[func->name].push_back(func);
+        }
+    }
+    for (auto& entry : local) {
+        functions_[entry.first] = std::move(entry.second);
+    }
+}
+
+FunctionDeclaration* FunctionLookup::resolve(FunctionCallExpression& call) const {
+    auto it = functions_.find(call.functionName);
+    if (it == functions_.end() || it->second.empty()) {
+        return nullptr;
+    }
+    
+    for (FunctionDeclaration* candidate : it->second) {
+        if (candidate->parameters.size() != call.arguments.size()) {
+            continue;
+        }
+        bool matches = true;
+        for (size_t i = 0; i < call.arguments.size() && matches; ++i) {
+            const auto& param = candidate->parameters[i];
+            const auto& arg = call.arguments[i];
+            matches = param->type && arg && arg->resultType && param->type->kind == arg->resultType->kind;
+        }
+        if (matches) {
+            return candidate;
+        }
+    }
+    return it->second.front();
+}
+
+} // namespace sdl
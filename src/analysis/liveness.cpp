@@ -0,0 +1,333 @@
+#include "analysis/liveness.h"
+#include "analysis/function_lookup.h"
+#include "parser/ast_walker.h"
+#include "semantic/types.h"
+#include <algorithm>
+
+namespace sdl {
+
+namespace {
+
+class CallCollector : public ASTWalker {
+public:
+    std::vector<FunctionCallExpression*> calls;
+    
+    void visit(FunctionCallExpression& node) override {
+        calls.push_back(&node);
+        ASTWalker::visit(node);
+    }
+};
+
+// Adds the locals and parameters an expression reads
+class UseCollector : public ASTWalker {
+public:
+    UseCollector(const NameResolution& names, std::unordered_set<const VariableDeclaration*>& live)
+        : names_(names), live_(live) {}
+    
+    void visit(IdentifierExpression& node) override {
+        const VariableDeclaration* var = names_.find(node);
+        if (var && names_.isLocal(var)) {
+            live_.insert(var);
+        }
+    }
+    
+private:
+    const NameResolution& names_;
+    std::unordered_set<const VariableDeclaration*>& live_;
+};
+
+// Target and value of an assignment statement or `a = b;` expression statement
+bool splitAssignment(Statement* stmt, Expression*& target, Expression*& value) {
+    if (auto assignment = dynamic_cast<AssignmentStatement*>(stmt)) {
+        target = assignment->target.get();
+        value = assignment->value.get();
+        return true;
+    }
+    if (auto exprStmt = dynamic_cast<ExpressionStatement*>(stmt)) {
+        auto binary = dynamic_cast<BinaryExpression*>(exprStmt->expression.get());
+        if (binary && binary->op == BinaryExpression::Operator::ASSIGN) {
+            target = binary->left.get();
+            value = binary->right.get();
+            return true;
+        }
+    }
+    return false;
+}
+
+// Expressions evaluated by the statement itself, not by nested statements
+std::vector<Expression*> ownExpressions(Statement* stmt) {
+    if (auto exprStmt = dynamic_cast<ExpressionStatement*>(stmt)) {
+        return {exprStmt->expression.get()};
+    } else if (auto assignment = dynamic_cast<AssignmentStatement*>(stmt)) {
+        return {assignment->target.get(), assignment->value.get()};
+    } else if (auto var = dynamic_cast<VariableDeclaration*>(stmt)) {
+        return {var->initializer.get()};
+    } else if (auto ifStmt = dynamic_cast<IfStatement*>(stmt)) {
+        return {ifStmt->condition.get()};
+    } else if (auto forStmt = dynamic_cast<ForStatement*>(stmt)) {
+        return {forStmt->condition.get()};
+    } else if (auto whileStmt = dynamic_cast<WhileStatement*>(stmt)) {
+        return {whileStmt->condition.get()};
+    } else if (auto returnStmt = dynamic_cast<ReturnStatement*>(stmt)) {
+        return {returnStmt->value.get()};
+    }
+    return {};
+}
+
+} // anonymous namespace
+
+std::vector<RegisterPressure> LivenessAnalysis::analyze(Program& program) {
+    names_.resolve(program);
+    
+    std::vector<RegisterPressure> result;
+    for (auto& decl : program.declarations) {
+        auto shader = dynamic_cast<ShaderDeclaration*>(decl.get());
+        if (!shader) {
+            continue;
+        }
+        
+        FunctionLookup lookup(program, *shader);
+        lookup_ = &lookup;
+        results_.clear();
+        
+        RegisterPressure pressure;
+        pressure.shader = shader->name;
+        pressure.stage = shader->shaderType;
+        for (auto& stmt : shader->body) {
+            if (auto func = dynamic_cast<FunctionDeclaration*>(stmt.get())) {
+                functionPressure(*func);
+            }
+        }
+        if (FunctionDeclaration* main = lookup.entryPoint()) {
+            const FunctionPressure& mainPressure = functionPressure(*main);
+            pressure.peakScalars = mainPressure.peakScalars;
+            pressure.peakLine = mainPressure.peakLine;
+        }
+        lookup_ = nullptr;
+        
+        for (auto& entry : results_) {
+            pressure.functions.push_back(entry.second);
+        }
+        std::sort(pressure.functions.begin(), pressure.functions.end(),
+                  [](const FunctionPressure& a, const FunctionPressure& b) { return a.line < b.line; });
+        
+        result.push_back(std::move(pressure));
+    }
+    return result;
+}
+
+const FunctionPressure& LivenessAnalysis::functionPressure(FunctionDeclaration& func) {
+    auto it = results_.find(&func);
+    if (it != results_.end()) {
+        return it->second;
+    }
+    
+    // Recursion is not allowed in shaders; do not loop forever on it
+    static const FunctionPressure recursive;
+    if (!inProgress_.insert(&func).second) {
+        return recursive;
+    }
+    
+    // Callees are analyzed on demand from inside this function; keep our state
+    FunctionPressure* outerCurrent = current_;
+    bool outerRecording = recording_;
+    
+    FunctionPressure pressure;
+    pressure.name = func.name;
+    pressure.line = func.line;
+    current_ = &pressure;
+    recording_ = true;
+    transferList(func.body, LiveSet());
+    
+    current_ = outerCurrent;
+    recording_ = outerRecording;
+    inProgress_.erase(&func);
+    
+    return results_[&func] = std::move(pressure);
+}
+
+LivenessAnalysis::LiveSet LivenessAnalysis::transferList(std::vector<StatementPtr>& statements,
+                                                         const LiveSet& liveOut) {
+    LiveSet live = liveOut;
+    for (auto it = statements.rbegin(); it != statements.rend(); ++it) {
+        live = transfer(it->get(), live);
+    }
+    return live;
+}
+
+LivenessAnalysis::LiveSet LivenessAnalysis::transfer(Statement* stmt, const LiveSet& liveOut) {
+    if (!stmt) {
+        return liveOut;
+    }
+    
+    LiveSet liveIn;
+    Expression* target = nullptr;
+    Expression* value = nullptr;
+    
+    if (auto block = dynamic_cast<BlockStatement*>(stmt)) {
+        return transferList(block->statements, liveOut);
+    } else if (splitAssignment(stmt, target, value)) {
+        liveIn = liveOut;
+        // Only a whole-variable write kills; `v.x = ...` keeps the rest of v live
+        if (const VariableDeclaration* defined = definedVariable(target)) {
+            liveIn.erase(defined);
+        }
+        addUses(value, liveIn);
+    } else if (auto var = dynamic_cast<VariableDeclaration*>(stmt)) {
+        liveIn = liveOut;
+        liveIn.erase(var);
+        addUses(var->initializer.get(), liveIn);
+    } else if (auto returnStmt = dynamic_cast<ReturnStatement*>(stmt)) {
+        // Nothing after a return is reached
+        addUses(returnStmt->value.get(), liveIn);
+        record(*stmt, liveIn, LiveSet());
+        return liveIn;
+    } else if (auto ifStmt = dynamic_cast<IfStatement*>(stmt)) {
+        liveIn = transfer(ifStmt->thenStatement.get(), liveOut);
+        LiveSet elseIn = ifStmt->elseStatement ? transfer(ifStmt->elseStatement.get(), liveOut) : liveOut;
+        liveIn.insert(elseIn.begin(), elseIn.end());
+        addUses(ifStmt->condition.get(), liveIn);
+    } else if (auto forStmt = dynamic_cast<ForStatement*>(stmt)) {
+        LiveSet head = loopHead(forStmt->condition.get(), forStmt->body.get(),
+                                forStmt->update.get(), liveOut);
+        record(*stmt, head, liveOut);
+        return transfer(forStmt->initialization.get(), head);
+    } else if (auto whileStmt = dynamic_cast<WhileStatement*>(stmt)) {
+        liveIn = loopHead(whileStmt->condition.get(), whileStmt->body.get(), nullptr, liveOut);
+    } else {
+        auto exprs = ownExpressions(stmt);
+        liveIn = liveOut;
+        for (Expression* expr : exprs) {
+            addUses(expr, liveIn);
+        }
+    }
+    
+    record(*stmt, liveIn, liveOut);
+    return liveIn;
+}
+
+LivenessAnalysis::LiveSet LivenessAnalysis::loopHead(Expression* condition, Statement* body,
+                                                     Statement* update, const LiveSet& liveOut) {
+    LiveSet exit = liveOut;
+    addUses(condition, exit);
+    
+    // Iterate to a fixed point without recording, then record one final pass
+    bool recording = recording_;
+    recording_ = false;
+    LiveSet head = exit;
+    while (true) {
+        LiveSet next = transfer(body, transfer(update, head));
+        next.insert(exit.begin(), exit.end());
+        if (next == head) {
+            break;
+        }
+        head = std::move(next);
+    }
+    
+    recording_ = recording;
+    if (recording_) {
+        transfer(body, transfer(update, head));
+    }
+    return head;
+}
+
+void LivenessAnalysis::record(Statement& stmt, const LiveSet& liveIn, const LiveSet& liveOut) {
+    if (!recording_ || !current_) {
+        return;
+    }
+    
+    int pressure = std::max(scalars(liveIn), scalars(liveOut));
+    if (int callee = calleePeak(stmt)) {
+        LiveSet across;
+        for (const VariableDeclaration* var : liveIn) {
+            if (liveOut.count(var)) {
+                across.insert(var);
+            }
+        }
+        pressure = std::max(pressure, scalars(across) + callee);
+    }
+    
+    if (pressure > current_->peakScalars ||
+        (pressure == current_->peakScalars && stmt.line < current_->peakLine)) {
+        current_->peakScalars = pressure;
+        current_->peakLine = stmt.line;
+    }
+}
+
+int LivenessAnalysis::calleePeak(Statement& stmt) {
+    int peak = 0;
+    for (Expression* expr : ownExpressions(&stmt)) {
+        if (!expr) {
+            continue;
+        }
+        CallCollector collector;
+        expr->accept(collector);
+        for (FunctionCallExpression* call : collector.calls) {
+            if (FunctionDeclaration* callee = lookup_->resolve(*call)) {
+                peak = std::max(peak, functionPressure(*callee).peakScalars);
+            }
+        }
+    }
+    return peak;
+}
+
+void LivenessAnalysis::addUses(Expression* expr, LiveSet& live) const {
+    if (expr) {
+        UseCollector collector(names_, live);
+        expr->accept(collector);
+    }
+}
+
+const VariableDeclaration* LivenessAnalysis::definedVariable(Expression* target) const {
+    auto identifier = dynamic_cast<IdentifierExpression*>(target);
+    if (!identifier) {
+        return nullptr;
+    }
+    const VariableDeclaration* var = names_.find(*identifier);
+    return var && names_.isLocal(var) ? var : nullptr;
+}
+
+int LivenessAnalysis::scalars(const LiveSet& live) {
+    int total = 0;
+    for (const VariableDeclaration* var : live) {
+        if (var->type) {
+            total += componentCount(var->type->kind);
+        }
+    }
+    return total;
+}
+
+int LivenessAnalysis::estimatedCudaRegisters(int peakScalars) {
+    // Thread index, launch bounds check and an address register
+    const int overhead = 4;
+    return std::min(255, peakScalars + overhead);
+}
+
+double LivenessAnalysis::estimatedCudaOccupancy(int registers) {
+    const int registersPerSM = 65536;
+    const int maxWarps = 64;
+    const int warpSize = 32;
+    
+    // Registers are allocated per thread in units of 8
+    int allocated = std::max(8, (registers + 7) / 8 * 8);
+    int warps = std::min(maxWarps, registersPerSM / (allocated * warpSize));
+    return static_cast<double>(warps) / maxWarps;
+}
+
+void LivenessAnalysis::writeJSON(JsonWriter& json, const RegisterPressure& pressure) {
+    json.beginObject();
+    json.key("peakScalars").integer(pressure.peakScalars);
+    json.key("line").integer(static_cast<long long>(pressure.peakLine));
+    json.key("functions").beginArray();
+    for (const FunctionPressure& func : pressure.functions) {
+        json.beginObject();
+        json.key("name").value(func.name);
+        json.key("peakScalars").integer(func.peakScalars);
+        json.key("line").integer(static_cast<long long>(func.peakLine));
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+}
+
+} // namespace sdl
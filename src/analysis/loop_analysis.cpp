@@ -0,0 +1,186 @@
+#include "analysis/loop_analysis.h"
+#include "parser/ast_walker.h"
+#include <string>
+
+namespace sdl {
+
+namespace {
+
+// Integer literal, optionally negated
+bool integerConstant(Expression* expr, int64_t& value) {
+    bool negate = false;
+    if (auto unary = dynamic_cast<UnaryExpression*>(expr)) {
+        if (unary->op != UnaryExpression::Operator::MINUS) {
+            return false;
+        }
+        negate = true;
+        expr = unary->operand.get();
+    }
+    
+    auto literal = dynamic_cast<LiteralExpression*>(expr);
+    if (!literal || literal->literalType != LiteralExpression::LiteralType::INT) {
+        return false;
+    }
+    try {
+        value = std::stoll(literal->value);
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (negate) {
+        value = -value;
+    }
+    return true;
+}
+
+bool isVariable(Expression* expr, const std::string& name) {
+    auto identifier = dynamic_cast<IdentifierExpression*>(expr);
+    return identifier && identifier->name == name;
+}
+
+// Target and value of `a = b`, whether written as a statement or an expression
+bool splitAssignment(Statement* stmt, Expression*& target, Expression*& value) {
+    if (auto assignment = dynamic_cast<AssignmentStatement*>(stmt)) {
+        target = assignment->target.get();
+        value = assignment->value.get();
+        return true;
+    }
+    if (auto exprStmt = dynamic_cast<ExpressionStatement*>(stmt)) {
+        auto binary = dynamic_cast<BinaryExpression*>(exprStmt->expression.get());
+        if (binary && binary->op == BinaryExpression::Operator::ASSIGN) {
+            target = binary->left.get();
+            value = binary->right.get();
+            return true;
+        }
+    }
+    return false;
+}
+
+class AssignmentFinder : public ASTWalker {
+public:
+    explicit AssignmentFinder(const std::string& name) : name_(name) {}
+    
+    bool found = false;
+    
+    void visit(AssignmentStatement& node) override {
+        check(node.target.get());
+        ASTWalker::visit(node);
+    }
+    
+    void visit(BinaryExpression& node) override {
+        if (node.op == BinaryExpression::Operator::ASSIGN) {
+            check(node.left.get());
+        }
+        ASTWalker::visit(node);
+    }
+    
+    // A redeclaration shadows the counter; be conservative and give up
+    void visit(VariableDeclaration& node) override {
+        if (node.name == name_) {
+            found = true;
+        }
+        ASTWalker::visit(node);
+    }
+    
+private:
+    std::string name_;
+    
+    void check(Expression* target) {
+        while (auto member = dynamic_cast<MemberAccessExpression*>(target)) {
+            target = member->object.get();
+        }
+        if (isVariable(target, name_)) {
+            found = true;
+        }
+    }
+};
+
+} // anonymous namespace
+
+std::optional<CountedLoop> analyzeCountedLoop(ForStatement& loop) {
+    CountedLoop counted;
+    
+    // Initialization
+    if (auto var = dynamic_cast<VariableDeclaration*>(loop.initialization.get())) {
+        if (!var->type || var->type->kind != Type::Kind::INT ||
+            !integerConstant(var->initializer.get(), counted.start)) {
+            return std::nullopt;
+        }
+        counted.variable = var->name;
+    } else {
+        Expression* target = nullptr;
+        Expression* value = nullptr;
+        if (!splitAssignment(loop.initialization.get(), target, value)) {
+            return std::nullopt;
+        }
+        auto identifier = dynamic_cast<IdentifierExpression*>(target);
+        if (!identifier || !integerConstant(value, counted.start)) {
+            return std::nullopt;
+        }
+        counted.variable = identifier->name;
+    }
+    
+    // Update: i = i + step or i = i - step
+    Expression* target = nullptr;
+    Expression* value = nullptr;
+    if (!splitAssignment(loop.update.get(), target, value) || !isVariable(target, counted.variable)) {
+        return std::nullopt;
+    }
+    auto increment = dynamic_cast<BinaryExpression*>(value);
+    if (!increment || !isVariable(increment->left.get(), counted.variable) ||
+        !integerConstant(increment->right.get(), counted.step)) {
+        return std::nullopt;
+    }
+    if (increment->op == BinaryExpression::Operator::SUBTRACT) {
+        counted.step = -counted.step;
+    } else if (increment->op != BinaryExpression::Operator::ADD) {
+        return std::nullopt;
+    }
+    if (counted.step == 0) {
+        return std::nullopt;
+    }
+    
+    // Condition: i <op> bound
+    auto condition = dynamic_cast<BinaryExpression*>(loop.condition.get());
+    int64_t bound = 0;
+    if (!condition || !isVariable(condition->left.get(), counted.variable) ||
+        !integerConstant(condition->right.get(), bound)) {
+        return std::nullopt;
+    }
+    
+    // Number of values start, start + step, ... that satisfy the condition
+    int64_t distance = 0;
+    switch (condition->op) {
+        case BinaryExpression::Operator::LESS_THAN:
+            if (counted.step < 0) return std::nullopt;
+            distance = bound - counted.start;
+            break;
+        case BinaryExpression::Operator::LESS_EQUAL:
+            if (counted.step < 0) return std::nullopt;
+            distance = bound - counted.start + 1;
+            break;
+        case BinaryExpression::Operator::GREATER_THAN:
+            if (counted.step > 0) return std::nullopt;
+            distance = counted.start - bound;
+            break;
+        case BinaryExpression::Operator::GREATER_EQUAL:
+            if (counted.step > 0) return std::nullopt;
+            distance = counted.start - bound + 1;
+            break;
+        default:
+            return std::nullopt;
+    }
+    int64_t step = counted.step < 0 ? -counted.step : counted.step;
+    counted.tripCount = distance <= 0 ? 0 : (distance + step - 1) / step;
+    
+    AssignmentFinder finder(counted.variable);
+    if (loop.body) {
+        loop.body->accept(finder);
+    }
+    if (finder.found) {
+        return std::nullopt;
+    }
+    
+    return counted;
+}
+
+} // namespace sdl
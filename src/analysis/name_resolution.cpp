@@ -0,0 +1,100 @@
+#include "analysis/name_resolution.h"
+#include "parser/ast_walker.h"
+
+namespace sdl {
+
+class NameResolver : public ASTWalker {
+public:
+    explicit NameResolver(NameResolution& result) : result_(result) {}
+    
+    void visit(Program& node) override {
+        scopes_.emplace_back();
+        declareAll(node.declarations);
+        ASTWalker::visit(node);
+        scopes_.pop_back();
+    }
+    
+    void visit(ShaderDeclaration& node) override {
+        scopes_.emplace_back();
+        declareAll(node.body);
+        ASTWalker::visit(node);
+        scopes_.pop_back();
+    }
+    
+    void visit(FunctionDeclaration& node) override {
+        ++functionDepth_;
+        scopes_.emplace_back();
+        for (auto& param : node.parameters) {
+            declare(*param);
+        }
+        for (auto& stmt : node.body) {
+            walk(stmt.get());
+        }
+        scopes_.pop_back();
+        --functionDepth_;
+    }
+    
+    void visit(BlockStatement& node) override {
+        scopes_.emplace_back();
+        ASTWalker::visit(node);
+        scopes_.pop_back();
+    }
+    
+    void visit(ForStatement& node) override {
+        scopes_.emplace_back();
+        ASTWalker::visit(node);
+        scopes_.pop_back();
+    }
+    
+    void visit(VariableDeclaration& node) override {
+        // `float x = x;` reads the outer x
+        walk(node.initializer.get());
+        if (functionDepth_ > 0) {
+            declare(node);
+        }
+    }
+    
+    void visit(IdentifierExpression& node) override {
+        for (auto scope = scopes_.rbegin(); scope != scopes_.rend(); ++scope) {
+            auto it = scope->find(node.name);
+            if (it != scope->end()) {
+                result_.bindings_[&node] = it->second;
+                return;
+            }
+        }
+    }
+    
+private:
+    NameResolution& result_;
+    std::vector<NameResolution::Scope> scopes_;
+    int functionDepth_ = 0;
+    
+    // Globals and shader-level variables are visible before their declaration
+    void declareAll(const std::vector<StatementPtr>& declarations) {
+        for (auto& decl : declarations) {
+            if (auto var = dynamic_cast<VariableDeclaration*>(decl.get())) {
+                scopes_.back()[var->name] = var;
+            }
+        }
+    }
+    
+    void declare(VariableDeclaration& var) {
+        scopes_.back()[var.name] = &var;
+        result_.locals_.insert(&var);
+    }
+};
+
+void NameResolution::resolve(Program& program) {
+    bindings_.clear();
+    locals_.clear();
+    
+    NameResolver resolver(*this);
+    program.accept(resolver);
+}
+
+const VariableDeclaration* NameResolution::find(const IdentifierExpression& identifier) const {
+    auto it = bindings_.find(&identifier);
+    return it != bindings_.end() ? it->second : nullptr;
+}
+
+} // namespace sdl
@@ -0,0 +1,208 @@
+#include "analysis/purity.h"
+#include "analysis/function_lookup.h"
+#include "parser/ast_walker.h"
+#include <string>
+
+namespace sdl {
+
+namespace {
+
+unsigned builtinEffects(const FunctionCallExpression& call) {
+    const BuiltinInfo* builtin = builtinInfo(call.builtin);
+    return builtin ? builtin->effects : Effect::NONE;
+}
+
+bool isOutputBuiltin(const std::string& name) {
+    return name == "gl_Position" || name == "gl_PointSize" || name == "gl_FragDepth";
+}
+
+} // anonymous namespace
+
+// Effects of one function body in the context of one shader
+class EffectCollector : public ASTWalker {
+public:
+    EffectCollector(PurityAnalysis& analysis, const FunctionLookup& lookup)
+        : analysis_(analysis), lookup_(lookup) {}
+    
+    unsigned effects = Effect::NONE;
+    
+    void visit(IdentifierExpression& node) override {
+        const VariableDeclaration* var = analysis_.names_.find(node);
+        if (!var) {
+            if (isOutputBuiltin(node.name)) {
+                effects |= Effect::READS_MUTABLE;
+            } else if (node.name != "true" && node.name != "false") {
+                effects |= Effect::READS_INPUTS;
+            }
+            return;
+        }
+        if (analysis_.names_.isLocal(var)) {
+            return;
+        }
+        switch (var->qualifier) {
+            case VariableDeclaration::Qualifier::UNIFORM:
+                effects |= Effect::READS_UNIFORMS;
+                break;
+            case VariableDeclaration::Qualifier::IN:
+                effects |= Effect::READS_INPUTS;
+                break;
+            case VariableDeclaration::Qualifier::CONST:
+                break;
+            default:
+                // A global nothing writes only ever holds its initializer
+                if (analysis_.writtenGlobals_.count(var)) {
+                    effects |= Effect::READS_MUTABLE;
+                }
+                break;
+        }
+    }
+    
+    void visit(AssignmentStatement& node) override {
+        write(node.target.get());
+        ASTWalker::visit(node);
+    }
+    
+    void visit(BinaryExpression& node) override {
+        if (node.op == BinaryExpression::Operator::ASSIGN) {
+            write(node.left.get());
+        }
+        ASTWalker::visit(node);
+    }
+    
+    void visit(FunctionCallExpression& node) override {
+        unsigned callEffects = builtinEffects(node);
+        if (FunctionDeclaration* callee = lookup_.resolve(node)) {
+            auto it = analysis_.functions_.find(callee);
+            callEffects = it != analysis_.functions_.end() ? it->second : Effect::NONE;
+            
+            // What the callee writes through out parameters are the caller's
+            // own arguments; those only matter if they are globals or outputs
+            for (size_t i = 0; i < node.arguments.size() && i < callee->parameters.size(); ++i) {
+                if (callee->parameters[i]->qualifier == VariableDeclaration::Qualifier::OUT) {
+                    write(node.arguments[i].get());
+                }
+            }
+        }
+        
+        analysis_.calls_[&node] |= callEffects;
+        effects |= callEffects & ~static_cast<unsigned>(Effect::WRITES_ARGUMENTS);
+        ASTWalker::visit(node);
+    }
+    
+private:
+    PurityAnalysis& analysis_;
+    const FunctionLookup& lookup_;
+    
+    void write(Expression* target) {
+        while (auto member = dynamic_cast<MemberAccessExpression*>(target)) {
+            target = member->object.get();
+        }
+        auto identifier = dynamic_cast<IdentifierExpression*>(target);
+        if (!identifier) {
+            return;
+        }
+        
+        const VariableDeclaration* var = analysis_.names_.find(*identifier);
+        if (!var) {
+            if (isOutputBuiltin(identifier->name)) {
+                effects |= Effect::WRITES_OUTPUTS;
+            }
+        } else if (analysis_.names_.isLocal(var)) {
+            if (var->qualifier == VariableDeclaration::Qualifier::OUT) {
+                effects |= Effect::WRITES_ARGUMENTS;
+            }
+        } else if (var->qualifier == VariableDeclaration::Qualifier::OUT) {
+            effects |= Effect::WRITES_OUTPUTS;
+            noteGlobalWrite(var);
+        } else {
+            effects |= Effect::WRITES_GLOBALS;
+            noteGlobalWrite(var);
+        }
+    }
+    
+    void noteGlobalWrite(const VariableDeclaration* var) {
+        if (analysis_.writtenGlobals_.insert(var).second) {
+            analysis_.changed_ = true;
+        }
+    }
+};
+
+const char* purityName(Purity purity) {
+    switch (purity) {
+        case Purity::PURE: return "pure";
+        case Purity::READS_UNIFORMS: return "reads-uniforms";
+        case Purity::READS_INPUTS: return "reads-inputs";
+        case Purity::SAMPLES_TEXTURES: return "samples-textures";
+        case Purity::READS_MUTABLE: return "reads-mutable";
+        case Purity::WRITES_OUTPUTS: return "writes-outputs";
+        case Purity::SIDE_EFFECTS: return "side-effects";
+    }
+    return "unknown";
+}
+
+void PurityAnalysis::analyze(Program& program) {
+    names_.resolve(program);
+    functions_.clear();
+    calls_.clear();
+    writtenGlobals_.clear();
+    
+    // Effects only grow; stop once a whole pass adds nothing
+    do {
+        changed_ = false;
+        for (auto& decl : program.declarations) {
+            auto shader = dynamic_cast<ShaderDeclaration*>(decl.get());
+            if (!shader) {
+                continue;
+            }
+            
+            FunctionLookup lookup(program, *shader);
+            for (auto* body : {&shader->body, &program.declarations}) {
+                for (auto& stmt : *body) {
+                    auto func = dynamic_cast<FunctionDeclaration*>(stmt.get());
+                    if (!func) {
+                        continue;
+                    }
+                    
+                    EffectCollector collector(*this, lookup);
+                    for (auto& bodyStmt : func->body) {
+                        if (bodyStmt) {
+                            bodyStmt->accept(collector);
+                        }
+                    }
+                    
+                    unsigned& effects = functions_[func];
+                    if ((effects | collector.effects) != effects) {
+                        effects |= collector.effects;
+                        changed_ = true;
+                    }
+                }
+            }
+        }
+    } while (changed_);
+}
+
+unsigned PurityAnalysis::effectsOf(const FunctionDeclaration* func) const {
+    auto it = functions_.find(func);
+    return it != functions_.end() ? it->second : Effect::NONE;
+}
+
+unsigned PurityAnalysis::effectsOf(const FunctionCallExpression& call) const {
+    auto it = calls_.find(&call);
+    return it != calls_.end() ? it->second : builtinEffects(call);
+}
+
+Purity PurityAnalysis::classify(unsigned effects) {
+    if (effects & (Effect::WRITES_GLOBALS | Effect::WRITES_ARGUMENTS)) return Purity::SIDE_EFFECTS;
+    if (effects & Effect::WRITES_OUTPUTS) return Purity::WRITES_OUTPUTS;
+    if (effects & Effect::READS_MUTABLE) return Purity::READS_MUTABLE;
+    if (effects & Effect::SAMPLES_TEXTURES) return Purity::SAMPLES_TEXTURES;
+    if (effects & Effect::READS_INPUTS) return Purity::READS_INPUTS;
+    if (effects & Effect::READS_UNIFORMS) return Purity::READS_UNIFORMS;
+    return Purity::PURE;
+}
+
+bool PurityAnalysis::isRemovable(unsigned effects) {
+    return !(effects & (Effect::WRITES_OUTPUTS | Effect::WRITES_GLOBALS | Effect::WRITES_ARGUMENTS));
+}
+
+} // namespace sdl
@@ -0,0 +1,508 @@
+#include "analysis/stage_interface.h"
+#include "parser/ast_walker.h"
+#include "semantic/types.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace sdl {
+
+namespace {
+
+// Names a shader reads, assigns and declares locally (parameters included)
+struct ShaderUsage {
+    std::unordered_set<std::string> reads;
+    std::unordered_set<std::string> writes;
+    std::unordered_set<std::string> locals;
+};
+
+class UsageCollector : public ASTWalker {
+public:
+    ShaderUsage usage;
+    
+    void visit(IdentifierExpression& node) override {
+        usage.reads.insert(node.name);
+    }
+    
+    void visit(BinaryExpression& node) override {
+        if (node.op == BinaryExpression::Operator::ASSIGN) {
+            assignTo(node.left.get());
+            walk(node.right.get());
+        } else {
+            ASTWalker::visit(node);
+        }
+    }
+    
+    void visit(AssignmentStatement& node) override {
+        assignTo(node.target.get());
+        walk(node.value.get());
+    }
+    
+    void visit(VariableDeclaration& node) override {
+        if (functionDepth_ > 0) {
+            usage.locals.insert(node.name);
+        }
+        ASTWalker::visit(node);
+    }
+    
+    void visit(FunctionDeclaration& node) override {
+        ++functionDepth_;
+        ASTWalker::visit(node);
+        --functionDepth_;
+    }
+    
+private:
+    int functionDepth_ = 0;
+    
+    // The root of `v.xy = ...` is written, not read
+    void assignTo(Expression* target) {
+        while (auto member = dynamic_cast<MemberAccessExpression*>(target)) {
+            target = member->object.get();
+        }
+        if (auto identifier = dynamic_cast<IdentifierExpression*>(target)) {
+            usage.writes.insert(identifier->name);
+        } else {
+            walk(target);
+        }
+    }
+};
+
+ShaderUsage collectUsage(ShaderDeclaration& shader) {
+    UsageCollector collector;
+    shader.accept(collector);
+    return std::move(collector.usage);
+}
+
+// Every name declared or referenced anywhere, so generated names cannot clash
+class NameCollector : public ASTWalker {
+public:
+    std::unordered_set<std::string> names;
+    
+    void visit(IdentifierExpression& node) override {
+        names.insert(node.name);
+    }
+    
+    void visit(VariableDeclaration& node) override {
+        names.insert(node.name);
+        ASTWalker::visit(node);
+    }
+    
+    void visit(FunctionDeclaration& node) override {
+        names.insert(node.name);
+        ASTWalker::visit(node);
+    }
+};
+
+VariableDeclaration* interfaceVariable(Statement* stmt, VariableDeclaration::Qualifier qualifier) {
+    auto var = dynamic_cast<VariableDeclaration*>(stmt);
+    if (var && var->qualifier == qualifier && var->type) {
+        return var;
+    }
+    return nullptr;
+}
+
+// Interpolator locations a varying of this type occupies
+int slotsFor(Type::Kind kind) {
+    return isMatrix(kind) ? matrixDimension(kind) : 1;
+}
+
+bool isPackable(Type::Kind kind) {
+    return kind == Type::Kind::FLOAT || kind == Type::Kind::VEC2 || kind == Type::Kind::VEC3;
+}
+
+const char* const SWIZZLE_SETS[] = {"xyzw", "rgba", "stpq"};
+
+// Maps a swizzle of a `components`-wide varying onto the packed vec4.
+// Returns an empty string if `member` is not such a swizzle.
+std::string composeSwizzle(const std::string& member, int components, int offset) {
+    if (member.empty() || member.size() > 4) {
+        return "";
+    }
+    
+    for (const char* set : SWIZZLE_SETS) {
+        std::string composed;
+        for (char c : member) {
+            const char* found = std::char_traits<char>::find(set, 4, c);
+            if (!found || found - set >= components) {
+                break;
+            }
+            composed += "xyzw"[offset + (found - set)];
+        }
+        if (composed.size() == member.size()) {
+            return composed;
+        }
+    }
+    return "";
+}
+
+// Replaces every access to a packed varying with a swizzle of its vec4
+class VaryingRewriter {
+public:
+    explicit VaryingRewriter(const std::unordered_map<std::string, const Varying*>& packed)
+        : packed_(packed) {}
+    
+    void rewrite(Statement* stmt) {
+        if (!stmt) {
+            return;
+        }
+        
+        if (auto exprStmt = dynamic_cast<ExpressionStatement*>(stmt)) {
+            rewrite(exprStmt->expression);
+        } else if (auto assignment = dynamic_cast<AssignmentStatement*>(stmt)) {
+            rewrite(assignment->target);
+            rewrite(assignment->value);
+        } else if (auto var = dynamic_cast<VariableDeclaration*>(stmt)) {
+            rewrite(var->initializer);
+        } else if (auto func = dynamic_cast<FunctionDeclaration*>(stmt)) {
+            for (auto& bodyStmt : func->body) {
+                rewrite(bodyStmt.get());
+            }
+        } else if (auto shader = dynamic_cast<ShaderDeclaration*>(stmt)) {
+            for (auto& bodyStmt : shader->body) {
+                rewrite(bodyStmt.get());
+            }
+        } else if (auto block = dynamic_cast<BlockStatement*>(stmt)) {
+            for (auto& blockStmt : block->statements) {
+                rewrite(blockStmt.get());
+            }
+        } else if (auto ifStmt = dynamic_cast<IfStatement*>(stmt)) {
+            rewrite(ifStmt->condition);
+            rewrite(ifStmt->thenStatement.get());
+            rewrite(ifStmt->elseStatement.get());
+        } else if (auto forStmt = dynamic_cast<ForStatement*>(stmt)) {
+            rewrite(forStmt->initialization.get());
+            rewrite(forStmt->condition);
+            rewrite(forStmt->update.get());
+            rewrite(forStmt->body.get());
+        } else if (auto whileStmt = dynamic_cast<WhileStatement*>(stmt)) {
+            rewrite(whileStmt->condition);
+            rewrite(whileStmt->body.get());
+        } else if (auto returnStmt = dynamic_cast<ReturnStatement*>(stmt)) {
+            rewrite(returnStmt->value);
+        }
+    }
+    
+    void rewrite(ExpressionPtr& expr) {
+        if (!expr) {
+            return;
+        }
+        
+        if (auto identifier = dynamic_cast<IdentifierExpression*>(expr.get())) {
+            if (const Varying* varying = find(identifier->name)) {
+                int components = componentCount(varying->type);
+                std::string swizzle = composeSwizzle(std::string("xyzw", components), components,
+                                                     varying->component);
+                expr = makeAccess(*varying, swizzle, *identifier);
+            }
+        } else if (auto member = dynamic_cast<MemberAccessExpression*>(expr.get())) {
+            // Fold `v.yx` into a single swizzle of the packed vector
+            auto object = dynamic_cast<IdentifierExpression*>(member->object.get());
+            const Varying* varying = object ? find(object->name) : nullptr;
+            std::string composed;
+            if (varying) {
+                composed = composeSwizzle(member->member, componentCount(varying->type),
+                                          varying->component);
+            }
+            
+            if (!composed.empty()) {
+                member->object = makePackedIdentifier(*varying, *object);
+                member->member = composed;
+            } else {
+                rewrite(member->object);
+            }
+        } else if (auto binary = dynamic_cast<BinaryExpression*>(expr.get())) {
+            rewrite(binary->left);
+            rewrite(binary->right);
+        } else if (auto unary = dynamic_cast<UnaryExpression*>(expr.get())) {
+            rewrite(unary->operand);
+        } else if (auto call = dynamic_cast<FunctionCallExpression*>(expr.get())) {
+            for (auto& arg : call->arguments) {
+                rewrite(arg);
+            }
+        }
+    }
+    
+private:
+    const std::unordered_map<std::string, const Varying*>& packed_;
+    
+    const Varying* find(const std::string& name) const {
+        auto it = packed_.find(name);
+        return it != packed_.end() ? it->second : nullptr;
+    }
+    
+    static ExpressionPtr makePackedIdentifier(const Varying& varying, const ASTNode& origin) {
+        auto identifier = std::make_unique<IdentifierExpression>(varying.packedName);
+        identifier->line = origin.line;
+        identifier->column = origin.column;
+        identifier->resultType = std::make_unique<Type>(Type::Kind::VEC4);
+        return identifier;
+    }
+    
+    static ExpressionPtr makeAccess(const Varying& varying, const std::string& swizzle,
+                                    const ASTNode& origin) {
+        auto access = std::make_unique<MemberAccessExpression>(
+            makePackedIdentifier(varying, origin), swizzle);
+        access->line = origin.line;
+        access->column = origin.column;
+        access->resultType = std::make_unique<Type>(varying.type);
+        return access;
+    }
+};
+
+// Replaces the declarations of the varyings in `members` with a single vec4
+// declaration at the position of the first one
+void replaceDeclarations(ShaderDeclaration& shader, VariableDeclaration::Qualifier qualifier,
+                         const std::unordered_set<std::string>& members,
+                         const std::string& packedName) {
+    bool replaced = false;
+    for (auto it = shader.body.begin(); it != shader.body.end();) {
+        VariableDeclaration* var = interfaceVariable(it->get(), qualifier);
+        if (!var || !members.count(var->name)) {
+            ++it;
+            continue;
+        }
+        
+        if (!replaced) {
+            auto packed = std::make_unique<VariableDeclaration>(
+                qualifier, std::make_unique<Type>(Type::Kind::VEC4), packedName);
+            packed->line = var->line;
+            packed->column = var->column;
+            *it = std::move(packed);
+            replaced = true;
+            ++it;
+        } else {
+            it = shader.body.erase(it);
+        }
+    }
+}
+
+} // anonymous namespace
+
+bool StageInterface::link(Program& program) {
+    links_.clear();
+    diagnostics_.clear();
+    
+    for (auto& decl : program.declarations) {
+        auto shader = dynamic_cast<ShaderDeclaration*>(decl.get());
+        if (!shader) {
+            continue;
+        }
+        
+        if (shader->shaderType == ShaderDeclaration::ShaderType::VERTEX) {
+            links_.emplace_back();
+            links_.back().vertex = shader;
+        } else if (shader->shaderType == ShaderDeclaration::ShaderType::FRAGMENT && !links_.empty()) {
+            links_.back().fragments.push_back(shader);
+        }
+    }
+    
+    NameCollector names;
+    program.accept(names);
+    reservedNames_ = std::move(names.names);
+    
+    for (auto& link : links_) {
+        checkLink(link);
+    }
+    
+    ErrorHandler::sortBySourceOrder(diagnostics_);
+    return !hasErrors();
+}
+
+bool StageInterface::hasErrors() const {
+    for (const auto& diagnostic : diagnostics_) {
+        if (diagnostic.severity == Diagnostic::Severity::ERROR) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void StageInterface::checkLink(StageLink& link) {
+    ShaderUsage vertexUsage = collectUsage(*link.vertex);
+    for (auto& stmt : link.vertex->body) {
+        if (auto var = interfaceVariable(stmt.get(), VariableDeclaration::Qualifier::OUT)) {
+            Varying varying;
+            varying.name = var->name;
+            varying.type = var->type->kind;
+            varying.written = vertexUsage.writes.count(var->name) > 0;
+            varying.shadowed = vertexUsage.locals.count(var->name) > 0;
+            link.varyings.push_back(varying);
+        }
+    }
+    
+    const std::string& vertexName = link.vertex->name;
+    for (ShaderDeclaration* fragment : link.fragments) {
+        ShaderUsage usage = collectUsage(*fragment);
+        
+        for (auto& stmt : fragment->body) {
+            auto var = interfaceVariable(stmt.get(), VariableDeclaration::Qualifier::IN);
+            if (!var) {
+                continue;
+            }
+            
+            auto varying = std::find_if(link.varyings.begin(), link.varyings.end(),
+                                        [&](const Varying& v) { return v.name == var->name; });
+            if (varying == link.varyings.end()) {
+                diagnostics_.emplace_back(Diagnostic::Severity::ERROR,
+                                          "Fragment input '" + var->name + "' of shader '" + fragment->name +
+                                          "' is not an output of vertex shader '" + vertexName + "'",
+                                          var->line, var->column);
+                continue;
+            }
+            if (varying->type != var->type->kind) {
+                diagnostics_.emplace_back(Diagnostic::Severity::ERROR,
+                                          "Fragment input '" + var->name + "' of shader '" + fragment->name +
+                                          "' has type " + typeName(var->type->kind) + " but vertex shader '" +
+                                          vertexName + "' outputs " + typeName(varying->type),
+                                          var->line, var->column);
+                continue;
+            }
+            
+            if (usage.locals.count(var->name)) {
+                varying->shadowed = true;
+            }
+            if (usage.reads.count(var->name)) {
+                varying->read = true;
+                if (!varying->written) {
+                    diagnostics_.emplace_back(Diagnostic::Severity::WARNING,
+                                              "Fragment input '" + var->name + "' is read but vertex shader '" +
+                                              vertexName + "' never writes it",
+                                              var->line, var->column);
+                }
+            }
+        }
+    }
+}
+
+void StageInterface::optimize() {
+    if (hasErrors()) {
+        return;
+    }
+    
+    for (auto& link : links_) {
+        // Without a consumer in this file the outputs feed an external stage
+        if (link.fragments.empty()) {
+            continue;
+        }
+        
+        link.slotsBefore = 0;
+        for (const Varying& varying : link.varyings) {
+            link.slotsBefore += slotsFor(varying.type);
+        }
+        
+        // Unread outputs stay as private globals: the vertex shader may still
+        // read back what it wrote
+        std::unordered_set<std::string> dropped;
+        for (const Varying& varying : link.varyings) {
+            if (!varying.read) {
+                dropped.insert(varying.name);
+                link.dropped.push_back(varying.name);
+            }
+        }
+        for (auto& stmt : link.vertex->body) {
+            auto var = interfaceVariable(stmt.get(), VariableDeclaration::Qualifier::OUT);
+            if (var && dropped.count(var->name)) {
+                var->qualifier = VariableDeclaration::Qualifier::NONE;
+            }
+        }
+        for (ShaderDeclaration* fragment : link.fragments) {
+            auto& body = fragment->body;
+            body.erase(std::remove_if(body.begin(), body.end(), [&](const StatementPtr& stmt) {
+                auto var = interfaceVariable(stmt.get(), VariableDeclaration::Qualifier::IN);
+                return var && dropped.count(var->name);
+            }), body.end());
+        }
+        link.varyings.erase(std::remove_if(link.varyings.begin(), link.varyings.end(),
+                                           [](const Varying& v) { return !v.read; }),
+                            link.varyings.end());
+        
+        packVaryings(link);
+        
+        // Number the remaining interface in declaration order
+        std::unordered_map<std::string, int> locations;
+        link.slotsAfter = 0;
+        for (auto& stmt : link.vertex->body) {
+            if (auto var = interfaceVariable(stmt.get(), VariableDeclaration::Qualifier::OUT)) {
+                locations[var->name] = link.slotsAfter;
+                link.slotsAfter += slotsFor(var->type->kind);
+            }
+        }
+        for (Varying& varying : link.varyings) {
+            auto location = locations.find(varying.packedName.empty() ? varying.name : varying.packedName);
+            if (location != locations.end()) {
+                varying.slot = location->second;
+            }
+        }
+    }
+}
+
+void StageInterface::packVaryings(StageLink& link) {
+    // First-fit decreasing: vec3s first so scalars can fill their fourth lane
+    std::vector<Varying*> candidates;
+    for (Varying& varying : link.varyings) {
+        if (isPackable(varying.type) && !varying.shadowed) {
+            candidates.push_back(&varying);
+        }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), [](const Varying* a, const Varying* b) {
+        return componentCount(a->type) > componentCount(b->type);
+    });
+    
+    struct Bin {
+        int used = 0;
+        std::vector<Varying*> members;
+    };
+    std::vector<Bin> bins;
+    for (Varying* varying : candidates) {
+        int components = componentCount(varying->type);
+        auto bin = std::find_if(bins.begin(), bins.end(),
+                                [&](const Bin& b) { return b.used + components <= 4; });
+        if (bin == bins.end()) {
+            bins.emplace_back();
+            bin = bins.end() - 1;
+        }
+        varying->component = bin->used;
+        bin->used += components;
+        bin->members.push_back(varying);
+    }
+    
+    std::unordered_map<std::string, const Varying*> packed;
+    int packedCount = 0;
+    for (Bin& bin : bins) {
+        // A varying alone in its slot keeps its own declaration
+        if (bin.members.size() < 2) {
+            bin.members.front()->component = 0;
+            continue;
+        }
+        
+        std::string name;
+        do {
+            name = "packedVarying" + std::to_string(packedCount++);
+        } while (reservedNames_.count(name));
+        reservedNames_.insert(name);
+        
+        std::unordered_set<std::string> members;
+        for (Varying* varying : bin.members) {
+            varying->packedName = name;
+            members.insert(varying->name);
+            packed[varying->name] = varying;
+        }
+        
+        replaceDeclarations(*link.vertex, VariableDeclaration::Qualifier::OUT, members, name);
+        for (ShaderDeclaration* fragment : link.fragments) {
+            replaceDeclarations(*fragment, VariableDeclaration::Qualifier::IN, members, name);
+        }
+    }
+    
+    if (packed.empty()) {
+        return;
+    }
+    
+    VaryingRewriter rewriter(packed);
+    rewriter.rewrite(link.vertex);
+    for (ShaderDeclaration* fragment : link.fragments) {
+        rewriter.rewrite(fragment);
+    }
+}
+
+} // namespace sdl
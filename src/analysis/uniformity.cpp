@@ -0,0 +1,248 @@
+#include "analysis/uniformity.h"
+#include "analysis/function_lookup.h"
+#include "semantic/builtins.h"
+
+namespace sdl {
+
+namespace {
+
+// Builtin variables every invocation of a draw or dispatch sees the same value of
+bool isUniformBuiltin(const std::string& name) {
+    return name == "true" || name == "false" || name == "gl_WorkGroupID";
+}
+
+bool hasBuiltinFlag(const FunctionCallExpression& call, unsigned flag) {
+    const BuiltinInfo* builtin = builtinInfo(call.builtin);
+    return builtin && builtin->has(flag);
+}
+
+} // anonymous namespace
+
+void UniformityAnalysis::analyze(Program& program) {
+    names_.resolve(program);
+    divergentVariables_.clear();
+    divergentReturns_.clear();
+    divergentCalls_.clear();
+    expressions_.clear();
+    branches_.clear();
+    fetches_.clear();
+    
+    // Divergence only ever grows, so iterate until nothing new is marked and
+    // then record the fetches in one final pass
+    recording_ = false;
+    size_t before;
+    do {
+        before = stateSize();
+        for (auto& decl : program.declarations) {
+            if (auto shader = dynamic_cast<ShaderDeclaration*>(decl.get())) {
+                walkShader(program, *shader);
+            }
+        }
+    } while (stateSize() != before);
+    
+    recording_ = true;
+    for (auto& decl : program.declarations) {
+        if (auto shader = dynamic_cast<ShaderDeclaration*>(decl.get())) {
+            walkShader(program, *shader);
+        }
+    }
+    recording_ = false;
+}
+
+bool UniformityAnalysis::isUniform(const Expression* expr) const {
+    auto it = expressions_.find(expr);
+    return it != expressions_.end() && it->second;
+}
+
+bool UniformityAnalysis::isUniformBranch(const Statement* stmt) const {
+    auto it = branches_.find(stmt);
+    return it != branches_.end() && it->second;
+}
+
+void UniformityAnalysis::walkShader(Program& program, ShaderDeclaration& shader) {
+    FunctionLookup lookup(program, shader);
+    lookup_ = &lookup;
+    shader_ = &shader;
+    recordedFetches_.clear();
+    
+    // Shader functions first, then the program-level functions in this shader's context
+    for (auto* body : {&shader.body, &program.declarations}) {
+        for (auto& stmt : *body) {
+            if (auto func = dynamic_cast<FunctionDeclaration*>(stmt.get())) {
+                walkFunction(*func);
+            } else if (auto var = dynamic_cast<VariableDeclaration*>(stmt.get())) {
+                function_ = nullptr;
+                walkStatement(var, false);
+            }
+        }
+    }
+    
+    lookup_ = nullptr;
+    shader_ = nullptr;
+}
+
+void UniformityAnalysis::walkFunction(FunctionDeclaration& func) {
+    function_ = &func;
+    divergentExit_ = false;
+    divergentBranches_.clear();
+    walkStatements(func.body, divergentCalls_.count(&func) > 0);
+    function_ = nullptr;
+}
+
+void UniformityAnalysis::walkStatements(std::vector<StatementPtr>& statements, bool divergent) {
+    for (auto& stmt : statements) {
+        // Threads that returned early no longer run the rest of the function
+        walkStatement(stmt.get(), divergent || divergentExit_);
+    }
+}
+
+void UniformityAnalysis::walkStatement(Statement* stmt, bool control) {
+    if (!stmt) {
+        return;
+    }
+    
+    if (auto block = dynamic_cast<BlockStatement*>(stmt)) {
+        walkStatements(block->statements, control);
+    } else if (auto exprStmt = dynamic_cast<ExpressionStatement*>(stmt)) {
+        divergent(exprStmt->expression.get(), control);
+    } else if (auto assignment = dynamic_cast<AssignmentStatement*>(stmt)) {
+        bool value = divergent(assignment->value.get(), control);
+        divergent(assignment->target.get(), control);
+        assign(assignment->target.get(), value || control);
+    } else if (auto var = dynamic_cast<VariableDeclaration*>(stmt)) {
+        if (var->initializer && (divergent(var->initializer.get(), control) || control)) {
+            divergentVariables_.insert(var);
+        }
+    } else if (auto ifStmt = dynamic_cast<IfStatement*>(stmt)) {
+        bool condition = divergent(ifStmt->condition.get(), control);
+        branches_[stmt] = !condition;
+        walkBranchBody(*stmt, ifStmt->thenStatement.get(), control, condition);
+        walkBranchBody(*stmt, ifStmt->elseStatement.get(), control, condition);
+    } else if (auto forStmt = dynamic_cast<ForStatement*>(stmt)) {
+        walkStatement(forStmt->initialization.get(), control);
+        bool condition = divergent(forStmt->condition.get(), control);
+        branches_[stmt] = !condition;
+        walkBranchBody(*stmt, forStmt->body.get(), control, condition);
+        walkBranchBody(*stmt, forStmt->update.get(), control, condition);
+    } else if (auto whileStmt = dynamic_cast<WhileStatement*>(stmt)) {
+        bool condition = divergent(whileStmt->condition.get(), control);
+        branches_[stmt] = !condition;
+        walkBranchBody(*stmt, whileStmt->body.get(), control, condition);
+    } else if (auto returnStmt = dynamic_cast<ReturnStatement*>(stmt)) {
+        bool value = divergent(returnStmt->value.get(), control);
+        if ((value || control) && function_) {
+            divergentReturns_.insert(function_);
+        }
+        if (control) {
+            divergentExit_ = true;
+        }
+    }
+}
+
+void UniformityAnalysis::walkBranchBody(Statement& branch, Statement* body, bool control,
+                                        bool conditionDivergent) {
+    if (conditionDivergent) {
+        divergentBranches_.push_back(&branch);
+    }
+    walkStatement(body, control || conditionDivergent);
+    if (conditionDivergent) {
+        divergentBranches_.pop_back();
+    }
+}
+
+void UniformityAnalysis::assign(Expression* target, bool divergent) {
+    // `v.x = ...` and `a[i] = ...` make all of v or a divergent
+    while (auto member = dynamic_cast<MemberAccessExpression*>(target)) {
+        target = member->object.get();
+    }
+    auto identifier = dynamic_cast<IdentifierExpression*>(target);
+    if (!identifier || !divergent) {
+        return;
+    }
+    if (const VariableDeclaration* var = names_.find(*identifier)) {
+        divergentVariables_.insert(var);
+    }
+}
+
+bool UniformityAnalysis::divergent(Expression* expr, bool control) {
+    if (!expr) {
+        return false;
+    }
+    bool result = evaluate(expr, control);
+    expressions_[expr] = !result;
+    return result;
+}
+
+bool UniformityAnalysis::evaluate(Expression* expr, bool control) {
+    if (dynamic_cast<LiteralExpression*>(expr)) {
+        return false;
+    }
+    
+    if (auto identifier = dynamic_cast<IdentifierExpression*>(expr)) {
+        if (const VariableDeclaration* var = names_.find(*identifier)) {
+            return var->qualifier == VariableDeclaration::Qualifier::IN || divergentVariables_.count(var) > 0;
+        }
+        return !isUniformBuiltin(identifier->name);
+    }
+    
+    if (auto binary = dynamic_cast<BinaryExpression*>(expr)) {
+        if (binary->op == BinaryExpression::Operator::ASSIGN) {
+            bool value = divergent(binary->right.get(), control);
+            divergent(binary->left.get(), control);
+            assign(binary->left.get(), value || control);
+            return value;
+        }
+        bool left = divergent(binary->left.get(), control);
+        bool right = divergent(binary->right.get(), control);
+        return left || right;
+    }
+    
+    if (auto unary = dynamic_cast<UnaryExpression*>(expr)) {
+        return divergent(unary->operand.get(), control);
+    }
+    
+    if (auto member = dynamic_cast<MemberAccessExpression*>(expr)) {
+        return divergent(member->object.get(), control);
+    }
+    
+    if (auto call = dynamic_cast<FunctionCallExpression*>(expr)) {
+        std::vector<bool> arguments;
+        bool anyDivergent = false;
+        for (auto& arg : call->arguments) {
+            arguments.push_back(divergent(arg.get(), control));
+            anyDivergent = anyDivergent || arguments.back();
+        }
+        
+        if (FunctionDeclaration* callee = lookup_ ? lookup_->resolve(*call) : nullptr) {
+            for (size_t i = 0; i < arguments.size() && i < callee->parameters.size(); ++i) {
+                if (arguments[i]) {
+                    divergentVariables_.insert(callee->parameters[i].get());
+                }
+            }
+            if (control) {
+                divergentCalls_.insert(callee);
+            }
+            return divergentReturns_.count(callee) > 0;
+        }
+        
+        if (recording_ && control && shader_ && hasBuiltinFlag(*call, BuiltinFlag::TEXTURE_FETCH) &&
+            recordedFetches_.insert(call).second) {
+            DivergentFetch fetch;
+            fetch.call = call;
+            fetch.branch = divergentBranches_.empty() ? nullptr : divergentBranches_.back();
+            fetch.shader = shader_->name;
+            fetch.stage = shader_->shaderType;
+            fetches_.push_back(fetch);
+        }
+        // Derivatives differ between neighbouring threads even for uniform arguments
+        return anyDivergent || hasBuiltinFlag(*call, BuiltinFlag::DERIVATIVE);
+    }
+    
+    return true;
+}
+
+size_t UniformityAnalysis::stateSize() const {
+    return divergentVariables_.size() + divergentReturns_.size() + divergentCalls_.size();
+}
+
+} // namespace sdl
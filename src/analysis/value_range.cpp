@@ -0,0 +1,847 @@
+#include "analysis/value_range.h"
+#include "analysis/function_lookup.h"
+#include "analysis/loop_analysis.h"
+#include "parser/ast_walker.h"
+#include "semantic/builtins.h"
+#include "semantic/types.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace sdl {
+
+namespace {
+
+const double INF = std::numeric_limits<double>::infinity();
+const double PI = 3.14159265358979323846;
+
+// A range that keeps growing after this many joins is widened to unbounded
+const int MAX_WIDENINGS = 4;
+
+// Float normalize() and the dot products and lengths of its results are off
+// by a few ulps, so a unit vector's components may exceed 1 by this much
+const double UNIT_BOUND = 1.0 + std::ldexp(1.0, -20);
+
+ValueRange unitVector() {
+    ValueRange result = ValueRange::between(-UNIT_BOUND, UNIT_BOUND);
+    result.unit = true;
+    return result;
+}
+
+// NaN bounds (inf - inf) mean nothing is known
+ValueRange bounded(double low, double high) {
+    if (std::isnan(low) || std::isnan(high)) {
+        return ValueRange::full();
+    }
+    return ValueRange::between(low, high);
+}
+
+// 0 * inf is 0 here: an unbounded operand times exactly zero is still zero
+double product(double a, double b) {
+    return a == 0.0 || b == 0.0 ? 0.0 : a * b;
+}
+
+ValueRange add(const ValueRange& a, const ValueRange& b) {
+    if (a.isEmpty() || b.isEmpty()) return ValueRange::empty();
+    return bounded(a.low + b.low, a.high + b.high);
+}
+
+ValueRange subtract(const ValueRange& a, const ValueRange& b) {
+    if (a.isEmpty() || b.isEmpty()) return ValueRange::empty();
+    return bounded(a.low - b.high, a.high - b.low);
+}
+
+ValueRange multiply(const ValueRange& a, const ValueRange& b) {
+    if (a.isEmpty() || b.isEmpty()) return ValueRange::empty();
+    double corners[] = {product(a.low, b.low), product(a.low, b.high),
+                        product(a.high, b.low), product(a.high, b.high)};
+    return bounded(*std::min_element(corners, corners + 4), *std::max_element(corners, corners + 4));
+}
+
+ValueRange divide(const ValueRange& a, const ValueRange& b) {
+    if (a.isEmpty() || b.isEmpty()) return ValueRange::empty();
+    if (b.low <= 0.0 && b.high >= 0.0) {
+        return ValueRange::full();
+    }
+    return multiply(a, ValueRange::between(1.0 / b.high, 1.0 / b.low));
+}
+
+ValueRange negate(const ValueRange& a) {
+    if (a.isEmpty()) return a;
+    return ValueRange::between(-a.high, -a.low);
+}
+
+// Sum of `terms` values from `a` (dot products, matrix rows)
+ValueRange repeat(const ValueRange& a, int terms) {
+    if (a.isEmpty()) return a;
+    return bounded(product(a.low, terms), product(a.high, terms));
+}
+
+// Applies a monotonically increasing function to both bounds
+template <typename F>
+ValueRange increasing(const ValueRange& a, F f) {
+    if (a.isEmpty()) return a;
+    return bounded(f(a.low), f(a.high));
+}
+
+ValueRange truncated(const ValueRange& a) {
+    return increasing(a, [](double v) { return std::trunc(v); });
+}
+
+ValueRange maxRange(const ValueRange& a, const ValueRange& b) {
+    if (a.isEmpty() || b.isEmpty()) return ValueRange::empty();
+    return ValueRange::between(std::max(a.low, b.low), std::max(a.high, b.high));
+}
+
+ValueRange minRange(const ValueRange& a, const ValueRange& b) {
+    if (a.isEmpty() || b.isEmpty()) return ValueRange::empty();
+    return ValueRange::between(std::min(a.low, b.low), std::min(a.high, b.high));
+}
+
+// Builtin variables with a known sign or value
+ValueRange builtinVariableRange(const std::string& name) {
+    if (name == "true") return ValueRange::exactly(1.0);
+    if (name == "false") return ValueRange::exactly(0.0);
+    if (name == "gl_FrontFacing") return ValueRange::between(0.0, 1.0);
+    if (name == "idx" || name == "idy" || name == "gl_VertexID" || name == "gl_InstanceID" ||
+        name == "gl_GlobalInvocationID" || name == "gl_LocalInvocationID" || name == "gl_WorkGroupID") {
+        return ValueRange::between(0.0, INF);
+    }
+    return ValueRange::full();
+}
+
+Type::Kind kindOf(const Expression* expr) {
+    return expr && expr->resultType ? expr->resultType->kind : Type::Kind::VOID;
+}
+
+class SideEffectFinder : public ASTWalker {
+public:
+    explicit SideEffectFinder(const PurityAnalysis& purity) : purity_(purity) {}
+    
+    bool found = false;
+    
+    void visit(BinaryExpression& node) override {
+        found = found || node.op == BinaryExpression::Operator::ASSIGN;
+        ASTWalker::visit(node);
+    }
+    
+    void visit(FunctionCallExpression& node) override {
+        found = found || !PurityAnalysis::isRemovable(purity_.effectsOf(node));
+        ASTWalker::visit(node);
+    }
+    
+private:
+    const PurityAnalysis& purity_;
+};
+
+} // anonymous namespace
+
+ValueRange annotatedRange(const VariableDeclaration& var) {
+    const Attribute* range = var.findAttribute("range");
+    if (!range || range->arguments.size() != 2) {
+        return ValueRange::full();
+    }
+    try {
+        return ValueRange::between(std::stod(range->arguments[0]), std::stod(range->arguments[1]));
+    } catch (const std::exception&) {
+        return ValueRange::full();
+    }
+}
+
+ValueRange operator+(const ValueRange& a, const ValueRange& b) {
+    return add(a, b);
+}
+
+ValueRange operator-(const ValueRange& a, const ValueRange& b) {
+    return subtract(a, b);
+}
+
+ValueRange operator*(const ValueRange& a, const ValueRange& b) {
+    return multiply(a, b);
+}
+
+ValueRange operator/(const ValueRange& a, const ValueRange& b) {
+    return divide(a, b);
+}
+
+ValueRange operator-(const ValueRange& a) {
+    return negate(a);
+}
+
+ValueRange builtinRange(BuiltinId id, const std::vector<ValueRange>& args, int components) {
+    for (const ValueRange& arg : args) {
+        if (arg.isEmpty()) {
+            return ValueRange::empty();
+        }
+    }
+    if (args.empty()) {
+        return ValueRange::full();
+    }
+    
+    const ValueRange& x = args[0];
+    
+    switch (id) {
+        case BuiltinId::SIN:
+        case BuiltinId::COS:
+            return ValueRange::between(-1.0, 1.0);
+        case BuiltinId::ASIN:
+            return ValueRange::between(-PI / 2, PI / 2);
+        case BuiltinId::ACOS:
+            return ValueRange::between(0.0, PI);
+        case BuiltinId::ATAN:
+            return args.size() == 1 ? ValueRange::between(-PI / 2, PI / 2) : ValueRange::between(-PI, PI);
+        case BuiltinId::ABS:
+            if (x.low >= 0.0) return x;
+            if (x.high <= 0.0) return negate(x);
+            return ValueRange::between(0.0, std::max(-x.low, x.high));
+        case BuiltinId::SIGN:
+            return ValueRange::between(x.low < 0.0 ? -1.0 : x.low > 0.0 ? 1.0 : 0.0,
+                                       x.high > 0.0 ? 1.0 : x.high < 0.0 ? -1.0 : 0.0);
+        case BuiltinId::SQRT:
+            return increasing(ValueRange::between(std::max(x.low, 0.0), std::max(x.high, 0.0)),
+                              [](double v) { return std::sqrt(v); });
+        case BuiltinId::INVERSESQRT:
+            return ValueRange::between(0.0, INF);
+        case BuiltinId::EXP:
+            return increasing(x, [](double v) { return std::exp(v); });
+        case BuiltinId::EXP2:
+            return increasing(x, [](double v) { return std::exp2(v); });
+        case BuiltinId::FLOOR:
+            return increasing(x, [](double v) { return std::floor(v); });
+        case BuiltinId::CEIL:
+            return increasing(x, [](double v) { return std::ceil(v); });
+        case BuiltinId::SATURATE:
+            if (x.within(0.0, 1.0)) {
+                return x;
+            }
+            return ValueRange::between(0.0, 1.0);
+        case BuiltinId::FRACT:
+        case BuiltinId::STEP:
+        case BuiltinId::SMOOTHSTEP:
+            return ValueRange::between(0.0, 1.0);
+        case BuiltinId::RADIANS:
+            return multiply(x, ValueRange::exactly(PI / 180.0));
+        case BuiltinId::DEGREES:
+            return multiply(x, ValueRange::exactly(180.0 / PI));
+        case BuiltinId::MOD:
+            if (args.size() == 2 && args[1].low > 0.0) {
+                return ValueRange::between(0.0, args[1].high);
+            }
+            break;
+        case BuiltinId::MIN:
+            if (args.size() == 2) {
+                return minRange(args[0], args[1]);
+            }
+            break;
+        case BuiltinId::MAX:
+            if (args.size() == 2) {
+                return maxRange(args[0], args[1]);
+            }
+            break;
+        case BuiltinId::CLAMP:
+            if (args.size() == 3) {
+                return minRange(maxRange(args[0], args[1]), args[2]);
+            }
+            break;
+        case BuiltinId::MIX:
+            if (args.size() == 3 && args[2].within(0.0, 1.0)) {
+                return args[0].join(args[1]);
+            }
+            break;
+        case BuiltinId::POW:
+            if (args.size() == 2 && x.low >= 0.0) {
+                if (x.high <= 1.0 && args[1].low >= 0.0) {
+                    return ValueRange::between(0.0, 1.0);
+                }
+                return ValueRange::between(0.0, INF);
+            }
+            break;
+        case BuiltinId::NORMALIZE:
+            return unitVector();
+        case BuiltinId::REFLECT:
+            if (args.size() == 2 && args[0].unit && args[1].unit) {
+                return unitVector();
+            }
+            break;
+        case BuiltinId::DOT:
+            if (args.size() == 2) {
+                if (args[0].unit && args[1].unit) {
+                    return ValueRange::between(-UNIT_BOUND, UNIT_BOUND);
+                }
+                return repeat(multiply(args[0], args[1]), components);
+            }
+            break;
+        case BuiltinId::LENGTH: {
+            if (x.unit) {
+                return ValueRange::between(2.0 - UNIT_BOUND, UNIT_BOUND);
+            }
+            double largest = std::max(std::fabs(x.low), std::fabs(x.high));
+            return ValueRange::between(0.0, largest * std::sqrt(components));
+        }
+        case BuiltinId::DISTANCE:
+            return ValueRange::between(0.0, INF);
+        default:
+            break;
+    }
+    
+    return ValueRange::full();
+}
+
+ValueRange ValueRange::full() {
+    return {-INF, INF};
+}
+
+ValueRange ValueRange::empty() {
+    return {INF, -INF};
+}
+
+ValueRange ValueRange::exactly(double value) {
+    return {value, value};
+}
+
+ValueRange ValueRange::between(double low, double high) {
+    return {low, high};
+}
+
+bool ValueRange::isFull() const {
+    return low == -INF && high == INF;
+}
+
+ValueRange ValueRange::join(const ValueRange& other) const {
+    if (isEmpty()) return other;
+    if (other.isEmpty()) return *this;
+    ValueRange result = between(std::min(low, other.low), std::max(high, other.high));
+    result.unit = unit && other.unit;
+    return result;
+}
+
+bool ValueRange::operator==(const ValueRange& other) const {
+    return low == other.low && high == other.high && unit == other.unit;
+}
+
+void ValueRangeAnalysis::analyze(Program& program) {
+    names_.resolve(program);
+    purity_.analyze(program);
+    variables_.clear();
+    widenings_.clear();
+    returns_.clear();
+    ranges_.clear();
+    loopCounters_.clear();
+    userFunctions_.clear();
+    
+    // Values that come from outside the program
+    auto seed = [this](std::vector<StatementPtr>& declarations) {
+        for (auto& decl : declarations) {
+            if (auto var = dynamic_cast<VariableDeclaration*>(decl.get())) {
+                if (var->qualifier == VariableDeclaration::Qualifier::UNIFORM ||
+                    var->qualifier == VariableDeclaration::Qualifier::IN) {
+                    variables_[var] = annotatedRange(*var);
+                } else if (var->qualifier == VariableDeclaration::Qualifier::CONST &&
+                           overriddenConsts_.count(var->name)) {
+                    variables_[var] = ValueRange::full();
+                }
+            } else if (auto func = dynamic_cast<FunctionDeclaration*>(decl.get())) {
+                userFunctions_.insert(func->name);
+                for (auto& param : func->parameters) {
+                    variables_[param.get()] = ValueRange::full();
+                }
+            }
+        }
+    };
+    seed(program.declarations);
+    for (auto& decl : program.declarations) {
+        if (auto shader = dynamic_cast<ShaderDeclaration*>(decl.get())) {
+            seed(shader->body);
+        }
+    }
+    
+    do {
+        changed_ = false;
+        for (auto& decl : program.declarations) {
+            if (auto shader = dynamic_cast<ShaderDeclaration*>(decl.get())) {
+                walkShader(program, *shader);
+            }
+        }
+    } while (changed_);
+}
+
+ValueRange ValueRangeAnalysis::rangeOf(const Expression* expr) const {
+    auto it = ranges_.find(expr);
+    return it != ranges_.end() ? it->second : ValueRange::full();
+}
+
+std::optional<bool> ValueRangeAnalysis::decide(const Expression* condition) const {
+    if (auto unary = dynamic_cast<const UnaryExpression*>(condition)) {
+        if (unary->op == UnaryExpression::Operator::LOGICAL_NOT) {
+            std::optional<bool> operand = decide(unary->operand.get());
+            return operand ? std::optional<bool>(!*operand) : std::nullopt;
+        }
+    }
+    
+    auto binary = dynamic_cast<const BinaryExpression*>(condition);
+    if (binary && (binary->op == BinaryExpression::Operator::LOGICAL_AND ||
+                   binary->op == BinaryExpression::Operator::LOGICAL_OR)) {
+        bool isAnd = binary->op == BinaryExpression::Operator::LOGICAL_AND;
+        std::optional<bool> left = decide(binary->left.get());
+        std::optional<bool> right = decide(binary->right.get());
+        // false && x, true || x
+        if ((left && *left != isAnd) || (right && *right != isAnd)) {
+            return !isAnd;
+        }
+        if (left && right) {
+            return isAnd;
+        }
+        return std::nullopt;
+    }
+    
+    if (binary && isScalar(kindOf(binary->left.get())) && isScalar(kindOf(binary->right.get()))) {
+        ValueRange a = rangeOf(binary->left.get());
+        ValueRange b = rangeOf(binary->right.get());
+        if (a.isEmpty() || b.isEmpty()) {
+            return std::nullopt;
+        }
+        switch (binary->op) {
+            case BinaryExpression::Operator::LESS_THAN:
+                if (a.high < b.low) return true;
+                if (a.low >= b.high) return false;
+                return std::nullopt;
+            case BinaryExpression::Operator::LESS_EQUAL:
+                if (a.high <= b.low) return true;
+                if (a.low > b.high) return false;
+                return std::nullopt;
+            case BinaryExpression::Operator::GREATER_THAN:
+                if (a.low > b.high) return true;
+                if (a.high <= b.low) return false;
+                return std::nullopt;
+            case BinaryExpression::Operator::GREATER_EQUAL:
+                if (a.low >= b.high) return true;
+                if (a.high < b.low) return false;
+                return std::nullopt;
+            case BinaryExpression::Operator::EQUAL:
+            case BinaryExpression::Operator::NOT_EQUAL: {
+                bool equal = binary->op == BinaryExpression::Operator::EQUAL;
+                if (a.low == a.high && b.low == b.high && a.low == b.low) return equal;
+                if (a.high < b.low || b.high < a.low) return !equal;
+                return std::nullopt;
+            }
+            default:
+                break;
+        }
+    }
+    
+    // Boolean constants
+    if (kindOf(condition) == Type::Kind::BOOL) {
+        ValueRange value = rangeOf(condition);
+        if (value.low == value.high && (value.low == 0.0 || value.low == 1.0)) {
+            return value.low == 1.0;
+        }
+    }
+    return std::nullopt;
+}
+
+void ValueRangeAnalysis::walkShader(Program& program, ShaderDeclaration& shader) {
+    FunctionLookup lookup(program, shader);
+    lookup_ = &lookup;
+    
+    // Program-level functions are walked once per shader that can call them
+    for (auto* body : {&shader.body, &program.declarations}) {
+        for (auto& stmt : *body) {
+            if (auto func = dynamic_cast<FunctionDeclaration*>(stmt.get())) {
+                function_ = func;
+                for (auto& bodyStmt : func->body) {
+                    walkStatement(bodyStmt.get());
+                }
+                function_ = nullptr;
+            } else if (auto var = dynamic_cast<VariableDeclaration*>(stmt.get())) {
+                walkStatement(var);
+            }
+        }
+    }
+    
+    lookup_ = nullptr;
+}
+
+void ValueRangeAnalysis::walkStatement(Statement* stmt) {
+    if (!stmt) {
+        return;
+    }
+    
+    if (auto block = dynamic_cast<BlockStatement*>(stmt)) {
+        for (auto& child : block->statements) {
+            walkStatement(child.get());
+        }
+    } else if (auto exprStmt = dynamic_cast<ExpressionStatement*>(stmt)) {
+        range(exprStmt->expression.get());
+    } else if (auto assignment = dynamic_cast<AssignmentStatement*>(stmt)) {
+        ValueRange value = range(assignment->value.get());
+        range(assignment->target.get());
+        assign(assignment->target.get(), value);
+    } else if (auto var = dynamic_cast<VariableDeclaration*>(stmt)) {
+        if (var->initializer && !loopCounters_.count(var)) {
+            joinInto(variables_.emplace(var, ValueRange::empty()).first->second, var,
+                     range(var->initializer.get()));
+        }
+    } else if (auto ifStmt = dynamic_cast<IfStatement*>(stmt)) {
+        range(ifStmt->condition.get());
+        walkStatement(ifStmt->thenStatement.get());
+        walkStatement(ifStmt->elseStatement.get());
+    } else if (auto forStmt = dynamic_cast<ForStatement*>(stmt)) {
+        walkFor(*forStmt);
+    } else if (auto whileStmt = dynamic_cast<WhileStatement*>(stmt)) {
+        range(whileStmt->condition.get());
+        walkStatement(whileStmt->body.get());
+    } else if (auto returnStmt = dynamic_cast<ReturnStatement*>(stmt)) {
+        if (returnStmt->value) {
+            ValueRange value = range(returnStmt->value.get());
+            if (function_) {
+                joinInto(returns_.emplace(function_, ValueRange::empty()).first->second, function_, value);
+            }
+        }
+    }
+}
+
+void ValueRangeAnalysis::walkFor(ForStatement& loop) {
+    auto counter = dynamic_cast<VariableDeclaration*>(loop.initialization.get());
+    std::optional<CountedLoop> counted = counter ? analyzeCountedLoop(loop) : std::nullopt;
+    if (!counted) {
+        walkStatement(loop.initialization.get());
+        range(loop.condition.get());
+        walkStatement(loop.body.get());
+        walkStatement(loop.update.get());
+        return;
+    }
+    
+    // The header sees every value up to the one that ends the loop, the body
+    // only the values it runs with
+    loopCounters_.insert(counter);
+    range(counter->initializer.get());
+    double start = static_cast<double>(counted->start);
+    double step = static_cast<double>(counted->step);
+    double end = start + step * static_cast<double>(counted->tripCount);
+    double last = counted->tripCount > 0 ? end - step : start;
+    ValueRange header = ValueRange::between(std::min(start, end), std::max(start, end));
+    ValueRange body = ValueRange::between(std::min(start, last), std::max(start, last));
+    
+    variables_[counter] = header;
+    range(loop.condition.get());
+    walkStatement(loop.update.get());
+    variables_[counter] = body;
+    walkStatement(loop.body.get());
+    variables_[counter] = header;
+}
+
+void ValueRangeAnalysis::assign(Expression* target, const ValueRange& value) {
+    // A write to v.x widens the range of all of v
+    while (auto member = dynamic_cast<MemberAccessExpression*>(target)) {
+        target = member->object.get();
+    }
+    auto identifier = dynamic_cast<IdentifierExpression*>(target);
+    if (!identifier) {
+        return;
+    }
+    const VariableDeclaration* var = names_.find(*identifier);
+    if (var && !loopCounters_.count(var)) {
+        joinInto(variables_.emplace(var, ValueRange::empty()).first->second, var, value);
+    }
+}
+
+void ValueRangeAnalysis::joinInto(ValueRange& slot, const void* key, const ValueRange& value) {
+    ValueRange joined = slot.join(value);
+    if (joined == slot) {
+        return;
+    }
+    if (++widenings_[key] > MAX_WIDENINGS) {
+        joined = ValueRange::full();
+    }
+    slot = joined;
+    changed_ = true;
+}
+
+ValueRange ValueRangeAnalysis::range(Expression* expr) {
+    if (!expr) {
+        return ValueRange::full();
+    }
+    ValueRange result = evaluate(expr);
+    // Ranges only grow between passes; keep the union over all of them
+    auto it = ranges_.find(expr);
+    if (it != ranges_.end()) {
+        it->second = it->second.join(result);
+    } else {
+        ranges_.emplace(expr, result);
+    }
+    return result;
+}
+
+ValueRange ValueRangeAnalysis::evaluate(Expression* expr) {
+    if (auto literal = dynamic_cast<LiteralExpression*>(expr)) {
+        if (literal->literalType == LiteralExpression::LiteralType::INT ||
+            literal->literalType == LiteralExpression::LiteralType::FLOAT) {
+            try {
+                return ValueRange::exactly(std::stod(literal->value));
+            } catch (const std::exception&) {
+                return ValueRange::full();
+            }
+        }
+        if (literal->literalType == LiteralExpression::LiteralType::BOOL) {
+            return ValueRange::exactly(literal->value == "true" ? 1.0 : 0.0);
+        }
+        return ValueRange::full();
+    }
+    
+    if (auto identifier = dynamic_cast<IdentifierExpression*>(expr)) {
+        if (const VariableDeclaration* var = names_.find(*identifier)) {
+            auto it = variables_.find(var);
+            return it != variables_.end() ? it->second : ValueRange::empty();
+        }
+        return builtinVariableRange(identifier->name);
+    }
+    
+    if (auto binary = dynamic_cast<BinaryExpression*>(expr)) {
+        ValueRange right = range(binary->right.get());
+        ValueRange left = range(binary->left.get());
+        Type::Kind leftKind = kindOf(binary->left.get());
+        Type::Kind rightKind = kindOf(binary->right.get());
+        bool integer = kindOf(binary) == Type::Kind::INT;
+        
+        switch (binary->op) {
+            case BinaryExpression::Operator::ASSIGN:
+                assign(binary->left.get(), right);
+                return right;
+            case BinaryExpression::Operator::ADD:
+                return add(left, right);
+            case BinaryExpression::Operator::SUBTRACT:
+                return subtract(left, right);
+            case BinaryExpression::Operator::MULTIPLY:
+                // Matrix products sum one product per row element
+                if (isMatrix(leftKind) && !isScalar(rightKind)) {
+                    return repeat(multiply(left, right), matrixDimension(leftKind));
+                }
+                if (isMatrix(rightKind) && !isScalar(leftKind)) {
+                    return repeat(multiply(left, right), matrixDimension(rightKind));
+                }
+                return multiply(left, right);
+            case BinaryExpression::Operator::DIVIDE:
+                return integer ? truncated(divide(left, right)) : divide(left, right);
+            case BinaryExpression::Operator::MODULO:
+                if (left.low >= 0.0 && right.low > 0.0 && !right.isEmpty()) {
+                    return ValueRange::between(0.0, std::min(left.high, right.high - 1.0));
+                }
+                return ValueRange::full();
+            default:
+                // Comparisons and logical operators
+                return ValueRange::between(0.0, 1.0);
+        }
+    }
+    
+    if (auto unary = dynamic_cast<UnaryExpression*>(expr)) {
+        ValueRange operand = range(unary->operand.get());
+        if (unary->op == UnaryExpression::Operator::MINUS) {
+            return negate(operand);
+        }
+        return ValueRange::between(0.0, 1.0);
+    }
+    
+    if (auto member = dynamic_cast<MemberAccessExpression*>(expr)) {
+        ValueRange object = range(member->object.get());
+        object.unit = false;
+        return object;
+    }
+    
+    if (auto call = dynamic_cast<FunctionCallExpression*>(expr)) {
+        return evaluateCall(*call);
+    }
+    
+    return ValueRange::full();
+}
+
+ValueRange ValueRangeAnalysis::evaluateCall(FunctionCallExpression& call) {
+    std::vector<ValueRange> args;
+    for (auto& arg : call.arguments) {
+        args.push_back(range(arg.get()));
+    }
+    
+    if (FunctionDeclaration* callee = lookup_ ? lookup_->resolve(call) : nullptr) {
+        auto it = returns_.find(callee);
+        return it != returns_.end() ? it->second : ValueRange::empty();
+    }
+    
+    for (const ValueRange& arg : args) {
+        if (arg.isEmpty()) {
+            return ValueRange::empty();
+        }
+    }
+    
+    // Constructors keep the range of their components
+    Type::Kind constructed;
+    if (typeFromName(call.functionName, constructed)) {
+        if (constructed == Type::Kind::BOOL) {
+            return ValueRange::between(0.0, 1.0);
+        }
+        ValueRange result = ValueRange::empty();
+        for (const ValueRange& arg : args) {
+            result = result.join(arg);
+        }
+        result.unit = false;
+        return constructed == Type::Kind::INT ? truncated(result) : result;
+    }
+    
+    int components = args.empty() ? 0 : componentCount(kindOf(call.arguments[0].get()));
+    return builtinRange(call.builtin, args, components);
+}
+
+bool ValueRangeAnalysis::hasSideEffects(Expression* expr) const {
+    if (!expr) {
+        return false;
+    }
+    SideEffectFinder finder(purity_);
+    expr->accept(finder);
+    return finder.found;
+}
+
+RangeEliminations ValueRangeAnalysis::eliminateRedundantChecks(Program& program) {
+    RangeEliminations removed;
+    simplifyStatements(program.declarations, removed);
+    return removed;
+}
+
+void ValueRangeAnalysis::simplifyStatements(std::vector<StatementPtr>& statements, RangeEliminations& removed) {
+    for (auto& stmt : statements) {
+        simplify(stmt, removed);
+    }
+    // An eliminated if without the branch that runs leaves nothing behind
+    statements.erase(std::remove(statements.begin(), statements.end(), nullptr), statements.end());
+}
+
+void ValueRangeAnalysis::simplify(StatementPtr& stmt, RangeEliminations& removed) {
+    if (!stmt) {
+        return;
+    }
+    
+    // Nested statements must stay present; an emptied branch becomes {}
+    auto simplifyNested = [&](StatementPtr& nested) {
+        if (!nested) {
+            return;
+        }
+        simplify(nested, removed);
+        if (!nested) {
+            nested = std::make_unique<BlockStatement>();
+        }
+    };
+    
+    if (auto block = dynamic_cast<BlockStatement*>(stmt.get())) {
+        simplifyStatements(block->statements, removed);
+    } else if (auto exprStmt = dynamic_cast<ExpressionStatement*>(stmt.get())) {
+        simplify(exprStmt->expression, removed);
+    } else if (auto assignment = dynamic_cast<AssignmentStatement*>(stmt.get())) {
+        simplify(assignment->target, removed);
+        simplify(assignment->value, removed);
+    } else if (auto var = dynamic_cast<VariableDeclaration*>(stmt.get())) {
+        simplify(var->initializer, removed);
+    } else if (auto func = dynamic_cast<FunctionDeclaration*>(stmt.get())) {
+        simplifyStatements(func->body, removed);
+    } else if (auto shader = dynamic_cast<ShaderDeclaration*>(stmt.get())) {
+        simplifyStatements(shader->body, removed);
+    } else if (auto ifStmt = dynamic_cast<IfStatement*>(stmt.get())) {
+        simplify(ifStmt->condition, removed);
+        simplifyNested(ifStmt->thenStatement);
+        simplifyNested(ifStmt->elseStatement);
+        
+        std::optional<bool> taken = decide(ifStmt->condition.get());
+        if (taken && !hasSideEffects(ifStmt->condition.get())) {
+            ++removed.decidedBranches;
+            StatementPtr branch = *taken ? std::move(ifStmt->thenStatement) : std::move(ifStmt->elseStatement);
+            stmt = std::move(branch);
+        }
+    } else if (auto forStmt = dynamic_cast<ForStatement*>(stmt.get())) {
+        simplifyNested(forStmt->initialization);
+        simplify(forStmt->condition, removed);
+        simplifyNested(forStmt->update);
+        simplifyNested(forStmt->body);
+    } else if (auto whileStmt = dynamic_cast<WhileStatement*>(stmt.get())) {
+        simplify(whileStmt->condition, removed);
+        simplifyNested(whileStmt->body);
+    } else if (auto returnStmt = dynamic_cast<ReturnStatement*>(stmt.get())) {
+        simplify(returnStmt->value, removed);
+    }
+}
+
+void ValueRangeAnalysis::simplify(ExpressionPtr& expr, RangeEliminations& removed) {
+    if (!expr) {
+        return;
+    }
+    
+    if (auto binary = dynamic_cast<BinaryExpression*>(expr.get())) {
+        simplify(binary->left, removed);
+        simplify(binary->right, removed);
+        return;
+    }
+    if (auto unary = dynamic_cast<UnaryExpression*>(expr.get())) {
+        simplify(unary->operand, removed);
+        return;
+    }
+    if (auto member = dynamic_cast<MemberAccessExpression*>(expr.get())) {
+        simplify(member->object, removed);
+        return;
+    }
+    
+    auto call = dynamic_cast<FunctionCallExpression*>(expr.get());
+    if (!call) {
+        return;
+    }
+    for (auto& arg : call->arguments) {
+        simplify(arg, removed);
+    }
+    if (userFunctions_.count(call->functionName)) {
+        return;
+    }
+    
+    // Replaces the call by argument `keep` when that does not change the
+    // type and every dropped argument can be skipped
+    auto replaceWith = [&](size_t keep) {
+        if (kindOf(call) != kindOf(call->arguments[keep].get())) {
+            return false;
+        }
+        for (size_t i = 0; i < call->arguments.size(); ++i) {
+            if (i != keep && hasSideEffects(call->arguments[i].get())) {
+                return false;
+            }
+        }
+        ExpressionPtr kept = std::move(call->arguments[keep]);
+        expr = std::move(kept);
+        ++removed.clamps;
+        return true;
+    };
+    
+    std::vector<ValueRange> args;
+    for (auto& arg : call->arguments) {
+        args.push_back(rangeOf(arg.get()));
+        if (args.back().isEmpty()) {
+            return;
+        }
+    }
+    
+    BuiltinId builtin = call->builtin;
+    if (builtin == BuiltinId::CLAMP && args.size() == 3) {
+        if (args[0].low >= args[1].high && args[0].high <= args[2].low) {
+            replaceWith(0);
+        }
+    } else if (builtin == BuiltinId::SATURATE && args.size() == 1) {
+        if (args[0].within(0.0, 1.0)) {
+            replaceWith(0);
+        }
+    } else if (builtin == BuiltinId::MAX && args.size() == 2) {
+        if (args[0].low >= args[1].high) {
+            replaceWith(0);
+        } else if (args[1].low >= args[0].high) {
+            replaceWith(1);
+        }
+    } else if (builtin == BuiltinId::MIN && args.size() == 2) {
+        if (args[0].high <= args[1].low) {
+            replaceWith(0);
+        } else if (args[1].high <= args[0].low) {
+            replaceWith(1);
+        }
+    }
+}
+
+} // namespace sdl
@@ -16,6 +16,31 @@ CLIParser::Options CLIParser::parse(int argc, char* argv[]) {
             options.showVersion = true;
         } else if (arg == "--verbose") {
             options.verbose = true;
+        } else if (arg == "--stats") {
+            options.stats = "text";
+        } else if (arg.rfind("--stats=", 0) == 0) {
+            options.stats = arg.substr(8);
+            if (options.stats != "text" && options.stats != "json") {
+                throw std::runtime_error("Unknown stats format: " + options.stats);
+            }
+        } else if (arg == "-O0" || arg == "-O1" || arg == "-O2" || arg == "-O3" || arg == "-Os") {
+            options.optimization = arg.substr(2);
+        } else if (arg.rfind("--passes=", 0) == 0) {
+            options.passes = arg.substr(9);
+        } else if (arg == "--time-passes") {
+            options.timePasses = true;
+        } else if (arg == "--fast-math") {
+            options.fastMath = true;
+        } else if (arg == "--glsl-es") {
+            options.glslES = true;
+        } else if (arg == "--fold-uniforms") {
+            options.foldUniforms = true;
+        } else if (arg == "--preshader") {
+            options.preshader = true;
+        } else if (arg.rfind("--print-before=", 0) == 0) {
+            options.printBefore = arg.substr(15);
+        } else if (arg.rfind("--print-after=", 0) == 0) {
+            options.printAfter = arg.substr(14);
         } else if (arg == "-t" || arg == "--target") {
             if (i + 1 < argc) {
                 std::string targets = argv[++i];
@@ -35,6 +60,12 @@ CLIParser::Options CLIParser::parse(int argc, char* argv[]) {
             } else {
                 throw std::runtime_error("Missing argument for " + arg);
             }
+        } else if (arg == "--permutations") {
+            if (i + 1 < argc) {
+                options.permutations = argv[++i];
+            } else {
+                throw std::runtime_error("Missing argument for " + arg);
+            }
         } else if (arg == "-D" || arg == "--define") {
             if (i + 1 < argc) {
                 options.defines.push_back(argv[++i]);
@@ -63,8 +94,22 @@ void CLIParser::printHelp() {
     std::cout << "  -t, --target <target>     Target language (glsl, cuda, or both)\n";
     std::cout << "  -o, --output <file>       Output file name\n";
     std::cout << "  -I, --include <dir>       Add include directory\n";
-    std::cout << "  -D, --define <macro>      Define preprocessor macro\n";
+    std::cout << "  -D, --define <name[=val]> Override the scalar const <name> (value defaults to 1)\n";
+    std::cout << "  --permutations <file>     Compile every combination of the define values in a JSON matrix,\n";
+    std::cout << "                            one output per distinct result, plus <output>_permutations.json\n";
+    std::cout << "  -O0, -O1, -O2, -O3, -Os   Optimization level (default -O2); -O3 adds a second\n";
+    std::cout << "                            cleanup round, -Os drops unrolling and inlines less\n";
+    std::cout << "  --passes=<pass,...>       Run these IR passes instead of the level's pipeline\n";
+    std::cout << "  --time-passes             Report wall time and IR size change of each pass\n";
+    std::cout << "  --print-before=<pass>     Dump the IR before each run of a pass (or all)\n";
+    std::cout << "  --print-after=<pass>      Dump the IR after each run of a pass (or all)\n";
+    std::cout << "  --fast-math               Reassociate and use approximate division and transcendentals\n";
+    std::cout << "  --glsl-es                 Emit GLSL ES 3.00 with mediump where half precision suffices\n";
+    std::cout << "  --fold-uniforms           Replace products of uniform matrices by one uniform, computed by\n";
+    std::cout << "                            the code written to <output>_uniforms.h\n";
+    std::cout << "  --preshader               Also move any expression of uniforms alone there\n";
     std::cout << "  --verbose                 Enable verbose output\n";
+    std::cout << "  --stats[=text|json]       Print the static cost estimate of every shader\n";
     std::cout << "  -h, --help                Show this help message\n";
     std::cout << "  -v, --version             Show version information\n\n";
     std::cout << "Examples:\n";
@@ -72,6 +117,9 @@ void CLIParser::printHelp() {
     std::cout << "  sdl_compiler -t cuda shader.sdl           # Compile to CUDA\n";
     std::cout << "  sdl_compiler -t glsl,cuda shader.sdl      # Compile to both\n";
     std::cout << "  sdl_compiler -o output.glsl shader.sdl    # Specify output file\n";
+    std::cout << "  sdl_compiler --stats=json shader.sdl      # Cost report for CI\n";
+    std::cout << "  sdl_compiler -O0 shader.sdl               # Fast compile for hot reload\n";
+    std::cout << "  sdl_compiler --permutations matrix.json shader.sdl  # All variants, parsed once\n";
 }
 
 void CLIParser::printVersion() {
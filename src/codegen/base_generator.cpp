@@ -6,6 +6,19 @@ std::string BaseCodeGenerator::generate(Program& program) {
     output_.str("");
     output_.clear();
     
+    userFunctions_.clear();
+    for (auto& decl : program.declarations) {
+        if (auto func = dynamic_cast<FunctionDeclaration*>(decl.get())) {
+            userFunctions_.insert(func->name);
+        } else if (auto shader = dynamic_cast<ShaderDeclaration*>(decl.get())) {
+            for (auto& stmt : shader->body) {
+                if (auto shaderFunc = dynamic_cast<FunctionDeclaration*>(stmt.get())) {
+                    userFunctions_.insert(shaderFunc->name);
+                }
+            }
+        }
+    }
+    
     generatePreamble();
     program.accept(*this);
     generatePostamble();
@@ -38,4 +51,30 @@ void BaseCodeGenerator::decreaseIndent() {
     }
 }
 
+std::string BaseCodeGenerator::capture(Expression& expr) {
+    std::stringstream saved;
+    saved.swap(output_);
+    expr.accept(*this);
+    std::string text = output_.str();
+    output_.swap(saved);
+    return text;
+}
+
+void BaseCodeGenerator::generateCall(FunctionCallExpression& node) {
+    std::vector<std::string> args;
+    for (auto& arg : node.arguments) {
+        args.push_back(capture(*arg));
+    }
+    
+    const BuiltinInfo* builtin = builtinInfo(node.builtin);
+    if (builtin && !userFunctions_.count(node.functionName)) {
+        std::string lowered = lowerBuiltin(getBuiltinTemplate(*builtin), args, builtin->minArgs);
+        if (!lowered.empty()) {
+            write(lowered);
+            return;
+        }
+    }
+    write(getFunctionCallString(node.functionName, args));
+}
+
 } // namespace sdl
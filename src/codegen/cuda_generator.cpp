@@ -1,4 +1,5 @@
 #include "codegen/cuda_generator.h"
+#include "analysis/uniformity.h"
 
 namespace sdl {
 
@@ -30,17 +31,12 @@ void CUDAGenerator::visit(UnaryExpression& node) {
 }
 
 void CUDAGenerator::visit(FunctionCallExpression& node) {
-    write(node.functionName + "(");
-    for (size_t i = 0; i < node.arguments.size(); ++i) {
-        if (i > 0) write(", ");
-        node.arguments[i]->accept(*this);
-    }
-    write(")");
+    generateCall(node);
 }
 
 void CUDAGenerator::visit(MemberAccessExpression& node) {
     node.object->accept(*this);
-    write("." + node.member);
+    write(node.member.front() == '[' ? node.member : "." + node.member);
 }
 
 void CUDAGenerator::visit(ExpressionStatement& node) {
@@ -160,7 +156,29 @@ void CUDAGenerator::visit(BlockStatement& node) {
 }
 
 void CUDAGenerator::visit(IfStatement& node) {
-    // Stub implementation
+    indent();
+    write("if (");
+    if (node.condition) {
+        node.condition->accept(*this);
+    }
+    write(") {");
+    if (uniformity_) {
+        // A uniform branch is taken by the whole warp and costs no serialization
+        write(uniformity_->isUniformBranch(&node) ? " // uniform" : " // divergent");
+    }
+    write("\n");
+    increaseIndent();
+    if (node.thenStatement) {
+        node.thenStatement->accept(*this);
+    }
+    decreaseIndent();
+    if (node.elseStatement) {
+        writeLine("} else {");
+        increaseIndent();
+        node.elseStatement->accept(*this);
+        decreaseIndent();
+    }
+    writeLine("}");
 }
 
 void CUDAGenerator::visit(ForStatement& node) {
@@ -200,7 +218,13 @@ void CUDAGenerator::visit(WhileStatement& node) {
 }
 
 void CUDAGenerator::visit(ReturnStatement& node) {
-    // Stub implementation
+    indent();
+    write("return");
+    if (node.value) {
+        write(" ");
+        node.value->accept(*this);
+    }
+    write(";\n");
 }
 
 void CUDAGenerator::visit(Program& node) {
@@ -270,7 +294,7 @@ std::string CUDAGenerator::getUnaryOperatorString(UnaryExpression::Operator op)
 
 std::string CUDAGenerator::getFunctionCallString(const std::string& name, 
                                                 const std::vector<std::string>& args) {
-    std::string result = getCUDABuiltinFunction(name) + "(";
+    std::string result = name + "(";
     for (size_t i = 0; i < args.size(); ++i) {
         if (i > 0) result += ", ";
         result += args[i];
@@ -293,16 +317,8 @@ void CUDAGenerator::generateCUDAIncludes() {
     writeLine("");
 }
 
-std::string CUDAGenerator::getCUDABuiltinFunction(const std::string& name) {
-    // Map GLSL functions to CUDA equivalents
-    if (name == "texture") return "tex2D";
-    if (name == "normalize") return "normalize";
-    if (name == "dot") return "dot";
-    if (name == "cross") return "cross";
-    if (name == "length") return "length";
-    if (name == "distance") return "distance";
-    
-    return name; // Return as-is if no mapping found
+const char* CUDAGenerator::getBuiltinTemplate(const BuiltinInfo& builtin) {
+    return builtin.cuda;
 }
 
 std::string CUDAGenerator::mapGLSLTypeToCUDA(const std::string& glslType) {
@@ -32,19 +32,14 @@ void GLSLGenerator::visit(UnaryExpression& node) {
 }
 
 void GLSLGenerator::visit(FunctionCallExpression& node) {
-    write(node.functionName + "(");
-    for (size_t i = 0; i < node.arguments.size(); ++i) {
-        if (i > 0) write(", ");
-        node.arguments[i]->accept(*this);
-    }
-    write(")");
+    generateCall(node);
 }
 
 void GLSLGenerator::visit(MemberAccessExpression& node) {
     if (node.object) {
         node.object->accept(*this);
     }
-    write("." + node.member);
+    write(node.member.front() == '[' ? node.member : "." + node.member);
 }
 
 void GLSLGenerator::visit(ExpressionStatement& node) {
@@ -330,9 +325,8 @@ void GLSLGenerator::generateGLSLVersion() {
     writeLine("");
 }
 
-std::string GLSLGenerator::getGLSLBuiltinFunction(const std::string& name) {
-    // Return GLSL built-in function names as-is
-    return name;
+const char* GLSLGenerator::getBuiltinTemplate(const BuiltinInfo& builtin) {
+    return builtin.glsl;
 }
 
 } // namespace sdl
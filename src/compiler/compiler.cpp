@@ -1,21 +1,118 @@
 #include "compiler/compiler.h"
 #include "lexer/lexer.h"
 #include "parser/parser.h"
+#include "semantic/analyzer.h"
+#include "semantic/builtins.h"
+#include "semantic/types.h"
+#include "analysis/stage_interface.h"
+#include "analysis/cost_model.h"
+#include "analysis/liveness.h"
+#include "analysis/uniformity.h"
+#include "analysis/value_range.h"
 #include "codegen/glsl_generator.h"
 #include "codegen/cuda_generator.h"
+#include "ir/cuda_printer.h"
+#include "ir/glsl_printer.h"
+#include "ir/host_printer.h"
+#include "ir/lowering.h"
+#include "ir/pass_manager.h"
+#include "utils/json.h"
+#include "utils/parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <fstream>
 #include <sstream>
 
 namespace sdl {
 
+std::vector<Permutation> expandPermutations(const std::string& matrix) {
+    JsonValue document = parseJson(matrix);
+    if (document.kind != JsonValue::Kind::OBJECT || document.keys.empty()) {
+        throw std::runtime_error("Permutation matrix must be an object of define names to value arrays");
+    }
+    
+    // Each define's values as -D spells them, numbers in their shortest
+    // spelling so that 1 and 1.0 give the same key
+    std::vector<std::vector<std::string>> values;
+    for (size_t d = 0; d < document.keys.size(); ++d) {
+        const JsonValue& list = document.elements[d];
+        if (std::find(document.keys.begin(), document.keys.begin() + d, document.keys[d]) !=
+            document.keys.begin() + d) {
+            throw std::runtime_error("Permutation matrix: " + document.keys[d] + " is listed twice");
+        }
+        if (list.kind != JsonValue::Kind::ARRAY || list.elements.empty()) {
+            throw std::runtime_error("Permutation matrix: " + document.keys[d] + " needs a non-empty array of values");
+        }
+        values.emplace_back();
+        for (const JsonValue& value : list.elements) {
+            std::string spelling;
+            if (value.kind == JsonValue::Kind::BOOLEAN) {
+                spelling = value.boolean ? "true" : "false";
+            } else if (value.kind == JsonValue::Kind::NUMBER) {
+                spelling = JsonWriter().number(value.number == 0 ? 0.0 : value.number).str();
+            } else {
+                throw std::runtime_error("Permutation matrix: values of " + document.keys[d] +
+                                         " must be numbers or booleans");
+            }
+            if (std::find(values.back().begin(), values.back().end(), spelling) != values.back().end()) {
+                throw std::runtime_error("Permutation matrix: " + document.keys[d] + " lists the value " +
+                                         spelling + " twice");
+            }
+            values.back().push_back(spelling);
+        }
+    }
+    
+    // Odometer over the value lists, the last define changing fastest
+    std::vector<Permutation> permutations;
+    std::vector<size_t> digits(values.size(), 0);
+    for (bool done = false; !done;) {
+        Permutation permutation;
+        for (size_t d = 0; d < values.size(); ++d) {
+            std::string define = document.keys[d] + "=" + values[d][digits[d]];
+            permutation.key += (d == 0 ? "" : ",") + define;
+            permutation.defines.push_back(define);
+        }
+        permutations.push_back(std::move(permutation));
+        
+        size_t d = values.size();
+        while (d > 0 && ++digits[d - 1] == values[d - 1].size()) {
+            digits[--d] = 0;
+        }
+        done = d == 0;
+    }
+    return permutations;
+}
+
 class Compiler::Impl {
 public:
     std::string glslOutput_;
     std::string cudaOutput_;
+    std::string hostUniformsOutput_;
+    std::string statsOutput_;
+    std::string passOutput_;
     std::vector<std::string> errors_;
     std::vector<std::string> warnings_;
+    std::vector<PermutationVariant> variants_;
+    std::vector<size_t> permutationVariants_;
+    
+    // Kept across compile() calls so unchanged declarations are not re-checked
+    SemanticAnalyzer analyzer_;
     
-    bool compile(const CompilerOptions& options) {
+    Impl() {
+        analyzer_.setIncremental(true);
+    }
+    
+    bool compile(const CompilerOptions& options, const std::vector<Permutation>* permutations = nullptr) {
+        errors_.clear();
+        warnings_.clear();
+        statsOutput_.clear();
+        passOutput_.clear();
+        hostUniformsOutput_.clear();
+        variants_.clear();
+        permutationVariants_.clear();
+        
         try {
             // Read input file
             std::ifstream file(options.inputFile);
@@ -53,18 +150,191 @@ public:
                 printf("Parsed %zu declarations\n", program->declarations.size());
             }
             
-            // Code generation
+            // Semantic analysis
+            bool analyzed = analyzer_.analyze(*program);
+            
+            for (const auto& diagnostic : analyzer_.getDiagnostics()) {
+                if (diagnostic.severity == Diagnostic::Severity::ERROR) {
+                    errors_.push_back(diagnostic.format());
+                } else {
+                    warnings_.push_back(diagnostic.format());
+                }
+            }
+            
+            if (!analyzed) {
+                return false;
+            }
+            
+            if (options.verbose) {
+                printf("Semantic analysis passed (%zu diagnostics, %zu declarations re-analyzed, %zu reused)\n",
+                       analyzer_.getDiagnostics().size(), analyzer_.getReanalyzedCount(),
+                       analyzer_.getReusedCount());
+            }
+            
+            // Vertex outputs must match the fragment inputs that read them
+            StageInterface stageInterface;
+            bool linked = stageInterface.link(*program);
+            
+            for (const auto& diagnostic : stageInterface.getDiagnostics()) {
+                if (diagnostic.severity == Diagnostic::Severity::ERROR) {
+                    errors_.push_back(diagnostic.format());
+                } else {
+                    warnings_.push_back(diagnostic.format());
+                }
+            }
+            
+            if (!linked) {
+                return false;
+            }
+            
+            if (options.optimization != OptimizationLevel::O0) {
+                stageInterface.optimize();
+                
+                if (options.verbose) {
+                    for (const auto& link : stageInterface.getLinks()) {
+                        if (link.fragments.empty()) {
+                            continue;
+                        }
+                        printf("Varyings of %s: %d interpolator slots -> %d (%zu unread outputs dropped)\n",
+                               link.vertex->name.c_str(), link.slotsBefore, link.slotsAfter,
+                               link.dropped.size());
+                    }
+                }
+            }
+            
+            // Drop clamps and branches the value ranges make redundant
+            RangeEliminations rangeEliminations;
+            if (options.optimization != OptimizationLevel::O0) {
+                std::unordered_set<std::string> overridden;
+                for (const auto& define : options.defines) {
+                    overridden.insert(define.substr(0, define.find('=')));
+                }
+                for (size_t i = 0; permutations && i < permutations->size(); ++i) {
+                    for (const auto& define : (*permutations)[i].defines) {
+                        overridden.insert(define.substr(0, define.find('=')));
+                    }
+                }
+                ValueRangeAnalysis ranges;
+                ranges.setOverriddenConsts(overridden);
+                ranges.analyze(*program);
+                rangeEliminations = ranges.eliminateRedundantChecks(*program);
+                
+                if (options.verbose) {
+                    printf("Range analysis removed %d clamp/min/max calls and %d decided branches\n",
+                           rangeEliminations.clamps, rangeEliminations.decidedBranches);
+                }
+            }
+            
+            LivenessAnalysis liveness;
+            std::vector<RegisterPressure> pressure = liveness.analyze(*program);
+            warnAboutRegisterPressure(pressure, options);
+            
+            UniformityAnalysis uniformity;
+            uniformity.analyze(*program);
+            const std::vector<DivergentFetch>& fetches = uniformity.getDivergentFetches();
+            
+            // Code generation goes through the SSA IR; programs it cannot
+            // represent yet are printed from the AST
+            IRModule module;
+            IRLowering lowering;
+            bool useIR = lowering.lower(*program, module, &uniformity);
+            if (options.fastMath) {
+                for (auto& function : module.functions) {
+                    function.fastMath = true;
+                }
+            }
+            if (!useIR && options.verbose) {
+                printf("Generating from the AST: %s\n", lowering.error().c_str());
+            }
+            
+            PassManager passes(options.optimization);
+            if (!configure(passes, options)) {
+                errors_.push_back(passes.error());
+                return false;
+            }
+            
+            if (permutations) {
+                if (!useIR) {
+                    errors_.push_back("Permutations need IR code generation: " + lowering.error());
+                    return false;
+                }
+                PassStatistics statistics;
+                if (!compileVariants(module, *permutations, options, fetches, statistics)) {
+                    return false;
+                }
+                if (options.stats != StatsFormat::NONE) {
+                    statsOutput_ = formatStats(*program, pressure, rangeEliminations, statistics,
+                                               StrippedInterface(), options);
+                }
+                return true;
+            }
+            
+            // Defines specialize the IR; the AST printers do not know them
+            if (useIR) {
+                std::vector<std::string> unmatched;
+                std::string problem = applyDefines(module, options.defines, unmatched);
+                if (!problem.empty()) {
+                    errors_.push_back(problem);
+                    return false;
+                }
+                warnAboutUnmatchedDefines(unmatched);
+            } else if (!options.defines.empty()) {
+                warnings_.push_back("Defines are ignored when generating from the AST");
+            }
+            
+            if (useIR) {
+                useIR = passes.run(module);
+                passOutput_ = passes.getDumps();
+                if (options.timePasses) {
+                    passOutput_ += passes.formatTimings();
+                }
+                if (!useIR) {
+                    warnings_.push_back("Generating from the AST: " + passes.error());
+                } else {
+                    HostPrinter host;
+                    hostUniformsOutput_ = host.print(module);
+                }
+                if (options.verbose) {
+                    printf("%s", passes.formatStatistics().c_str());
+                    for (const auto& stripped : strippedInterface(module)) {
+                        printf("Stripped unused %s from %s\n", stripped.second.c_str(), stripped.first.c_str());
+                    }
+                    for (const auto& shader : module.shaders) {
+                        for (const auto& inst : shader.preshader.instructions) {
+                            if (inst.op == IROp::STORE) {
+                                printf("Preshader of %s computes uniform %s\n", shader.name.c_str(),
+                                       module.globals[inst.imm].name.c_str());
+                            }
+                        }
+                    }
+                }
+            }
+            warnAboutDivergentFetches(fetches, useIR ? remainingFetches(module, fetches)
+                                                     : std::vector<bool>(fetches.size(), true), options);
+            
+            if (options.stats != StatsFormat::NONE) {
+                statsOutput_ = formatStats(*program, pressure, rangeEliminations, passes.getStatistics(),
+                                           useIR ? strippedInterface(module) : StrippedInterface(), options);
+            }
+            
             for (auto target : options.targets) {
                 if (target == TargetLanguage::GLSL) {
-                    GLSLGenerator generator;
-                    glslOutput_ = generator.generate(*program);
+                    GLSLPrinter printer(options.glslES);
+                    if (!useIR || !printIR(printer, module, glslOutput_, options)) {
+                        GLSLGenerator generator;
+                        glslOutput_ = generator.generate(*program);
+                    }
                     
                     if (options.verbose) {
                         printf("Generated GLSL output (%zu characters)\n", glslOutput_.length());
                     }
                 } else if (target == TargetLanguage::CUDA) {
-                    CUDAGenerator generator;
-                    cudaOutput_ = generator.generate(*program);
+                    CUDAPrinter printer;
+                    if (!useIR || !printIR(printer, module, cudaOutput_, options)) {
+                        CUDAGenerator generator;
+                        generator.setUniformity(&uniformity);
+                        cudaOutput_ = generator.generate(*program);
+                    }
                     
                     if (options.verbose) {
                         printf("Generated CUDA output (%zu characters)\n", cudaOutput_.length());
@@ -79,6 +349,429 @@ public:
             return false;
         }
     }
+    
+    static bool configure(PassManager& passes, const CompilerOptions& options) {
+        passes.setTiming(options.timePasses);
+        passes.setFoldUniformProducts(options.foldUniforms || options.preshader);
+        passes.setExtractPreshader(options.preshader);
+        return (options.passes.empty() || passes.setPipeline(options.passes)) &&
+               (options.printBefore.empty() || passes.setPrintBefore(options.printBefore)) &&
+               (options.printAfter.empty() || passes.setPrintAfter(options.printAfter));
+    }
+    
+    // Gives the consts the defines name their values. Returns an error
+    // message or "", and lists in `unmatched` the defines naming no const.
+    static std::string applyDefines(IRModule& module, const std::vector<std::string>& defines,
+                                    std::vector<std::string>& unmatched) {
+        for (const auto& define : defines) {
+            size_t equals = define.find('=');
+            std::string name = define.substr(0, equals);
+            std::string text = equals == std::string::npos ? "1" : define.substr(equals + 1);
+            double value = text == "true" ? 1 : 0;
+            if (text != "true" && text != "false") {
+                char* end = nullptr;
+                value = std::strtod(text.c_str(), &end);
+                if (text.empty() || *end != '\0') {
+                    return "Define " + define + ": the value must be a number, true or false";
+                }
+            }
+            for (const auto& global : module.globals) {
+                if (global.name != name || global.qualifier != VariableDeclaration::Qualifier::CONST) {
+                    continue;
+                }
+                if (global.type == Type::Kind::INT && (value != std::trunc(value) || value < INT32_MIN ||
+                                                       value > INT32_MAX)) {
+                    return "Define " + define + ": const int " + name + " needs an integer value";
+                }
+                if (global.type == Type::Kind::BOOL && text != "true" && text != "false" && value != 0 &&
+                    value != 1) {
+                    return "Define " + define + ": const bool " + name + " needs true, false, 0 or 1";
+                }
+            }
+            if (specializeConstant(module, name, value) == 0) {
+                unmatched.push_back(name);
+            }
+        }
+        return "";
+    }
+    
+    void warnAboutUnmatchedDefines(const std::vector<std::string>& unmatched) {
+        for (const auto& name : unmatched) {
+            warnings_.push_back("Define " + name + " matches no scalar const; ignored");
+        }
+    }
+    
+    // Specializes, optimizes and prints a copy of the module per
+    // permutation, then keeps one output per distinct final IR: a matching
+    // hash is only shared once the printed outputs compare equal too
+    bool compileVariants(const IRModule& module, const std::vector<Permutation>& permutations,
+                         const CompilerOptions& options, const std::vector<DivergentFetch>& fetches,
+                         PassStatistics& statistics) {
+        struct Result {
+            std::string error;
+            std::vector<std::string> unmatched;
+            std::vector<bool> remaining; // Per divergent fetch
+            std::string passOutput;
+            PassStatistics statistics;
+            PermutationVariant variant;
+        };
+        std::vector<Result> results(permutations.size());
+        std::vector<bool> remaining(fetches.size(), false);
+        Parallel::forEach(permutations.size(), 0, [&](size_t i) {
+            Result& result = results[i];
+            IRModule specialized = module;
+            std::vector<std::string> defines = options.defines;
+            defines.insert(defines.end(), permutations[i].defines.begin(), permutations[i].defines.end());
+            result.error = applyDefines(specialized, defines, result.unmatched);
+            if (!result.error.empty()) {
+                return;
+            }
+            
+            PassManager passes(options.optimization);
+            configure(passes, options);
+            if (!passes.run(specialized)) {
+                result.error = passes.error();
+                return;
+            }
+            result.passOutput = passes.getDumps() + (options.timePasses ? passes.formatTimings() : "");
+            result.statistics = passes.getStatistics();
+            result.remaining = remainingFetches(specialized, fetches);
+            result.variant.hash = hashIR(specialized);
+            try {
+                for (auto target : options.targets) {
+                    if (target == TargetLanguage::GLSL) {
+                        GLSLPrinter printer(options.glslES);
+                        result.variant.glslOutput = printer.print(specialized);
+                    } else if (target == TargetLanguage::CUDA) {
+                        CUDAPrinter printer;
+                        result.variant.cudaOutput = printer.print(specialized);
+                    }
+                }
+                HostPrinter host;
+                result.variant.hostUniformsOutput = host.print(specialized);
+            } catch (const std::runtime_error& e) {
+                result.error = e.what();
+            }
+        });
+        
+        for (size_t i = 0; i < results.size(); ++i) {
+            Result& result = results[i];
+            if (!result.error.empty()) {
+                errors_.push_back(permutations[i].key + ": " + result.error);
+                continue;
+            }
+            if (!result.passOutput.empty()) {
+                passOutput_ += "Permutation " + permutations[i].key + ":\n" + result.passOutput;
+            }
+            for (const auto& counter : result.statistics) {
+                statistics[counter.first] += counter.second;
+            }
+            for (size_t f = 0; f < fetches.size(); ++f) {
+                remaining[f] = remaining[f] || result.remaining[f];
+            }
+            auto same = std::find_if(variants_.begin(), variants_.end(), [&](const PermutationVariant& variant) {
+                return variant.hash == result.variant.hash && variant.glslOutput == result.variant.glslOutput &&
+                       variant.cudaOutput == result.variant.cudaOutput &&
+                       variant.hostUniformsOutput == result.variant.hostUniformsOutput;
+            });
+            permutationVariants_.push_back(same - variants_.begin());
+            if (same == variants_.end()) {
+                variants_.push_back(std::move(result.variant));
+            }
+        }
+        if (!results.empty()) {
+            // Every permutation names the same defines
+            warnAboutUnmatchedDefines(results[0].unmatched);
+        }
+        warnAboutDivergentFetches(fetches, remaining, options);
+        
+        if (options.verbose) {
+            printf("Compiled %zu permutations to %zu distinct variants\n", permutations.size(), variants_.size());
+        }
+        return errors_.empty();
+    }
+    
+    // (shader, declaration) of the uniforms and inputs the passes removed
+    using StrippedInterface = std::vector<std::pair<std::string, std::string>>;
+    
+    static StrippedInterface strippedInterface(const IRModule& module) {
+        StrippedInterface stripped;
+        for (uint32_t index : module.strippedGlobals) {
+            const IRGlobal& global = module.globals[index];
+            const char* qualifier = global.qualifier == VariableDeclaration::Qualifier::UNIFORM ? "uniform"
+                                    : global.qualifier == VariableDeclaration::Qualifier::IN  ? "in"
+                                                                                               : nullptr;
+            if (qualifier) {
+                std::string shader = global.shader != IR_NONE ? module.shaders[global.shader].name : "";
+                stripped.emplace_back(shader, std::string(qualifier) + " " + typeName(global.type) + " " + global.name);
+            }
+        }
+        return stripped;
+    }
+    
+    static bool printIR(IRPrinter& printer, const IRModule& module, std::string& output,
+                        const CompilerOptions& options) {
+        try {
+            output = printer.print(module);
+            return true;
+        } catch (const std::runtime_error& e) {
+            if (options.verbose) {
+                printf("Generating from the AST: %s\n", e.what());
+            }
+            return false;
+        }
+    }
+    
+    void warnAboutRegisterPressure(const std::vector<RegisterPressure>& pressure,
+                                   const CompilerOptions& options) {
+        for (auto target : options.targets) {
+            for (const auto& shader : pressure) {
+                if (target == TargetLanguage::GLSL &&
+                    shader.stage == ShaderDeclaration::ShaderType::FRAGMENT &&
+                    shader.peakScalars > LivenessAnalysis::MOBILE_SCALAR_BUDGET) {
+                    Diagnostic warning(Diagnostic::Severity::WARNING,
+                                       "Fragment shader '" + shader.shader + "' keeps " +
+                                       std::to_string(shader.peakScalars) + " scalars live; more than " +
+                                       std::to_string(LivenessAnalysis::MOBILE_SCALAR_BUDGET) +
+                                       " will likely spill on mobile GPUs",
+                                       shader.peakLine);
+                    warnings_.push_back(warning.format());
+                }
+                
+                if (target == TargetLanguage::CUDA) {
+                    int registers = LivenessAnalysis::estimatedCudaRegisters(shader.peakScalars);
+                    double occupancy = LivenessAnalysis::estimatedCudaOccupancy(registers);
+                    if (occupancy < 0.5) {
+                        Diagnostic warning(Diagnostic::Severity::WARNING,
+                                           "Kernel '" + shader.shader + "' needs about " +
+                                           std::to_string(registers) + " registers per thread; estimated occupancy " +
+                                           std::to_string(static_cast<int>(occupancy * 100)) + "%",
+                                           shader.peakLine);
+                        warnings_.push_back(warning.format());
+                    }
+                }
+            }
+        }
+    }
+    
+    // Per fetch the AST analysis found under divergent control flow, whether
+    // it still is after the passes: if-conversion and dce may remove it from
+    // there. Fetches keep the source position of their call through the IR.
+    static std::vector<bool> remainingFetches(const IRModule& module, const std::vector<DivergentFetch>& fetches) {
+        // Functions strip-globals took out of the items, inlined ones among
+        // them, are no longer printed
+        std::vector<bool> printed(module.functions.size(), false);
+        auto list = [&](const std::vector<IRItem>& items) {
+            for (const IRItem& item : items) {
+                if (item.kind == IRItem::Kind::FUNCTION) {
+                    printed[item.index] = true;
+                }
+            }
+        };
+        list(module.items);
+        for (const auto& shader : module.shaders) {
+            list(shader.items);
+        }
+        
+        std::vector<bool> remaining(fetches.size(), false);
+        for (uint32_t index = 0; index < module.functions.size(); ++index) {
+            const IRFunction& function = module.functions[index];
+            if (!printed[index]) {
+                continue;
+            }
+            std::vector<uint32_t> idom;
+            for (uint32_t b = 0; b < function.blocks.size(); ++b) {
+                for (IRValue value : function.blocks[b].instructions) {
+                    const IRInstruction& inst = function.instructions[value];
+                    if (inst.op != IROp::BUILTIN || inst.line == 0) {
+                        continue;
+                    }
+                    for (size_t f = 0; f < fetches.size(); ++f) {
+                        const DivergentFetch& fetch = fetches[f];
+                        if (remaining[f] || inst.line != fetch.call->line || inst.column != fetch.call->column ||
+                            (function.shader != IR_NONE && module.shaders[function.shader].name != fetch.shader)) {
+                            continue;
+                        }
+                        if (idom.empty()) {
+                            idom = immediateDominators(function);
+                        }
+                        // A function called divergently that was not inlined
+                        // still runs its fetch there
+                        remaining[f] = (!fetch.branch && !function.entryPoint) ||
+                                       underDivergentBranch(function, idom, b);
+                    }
+                }
+            }
+        }
+        return remaining;
+    }
+    
+    // Whether the block is inside an if or loop whose condition may differ
+    // between threads
+    static bool underDivergentBranch(const IRFunction& function, const std::vector<uint32_t>& idom, uint32_t block) {
+        auto dominates = [&](uint32_t a, uint32_t b) {
+            while (b != IR_NONE && b != a) {
+                b = idom[b];
+            }
+            return b == a;
+        };
+        for (uint32_t header = 0; header < function.blocks.size(); ++header) {
+            const IRBlock& construct = function.blocks[header];
+            IRValue term = function.terminator(header);
+            if (construct.structure == IRStructure::NONE || term == IR_NONE ||
+                function.instructions[term].aux == BRANCH_UNIFORM || header == block || !dominates(header, block)) {
+                continue;
+            }
+            if (construct.merge == IR_NONE || !dominates(construct.merge, block)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    void warnAboutDivergentFetches(const std::vector<DivergentFetch>& fetches, const std::vector<bool>& remaining,
+                                   const CompilerOptions& options) {
+        bool cuda = false;
+        for (auto target : options.targets) {
+            cuda = cuda || target == TargetLanguage::CUDA;
+        }
+        
+        for (size_t f = 0; f < fetches.size(); ++f) {
+            const DivergentFetch& fetch = fetches[f];
+            if (!remaining[f]) {
+                continue;
+            }
+            std::string where = fetch.branch
+                ? "inside the divergent branch at line " + std::to_string(fetch.branch->line)
+                : "in a function called from divergent control flow";
+            
+            // Implicit derivatives are undefined when neighbouring fragments disagree
+            if (fetch.stage == ShaderDeclaration::ShaderType::FRAGMENT && fetch.call->builtin == BuiltinId::TEXTURE) {
+                Diagnostic warning(Diagnostic::Severity::WARNING,
+                                   "texture() " + where + " of '" + fetch.shader +
+                                   "' has undefined derivatives; use textureLod or fetch before branching",
+                                   fetch.call->line, fetch.call->column);
+                warnings_.push_back(warning.format());
+            } else if (cuda) {
+                Diagnostic warning(Diagnostic::Severity::WARNING,
+                                   "Texture fetch " + where + " of '" + fetch.shader +
+                                   "' serializes the warp; fetch before branching if possible",
+                                   fetch.call->line, fetch.call->column);
+                warnings_.push_back(warning.format());
+            }
+        }
+    }
+    
+    std::string formatStats(Program& program, const std::vector<RegisterPressure>& pressure,
+                            const RangeEliminations& rangeEliminations, const PassStatistics& passStatistics,
+                            const StrippedInterface& stripped, const CompilerOptions& options) {
+        std::vector<std::pair<TargetLanguage, std::vector<ShaderCost>>> reports;
+        for (auto target : options.targets) {
+            CostModel model(target);
+            reports.emplace_back(target, model.analyze(program));
+        }
+        
+        if (options.stats == StatsFormat::JSON) {
+            JsonWriter json;
+            json.beginObject();
+            json.key("file").value(options.inputFile);
+            json.key("targets").beginArray();
+            for (const auto& report : reports) {
+                json.beginObject();
+                json.key("target").value(targetName(report.first));
+                json.key("shaders").beginArray();
+                for (size_t i = 0; i < report.second.size(); ++i) {
+                    json.beginObject();
+                    CostModel::writeJSON(json, report.second[i]);
+                    json.key("registers");
+                    LivenessAnalysis::writeJSON(json, pressure[i]);
+                    if (report.first == TargetLanguage::CUDA) {
+                        int registers = LivenessAnalysis::estimatedCudaRegisters(pressure[i].peakScalars);
+                        json.key("estimatedRegisters").integer(registers);
+                        json.key("estimatedOccupancy").number(LivenessAnalysis::estimatedCudaOccupancy(registers));
+                    }
+                    json.endObject();
+                }
+                json.endArray();
+                json.endObject();
+            }
+            json.endArray();
+            json.key("rangeEliminations").beginObject();
+            json.key("clamps").integer(rangeEliminations.clamps);
+            json.key("decidedBranches").integer(rangeEliminations.decidedBranches);
+            json.endObject();
+            json.key("passes").beginObject();
+            for (const auto& counter : passStatistics) {
+                json.key(counter.first).integer(counter.second);
+            }
+            json.endObject();
+            json.key("strippedInterface").beginArray();
+            for (const auto& entry : stripped) {
+                json.beginObject();
+                json.key("shader").value(entry.first);
+                json.key("declaration").value(entry.second);
+                json.endObject();
+            }
+            json.endArray();
+            json.endObject();
+            return json.str() + "\n";
+        }
+        
+        std::ostringstream text;
+        for (const auto& report : reports) {
+            text << "Cost estimate (" << targetName(report.first) << "):\n";
+            for (size_t i = 0; i < report.second.size(); ++i) {
+                const auto& shader = report.second[i];
+                text << "  " << shader.name << " [" << shaderStageName(shader.stage) << "]: "
+                     << formatCost(shader.cost) << "\n";
+                text << "    peak live scalars: " << pressure[i].peakScalars
+                     << " (line " << pressure[i].peakLine << ")";
+                if (report.first == TargetLanguage::CUDA) {
+                    int registers = LivenessAnalysis::estimatedCudaRegisters(pressure[i].peakScalars);
+                    text << ", ~" << registers << " registers, occupancy "
+                         << static_cast<int>(LivenessAnalysis::estimatedCudaOccupancy(registers) * 100) << "%";
+                }
+                text << "\n";
+                for (const auto& func : shader.functions) {
+                    text << "    " << func.name << " (line " << func.line << "): "
+                         << formatCost(func.cost) << "\n";
+                    for (const auto& loop : func.loops) {
+                        text << "      loop at line " << loop.line << ": ";
+                        if (loop.tripCount >= 0) {
+                            text << loop.tripCount << " trips";
+                        } else {
+                            text << "unknown trip count";
+                        }
+                        text << ", " << loop.iteration.cycles << " cycles per iteration\n";
+                    }
+                }
+            }
+        }
+        text << "Range analysis: removed " << rangeEliminations.clamps << " clamp/min/max calls and "
+             << rangeEliminations.decidedBranches << " decided branches\n";
+        for (const auto& counter : passStatistics) {
+            if (counter.second != 0) {
+                text << "IR pass " << counter.first << ": " << counter.second << "\n";
+            }
+        }
+        for (const auto& entry : stripped) {
+            text << "Stripped unused " << entry.second
+                 << (entry.first.empty() ? "" : " from " + entry.first) << "\n";
+        }
+        return text.str();
+    }
+    
+    static const char* targetName(TargetLanguage target) {
+        return target == TargetLanguage::CUDA ? "cuda" : "glsl";
+    }
+    
+    static std::string formatCost(const CostEstimate& cost) {
+        std::ostringstream text;
+        text << cost.cycles << " cycles (" << cost.aluOps << " ALU, "
+             << cost.transcendentalOps << " transcendental, " << cost.textureFetches << " texture, "
+             << cost.branches << " branches)";
+        return text.str();
+    }
 };
 
 Compiler::Compiler() : impl_(std::make_unique<Impl>()) {
@@ -90,6 +783,10 @@ bool Compiler::compile(const CompilerOptions& options) {
     return impl_->compile(options);
 }
 
+bool Compiler::compilePermutations(const CompilerOptions& options, const std::vector<Permutation>& permutations) {
+    return impl_->compile(options, &permutations);
+}
+
 std::string Compiler::getGLSLOutput() const {
     return impl_->glslOutput_;
 }
@@ -98,6 +795,26 @@ std::string Compiler::getCUDAOutput() const {
     return impl_->cudaOutput_;
 }
 
+std::string Compiler::getHostUniformsOutput() const {
+    return impl_->hostUniformsOutput_;
+}
+
+const std::vector<PermutationVariant>& Compiler::getVariants() const {
+    return impl_->variants_;
+}
+
+const std::vector<size_t>& Compiler::getPermutationVariants() const {
+    return impl_->permutationVariants_;
+}
+
+std::string Compiler::getStatsOutput() const {
+    return impl_->statsOutput_;
+}
+
+std::string Compiler::getPassOutput() const {
+    return impl_->passOutput_;
+}
+
 bool Compiler::hasErrors() const {
     return !impl_->errors_.empty();
 }
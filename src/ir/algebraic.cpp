@@ -0,0 +1,112 @@
+#include "ir/algebraic.h"
+#include "ir/passes.h"
+#include "semantic/types.h"
+#include <algorithm>
+#include <cmath>
+
+namespace sdl {
+
+bool RewriteBuilder::isBuiltin(IRValue value, BuiltinId id) const {
+    return inst(value).op == IROp::BUILTIN && static_cast<BuiltinId>(inst(value).imm) == id;
+}
+
+bool RewriteBuilder::splat(IRValue value, double& result) const {
+    if (inst(value).op != IROp::CONSTANT) {
+        return false;
+    }
+    const std::vector<double>& components = module_.constants[inst(value).imm].components;
+    if (components.empty()) {
+        return false;
+    }
+    for (double component : components) {
+        // Compares bits, so -0.0 is no splat of 0.0
+        if (component != components[0] || std::signbit(component) != std::signbit(components[0])) {
+            return false;
+        }
+    }
+    result = components[0];
+    return true;
+}
+
+bool RewriteBuilder::isSplat(IRValue value, double scalar) const {
+    double result;
+    return splat(value, result) && result == scalar;
+}
+
+IRValue RewriteBuilder::constant(Type::Kind type, double scalar) {
+    if (type != Type::Kind::INT && type != Type::Kind::BOOL) {
+        scalar = static_cast<float>(scalar);
+    }
+    uint32_t index = module_.constant(type, std::vector<double>(static_cast<size_t>(componentCount(type)), scalar));
+    
+    // Constants live at the top of the entry block, which dominates every use
+    for (IRValue value : function_.blocks[0].instructions) {
+        if (inst(value).op == IROp::CONSTANT && inst(value).imm == index) {
+            return value;
+        }
+    }
+    IRValue value = function_.create(IROp::CONSTANT, type, {}, index);
+    function_.insert(0, 0, value);
+    return value;
+}
+
+IRValue RewriteBuilder::emit(IROp op, Type::Kind type, const std::vector<IRValue>& args, uint32_t imm) {
+    IRValue value = function_.create(op, type, args, imm);
+    uint32_t block = inst(position_).block;
+    const auto& list = function_.blocks[block].instructions;
+    function_.insert(block, static_cast<size_t>(std::find(list.begin(), list.end(), position_) - list.begin()), value);
+    return value;
+}
+
+IRValue RewriteBuilder::builtin(BuiltinId id, Type::Kind type, const std::vector<IRValue>& args) {
+    return emit(IROp::BUILTIN, type, args, static_cast<uint32_t>(id));
+}
+
+bool simplifyAlgebra(IRModule& module, PassContext& context) {
+    const std::vector<AlgebraicRule>& rules = algebraicRules();
+    int rewrites = 0;
+    for (auto& function : module.functions) {
+        RewriteBuilder builder(module, function);
+        bool fastMath = function.fastMath;
+        
+        // Rewrites expose more, as pow(normalize(normalize(v)), 1.0) does;
+        // instructions a rule creates are looked at in the next round
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto& block : function.blocks) {
+                for (IRValue value : std::vector<IRValue>(block.instructions)) {
+                    const IRInstruction& inst = function.instructions[value];
+                    if (inst.block == IR_NONE) {
+                        continue;
+                    }
+                    for (const auto& rule : rules) {
+                        bool matches = rule.op == inst.op &&
+                                       (inst.op != IROp::BUILTIN || static_cast<uint32_t>(rule.builtin) == inst.imm);
+                        if (!matches || (rule.kind == RuleKind::FAST_MATH && !fastMath)) {
+                            continue;
+                        }
+                        builder.setPosition(value);
+                        IRValue replacement = rule.rewrite(builder, value);
+                        if (replacement == IR_NONE) {
+                            continue;
+                        }
+                        IRInstruction& result = function.instructions[replacement];
+                        if (result.name == 0 && result.op != IROp::CONSTANT) {
+                            result.name = function.instructions[value].name;
+                        }
+                        function.remove(value);
+                        function.replaceAllUses(value, replacement);
+                        ++context.statistics[std::string("simplify-algebra.") + rule.name];
+                        ++rewrites;
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return rewrites > 0;
+}
+
+} // namespace sdl
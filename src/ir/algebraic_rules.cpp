@@ -0,0 +1,237 @@
+#include "ir/algebraic.h"
+#include "semantic/types.h"
+#include <cmath>
+
+namespace sdl {
+
+namespace {
+
+// The other operand of a binary instruction whose operand `constant` is a
+// splat of `scalar`, as long as it has the result's type; IR_NONE otherwise
+IRValue operandBeside(RewriteBuilder& b, IRValue value, double scalar, bool commutative) {
+    for (size_t constant = commutative ? 0 : 1; constant < 2; ++constant) {
+        IRValue other = b.operand(value, 1 - constant);
+        IRValue splat = b.operand(value, constant);
+        if (b.isSplat(splat, scalar) && !isMatrix(b.type(splat)) && b.type(other) == b.type(value)) {
+            return other;
+        }
+    }
+    return IR_NONE;
+}
+
+// The operand that is a constant splat of zero with the given sign, or
+// either sign when `sign` is 0
+IRValue besideZero(RewriteBuilder& b, IRValue value, int sign, bool commutative) {
+    for (size_t constant = commutative ? 0 : 1; constant < 2; ++constant) {
+        IRValue other = b.operand(value, 1 - constant);
+        double zero;
+        if (b.splat(b.operand(value, constant), zero) && zero == 0.0 && b.type(other) == b.type(value) &&
+            (sign == 0 || std::signbit(zero) == (sign < 0))) {
+            return other;
+        }
+    }
+    return IR_NONE;
+}
+
+IRValue ruleMulOne(RewriteBuilder& b, IRValue value) {
+    return operandBeside(b, value, 1.0, true);
+}
+
+IRValue ruleMulMinusOne(RewriteBuilder& b, IRValue value) {
+    IRValue other = operandBeside(b, value, -1.0, true);
+    return other == IR_NONE ? IR_NONE : b.emit(IROp::NEG, b.type(value), {other});
+}
+
+IRValue ruleMulZero(RewriteBuilder& b, IRValue value) {
+    if (!b.isSplat(b.operand(value, 0), 0.0) && !b.isSplat(b.operand(value, 1), 0.0)) {
+        return IR_NONE;
+    }
+    return b.constant(b.type(value), 0.0);
+}
+
+IRValue ruleMulZeroInt(RewriteBuilder& b, IRValue value) {
+    if (b.type(value) != Type::Kind::INT) {
+        return IR_NONE;
+    }
+    return ruleMulZero(b, value);
+}
+
+IRValue ruleDivOne(RewriteBuilder& b, IRValue value) {
+    return operandBeside(b, value, 1.0, false);
+}
+
+// x / c as x * (1 / c); `exact` asks for a reciprocal that is exact in
+// single precision, which makes the product round like the quotient
+IRValue reciprocalProduct(RewriteBuilder& b, IRValue value, bool exact) {
+    IRValue divisor = b.operand(value, 1);
+    double c;
+    if (b.type(value) == Type::Kind::INT || isMatrix(b.type(divisor)) || !b.splat(divisor, c) ||
+        c == 0.0 || !std::isfinite(c)) {
+        return IR_NONE;
+    }
+    float reciprocal = 1.0f / static_cast<float>(c);
+    if (!std::isnormal(reciprocal)) {
+        return IR_NONE;
+    }
+    int exponent;
+    if (exact && std::fabs(std::frexp(c, &exponent)) != 0.5) {
+        return IR_NONE;
+    }
+    return b.emit(IROp::MUL, b.type(value), {b.operand(value, 0), b.constant(b.type(divisor), reciprocal)});
+}
+
+IRValue ruleDivPowerOfTwo(RewriteBuilder& b, IRValue value) {
+    return reciprocalProduct(b, value, true);
+}
+
+IRValue ruleDivReciprocal(RewriteBuilder& b, IRValue value) {
+    return reciprocalProduct(b, value, false);
+}
+
+IRValue ruleAddZero(RewriteBuilder& b, IRValue value) {
+    // -0.0 + 0.0 is 0.0, so only -0.0 leaves every float unchanged
+    return besideZero(b, value, b.type(value) == Type::Kind::INT ? 0 : -1, true);
+}
+
+IRValue ruleAddZeroFloat(RewriteBuilder& b, IRValue value) {
+    return besideZero(b, value, 0, true);
+}
+
+IRValue ruleSubZero(RewriteBuilder& b, IRValue value) {
+    return besideZero(b, value, b.type(value) == Type::Kind::INT ? 0 : 1, false);
+}
+
+IRValue ruleDoubleNegation(RewriteBuilder& b, IRValue value) {
+    IRValue inner = b.operand(value, 0);
+    return b.inst(inner).op == b.inst(value).op ? b.operand(inner, 0) : IR_NONE;
+}
+
+IRValue rulePowOne(RewriteBuilder& b, IRValue value) {
+    return operandBeside(b, value, 1.0, false);
+}
+
+IRValue rulePowTwo(RewriteBuilder& b, IRValue value) {
+    if (!b.isSplat(b.operand(value, 1), 2.0)) {
+        return IR_NONE;
+    }
+    IRValue x = b.operand(value, 0);
+    return b.emit(IROp::MUL, b.type(value), {x, x});
+}
+
+IRValue rulePowHalf(RewriteBuilder& b, IRValue value) {
+    if (!b.isSplat(b.operand(value, 1), 0.5)) {
+        return IR_NONE;
+    }
+    return b.builtin(BuiltinId::SQRT, b.type(value), {b.operand(value, 0)});
+}
+
+IRValue rulePowMinusHalf(RewriteBuilder& b, IRValue value) {
+    if (!b.isSplat(b.operand(value, 1), -0.5)) {
+        return IR_NONE;
+    }
+    return b.builtin(BuiltinId::INVERSESQRT, b.type(value), {b.operand(value, 0)});
+}
+
+IRValue ruleDivSqrt(RewriteBuilder& b, IRValue value) {
+    IRValue root = b.operand(value, 1);
+    if (!b.isSplat(b.operand(value, 0), 1.0) || !b.isBuiltin(root, BuiltinId::SQRT) || b.type(root) != b.type(value)) {
+        return IR_NONE;
+    }
+    return b.builtin(BuiltinId::INVERSESQRT, b.type(value), {b.operand(root, 0)});
+}
+
+IRValue ruleNormalizeTwice(RewriteBuilder& b, IRValue value) {
+    IRValue inner = b.operand(value, 0);
+    return b.isBuiltin(inner, BuiltinId::NORMALIZE) ? inner : IR_NONE;
+}
+
+IRValue ruleMixEnds(RewriteBuilder& b, IRValue value) {
+    IRValue t = b.operand(value, 2);
+    if (b.isSplat(t, 0.0)) {
+        return b.operand(value, 0);
+    }
+    if (b.isSplat(t, 1.0)) {
+        return b.operand(value, 1);
+    }
+    return IR_NONE;
+}
+
+// Compares squared lengths instead, which needs no square root. Rules must
+// not emit anything before they know they apply.
+IRValue ruleLengthCompare(RewriteBuilder& b, IRValue value) {
+    for (size_t side = 0; side < 2; ++side) {
+        IRValue length = b.operand(value, side);
+        double r;
+        if (!b.splat(b.operand(value, 1 - side), r) || r < 0.0 || !std::isfinite(r)) {
+            continue;
+        }
+        
+        bool distance = b.isBuiltin(length, BuiltinId::DISTANCE);
+        if ((!distance && !b.isBuiltin(length, BuiltinId::LENGTH)) || !isFloatVector(b.type(b.operand(length, 0)))) {
+            continue;
+        }
+        
+        IRValue v = b.operand(length, 0);
+        if (distance) {
+            v = b.emit(IROp::SUB, b.type(v), {v, b.operand(length, 1)});
+        }
+        IRValue squared = b.builtin(BuiltinId::DOT, Type::Kind::FLOAT, {v, v});
+        IRValue bound = b.constant(Type::Kind::FLOAT, static_cast<float>(r) * static_cast<float>(r));
+        return b.emit(b.inst(value).op, b.type(value), side == 0 ? std::vector<IRValue>{squared, bound}
+                                                                 : std::vector<IRValue>{bound, squared});
+    }
+    return IR_NONE;
+}
+
+// (x op c1) op c2 -> x op (c1 op c2) for a commutative float op and
+// constant splats, which rounds once where the source rounded twice
+IRValue reassociate(RewriteBuilder& b, IRValue value) {
+    Type::Kind type = b.type(value);
+    if (type != Type::Kind::FLOAT && !isFloatVector(type)) {
+        return IR_NONE;
+    }
+    IROp op = b.inst(value).op;
+    for (size_t outer = 0; outer < 2; ++outer) {
+        IRValue inner = b.operand(value, 1 - outer);
+        double c2;
+        if (!b.splat(b.operand(value, outer), c2) || b.inst(inner).op != op || b.type(inner) != type) {
+            continue;
+        }
+        for (size_t side = 0; side < 2; ++side) {
+            double c1;
+            IRValue x = b.operand(inner, 1 - side);
+            if (!b.splat(b.operand(inner, side), c1) || b.type(x) != type) {
+                continue;
+            }
+            double folded = op == IROp::ADD ? static_cast<float>(c1) + static_cast<float>(c2)
+                                            : static_cast<float>(c1) * static_cast<float>(c2);
+            if (!std::isfinite(static_cast<float>(folded))) {
+                return IR_NONE;
+            }
+            return b.emit(op, type, {x, b.constant(type, folded)});
+        }
+    }
+    return IR_NONE;
+}
+
+IRValue ruleReassociateAdd(RewriteBuilder& b, IRValue value) {
+    return reassociate(b, value);
+}
+
+IRValue ruleReassociateMul(RewriteBuilder& b, IRValue value) {
+    return reassociate(b, value);
+}
+
+} // anonymous namespace
+
+const std::vector<AlgebraicRule>& algebraicRules() {
+    static const std::vector<AlgebraicRule> rules = {
+#define SDL_ALGEBRAIC_RULE(name, op, builtin, kind, rewrite, description) \
+    {name, IROp::op, BuiltinId::builtin, RuleKind::kind, rewrite, description},
+#include "ir/algebraic_rules.def"
+#undef SDL_ALGEBRAIC_RULE
+    };
+    return rules;
+}
+
+} // namespace sdl
@@ -0,0 +1,480 @@
+#include "ir/passes.h"
+#include "semantic/types.h"
+#include <cmath>
+#include <cstdint>
+#include <map>
+
+namespace sdl {
+
+namespace {
+
+// Constant arithmetic follows the target: floats are IEEE single precision,
+// ints wrap at 32 bits. Inputs are already representable, so doing + - * /
+// in double and rounding once gives the correctly rounded float result.
+double toSingle(double value) {
+    return static_cast<float>(value);
+}
+
+double wrapInt(long long value) {
+    return static_cast<int32_t>(static_cast<uint32_t>(value));
+}
+
+double represent(Type::Kind type, double value) {
+    switch (type) {
+        case Type::Kind::BOOL: return value != 0.0 ? 1.0 : 0.0;
+        case Type::Kind::INT: return wrapInt(static_cast<long long>(value));
+        default: return toSingle(value);
+    }
+}
+
+// Component i, with scalars standing for every component
+double component(const IRConstant& constant, int index) {
+    return constant.components.size() == 1 ? constant.components[0] : constant.components[index];
+}
+
+double dot(const IRConstant& a, const IRConstant& b) {
+    double sum = 0.0;
+    for (size_t i = 0; i < a.components.size(); ++i) {
+        sum = toSingle(sum + toSingle(a.components[i] * b.components[i]));
+    }
+    return sum;
+}
+
+class Folder {
+public:
+    Folder(IRModule& module, IRFunction& function, const std::map<uint32_t, uint32_t>& globals)
+        : module_(module), function_(function), globals_(globals) {}
+    
+    int folded() const { return folded_; }
+    
+    bool run() {
+        if (function_.blocks.empty()) {
+            return false;
+        }
+        for (IRValue value : function_.blocks[0].instructions) {
+            const IRInstruction& inst = function_.instructions[value];
+            if (inst.op == IROp::CONSTANT) {
+                constants_.emplace(inst.imm, value);
+            }
+        }
+        
+        bool changed = false;
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            for (uint32_t b = 0; b < function_.blocks.size(); ++b) {
+                for (IRValue value : std::vector<IRValue>(function_.blocks[b].instructions)) {
+                    IRValue replacement = fold(value);
+                    if (replacement != IR_NONE) {
+                        function_.remove(value);
+                        function_.replaceAllUses(value, replacement);
+                        ++folded_;
+                        progress = true;
+                    }
+                }
+            }
+            // Phis whose incoming values folded to the same constant
+            size_t before = placedCount();
+            removeTrivialPhis(function_);
+            progress |= placedCount() != before;
+            changed |= progress;
+        }
+        return changed;
+    }
+    
+private:
+    IRModule& module_;
+    IRFunction& function_;
+    const std::map<uint32_t, uint32_t>& globals_; // Global -> constant it always holds
+    std::map<uint32_t, IRValue> constants_;       // Constant -> its instruction in the entry block
+    int folded_ = 0;
+    
+    size_t placedCount() const {
+        size_t count = 0;
+        for (const auto& block : function_.blocks) {
+            count += block.instructions.size();
+        }
+        return count;
+    }
+    
+    const IRConstant* constantOf(IRValue value) const {
+        const IRInstruction& inst = function_.instructions[value];
+        return inst.op == IROp::CONSTANT ? &module_.constants[inst.imm] : nullptr;
+    }
+    
+    IRValue materialize(uint32_t constant) {
+        auto it = constants_.find(constant);
+        if (it != constants_.end()) {
+            return it->second;
+        }
+        IRValue value = function_.create(IROp::CONSTANT, module_.constants[constant].type, {}, constant);
+        function_.insert(0, 0, value);
+        constants_.emplace(constant, value);
+        return value;
+    }
+    
+    IRValue materialize(Type::Kind type, std::vector<double> components) {
+        for (double& value : components) {
+            value = represent(type == Type::Kind::BOOL || type == Type::Kind::INT ? type : Type::Kind::FLOAT, value);
+            if (!std::isfinite(value)) {
+                return IR_NONE; // Leave inf and NaN to the target's own arithmetic
+            }
+        }
+        return materialize(module_.constant(type, components));
+    }
+    
+    // The value replacing `value`, or IR_NONE when it does not fold
+    IRValue fold(IRValue value) {
+        const IRInstruction& inst = function_.instructions[value];
+        switch (inst.op) {
+            case IROp::LOAD: {
+                auto it = globals_.find(inst.imm);
+                return it != globals_.end() ? materialize(it->second) : IR_NONE;
+            }
+            case IROp::SELECT: {
+                const IRConstant* condition = constantOf(function_.operand(value, 0));
+                if (!condition) {
+                    return IR_NONE;
+                }
+                return function_.operand(value, condition->components[0] != 0.0 ? 1 : 2);
+            }
+            case IROp::CONSTANT:
+            case IROp::PARAMETER:
+            case IROp::PHI:
+            case IROp::CALL:
+            case IROp::STORE:
+            case IROp::BRANCH:
+            case IROp::COND_BRANCH:
+            case IROp::RETURN:
+                return IR_NONE;
+            default:
+                break;
+        }
+        
+        std::vector<const IRConstant*> args;
+        for (uint32_t i = 0; i < inst.operandCount; ++i) {
+            const IRConstant* arg = constantOf(function_.operand(value, i));
+            if (!arg) {
+                return IR_NONE;
+            }
+            args.push_back(arg);
+        }
+        
+        std::vector<double> result;
+        if (!evaluate(inst, args, result)) {
+            return IR_NONE;
+        }
+        return materialize(inst.type, result);
+    }
+    
+    bool evaluate(const IRInstruction& inst, const std::vector<const IRConstant*>& args, std::vector<double>& result) {
+        int count = componentCount(inst.type);
+        switch (inst.op) {
+            case IROp::ADD:
+            case IROp::SUB:
+            case IROp::MUL:
+            case IROp::DIV:
+            case IROp::MOD:
+                if (inst.op == IROp::MUL && (isMatrix(args[0]->type) || isMatrix(args[1]->type)) &&
+                    !isScalar(args[0]->type) && !isScalar(args[1]->type)) {
+                    return multiply(*args[0], *args[1], result);
+                }
+                for (int i = 0; i < count; ++i) {
+                    double a = component(*args[0], i);
+                    double b = component(*args[1], i);
+                    if (!arithmetic(inst.op, inst.type, a, b, result)) {
+                        return false;
+                    }
+                }
+                return true;
+            case IROp::NEG:
+                for (double a : args[0]->components) {
+                    result.push_back(inst.type == Type::Kind::INT ? wrapInt(-static_cast<long long>(a)) : -a);
+                }
+                return true;
+            case IROp::EQ:
+            case IROp::NE: {
+                bool equal = args[0]->components == args[1]->components;
+                result.push_back(equal == (inst.op == IROp::EQ) ? 1.0 : 0.0);
+                return true;
+            }
+            case IROp::LT: result.push_back(args[0]->components[0] < args[1]->components[0]); return true;
+            case IROp::LE: result.push_back(args[0]->components[0] <= args[1]->components[0]); return true;
+            case IROp::GT: result.push_back(args[0]->components[0] > args[1]->components[0]); return true;
+            case IROp::GE: result.push_back(args[0]->components[0] >= args[1]->components[0]); return true;
+            case IROp::AND: result.push_back(args[0]->components[0] != 0.0 && args[1]->components[0] != 0.0); return true;
+            case IROp::OR: result.push_back(args[0]->components[0] != 0.0 || args[1]->components[0] != 0.0); return true;
+            case IROp::NOT: result.push_back(args[0]->components[0] == 0.0); return true;
+            case IROp::CONSTRUCT:
+                return construct(inst.type, args, result);
+            case IROp::EXTRACT: {
+                int dimension = matrixDimension(args[0]->type);
+                for (int row = 0; row < dimension; ++row) {
+                    result.push_back(args[0]->components[inst.imm * dimension + row]);
+                }
+                return true;
+            }
+            case IROp::SWIZZLE:
+                for (int i = 0; i < swizzleCount(inst.imm); ++i) {
+                    result.push_back(args[0]->components[swizzleComponent(inst.imm, i)]);
+                }
+                return true;
+            case IROp::INSERT:
+                result = args[0]->components;
+                for (int i = 0; i < swizzleCount(inst.imm); ++i) {
+                    result[swizzleComponent(inst.imm, i)] = component(*args[1], i);
+                }
+                return true;
+            case IROp::BUILTIN:
+                return builtin(static_cast<BuiltinId>(inst.imm), inst.type, args, result);
+            default:
+                return false;
+        }
+    }
+    
+    static bool arithmetic(IROp op, Type::Kind type, double a, double b, std::vector<double>& result) {
+        if (type == Type::Kind::INT) {
+            long long x = static_cast<long long>(a);
+            long long y = static_cast<long long>(b);
+            switch (op) {
+                case IROp::ADD: result.push_back(wrapInt(x + y)); return true;
+                case IROp::SUB: result.push_back(wrapInt(x - y)); return true;
+                case IROp::MUL: result.push_back(wrapInt(x * y)); return true;
+                case IROp::DIV:
+                    if (y == 0 || (x == INT32_MIN && y == -1)) {
+                        return false;
+                    }
+                    result.push_back(static_cast<double>(x / y));
+                    return true;
+                default:
+                    // % of negative operands differs between GLSL and CUDA
+                    if (x < 0 || y <= 0) {
+                        return false;
+                    }
+                    result.push_back(static_cast<double>(x % y));
+                    return true;
+            }
+        }
+        switch (op) {
+            case IROp::ADD: result.push_back(a + b); return true;
+            case IROp::SUB: result.push_back(a - b); return true;
+            case IROp::MUL: result.push_back(a * b); return true;
+            case IROp::DIV: result.push_back(a / b); return true;
+            default: return false; // Float % has no common meaning across targets
+        }
+    }
+    
+    // Linear-algebra products; matrices are column-major
+    static bool multiply(const IRConstant& a, const IRConstant& b, std::vector<double>& result) {
+        int n = std::max(matrixDimension(a.type), matrixDimension(b.type));
+        auto at = [&](const IRConstant& m, int column, int row) { return m.components[column * n + row]; };
+        auto accumulate = [](double sum, double x, double y) { return toSingle(sum + toSingle(x * y)); };
+        
+        if (isMatrix(a.type) && isMatrix(b.type)) {
+            for (int column = 0; column < n; ++column) {
+                for (int row = 0; row < n; ++row) {
+                    double sum = 0.0;
+                    for (int k = 0; k < n; ++k) {
+                        sum = accumulate(sum, at(a, k, row), at(b, column, k));
+                    }
+                    result.push_back(sum);
+                }
+            }
+        } else if (isMatrix(a.type)) {
+            for (int row = 0; row < n; ++row) {
+                double sum = 0.0;
+                for (int k = 0; k < n; ++k) {
+                    sum = accumulate(sum, at(a, k, row), b.components[k]);
+                }
+                result.push_back(sum);
+            }
+        } else {
+            for (int column = 0; column < n; ++column) {
+                double sum = 0.0;
+                for (int k = 0; k < n; ++k) {
+                    sum = accumulate(sum, a.components[k], at(b, column, k));
+                }
+                result.push_back(sum);
+            }
+        }
+        return true;
+    }
+    
+    static bool construct(Type::Kind type, const std::vector<const IRConstant*>& args, std::vector<double>& result) {
+        int count = componentCount(type);
+        int dimension = matrixDimension(type);
+        
+        if (args.size() == 1 && args[0]->components.size() == 1 && count > 1) {
+            // vec3(x) splats, mat3(x) scales the identity
+            for (int i = 0; i < count; ++i) {
+                bool diagonal = dimension == 0 || i % (dimension + 1) == 0;
+                result.push_back(diagonal ? args[0]->components[0] : 0.0);
+            }
+        } else if (args.size() == 1 && dimension > 0 && isMatrix(args[0]->type)) {
+            // mat3(mat4) keeps the top-left corner, mat4(mat3) pads with the identity
+            int source = matrixDimension(args[0]->type);
+            for (int column = 0; column < dimension; ++column) {
+                for (int row = 0; row < dimension; ++row) {
+                    bool inside = column < source && row < source;
+                    result.push_back(inside ? args[0]->components[column * source + row] : column == row ? 1.0 : 0.0);
+                }
+            }
+        } else {
+            for (const IRConstant* arg : args) {
+                result.insert(result.end(), arg->components.begin(), arg->components.end());
+            }
+            if (static_cast<int>(result.size()) < count) {
+                return false;
+            }
+            result.resize(count);
+        }
+        
+        if (type == Type::Kind::INT) {
+            // Conversion truncates toward zero; out-of-range values are undefined
+            if (!(std::fabs(result[0]) < 2147483648.0)) {
+                return false;
+            }
+            result[0] = std::trunc(result[0]);
+        }
+        return true;
+    }
+    
+    static bool builtin(BuiltinId id, Type::Kind type, const std::vector<const IRConstant*>& args,
+                        std::vector<double>& result) {
+        const BuiltinInfo* info = builtinInfo(id);
+        if (!info || info->effects != Effect::NONE) {
+            return false;
+        }
+        
+        if (info->fold) {
+            if (type == Type::Kind::INT) {
+                // Folds go through float; larger ints would lose bits
+                for (const IRConstant* arg : args) {
+                    if (std::fabs(arg->components[0]) > 16777216.0) {
+                        return false;
+                    }
+                }
+            }
+            std::vector<double> scalars(args.size());
+            for (int i = 0; i < componentCount(type); ++i) {
+                for (size_t a = 0; a < args.size(); ++a) {
+                    scalars[a] = component(*args[a], i);
+                }
+                result.push_back(info->fold(scalars.data(), scalars.size()));
+            }
+            return true;
+        }
+        
+        switch (id) {
+            case BuiltinId::DOT:
+                result.push_back(dot(*args[0], *args[1]));
+                return true;
+            case BuiltinId::LENGTH:
+                result.push_back(std::sqrt(static_cast<float>(dot(*args[0], *args[0]))));
+                return true;
+            case BuiltinId::DISTANCE: {
+                IRConstant difference{args[0]->type, {}};
+                for (size_t i = 0; i < args[0]->components.size(); ++i) {
+                    difference.components.push_back(toSingle(args[0]->components[i] - args[1]->components[i]));
+                }
+                result.push_back(std::sqrt(static_cast<float>(dot(difference, difference))));
+                return true;
+            }
+            case BuiltinId::NORMALIZE: {
+                double length = std::sqrt(static_cast<float>(dot(*args[0], *args[0])));
+                for (double x : args[0]->components) {
+                    result.push_back(x / length);
+                }
+                return true;
+            }
+            case BuiltinId::CROSS: {
+                const auto& a = args[0]->components;
+                const auto& b = args[1]->components;
+                for (int i = 0; i < 3; ++i) {
+                    int j = (i + 1) % 3;
+                    int k = (i + 2) % 3;
+                    result.push_back(toSingle(a[j] * b[k]) - toSingle(a[k] * b[j]));
+                }
+                return true;
+            }
+            case BuiltinId::REFLECT: {
+                // I - 2 * dot(N, I) * N
+                double scale = toSingle(2.0 * dot(*args[1], *args[0]));
+                for (size_t i = 0; i < args[0]->components.size(); ++i) {
+                    result.push_back(args[0]->components[i] - toSingle(scale * args[1]->components[i]));
+                }
+                return true;
+            }
+            case BuiltinId::TRANSPOSE: {
+                int n = matrixDimension(type);
+                for (int column = 0; column < n; ++column) {
+                    for (int row = 0; row < n; ++row) {
+                        result.push_back(args[0]->components[row * n + column]);
+                    }
+                }
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+};
+
+// Globals every read of which sees the constant their initializer returns:
+// consts, and private globals no function stores to
+std::map<uint32_t, uint32_t> constantGlobals(const IRModule& module) {
+    std::vector<bool> stored(module.globals.size(), false);
+    for (const auto& function : module.functions) {
+        for (const auto& block : function.blocks) {
+            for (IRValue value : block.instructions) {
+                if (function.instructions[value].op == IROp::STORE) {
+                    stored[function.instructions[value].imm] = true;
+                }
+            }
+        }
+    }
+    
+    std::map<uint32_t, uint32_t> constants;
+    for (uint32_t g = 0; g < module.globals.size(); ++g) {
+        const IRGlobal& global = module.globals[g];
+        bool immutable = global.qualifier == VariableDeclaration::Qualifier::CONST ||
+                         (global.qualifier == VariableDeclaration::Qualifier::NONE && !stored[g]);
+        if (!immutable || global.initializer == IR_NONE) {
+            continue;
+        }
+        const IRFunction& initializer = module.functions[global.initializer];
+        if (initializer.blocks.size() != 1) {
+            continue;
+        }
+        IRValue term = initializer.terminator(0);
+        if (term == IR_NONE || initializer.instructions[term].operandCount != 1) {
+            continue;
+        }
+        const IRInstruction& returned = initializer.instructions[initializer.operand(term, 0)];
+        if (returned.op == IROp::CONSTANT) {
+            constants.emplace(g, returned.imm);
+        }
+    }
+    return constants;
+}
+
+} // anonymous namespace
+
+bool foldConstants(IRModule& module, PassContext& context) {
+    bool changed = false;
+    bool progress = true;
+    while (progress) {
+        // Folding an initializer can make more globals constant
+        progress = false;
+        std::map<uint32_t, uint32_t> globals = constantGlobals(module);
+        for (auto& function : module.functions) {
+            Folder folder(module, function, globals);
+            progress |= folder.run();
+            context.statistics["fold-constants.folded"] += folder.folded();
+        }
+        changed |= progress;
+    }
+    return changed;
+}
+
+} // namespace sdl
@@ -0,0 +1,372 @@
+#include "ir/cuda_printer.h"
+#include "semantic/types.h"
+#include <cstdio>
+
+namespace sdl {
+
+bool CUDAPrinter::isPerThread(const IRGlobal& global) const {
+    return global.qualifier != VariableDeclaration::Qualifier::UNIFORM &&
+           global.qualifier != VariableDeclaration::Qualifier::CONST;
+}
+
+bool CUDAPrinter::usesHalf() const {
+    for (const auto& function : module_->functions) {
+        for (const auto& block : function.blocks) {
+            for (IRValue value : block.instructions) {
+                if (halfArithmetic(function, value)) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void CUDAPrinter::collectThreadGlobals() {
+    const auto& functions = module_->functions;
+    threadGlobals_.assign(functions.size(), {});
+    
+    for (size_t f = 0; f < functions.size(); ++f) {
+        for (const auto& block : functions[f].blocks) {
+            for (IRValue value : block.instructions) {
+                const IRInstruction& inst = functions[f].instructions[value];
+                if ((inst.op == IROp::LOAD || inst.op == IROp::STORE) && isPerThread(module_->globals[inst.imm])) {
+                    threadGlobals_[f][inst.imm] |= inst.op == IROp::STORE;
+                }
+            }
+        }
+    }
+    
+    // Callers pass everything their callees use
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t f = 0; f < functions.size(); ++f) {
+            for (const auto& block : functions[f].blocks) {
+                for (IRValue value : block.instructions) {
+                    const IRInstruction& inst = functions[f].instructions[value];
+                    if (inst.op != IROp::CALL) {
+                        continue;
+                    }
+                    for (const auto& used : threadGlobals_[inst.imm]) {
+                        auto it = threadGlobals_[f].find(used.first);
+                        if (it == threadGlobals_[f].end() || (used.second && !it->second)) {
+                            threadGlobals_[f][used.first] = it != threadGlobals_[f].end() ? true : used.second;
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void CUDAPrinter::printModule() {
+    collectThreadGlobals();
+    
+    writeLine(0, "#include <cuda_runtime.h>");
+    writeLine(0, "#include <device_launch_parameters.h>");
+    if (usesHalf()) {
+        writeLine(0, "#include <cuda_fp16.h>");
+    }
+    writeLine(0, "");
+    
+    for (const auto& item : module_->items) {
+        if (item.kind == IRItem::Kind::GLOBAL) {
+            printFileScopeGlobal(item.index);
+        } else if (item.kind == IRItem::Kind::FUNCTION) {
+            printDeviceFunction(item.index);
+        } else {
+            printKernel(item.index);
+        }
+    }
+}
+
+void CUDAPrinter::printFileScopeGlobal(uint32_t index) {
+    const IRGlobal& global = module_->globals[index];
+    if (isPerThread(global)) {
+        return; // Declared in the kernels that use it
+    }
+    std::string prefix = global.qualifier == VariableDeclaration::Qualifier::UNIFORM ? "__constant__ " : "const ";
+    std::string line = prefix + typeName(global.type) + " " + global.name;
+    if (global.initializer != IR_NONE) {
+        line += " = " + initializerExpression(global);
+    }
+    writeLine(0, line + ";");
+}
+
+void CUDAPrinter::printDeviceFunction(uint32_t index) {
+    const IRFunction& function = module_->functions[index];
+    std::string signature = "__device__ " + typeName(function.returnType) + " " + function.name + "(";
+    bool first = true;
+    for (const auto& param : function.parameters) {
+        signature += (first ? "" : ", ") + typeName(param.type) + " " + param.name;
+        first = false;
+    }
+    for (const auto& used : threadGlobals_[index]) {
+        const IRGlobal& global = module_->globals[used.first];
+        signature += (first ? "" : ", ") + typeName(global.type) + (used.second ? "& " : " ") + global.name;
+        first = false;
+    }
+    writeLine(0, signature + ") {");
+    printBody(function, 1);
+    writeLine(0, "}");
+    writeLine(0, "");
+}
+
+void CUDAPrinter::printKernel(uint32_t index) {
+    const IRShader& shader = module_->shaders[index];
+    writeLine(0, "// CUDA Kernel: " + shader.name);
+    
+    for (const auto& item : shader.items) {
+        if (item.kind == IRItem::Kind::GLOBAL) {
+            printFileScopeGlobal(item.index);
+        } else if (item.index != shader.entryPoint) {
+            printDeviceFunction(item.index);
+        }
+    }
+    
+    std::string signature = "__global__ void " + shader.name + "_kernel(";
+    switch (shader.stage) {
+        case ShaderDeclaration::ShaderType::VERTEX:
+            signature += "float* vertices, float* output, int numVertices";
+            break;
+        case ShaderDeclaration::ShaderType::FRAGMENT:
+            signature += "float* pixels, int width, int height";
+            break;
+        case ShaderDeclaration::ShaderType::COMPUTE:
+            signature += "float* input, float* output, int width, int height";
+            break;
+    }
+    writeLine(0, signature + ") {");
+    
+    if (shader.stage == ShaderDeclaration::ShaderType::COMPUTE) {
+        writeLine(1, "// Thread indexing");
+        writeLine(1, "int idx = blockIdx.x * blockDim.x + threadIdx.x;");
+        writeLine(1, "int idy = blockIdx.y * blockDim.y + threadIdx.y;");
+        writeLine(1, "");
+    }
+    
+    if (shader.entryPoint != IR_NONE) {
+        bool declared = false;
+        for (const auto& used : threadGlobals_[shader.entryPoint]) {
+            const IRGlobal& global = module_->globals[used.first];
+            std::string line = typeName(global.type) + " " + global.name;
+            if (global.name == "idx" || global.name == "idy") {
+                continue;
+            } else if (global.name == "gl_GlobalInvocationID") {
+                line += " = make_float3(blockIdx.x * blockDim.x + threadIdx.x, blockIdx.y * blockDim.y + threadIdx.y, "
+                        "blockIdx.z * blockDim.z + threadIdx.z)";
+            } else if (global.name == "gl_LocalInvocationID") {
+                line += " = make_float3(threadIdx.x, threadIdx.y, threadIdx.z)";
+            } else if (global.name == "gl_WorkGroupID") {
+                line += " = make_float3(blockIdx.x, blockIdx.y, blockIdx.z)";
+            } else if (global.initializer != IR_NONE) {
+                line += " = " + initializerExpression(global);
+            }
+            writeLine(1, line + ";");
+            declared = true;
+        }
+        if (declared) {
+            writeLine(1, "");
+        }
+        printBody(module_->functions[shader.entryPoint], 1);
+    }
+    
+    writeLine(0, "}");
+    writeLine(0, "");
+}
+
+std::string CUDAPrinter::typeName(Type::Kind type) const {
+    switch (type) {
+        case Type::Kind::VEC2: return "float2";
+        case Type::Kind::VEC3: return "float3";
+        case Type::Kind::VEC4: return "float4";
+        case Type::Kind::MAT2: return "float2x2";
+        case Type::Kind::MAT3: return "float3x3";
+        case Type::Kind::MAT4: return "float4x4";
+        case Type::Kind::SAMPLER2D:
+        case Type::Kind::SAMPLER3D:
+        case Type::Kind::SAMPLERCUBE: return "cudaTextureObject_t";
+        default: return sdl::typeName(type);
+    }
+}
+
+std::string CUDAPrinter::constant(const IRConstant& constant) const {
+    auto scalar = [&](double value) -> std::string {
+        switch (constant.type) {
+            case Type::Kind::BOOL: return value != 0.0 ? "true" : "false";
+            case Type::Kind::INT: return formatInt(value);
+            default: break;
+        }
+        std::string text = formatFloat(value);
+        if (text[0] == '(') {
+            // NaN and infinities have no literal
+            unsigned bits = value != value ? 0x7fffffffu : value > 0 ? 0x7f800000u : 0xff800000u;
+            char buffer[40];
+            std::snprintf(buffer, sizeof(buffer), "__int_as_float(0x%08x)", bits);
+            return buffer;
+        }
+        return text + "f";
+    };
+    
+    const auto& values = constant.components;
+    if (values.size() == 1) {
+        return scalar(values[0]);
+    }
+    
+    bool splat = !isMatrix(constant.type);
+    for (size_t i = 1; i < values.size() && splat; ++i) {
+        splat = values[i] == values[0];
+    }
+    std::vector<std::string> args;
+    for (size_t i = 0; i < (splat ? 1 : values.size()); ++i) {
+        args.push_back(scalar(values[i]));
+    }
+    return construct(constant.type, args);
+}
+
+std::string CUDAPrinter::construct(Type::Kind type, const std::vector<std::string>& args) const {
+    // make_float3(...) as in helper_math.h; scalars are functional casts
+    std::string text = (isScalar(type) ? "" : "make_") + typeName(type) + "(";
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (i > 0) text += ", ";
+        text += args[i];
+    }
+    return text + ")";
+}
+
+const char* CUDAPrinter::builtinTemplate(const BuiltinInfo& builtin) const {
+    return builtin.cuda;
+}
+
+const char* CUDAPrinter::fastBuiltinTemplate(const BuiltinInfo& builtin, Type::Kind argument) const {
+    // The SFU intrinsics nvcc's -use_fast_math would pick; they exist for
+    // float only. Error bounds are listed in README.md under Fast math.
+    if (argument != Type::Kind::FLOAT) {
+        return nullptr;
+    }
+    switch (builtin.id) {
+        case BuiltinId::SIN: return "__sinf($0)";
+        case BuiltinId::COS: return "__cosf($0)";
+        case BuiltinId::TAN: return "__tanf($0)";
+        case BuiltinId::EXP: return "__expf($0)";
+        case BuiltinId::LOG: return "__logf($0)";
+        case BuiltinId::LOG2: return "__log2f($0)";
+        case BuiltinId::POW: return "__powf($0, $1)";
+        case BuiltinId::INVERSESQRT: return "rsqrtf($0)";
+        default: return nullptr;
+    }
+}
+
+const char* CUDAPrinter::fastDivisionTemplate(Type::Kind dividend, Type::Kind divisor) const {
+    if (divisor != Type::Kind::FLOAT) {
+        return nullptr;
+    }
+    if (dividend == Type::Kind::FLOAT) {
+        return "__fdividef($0, $1)";
+    }
+    return isFloatVector(dividend) ? "($0 * __fdividef(1.0f, $1))" : nullptr;
+}
+
+std::string CUDAPrinter::swizzle(const std::string& value, uint32_t swizzle) const {
+    int count = swizzleCount(swizzle);
+    if (count == 1) {
+        return IRPrinter::swizzle(value, swizzle);
+    }
+    std::vector<std::string> args;
+    for (int i = 0; i < count; ++i) {
+        args.push_back(value + "." + "xyzw"[swizzleComponent(swizzle, i)]);
+    }
+    return construct(floatVectorType(count), args);
+}
+
+std::string CUDAPrinter::assignComponents(const std::string& target, uint32_t mask, const std::string& value) const {
+    int count = swizzleCount(mask);
+    if (count == 1) {
+        return IRPrinter::assignComponents(target, mask, value);
+    }
+    std::string text;
+    for (int i = 0; i < count; ++i) {
+        if (i > 0) text += " ";
+        text += target + "." + "xyzw"[swizzleComponent(mask, i)] + " = " + value + "." + "xyzw"[i] + ";";
+    }
+    return text;
+}
+
+bool CUDAPrinter::needsName(const IRInstruction& inst, size_t operand) const {
+    switch (inst.op) {
+        case IROp::SWIZZLE: return swizzleCount(inst.imm) > 1;
+        case IROp::INSERT: return operand == 1 && swizzleCount(inst.imm) > 1;
+        case IROp::STORE: return swizzleCount(inst.aux) > 1;
+        default: return IRPrinter::needsName(inst, operand);
+    }
+}
+
+std::vector<std::string> CUDAPrinter::extraArguments(uint32_t function) const {
+    std::vector<std::string> args;
+    for (const auto& used : threadGlobals_[function]) {
+        args.push_back(module_->globals[used.first].name);
+    }
+    return args;
+}
+
+std::string CUDAPrinter::branchComment(uint32_t hint) const {
+    // A uniform branch is taken by the whole warp and costs no serialization
+    switch (hint) {
+        case BRANCH_UNIFORM: return " // uniform";
+        case BRANCH_DIVERGENT: return " // divergent";
+        default: return "";
+    }
+}
+
+std::string CUDAPrinter::loopPragma(uint32_t unroll) const {
+    return unroll ? "#pragma unroll " + std::to_string(unroll) : "";
+}
+
+std::string CUDAPrinter::variableType(const IRFunction& function, IRValue value) const {
+    Type::Kind type = function.instructions[value].type;
+    if (halfArithmetic(function, value)) {
+        return type == Type::Kind::VEC2 ? "__half2" : "__half";
+    }
+    return typeName(type);
+}
+
+bool CUDAPrinter::halfArithmetic(const IRFunction& function, IRValue value) const {
+    // cuda_fp16.h has operators for these on __half and __half2, without
+    // mixing the two
+    const IRInstruction& inst = function.instructions[value];
+    bool arithmetic = inst.op == IROp::ADD || inst.op == IROp::SUB || inst.op == IROp::MUL || inst.op == IROp::NEG;
+    if (inst.precision != IRPrecision::MEDIUM || !arithmetic ||
+        (inst.type != Type::Kind::FLOAT && inst.type != Type::Kind::VEC2)) {
+        return false;
+    }
+    for (uint32_t k = 0; k < inst.operandCount; ++k) {
+        if (function.instructions[function.operand(value, k)].type != inst.type) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string CUDAPrinter::halfConversion(const std::string& value, Type::Kind type, bool toHalf) const {
+    if (type == Type::Kind::VEC2) {
+        return (toHalf ? "__float22half2_rn(" : "__half22float2(") + value + ")";
+    }
+    return (toHalf ? "__float2half(" : "__half2float(") + value + ")";
+}
+
+bool CUDAPrinter::isReserved(const std::string& name) const {
+    static const char* const kernelNames[] = {
+        "vertices", "output", "numVertices", "pixels", "width", "height", "input",
+        "idx", "idy", "threadIdx", "blockIdx", "blockDim",
+    };
+    for (const char* reserved : kernelNames) {
+        if (name == reserved) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace sdl
@@ -0,0 +1,305 @@
+#include "ir/passes.h"
+#include <algorithm>
+#include <map>
+
+namespace sdl {
+
+namespace {
+
+constexpr unsigned WRITES = Effect::WRITES_OUTPUTS | Effect::WRITES_GLOBALS | Effect::WRITES_ARGUMENTS;
+
+bool hasSideEffects(const IRFunction& function, IRValue value, const std::vector<unsigned>& effects) {
+    const IRInstruction& inst = function.instructions[value];
+    switch (inst.op) {
+        case IROp::STORE:
+        case IROp::BRANCH:
+        case IROp::COND_BRANCH:
+        case IROp::RETURN:
+            return true;
+        case IROp::CALL:
+            return (effects[inst.imm] & WRITES) != 0;
+        default:
+            return false;
+    }
+}
+
+// Removes stores to private globals no function loads, and full stores
+// overwritten later in the same block before anything could read them
+int removeDeadStores(IRModule& module, IRFunction& function, const std::vector<bool>& loaded) {
+    int removed = 0;
+    for (auto& block : function.blocks) {
+        std::map<uint32_t, IRValue> pending; // Global -> last store not read since
+        for (IRValue value : std::vector<IRValue>(block.instructions)) {
+            const IRInstruction& inst = function.instructions[value];
+            if (inst.op == IROp::STORE) {
+                const IRGlobal& global = module.globals[inst.imm];
+                if (global.qualifier == VariableDeclaration::Qualifier::NONE && !loaded[inst.imm]) {
+                    function.remove(value);
+                    ++removed;
+                    continue;
+                }
+                auto it = pending.find(inst.imm);
+                if (inst.aux == 0 && it != pending.end()) {
+                    function.remove(it->second);
+                    ++removed;
+                }
+                pending[inst.imm] = value;
+            } else if (inst.op == IROp::LOAD) {
+                pending.erase(inst.imm);
+            } else if (inst.op == IROp::CALL) {
+                pending.clear();
+            }
+        }
+    }
+    return removed;
+}
+
+// Marks from the instructions with effects back through their operands;
+// whatever is left unmarked, dead phi cycles included, goes
+int removeDeadInstructions(IRFunction& function, const std::vector<unsigned>& effects) {
+    std::vector<bool> live(function.instructions.size(), false);
+    std::vector<IRValue> worklist;
+    for (const auto& block : function.blocks) {
+        for (IRValue value : block.instructions) {
+            if (hasSideEffects(function, value, effects)) {
+                live[value] = true;
+                worklist.push_back(value);
+            }
+        }
+    }
+    while (!worklist.empty()) {
+        IRValue value = worklist.back();
+        worklist.pop_back();
+        for (uint32_t i = 0; i < function.instructions[value].operandCount; ++i) {
+            IRValue operand = function.operand(value, i);
+            if (!live[operand]) {
+                live[operand] = true;
+                worklist.push_back(operand);
+            }
+        }
+    }
+    
+    int removed = 0;
+    for (auto& block : function.blocks) {
+        for (IRValue value : std::vector<IRValue>(block.instructions)) {
+            if (!live[value]) {
+                function.remove(value);
+                ++removed;
+            }
+        }
+    }
+    return removed;
+}
+
+// An if whose arms do nothing but reach the merge, which takes no values
+// from them, becomes a branch to the merge
+bool removeEmptySelection(IRFunction& function, uint32_t header) {
+    IRBlock& block = function.blocks[header];
+    uint32_t merge = block.merge;
+    if (block.structure != IRStructure::SELECTION || merge == IR_NONE) {
+        return false;
+    }
+    for (IRValue value : function.blocks[merge].instructions) {
+        if (function.instructions[value].op == IROp::PHI) {
+            return false;
+        }
+    }
+    for (uint32_t arm : block.successors) {
+        const IRBlock& successor = function.blocks[arm];
+        bool empty = successor.instructions.size() == 1 && successor.successors[0] == merge &&
+                     successor.predecessors.size() == 1 &&
+                     function.instructions[successor.instructions[0]].op == IROp::BRANCH;
+        if (arm != merge && !empty) {
+            return false;
+        }
+    }
+    
+    // The arms become unreachable; removeUnreachableBlocks drops their edges
+    auto& preds = function.blocks[merge].predecessors;
+    preds.erase(std::remove(preds.begin(), preds.end(), header), preds.end());
+    preds.push_back(header);
+    function.remove(function.terminator(header));
+    function.append(header, IROp::BRANCH, Type::Kind::VOID);
+    block.successors[0] = merge;
+    block.successors[1] = IR_NONE;
+    block.structure = IRStructure::NONE;
+    block.merge = IR_NONE;
+    return true;
+}
+
+// A loop that stores nothing, calls nothing that writes, does not return and
+// computes nothing used after it has no effect, so the header branches to
+// the exit directly. A loop that never ends is undefined behaviour anyway.
+bool removeDeadLoop(IRFunction& function, uint32_t header, const std::vector<unsigned>& effects) {
+    IRBlock& block = function.blocks[header];
+    uint32_t exit = block.merge;
+    if (block.structure != IRStructure::LOOP || exit == IR_NONE) {
+        return false;
+    }
+    
+    // Everything the header reaches before the exit, returning blocks included
+    std::vector<bool> inLoop(function.blocks.size(), false);
+    std::vector<uint32_t> worklist{header};
+    inLoop[header] = true;
+    while (!worklist.empty()) {
+        uint32_t b = worklist.back();
+        worklist.pop_back();
+        for (uint32_t succ : function.blocks[b].successors) {
+            if (succ != IR_NONE && succ != exit && !inLoop[succ]) {
+                inLoop[succ] = true;
+                worklist.push_back(succ);
+            }
+        }
+    }
+    
+    for (uint32_t b = 0; b < function.blocks.size(); ++b) {
+        for (IRValue value : function.blocks[b].instructions) {
+            const IRInstruction& inst = function.instructions[value];
+            if (inLoop[b]) {
+                bool branch = inst.op == IROp::BRANCH || inst.op == IROp::COND_BRANCH;
+                if (!branch && hasSideEffects(function, value, effects)) {
+                    return false;
+                }
+                continue;
+            }
+            for (uint32_t k = 0; k < inst.operandCount; ++k) {
+                uint32_t defined = function.instructions[function.operand(value, k)].block;
+                if (defined != IR_NONE && inLoop[defined]) {
+                    return false;
+                }
+            }
+        }
+    }
+    
+    // The body becomes unreachable; removeUnreachableBlocks drops the back
+    // edge and its phi operands
+    function.remove(function.terminator(header));
+    function.append(header, IROp::BRANCH, Type::Kind::VOID);
+    block.successors[0] = exit;
+    block.successors[1] = IR_NONE;
+    block.structure = IRStructure::NONE;
+    block.merge = IR_NONE;
+    block.continueTarget = IR_NONE;
+    block.unroll = 0;
+    return true;
+}
+
+std::vector<bool> loadedGlobals(const IRModule& module) {
+    std::vector<bool> loaded(module.globals.size(), false);
+    for (const auto& function : module.functions) {
+        for (const auto& block : function.blocks) {
+            for (IRValue value : block.instructions) {
+                if (function.instructions[value].op == IROp::LOAD) {
+                    loaded[function.instructions[value].imm] = true;
+                }
+            }
+        }
+    }
+    return loaded;
+}
+
+} // anonymous namespace
+
+bool eliminateDeadCode(IRModule& module, PassContext& context) {
+    std::vector<unsigned> effects = functionEffects(module);
+    std::vector<bool> loaded = loadedGlobals(module);
+    
+    int stores = 0;
+    int instructions = 0;
+    int selections = 0;
+    int loops = 0;
+    for (auto& function : module.functions) {
+        stores += removeDeadStores(module, function, loaded);
+        instructions += removeDeadInstructions(function, effects);
+        
+        // Removing an if or loop can empty the construct around it
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (uint32_t b = 0; b < function.blocks.size() && !changed; ++b) {
+                if (removeEmptySelection(function, b)) {
+                    ++selections;
+                    changed = true;
+                } else if (removeDeadLoop(function, b, effects)) {
+                    ++loops;
+                    changed = true;
+                }
+            }
+            if (changed) {
+                removeUnreachableBlocks(function);
+                removeTrivialPhis(function);
+                instructions += removeDeadInstructions(function, effects);
+            }
+        }
+    }
+    context.statistics["dce.stores"] += stores;
+    context.statistics["dce.instructions"] += instructions;
+    context.statistics["dce.selections"] += selections;
+    context.statistics["dce.loops"] += loops;
+    return stores + instructions + selections + loops > 0;
+}
+
+bool stripUnusedGlobals(IRModule& module, PassContext& context) {
+    // Live: entry points, what they call, and the initializers of the
+    // globals live functions use
+    std::vector<bool> liveFunction(module.functions.size(), false);
+    std::vector<bool> liveGlobal(module.globals.size(), false);
+    std::vector<uint32_t> worklist;
+    auto reach = [&](uint32_t function) {
+        if (!liveFunction[function]) {
+            liveFunction[function] = true;
+            worklist.push_back(function);
+        }
+    };
+    for (const auto& shader : module.shaders) {
+        if (shader.entryPoint != IR_NONE) {
+            reach(shader.entryPoint);
+        }
+    }
+    while (!worklist.empty()) {
+        const IRFunction& function = module.functions[worklist.back()];
+        worklist.pop_back();
+        for (const auto& block : function.blocks) {
+            for (IRValue value : block.instructions) {
+                const IRInstruction& inst = function.instructions[value];
+                if (inst.op == IROp::CALL) {
+                    reach(inst.imm);
+                } else if (inst.op == IROp::LOAD || inst.op == IROp::STORE) {
+                    liveGlobal[inst.imm] = true;
+                    if (module.globals[inst.imm].initializer != IR_NONE) {
+                        reach(module.globals[inst.imm].initializer);
+                    }
+                }
+            }
+        }
+    }
+    
+    int functions = 0;
+    int globals = 0;
+    auto prune = [&](std::vector<IRItem>& items) {
+        items.erase(std::remove_if(items.begin(), items.end(), [&](const IRItem& item) {
+            if (item.kind == IRItem::Kind::FUNCTION && !liveFunction[item.index]) {
+                ++functions;
+                return true;
+            }
+            if (item.kind == IRItem::Kind::GLOBAL && !liveGlobal[item.index] &&
+                module.globals[item.index].qualifier != VariableDeclaration::Qualifier::OUT) {
+                // Outputs stay: the next stage or the host reads them
+                module.strippedGlobals.push_back(item.index);
+                ++globals;
+                return true;
+            }
+            return false;
+        }), items.end());
+    };
+    prune(module.items);
+    for (auto& shader : module.shaders) {
+        prune(shader.items);
+    }
+    
+    context.statistics["strip-globals.functions"] += functions;
+    context.statistics["strip-globals.globals"] += globals;
+    return functions + globals > 0;
+}
+
+} // namespace sdl
@@ -0,0 +1,132 @@
+#include "ir/glsl_printer.h"
+#include "semantic/types.h"
+
+namespace sdl {
+
+namespace {
+
+const char* qualifierPrefix(VariableDeclaration::Qualifier qualifier) {
+    switch (qualifier) {
+        case VariableDeclaration::Qualifier::IN: return "in ";
+        case VariableDeclaration::Qualifier::OUT: return "out ";
+        case VariableDeclaration::Qualifier::UNIFORM: return "uniform ";
+        case VariableDeclaration::Qualifier::CONST: return "const ";
+        default: return "";
+    }
+}
+
+} // anonymous namespace
+
+void GLSLPrinter::printModule() {
+    if (es_) {
+        writeLine(0, "#version 300 es");
+        writeLine(0, "precision highp float;");
+        writeLine(0, "precision highp int;");
+    } else {
+        writeLine(0, "#version 330 core");
+    }
+    writeLine(0, "");
+    for (const auto& item : module_->items) {
+        printItem(item);
+    }
+}
+
+void GLSLPrinter::printItem(const IRItem& item) {
+    if (item.kind == IRItem::Kind::SHADER) {
+        const IRShader& shader = module_->shaders[item.index];
+        writeLine(0, "// Shader: " + shader.name);
+        for (const auto& inner : shader.items) {
+            printItem(inner);
+        }
+        return;
+    }
+    
+    if (item.kind == IRItem::Kind::GLOBAL) {
+        const IRGlobal& global = module_->globals[item.index];
+        std::string line = qualifierPrefix(global.qualifier) + typeName(global.type) + " " + global.name;
+        if (global.initializer != IR_NONE) {
+            line += " = " + initializerExpression(global);
+        }
+        writeLine(0, line + ";");
+        return;
+    }
+    
+    const IRFunction& function = module_->functions[item.index];
+    std::string signature = typeName(function.returnType) + " " + function.name + "(";
+    for (size_t i = 0; i < function.parameters.size(); ++i) {
+        if (i > 0) signature += ", ";
+        signature += typeName(function.parameters[i].type) + " " + function.parameters[i].name;
+    }
+    writeLine(0, signature + ") {");
+    printBody(function, 1);
+    writeLine(0, "}");
+    writeLine(0, "");
+}
+
+std::string GLSLPrinter::typeName(Type::Kind type) const {
+    return sdl::typeName(type);
+}
+
+std::string GLSLPrinter::constant(const IRConstant& constant) const {
+    auto scalar = [&](double value) -> std::string {
+        switch (constant.type) {
+            case Type::Kind::BOOL: return value != 0.0 ? "true" : "false";
+            case Type::Kind::INT: return formatInt(value);
+            default: return formatFloat(value);
+        }
+    };
+    
+    const auto& values = constant.components;
+    if (values.size() == 1) {
+        return scalar(values[0]);
+    }
+    
+    // vec3(x) splats; mat3(x) puts x on the diagonal
+    int dimension = matrixDimension(constant.type);
+    bool single = true;
+    for (size_t i = 0; i < values.size() && single; ++i) {
+        bool diagonal = dimension == 0 || static_cast<int>(i) % (dimension + 1) == 0;
+        single = diagonal ? values[i] == values[0] : values[i] == 0.0;
+    }
+    if (single) {
+        return typeName(constant.type) + "(" + scalar(values[0]) + ")";
+    }
+    
+    std::vector<std::string> args;
+    for (double value : values) {
+        args.push_back(scalar(value));
+    }
+    return construct(constant.type, args);
+}
+
+std::string GLSLPrinter::construct(Type::Kind type, const std::vector<std::string>& args) const {
+    std::string text = typeName(type) + "(";
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (i > 0) text += ", ";
+        text += args[i];
+    }
+    return text + ")";
+}
+
+const char* GLSLPrinter::builtinTemplate(const BuiltinInfo& builtin) const {
+    return builtin.glsl;
+}
+
+const char* GLSLPrinter::fastBuiltinTemplate(const BuiltinInfo& builtin, Type::Kind argument) const {
+    // normalize() must survive a zero or huge vector; one inversesqrt on the
+    // special function unit need not
+    if (builtin.id == BuiltinId::NORMALIZE && isFloatVector(argument)) {
+        return "($0 * inversesqrt(dot($0, $0)))";
+    }
+    return nullptr;
+}
+
+std::string GLSLPrinter::variableType(const IRFunction& function, IRValue value) const {
+    const IRInstruction& inst = function.instructions[value];
+    if (es_ && inst.precision == IRPrecision::MEDIUM) {
+        return "mediump " + typeName(inst.type);
+    }
+    return typeName(inst.type);
+}
+
+} // namespace sdl
@@ -0,0 +1,215 @@
+#include "ir/passes.h"
+#include "semantic/types.h"
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+namespace sdl {
+
+namespace {
+
+// What an instruction computes: equal keys give equal values
+struct ValueKey {
+    IROp op;
+    Type::Kind type;
+    uint32_t imm;
+    uint32_t aux;
+    uint32_t block; // Phis are only equal within their block
+    std::vector<IRValue> operands;
+    
+    bool operator<(const ValueKey& other) const {
+        return std::tie(op, type, imm, aux, block, operands) <
+               std::tie(other.op, other.type, other.imm, other.aux, other.block, other.operands);
+    }
+};
+
+constexpr unsigned WRITES = Effect::WRITES_OUTPUTS | Effect::WRITES_GLOBALS | Effect::WRITES_ARGUMENTS;
+
+class ValueNumbering {
+public:
+    ValueNumbering(IRFunction& function, const std::vector<unsigned>& effects, const std::vector<bool>& stored)
+        : function_(function), effects_(effects), stored_(stored) {}
+    
+    int run() {
+        if (function_.blocks.empty()) {
+            return 0;
+        }
+        std::vector<uint32_t> idom = immediateDominators(function_);
+        children_.assign(function_.blocks.size(), {});
+        for (uint32_t b = 0; b < function_.blocks.size(); ++b) {
+            if (idom[b] != IR_NONE) {
+                children_[idom[b]].push_back(b);
+            }
+        }
+        visit(0);
+        return eliminated_;
+    }
+    
+private:
+    IRFunction& function_;
+    const std::vector<unsigned>& effects_;
+    const std::vector<bool>& stored_; // Globals some function stores to
+    std::vector<std::vector<uint32_t>> children_; // Dominator tree
+    std::map<ValueKey, IRValue> available_;       // Values computed in the dominators of the current block
+    int eliminated_ = 0;
+    
+    // Walks the dominator tree; what a block computes is available in the
+    // blocks it dominates
+    void visit(uint32_t block) {
+        std::vector<ValueKey> added;
+        // Loads of globals something writes, valid until the next write
+        std::map<uint32_t, IRValue> loads;
+        
+        for (IRValue value : std::vector<IRValue>(function_.blocks[block].instructions)) {
+            const IRInstruction& inst = function_.instructions[value];
+            
+            if (inst.op == IROp::LOAD && stored_[inst.imm]) {
+                auto it = loads.find(inst.imm);
+                if (it != loads.end()) {
+                    replace(value, it->second);
+                } else {
+                    loads.emplace(inst.imm, value);
+                }
+                continue;
+            }
+            if (inst.op == IROp::STORE) {
+                // Later loads in the block see the stored value
+                loads.erase(inst.imm);
+                if (inst.aux == 0) {
+                    loads.emplace(inst.imm, function_.operand(value, 0));
+                }
+                continue;
+            }
+            if (inst.op == IROp::CALL && (effects_[inst.imm] & WRITES) != 0) {
+                loads.clear();
+                continue;
+            }
+            
+            ValueKey key;
+            if (!keyOf(value, key)) {
+                continue;
+            }
+            auto it = available_.find(key);
+            if (it != available_.end()) {
+                replace(value, it->second);
+            } else {
+                available_.emplace(key, value);
+                added.push_back(std::move(key));
+            }
+        }
+        
+        for (uint32_t child : children_[block]) {
+            visit(child);
+        }
+        for (const auto& key : added) {
+            available_.erase(key);
+        }
+    }
+    
+    bool keyOf(IRValue value, ValueKey& key) const {
+        const IRInstruction& inst = function_.instructions[value];
+        switch (inst.op) {
+            case IROp::CONSTANT:
+            case IROp::PARAMETER:
+            case IROp::STORE:
+            case IROp::BRANCH:
+            case IROp::COND_BRANCH:
+            case IROp::RETURN:
+                return false;
+            case IROp::CALL:
+                // Only calls whose result depends on nothing but their arguments
+                if ((effects_[inst.imm] & (WRITES | Effect::READS_MUTABLE)) != 0) {
+                    return false;
+                }
+                break;
+            case IROp::BUILTIN: {
+                const BuiltinInfo* info = builtinInfo(static_cast<BuiltinId>(inst.imm));
+                if (!info || (info->effects & WRITES) != 0) {
+                    return false;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        
+        key.op = inst.op;
+        key.type = inst.type;
+        key.imm = inst.imm;
+        key.aux = inst.aux;
+        key.block = inst.op == IROp::PHI ? inst.block : IR_NONE;
+        key.operands.assign(function_.operandsOf(value), function_.operandsOf(value) + inst.operandCount);
+        
+        // a > b is b < a; commutative operands in a canonical order
+        if (key.op == IROp::GT || key.op == IROp::GE) {
+            key.op = key.op == IROp::GT ? IROp::LT : IROp::LE;
+            std::swap(key.operands[0], key.operands[1]);
+        } else if (commutative(value) && key.operands[1] < key.operands[0]) {
+            std::swap(key.operands[0], key.operands[1]);
+        }
+        return true;
+    }
+    
+    bool commutative(IRValue value) const {
+        const IRInstruction& inst = function_.instructions[value];
+        switch (inst.op) {
+            case IROp::ADD:
+            case IROp::EQ:
+            case IROp::NE:
+            case IROp::AND:
+            case IROp::OR:
+                return true;
+            case IROp::MUL: {
+                // Matrix products are not; everything else is componentwise
+                return !isMatrix(function_.instructions[function_.operand(value, 0)].type) &&
+                       !isMatrix(function_.instructions[function_.operand(value, 1)].type);
+            }
+            case IROp::BUILTIN:
+                switch (static_cast<BuiltinId>(inst.imm)) {
+                    case BuiltinId::MIN:
+                    case BuiltinId::MAX:
+                    case BuiltinId::DOT:
+                    case BuiltinId::DISTANCE:
+                        return true;
+                    default:
+                        return false;
+                }
+            default:
+                return false;
+        }
+    }
+    
+    void replace(IRValue value, IRValue leader) {
+        if (function_.instructions[leader].name == 0) {
+            function_.instructions[leader].name = function_.instructions[value].name;
+        }
+        function_.remove(value);
+        function_.replaceAllUses(value, leader);
+        ++eliminated_;
+    }
+};
+
+} // anonymous namespace
+
+bool eliminateCommonSubexpressions(IRModule& module, PassContext& context) {
+    std::vector<unsigned> effects = functionEffects(module);
+    std::vector<bool> stored(module.globals.size(), false);
+    for (const auto& function : module.functions) {
+        for (const auto& block : function.blocks) {
+            for (IRValue value : block.instructions) {
+                if (function.instructions[value].op == IROp::STORE) {
+                    stored[function.instructions[value].imm] = true;
+                }
+            }
+        }
+    }
+    
+    int eliminated = 0;
+    for (auto& function : module.functions) {
+        eliminated += ValueNumbering(function, effects, stored).run();
+    }
+    context.statistics["gvn.eliminated"] += eliminated;
+    return eliminated > 0;
+}
+
+} // namespace sdl
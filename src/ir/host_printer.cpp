@@ -0,0 +1,431 @@
+#include "ir/host_printer.h"
+#include "semantic/types.h"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace sdl {
+
+namespace {
+
+std::string join(const std::vector<std::string>& parts, const char* separator) {
+    std::string text;
+    for (size_t n = 0; n < parts.size(); ++n) {
+        text += (n > 0 ? separator : "") + parts[n];
+    }
+    return text;
+}
+
+} // anonymous namespace
+
+void HostPrinter::printModule() {
+    bool any = std::any_of(module_->shaders.begin(), module_->shaders.end(),
+                           [](const IRShader& shader) { return !shader.preshader.blocks.empty(); });
+    if (!any) {
+        return;
+    }
+    
+    writeLine(0, "// Preshaders generated by the shader compiler: run each once per draw and");
+    writeLine(0, "// upload its outputs as the uniforms of the same names. Vectors and");
+    writeLine(0, "// matrices are float arrays, matrices column-major.");
+    writeLine(0, "#pragma once");
+    writeLine(0, "");
+    writeLine(0, "#include <algorithm>");
+    writeLine(0, "#include <cmath>");
+    writeLine(0, "");
+    writeLine(0, "#ifndef SDL_PRESHADER_HELPERS");
+    writeLine(0, "#define SDL_PRESHADER_HELPERS");
+    writeLine(0, "// Inverts an n x n matrix in place by Gauss-Jordan elimination; a singular");
+    writeLine(0, "// matrix gives infinities and NaNs, as inverse() does in a shader");
+    writeLine(0, "inline void sdlInvert(float* m, int n) {");
+    writeLine(1, "float inverse[16] = {};");
+    writeLine(1, "for (int i = 0; i < n; ++i) {");
+    writeLine(2, "inverse[i * n + i] = 1.0f;");
+    writeLine(1, "}");
+    writeLine(1, "for (int column = 0; column < n; ++column) {");
+    writeLine(2, "int pivot = column;");
+    writeLine(2, "for (int row = column + 1; row < n; ++row) {");
+    writeLine(3, "if (std::fabs(m[column * n + row]) > std::fabs(m[column * n + pivot])) {");
+    writeLine(4, "pivot = row;");
+    writeLine(3, "}");
+    writeLine(2, "}");
+    writeLine(2, "for (int k = 0; k < n; ++k) {");
+    writeLine(3, "std::swap(m[k * n + column], m[k * n + pivot]);");
+    writeLine(3, "std::swap(inverse[k * n + column], inverse[k * n + pivot]);");
+    writeLine(2, "}");
+    writeLine(2, "float scale = 1.0f / m[column * n + column];");
+    writeLine(2, "for (int k = 0; k < n; ++k) {");
+    writeLine(3, "m[k * n + column] *= scale;");
+    writeLine(3, "inverse[k * n + column] *= scale;");
+    writeLine(2, "}");
+    writeLine(2, "for (int row = 0; row < n; ++row) {");
+    writeLine(3, "float factor = m[column * n + row];");
+    writeLine(3, "if (row == column || factor == 0.0f) {");
+    writeLine(4, "continue;");
+    writeLine(3, "}");
+    writeLine(3, "for (int k = 0; k < n; ++k) {");
+    writeLine(4, "m[k * n + row] -= factor * m[k * n + column];");
+    writeLine(4, "inverse[k * n + row] -= factor * inverse[k * n + column];");
+    writeLine(3, "}");
+    writeLine(2, "}");
+    writeLine(1, "}");
+    writeLine(1, "std::copy(inverse, inverse + n * n, m);");
+    writeLine(0, "}");
+    writeLine(0, "#endif");
+    
+    for (const auto& shader : module_->shaders) {
+        if (!shader.preshader.blocks.empty()) {
+            printPreshader(shader);
+        }
+    }
+}
+
+void HostPrinter::printPreshader(const IRShader& shader) {
+    function_ = &shader.preshader;
+    std::vector<uint32_t> inputs;
+    std::vector<uint32_t> outputs;
+    for (IRValue value : function_->blocks[0].instructions) {
+        const IRInstruction& inst = function_->instructions[value];
+        auto& list = inst.op == IROp::LOAD ? inputs : outputs;
+        if ((inst.op == IROp::LOAD || inst.op == IROp::STORE) &&
+            std::find(list.begin(), list.end(), inst.imm) == list.end()) {
+            list.push_back(inst.imm);
+        }
+    }
+    
+    for (int side = 0; side < 2; ++side) {
+        writeLine(0, "");
+        writeLine(0, "struct " + shader.name + (side == 0 ? "_PreshaderInputs {" : "_PreshaderOutputs {"));
+        for (uint32_t global : side == 0 ? inputs : outputs) {
+            writeLine(1, declaration(module_->globals[global].type, module_->globals[global].name) + ";");
+        }
+        writeLine(0, "};");
+    }
+    
+    writeLine(0, "");
+    writeLine(0, "inline void " + shader.name + "_preshader(const " + shader.name + "_PreshaderInputs& in, " +
+                     shader.name + "_PreshaderOutputs& out) {");
+    for (IRValue value : function_->blocks[0].instructions) {
+        printInstruction(value);
+    }
+    writeLine(0, "}");
+}
+
+void HostPrinter::printInstruction(IRValue value) {
+    const IRInstruction& inst = function_->instructions[value];
+    auto operand = [&](size_t index) { return function_->operand(value, index); };
+    auto typeOf = [&](IRValue v) { return function_->instructions[v].type; };
+    int count = std::max(1, componentCount(inst.type));
+    std::vector<std::string> elements;
+    
+    switch (inst.op) {
+        case IROp::CONSTANT:
+        case IROp::LOAD:
+        case IROp::RETURN:
+            return; // Read where used
+        case IROp::STORE: {
+            const IRGlobal& global = module_->globals[inst.imm];
+            int components = componentCount(global.type);
+            if (components > 1 && function_->instructions[operand(0)].op != IROp::CONSTANT) {
+                std::string source = element(operand(0), 0);
+                source = source.substr(0, source.size() - 3); // Without the [0]
+                writeLine(1, "std::copy(" + source + ", " + source + " + " + std::to_string(components) + ", out." +
+                                 global.name + ");");
+                return;
+            }
+            for (int c = 0; c < components; ++c) {
+                std::string target = "out." + global.name + (components > 1 ? "[" + std::to_string(c) + "]" : "");
+                writeLine(1, target + " = " + element(operand(0), c) + ";");
+            }
+            return;
+        }
+        case IROp::ADD:
+        case IROp::SUB:
+        case IROp::DIV:
+        case IROp::MOD:
+        case IROp::AND:
+        case IROp::OR:
+        case IROp::LT:
+        case IROp::LE:
+        case IROp::GT:
+        case IROp::GE: {
+            const char* symbol = inst.op == IROp::ADD ? " + " : inst.op == IROp::SUB ? " - "
+                               : inst.op == IROp::DIV ? " / " : inst.op == IROp::MOD ? " % "
+                               : inst.op == IROp::AND ? " && " : inst.op == IROp::OR ? " || "
+                               : inst.op == IROp::LT ? " < " : inst.op == IROp::LE ? " <= "
+                               : inst.op == IROp::GT ? " > " : " >= ";
+            for (int c = 0; c < count; ++c) {
+                elements.push_back(argument(operand(0), c) + symbol + argument(operand(1), c));
+            }
+            break;
+        }
+        case IROp::MUL: {
+            Type::Kind left = typeOf(operand(0));
+            Type::Kind right = typeOf(operand(1));
+            if ((isMatrix(left) && componentCount(right) > 1) || (isMatrix(right) && componentCount(left) > 1)) {
+                // Linear-algebra product, each element a sum of n terms
+                int n = matrixDimension(isMatrix(left) ? left : right);
+                int columns = isMatrix(right) ? n : 1;
+                int rows = isMatrix(left) ? n : 1;
+                for (int column = 0; column < columns; ++column) {
+                    for (int row = 0; row < rows; ++row) {
+                        std::vector<std::string> terms;
+                        for (int k = 0; k < n; ++k) {
+                            int a = isMatrix(left) ? k * n + row : k;
+                            int b = isMatrix(right) ? column * n + k : k;
+                            terms.push_back(element(operand(0), a) + " * " + element(operand(1), b));
+                        }
+                        elements.push_back(join(terms, " + "));
+                    }
+                }
+            } else {
+                for (int c = 0; c < count; ++c) {
+                    elements.push_back(argument(operand(0), c) + " * " + argument(operand(1), c));
+                }
+            }
+            break;
+        }
+        case IROp::NEG:
+        case IROp::NOT:
+            for (int c = 0; c < count; ++c) {
+                elements.push_back((inst.op == IROp::NEG ? "-" : "!") + argument(operand(0), c));
+            }
+            break;
+        case IROp::EQ:
+        case IROp::NE: {
+            // Whole vectors
+            std::vector<std::string> parts;
+            int components = std::max(1, componentCount(typeOf(operand(0))));
+            for (int c = 0; c < components; ++c) {
+                parts.push_back(argument(operand(0), c) + (inst.op == IROp::EQ ? " == " : " != ") +
+                                argument(operand(1), c));
+            }
+            elements.push_back(join(parts, inst.op == IROp::EQ ? " && " : " || "));
+            break;
+        }
+        case IROp::SELECT:
+            for (int c = 0; c < count; ++c) {
+                elements.push_back(argument(operand(0), c) + " ? " + argument(operand(1), c) + " : " +
+                                   argument(operand(2), c));
+            }
+            break;
+        case IROp::CONSTRUCT: {
+            Type::Kind source = typeOf(operand(0));
+            if (inst.operandCount == 1 && isMatrix(inst.type) && componentCount(source) == 1) {
+                // Scalar on the diagonal
+                std::string diagonal = convertedElements(operand(0), inst.type)[0];
+                int n = matrixDimension(inst.type);
+                for (int c = 0; c < count; ++c) {
+                    elements.push_back(c % (n + 1) == 0 ? diagonal : "0.0f");
+                }
+            } else if (inst.operandCount == 1 && isMatrix(inst.type) && isMatrix(source)) {
+                // Upper-left part, identity beyond the source
+                int n = matrixDimension(inst.type);
+                int m = matrixDimension(source);
+                for (int column = 0; column < n; ++column) {
+                    for (int row = 0; row < n; ++row) {
+                        elements.push_back(column < m && row < m ? element(operand(0), column * m + row)
+                                                                 : column == row ? "1.0f" : "0.0f");
+                    }
+                }
+            } else {
+                for (uint32_t k = 0; k < inst.operandCount; ++k) {
+                    std::vector<std::string> parts = convertedElements(operand(k), inst.type);
+                    elements.insert(elements.end(), parts.begin(), parts.end());
+                }
+                // A single scalar fills a vector
+                elements.resize(count, elements[0]);
+            }
+            break;
+        }
+        case IROp::EXTRACT: {
+            int n = matrixDimension(typeOf(operand(0)));
+            for (int row = 0; row < n; ++row) {
+                elements.push_back(element(operand(0), static_cast<int>(inst.imm) * n + row));
+            }
+            break;
+        }
+        case IROp::SWIZZLE:
+            for (int c = 0; c < swizzleCount(inst.imm); ++c) {
+                elements.push_back(element(operand(0), swizzleComponent(inst.imm, c)));
+            }
+            break;
+        case IROp::INSERT:
+            for (int c = 0; c < count; ++c) {
+                elements.push_back(element(operand(0), c));
+            }
+            for (int c = 0; c < swizzleCount(inst.imm); ++c) {
+                elements[swizzleComponent(inst.imm, c)] = argument(operand(1), c);
+            }
+            break;
+        case IROp::BUILTIN:
+            elements = builtinElements(value);
+            break;
+        default:
+            throw std::runtime_error(std::string("no host code for ") + irOpName(inst.op));
+    }
+    
+    if (!elements.empty()) {
+        printTemporary(value, elements);
+    }
+}
+
+void HostPrinter::printTemporary(IRValue value, const std::vector<std::string>& elements) {
+    Type::Kind type = function_->instructions[value].type;
+    std::string name = "t" + std::to_string(value);
+    if (elements.size() == 1) {
+        writeLine(1, typeName(type) + " " + name + " = " + elements[0] + ";");
+    } else if (elements.size() <= 4) {
+        writeLine(1, declaration(type, name) + " = {" + join(elements, ", ") + "};");
+    } else {
+        writeLine(1, declaration(type, name) + " = {");
+        for (const auto& part : elements) {
+            writeLine(2, part + ",");
+        }
+        writeLine(1, "};");
+    }
+}
+
+std::vector<std::string> HostPrinter::builtinElements(IRValue value) {
+    const IRInstruction& inst = function_->instructions[value];
+    auto id = static_cast<BuiltinId>(inst.imm);
+    IRValue first = function_->operand(value, 0);
+    int components = std::max(1, componentCount(function_->instructions[first].type));
+    std::string name = "t" + std::to_string(value);
+    auto sum = [&](const std::function<std::string(int)>& term) {
+        std::vector<std::string> terms;
+        for (int c = 0; c < components; ++c) {
+            terms.push_back(term(c));
+        }
+        return join(terms, " + ");
+    };
+    auto at = [&](size_t index, int c) { return element(function_->operand(value, index), c); };
+    auto difference = [&](int c) { return "(" + at(0, c) + " - " + at(1, c) + ")"; };
+    
+    switch (id) {
+        case BuiltinId::DOT:
+            return {sum([&](int c) { return at(0, c) + " * " + at(1, c); })};
+        case BuiltinId::LENGTH:
+            return {"std::sqrt(" + sum([&](int c) { return at(0, c) + " * " + at(0, c); }) + ")"};
+        case BuiltinId::DISTANCE:
+            return {"std::sqrt(" + sum([&](int c) { return difference(c) + " * " + difference(c); }) + ")"};
+        case BuiltinId::NORMALIZE: {
+            writeLine(1, "float " + name + "_length = std::sqrt(" +
+                             sum([&](int c) { return at(0, c) + " * " + at(0, c); }) + ");");
+            std::vector<std::string> elements;
+            for (int c = 0; c < components; ++c) {
+                elements.push_back(at(0, c) + " / " + name + "_length");
+            }
+            return elements;
+        }
+        case BuiltinId::CROSS: {
+            std::vector<std::string> elements;
+            for (int c = 0; c < 3; ++c) {
+                int i = (c + 1) % 3;
+                int j = (c + 2) % 3;
+                elements.push_back(at(0, i) + " * " + at(1, j) + " - " + at(0, j) + " * " + at(1, i));
+            }
+            return elements;
+        }
+        case BuiltinId::TRANSPOSE:
+        case BuiltinId::INVERSE: {
+            int n = matrixDimension(inst.type);
+            std::vector<std::string> elements;
+            for (int column = 0; column < n; ++column) {
+                for (int row = 0; row < n; ++row) {
+                    elements.push_back(id == BuiltinId::TRANSPOSE ? at(0, row * n + column) : at(0, column * n + row));
+                }
+            }
+            if (id == BuiltinId::INVERSE) {
+                // A copy the helper inverts in place
+                printTemporary(value, elements);
+                writeLine(1, "sdlInvert(" + name + ", " + std::to_string(n) + ");");
+                return {};
+            }
+            return elements;
+        }
+        default: {
+            // Componentwise, through the CPU template
+            const BuiltinInfo* info = builtinInfo(id);
+            std::vector<std::string> elements;
+            for (int c = 0; c < std::max(1, componentCount(inst.type)); ++c) {
+                std::vector<std::string> args;
+                for (uint32_t k = 0; k < inst.operandCount; ++k) {
+                    args.push_back(argument(function_->operand(value, k), c));
+                }
+                elements.push_back(lowerBuiltin(info->cpu, args, info->minArgs));
+            }
+            return elements;
+        }
+    }
+}
+
+std::string HostPrinter::declaration(Type::Kind type, const std::string& name) const {
+    int count = componentCount(type);
+    return typeName(type) + " " + name + (count > 1 ? "[" + std::to_string(count) + "]" : "");
+}
+
+std::string HostPrinter::literal(const IRConstant& constant, int component) const {
+    double value = constant.components[std::min(static_cast<size_t>(component), constant.components.size() - 1)];
+    switch (constant.type) {
+        case Type::Kind::BOOL: return value != 0.0 ? "true" : "false";
+        case Type::Kind::INT: return formatInt(value);
+        default: break;
+    }
+    std::string text = formatFloat(value);
+    if (text[0] == '(') {
+        // NaN and infinities have no literal
+        return value != value ? "NAN" : value > 0 ? "INFINITY" : "-INFINITY";
+    }
+    return text + "f";
+}
+
+std::string HostPrinter::element(IRValue value, int component) const {
+    const IRInstruction& inst = function_->instructions[value];
+    if (inst.op == IROp::CONSTANT) {
+        return literal(module_->constants[inst.imm], component);
+    }
+    std::string base = inst.op == IROp::LOAD ? "in." + module_->globals[inst.imm].name : "t" + std::to_string(value);
+    return componentCount(inst.type) > 1 ? base + "[" + std::to_string(component) + "]" : base;
+}
+
+std::string HostPrinter::argument(IRValue value, int component) const {
+    return element(value, componentCount(function_->instructions[value].type) > 1 ? component : 0);
+}
+
+std::vector<std::string> HostPrinter::convertedElements(IRValue value, Type::Kind type) const {
+    Type::Kind source = function_->instructions[value].type;
+    std::vector<std::string> elements;
+    for (int c = 0; c < std::max(1, componentCount(source)); ++c) {
+        std::string text = element(value, c);
+        if (type == Type::Kind::BOOL && source != Type::Kind::BOOL) {
+            text = "(" + text + " != 0)";
+        } else if (typeName(type) != typeName(source)) {
+            text = "static_cast<" + typeName(type) + ">(" + text + ")";
+        }
+        elements.push_back(text);
+    }
+    return elements;
+}
+
+std::string HostPrinter::typeName(Type::Kind type) const {
+    switch (type) {
+        case Type::Kind::BOOL: return "bool";
+        case Type::Kind::INT: return "int";
+        default: return "float";
+    }
+}
+
+std::string HostPrinter::constant(const IRConstant& constant) const {
+    return literal(constant, 0);
+}
+
+std::string HostPrinter::construct(Type::Kind type, const std::vector<std::string>& args) const {
+    return typeName(type) + "(" + join(args, ", ") + ")";
+}
+
+const char* HostPrinter::builtinTemplate(const BuiltinInfo& builtin) const {
+    return builtin.cpu;
+}
+
+} // namespace sdl
@@ -0,0 +1,257 @@
+#include "ir/passes.h"
+#include <algorithm>
+
+namespace sdl {
+
+namespace {
+
+constexpr unsigned WRITES = Effect::WRITES_OUTPUTS | Effect::WRITES_GLOBALS | Effect::WRITES_ARGUMENTS;
+
+class IfConversion {
+public:
+    IfConversion(IRFunction& function, const IRModule& module, const std::vector<unsigned>& effects,
+                 PassContext& context)
+        : function_(function), module_(module), effects_(effects), context_(context) {}
+    
+    bool run() {
+        // Inner ifs first: once flattened, the arm holding them is a single
+        // block and the outer if may follow
+        bool changed = false;
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            std::vector<uint32_t> order = reversePostorder(function_);
+            for (auto it = order.rbegin(); it != order.rend() && !progress; ++it) {
+                progress = convert(*it);
+            }
+            if (progress) {
+                removeUnreachableBlocks(function_);
+                changed = true;
+                ++context_.statistics["if-convert.flattened"];
+            }
+        }
+        return changed;
+    }
+    
+private:
+    IRFunction& function_;
+    const IRModule& module_;
+    const std::vector<unsigned>& effects_;
+    PassContext& context_;
+    
+    const IRInstruction& inst(IRValue value) const { return function_.instructions[value]; }
+    
+    // Operations both arms together may cost before a branch is cheaper
+    int threshold() const {
+        switch (context_.level) {
+            case OptimizationLevel::O3: return 32;
+            case OptimizationLevel::OS: return 8;
+            default: return 16;
+        }
+    }
+    
+    // A single block between the header and the merge, or the merge itself
+    // for a missing arm
+    bool simpleArm(uint32_t header, uint32_t arm, uint32_t merge) const {
+        if (arm == merge) {
+            return true;
+        }
+        const IRBlock& block = function_.blocks[arm];
+        return block.predecessors.size() == 1 && block.predecessors[0] == header &&
+               block.structure == IRStructure::NONE && inst(function_.terminator(arm)).op == IROp::BRANCH &&
+               block.successors[0] == merge;
+    }
+    
+    // Whether the instruction may run although its arm was not taken, and
+    // what running it costs
+    bool speculatable(IRValue value, bool flatten, int& cost) const {
+        const IRInstruction& i = inst(value);
+        switch (i.op) {
+            case IROp::PHI:
+                return false;
+            case IROp::STORE:
+                return i.aux == 0; // Stores of some components would need the rest merged too
+            case IROp::DIV:
+            case IROp::MOD:
+                if (i.type == Type::Kind::INT) {
+                    IRValue divisor = function_.operand(value, 1);
+                    if (inst(divisor).op != IROp::CONSTANT || module_.constants[inst(divisor).imm].components[0] == 0) {
+                        return false;
+                    }
+                }
+                break;
+            case IROp::CALL:
+                if ((effects_[i.imm] & (WRITES | Effect::READS_MUTABLE)) != 0 ||
+                    (!flatten && (effects_[i.imm] & Effect::SAMPLES_TEXTURES) != 0)) {
+                    return false;
+                }
+                break;
+            case IROp::BUILTIN: {
+                const BuiltinInfo* info = builtinInfo(static_cast<BuiltinId>(i.imm));
+                // Fetches are too costly to run for nothing unless asked to
+                if ((info->effects & WRITES) != 0 ||
+                    (!flatten && info->has(BuiltinFlag::TEXTURE_FETCH | BuiltinFlag::DERIVATIVE))) {
+                    return false;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        cost += operationCount(function_, value);
+        return true;
+    }
+    
+    bool convert(uint32_t header) {
+        IRBlock& block = function_.blocks[header];
+        IRValue term = function_.terminator(header);
+        if (block.structure != IRStructure::SELECTION || block.merge == IR_NONE) {
+            return false;
+        }
+        auto control = static_cast<IRBranchControl>(inst(term).imm);
+        bool flatten = control == IRBranchControl::FLATTEN;
+        uint32_t merge = block.merge;
+        uint32_t arms[2] = {block.successors[0], block.successors[1]};
+        if (control == IRBranchControl::BRANCH || (arms[0] == merge && arms[1] == merge) ||
+            !simpleArm(header, arms[0], merge) || !simpleArm(header, arms[1], merge) ||
+            function_.blocks[merge].predecessors.size() != 2) {
+            return false;
+        }
+        
+        // Both arms run from now on; a uniform branch does not diverge and
+        // is left alone unless flattening was asked for
+        int cost = 0;
+        for (uint32_t arm : arms) {
+            if (arm == merge) {
+                continue;
+            }
+            const auto& list = function_.blocks[arm].instructions;
+            for (size_t n = 0; n + 1 < list.size(); ++n) {
+                if (!speculatable(list[n], flatten, cost)) {
+                    return false;
+                }
+            }
+        }
+        if (!flatten && (inst(term).aux == BRANCH_UNIFORM || cost > threshold())) {
+            return false;
+        }
+        
+        IRValue condition = function_.operand(term, 0);
+        auto beforeTerminator = [&](IRValue value) {
+            auto& list = function_.blocks[header].instructions;
+            function_.insert(header, std::find(list.begin(), list.end(), term) - list.begin(), value);
+        };
+        
+        // Arm code moves into the header, then-arm first. Stores are held
+        // back and merged below; loads after a store in the same arm read
+        // the stored value.
+        std::vector<std::pair<uint32_t, IRValue>> stored[2]; // (global, value) in order
+        for (int side = 0; side < 2; ++side) {
+            if (arms[side] == merge) {
+                continue;
+            }
+            std::vector<IRValue> list = function_.blocks[arms[side]].instructions;
+            for (IRValue value : list) {
+                const IRInstruction& i = inst(value);
+                function_.remove(value);
+                if (isTerminator(i.op)) {
+                    continue;
+                }
+                auto last = std::find_if(stored[side].rbegin(), stored[side].rend(),
+                                         [&](const std::pair<uint32_t, IRValue>& s) { return s.first == i.imm; });
+                if (i.op == IROp::STORE) {
+                    stored[side].emplace_back(i.imm, function_.operand(value, 0));
+                } else if (i.op == IROp::LOAD && last != stored[side].rend()) {
+                    function_.replaceAllUses(value, last->second);
+                } else {
+                    beforeTerminator(value);
+                }
+            }
+        }
+        
+        auto select = [&](Type::Kind type, IRValue ifTrue, IRValue ifFalse) {
+            if (ifTrue == ifFalse) {
+                return ifTrue;
+            }
+            IRValue value = function_.create(IROp::SELECT, type, {condition, ifTrue, ifFalse});
+            beforeTerminator(value);
+            return value;
+        };
+        
+        // Phis of the merge choose by the condition instead of the edge
+        IRBlock& join = function_.blocks[merge];
+        size_t thenEdge = join.predecessors[0] == (arms[0] == merge ? header : arms[0]) ? 0 : 1;
+        for (IRValue value : std::vector<IRValue>(join.instructions)) {
+            if (inst(value).op != IROp::PHI) {
+                break;
+            }
+            IRValue chosen = select(inst(value).type, function_.operand(value, thenEdge),
+                                    function_.operand(value, 1 - thenEdge));
+            if (inst(chosen).name == 0) {
+                function_.instructions[chosen].name = inst(value).name;
+            }
+            function_.replaceAllUses(value, chosen);
+            function_.remove(value);
+        }
+        
+        // One store per global either arm wrote, of the value its arm left
+        // there or the one from before the if
+        std::vector<uint32_t> globals;
+        for (const auto& side : stored) {
+            for (const auto& store : side) {
+                if (std::find(globals.begin(), globals.end(), store.first) == globals.end()) {
+                    globals.push_back(store.first);
+                }
+            }
+        }
+        for (uint32_t global : globals) {
+            Type::Kind type = module_.globals[global].type;
+            IRValue values[2] = {IR_NONE, IR_NONE};
+            for (int side = 0; side < 2; ++side) {
+                for (const auto& store : stored[side]) {
+                    if (store.first == global) {
+                        values[side] = store.second;
+                    }
+                }
+                if (values[side] == IR_NONE) {
+                    values[side] = function_.create(IROp::LOAD, type, {}, global);
+                    beforeTerminator(values[side]);
+                }
+            }
+            IRValue value = select(type, values[0], values[1]);
+            beforeTerminator(function_.create(IROp::STORE, Type::Kind::VOID, {value}, global));
+        }
+        
+        // The header now falls through to the merge
+        function_.remove(term);
+        function_.append(header, IROp::BRANCH, Type::Kind::VOID);
+        IRBlock& head = function_.blocks[header];
+        head.successors[0] = merge;
+        head.successors[1] = IR_NONE;
+        head.structure = IRStructure::NONE;
+        head.merge = IR_NONE;
+        function_.blocks[merge].predecessors = {header};
+        for (uint32_t arm : arms) {
+            if (arm != merge) {
+                function_.blocks[arm].predecessors.clear();
+                function_.blocks[arm].successors[0] = IR_NONE;
+            }
+        }
+        return true;
+    }
+};
+
+} // anonymous namespace
+
+bool convertBranchesToSelects(IRModule& module, PassContext& context) {
+    std::vector<unsigned> effects = functionEffects(module);
+    bool changed = false;
+    for (auto& function : module.functions) {
+        if (!function.blocks.empty()) {
+            changed |= IfConversion(function, module, effects, context).run();
+        }
+    }
+    return changed;
+}
+
+} // namespace sdl
@@ -0,0 +1,358 @@
+#include "ir/passes.h"
+#include "semantic/types.h"
+#include <algorithm>
+#include <map>
+
+namespace sdl {
+
+namespace {
+
+int functionSize(const IRFunction& function) {
+    int size = 0;
+    for (const auto& block : function.blocks) {
+        for (IRValue value : block.instructions) {
+            size += operationCount(function, value);
+        }
+    }
+    return size;
+}
+
+// The single RETURN of a function, if it sits outside every if and loop so
+// that turning it into a branch keeps the caller structured
+IRValue outermostReturn(const IRFunction& function) {
+    IRValue found = IR_NONE;
+    for (const auto& block : function.blocks) {
+        for (IRValue value : block.instructions) {
+            if (function.instructions[value].op == IROp::RETURN) {
+                if (found != IR_NONE) {
+                    return IR_NONE;
+                }
+                found = value;
+            }
+        }
+    }
+    if (found == IR_NONE) {
+        return IR_NONE;
+    }
+    
+    // Follow the top-level chain of blocks, stepping over constructs
+    uint32_t block = 0;
+    for (size_t steps = 0; steps <= function.blocks.size(); ++steps) {
+        if (block == function.instructions[found].block) {
+            return found;
+        }
+        const IRBlock& current = function.blocks[block];
+        if (current.structure != IRStructure::NONE) {
+            block = current.merge;
+        } else if (function.terminator(block) != IR_NONE &&
+                   function.instructions[function.terminator(block)].op == IROp::BRANCH) {
+            block = current.successors[0];
+        } else {
+            return IR_NONE;
+        }
+        if (block == IR_NONE) {
+            return IR_NONE;
+        }
+    }
+    return IR_NONE;
+}
+
+class Inliner {
+public:
+    Inliner(IRModule& module, PassContext& context) : module_(module), context_(context) {}
+    
+    bool run() {
+        countCallSites();
+        int size = 0;
+        for (const auto& function : module_.functions) {
+            size += functionSize(function);
+        }
+        budget_ = growthBudget(size);
+        
+        // Callees first, so a caller sees their size after their own inlining
+        std::vector<uint32_t> order = bottomUpOrder();
+        int inlined = 0;
+        for (uint32_t caller : order) {
+            bool progress = true;
+            while (progress) {
+                progress = false;
+                IRFunction& function = module_.functions[caller];
+                for (uint32_t b = 0; b < function.blocks.size() && !progress; ++b) {
+                    for (IRValue value : function.blocks[b].instructions) {
+                        const IRInstruction& inst = function.instructions[value];
+                        if (inst.op == IROp::CALL && shouldInline(function, inst.imm)) {
+                            inlineCall(caller, value);
+                            ++inlined;
+                            progress = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        context_.statistics["inline.calls"] += inlined;
+        return inlined > 0;
+    }
+    
+private:
+    IRModule& module_;
+    PassContext& context_;
+    std::vector<int> callSites_;
+    std::vector<bool> recursive_; // Reaches itself through its calls
+    int budget_ = 0; // Operations the module may still grow by
+    
+    int growthBudget(int size) const {
+        switch (context_.level) {
+            case OptimizationLevel::O3: return size * 2;
+            case OptimizationLevel::OS: return 0;
+            default: return size / 2;
+        }
+    }
+    
+    // Callees at most this big are inlined everywhere the budget allows
+    int threshold() const {
+        switch (context_.level) {
+            case OptimizationLevel::O3: return 120;
+            case OptimizationLevel::OS: return 4;
+            default: return 40;
+        }
+    }
+    
+    std::vector<uint32_t> callees(uint32_t f) const {
+        std::vector<uint32_t> result;
+        const IRFunction& function = module_.functions[f];
+        for (const auto& block : function.blocks) {
+            for (IRValue value : block.instructions) {
+                if (function.instructions[value].op == IROp::CALL) {
+                    result.push_back(function.instructions[value].imm);
+                }
+            }
+        }
+        return result;
+    }
+    
+    void countCallSites() {
+        size_t count = module_.functions.size();
+        callSites_.assign(count, 0);
+        std::vector<std::vector<uint32_t>> calls(count);
+        for (uint32_t f = 0; f < count; ++f) {
+            calls[f] = callees(f);
+            for (uint32_t callee : calls[f]) {
+                ++callSites_[callee];
+            }
+        }
+        
+        recursive_.assign(count, false);
+        for (uint32_t f = 0; f < count; ++f) {
+            std::vector<bool> seen(count, false);
+            std::vector<uint32_t> work(calls[f]);
+            while (!work.empty() && !recursive_[f]) {
+                uint32_t g = work.back();
+                work.pop_back();
+                if (seen[g]) {
+                    continue;
+                }
+                seen[g] = true;
+                recursive_[f] = g == f;
+                work.insert(work.end(), calls[g].begin(), calls[g].end());
+            }
+        }
+    }
+    
+    std::vector<uint32_t> bottomUpOrder() const {
+        std::vector<uint32_t> order;
+        std::vector<int> state(module_.functions.size(), 0); // 0 new, 1 on stack, 2 done
+        std::vector<std::pair<uint32_t, std::vector<uint32_t>>> stack;
+        for (uint32_t root = 0; root < module_.functions.size(); ++root) {
+            if (state[root] != 0) {
+                continue;
+            }
+            state[root] = 1;
+            stack.emplace_back(root, callees(root));
+            while (!stack.empty()) {
+                auto& top = stack.back();
+                if (!top.second.empty()) {
+                    uint32_t callee = top.second.back();
+                    top.second.pop_back();
+                    if (state[callee] == 0) {
+                        state[callee] = 1;
+                        stack.emplace_back(callee, callees(callee));
+                    }
+                    continue;
+                }
+                state[top.first] = 2;
+                order.push_back(top.first);
+                stack.pop_back();
+            }
+        }
+        return order;
+    }
+    
+    bool shouldInline(const IRFunction& caller, uint32_t callee) {
+        const IRFunction& function = module_.functions[callee];
+        if (function.inlineHint == IRInlineHint::NEVER || function.entryPoint || recursive_[callee] ||
+            function.blocks.empty() || outermostReturn(function) == IR_NONE) {
+            return false;
+        }
+        // The body would be printed under the caller's fast-math setting
+        if (function.fastMath != caller.fastMath) {
+            return false;
+        }
+        if (function.inlineHint == IRInlineHint::ALWAYS) {
+            return true;
+        }
+        
+        // The last call of a function costs nothing: the body moves instead
+        // of being copied
+        int size = functionSize(function);
+        if (callSites_[callee] == 1) {
+            return true;
+        }
+        int overhead = 1 + static_cast<int>(function.parameters.size());
+        if (size <= overhead) {
+            return true;
+        }
+        if (size > threshold() || size > budget_) {
+            return false;
+        }
+        budget_ -= size;
+        return true;
+    }
+    
+    IRValue constantIn(IRFunction& function, uint32_t constant) {
+        for (IRValue value : function.blocks[0].instructions) {
+            const IRInstruction& inst = function.instructions[value];
+            if (inst.op == IROp::CONSTANT && inst.imm == constant) {
+                return value;
+            }
+        }
+        IRValue value = function.create(IROp::CONSTANT, module_.constants[constant].type, {}, constant);
+        function.insert(0, 0, value);
+        return value;
+    }
+    
+    void inlineCall(uint32_t callerIndex, IRValue call) {
+        IRFunction& caller = module_.functions[callerIndex];
+        const IRFunction& callee = module_.functions[caller.instructions[call].imm];
+        --callSites_[caller.instructions[call].imm];
+        std::vector<IRValue> arguments(caller.operandsOf(call),
+                                       caller.operandsOf(call) + caller.instructions[call].operandCount);
+        
+        // Split the block after the call; the continuation takes over its
+        // successors and whatever construct its terminator opens
+        uint32_t block = caller.instructions[call].block;
+        uint32_t continuation = caller.addBlock();
+        {
+            auto& list = caller.blocks[block].instructions;
+            auto at = std::find(list.begin(), list.end(), call);
+            std::vector<IRValue> moved(at + 1, list.end());
+            list.erase(at, list.end());
+            caller.instructions[call].block = IR_NONE;
+            for (IRValue value : moved) {
+                caller.insert(continuation, caller.blocks[continuation].instructions.size(), value);
+            }
+        }
+        IRBlock& head = caller.blocks[block];
+        IRBlock& tail = caller.blocks[continuation];
+        std::copy(std::begin(head.successors), std::end(head.successors), std::begin(tail.successors));
+        tail.structure = head.structure;
+        tail.merge = head.merge;
+        tail.continueTarget = head.continueTarget;
+        head.structure = IRStructure::NONE;
+        head.merge = head.continueTarget = IR_NONE;
+        head.successors[0] = head.successors[1] = IR_NONE;
+        for (uint32_t succ : tail.successors) {
+            if (succ != IR_NONE) {
+                auto& preds = caller.blocks[succ].predecessors;
+                std::replace(preds.begin(), preds.end(), block, continuation);
+            }
+        }
+        for (auto& other : caller.blocks) {
+            if (other.continueTarget == block) {
+                other.continueTarget = continuation; // The back edge now leaves from the continuation
+            }
+        }
+        
+        // Copy the callee's blocks, then its instructions with operands remapped
+        uint32_t base = static_cast<uint32_t>(caller.blocks.size());
+        for (size_t b = 0; b < callee.blocks.size(); ++b) {
+            caller.addBlock();
+        }
+        auto mapBlock = [&](uint32_t b) { return b == IR_NONE ? IR_NONE : base + b; };
+        
+        std::map<IRValue, IRValue> values;
+        IRValue returned = IR_NONE;
+        uint32_t returnBlock = IR_NONE;
+        for (size_t b = 0; b < callee.blocks.size(); ++b) {
+            const IRBlock& source = callee.blocks[b];
+            IRBlock& target = caller.blocks[base + b];
+            for (uint32_t pred : source.predecessors) {
+                target.predecessors.push_back(mapBlock(pred));
+            }
+            target.successors[0] = mapBlock(source.successors[0]);
+            target.successors[1] = mapBlock(source.successors[1]);
+            target.structure = source.structure;
+            target.merge = mapBlock(source.merge);
+            target.continueTarget = mapBlock(source.continueTarget);
+            
+            for (IRValue value : source.instructions) {
+                const IRInstruction& inst = callee.instructions[value];
+                if (inst.op == IROp::PARAMETER) {
+                    values[value] = arguments[inst.imm];
+                    continue;
+                }
+                if (inst.op == IROp::CONSTANT) {
+                    values[value] = constantIn(caller, inst.imm);
+                    continue;
+                }
+                if (inst.op == IROp::RETURN) {
+                    returned = inst.operandCount ? callee.operand(value, 0) : IR_NONE;
+                    returnBlock = base + static_cast<uint32_t>(b);
+                    caller.append(returnBlock, IROp::BRANCH, Type::Kind::VOID);
+                    continue;
+                }
+                IRValue copy = caller.append(base + static_cast<uint32_t>(b), inst.op, inst.type,
+                                             std::vector<IRValue>(inst.operandCount, IR_NONE), inst.imm);
+                caller.instructions[copy].aux = inst.aux;
+                caller.instructions[copy].line = inst.line;
+                caller.instructions[copy].column = inst.column;
+                caller.instructions[copy].name = inst.name ? caller.internName(callee.names[inst.name]) : 0;
+                values[value] = copy;
+            }
+        }
+        for (const auto& entry : values) {
+            IRValue copy = entry.second;
+            if (caller.instructions[copy].block < base) {
+                continue; // An argument or a constant of the caller
+            }
+            const IRInstruction& inst = callee.instructions[entry.first];
+            std::vector<IRValue> operands;
+            for (uint32_t i = 0; i < inst.operandCount; ++i) {
+                operands.push_back(values.at(callee.operand(entry.first, i)));
+            }
+            caller.setOperands(copy, operands);
+        }
+        
+        caller.append(block, IROp::BRANCH, Type::Kind::VOID);
+        caller.blocks[block].successors[0] = base;
+        caller.blocks[base].predecessors.push_back(block);
+        caller.blocks[returnBlock].successors[0] = continuation;
+        caller.blocks[continuation].predecessors.push_back(returnBlock);
+        
+        if (returned != IR_NONE) {
+            IRValue result = values.at(returned);
+            if (caller.instructions[result].name == 0) {
+                caller.instructions[result].name = caller.instructions[call].name;
+            }
+            caller.replaceAllUses(call, result);
+        }
+    }
+};
+
+} // anonymous namespace
+
+bool inlineFunctions(IRModule& module, PassContext& context) {
+    return Inliner(module, context).run();
+}
+
+} // namespace sdl
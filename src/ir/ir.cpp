@@ -0,0 +1,954 @@
+#include "ir/ir.h"
+#include "semantic/types.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <unordered_set>
+
+namespace sdl {
+
+uint32_t IRFunction::addBlock() {
+    blocks.emplace_back();
+    return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+IRValue IRFunction::create(IROp op, Type::Kind type, const std::vector<IRValue>& args, uint32_t imm) {
+    IRInstruction inst;
+    inst.op = op;
+    inst.type = type;
+    inst.firstOperand = static_cast<uint32_t>(operands.size());
+    inst.operandCount = static_cast<uint32_t>(args.size());
+    inst.imm = imm;
+    operands.insert(operands.end(), args.begin(), args.end());
+    instructions.push_back(inst);
+    return static_cast<IRValue>(instructions.size() - 1);
+}
+
+IRValue IRFunction::append(uint32_t block, IROp op, Type::Kind type, const std::vector<IRValue>& args,
+                           uint32_t imm) {
+    IRValue value = create(op, type, args, imm);
+    instructions[value].block = block;
+    blocks[block].instructions.push_back(value);
+    return value;
+}
+
+void IRFunction::insert(uint32_t block, size_t index, IRValue value) {
+    auto& list = blocks[block].instructions;
+    list.insert(list.begin() + static_cast<std::ptrdiff_t>(std::min(index, list.size())), value);
+    instructions[value].block = block;
+}
+
+void IRFunction::remove(IRValue value) {
+    uint32_t block = instructions[value].block;
+    if (block == IR_NONE) {
+        return;
+    }
+    auto& list = blocks[block].instructions;
+    list.erase(std::find(list.begin(), list.end(), value));
+    instructions[value].block = IR_NONE;
+}
+
+void IRFunction::setOperands(IRValue value, const std::vector<IRValue>& args) {
+    IRInstruction& inst = instructions[value];
+    if (args.size() > inst.operandCount) {
+        // Does not fit the old slot: move to the end of the pool
+        inst.firstOperand = static_cast<uint32_t>(operands.size());
+        operands.insert(operands.end(), args.begin(), args.end());
+    } else {
+        std::copy(args.begin(), args.end(), operands.begin() + inst.firstOperand);
+    }
+    inst.operandCount = static_cast<uint32_t>(args.size());
+}
+
+const IRInstruction* IRFunction::terminatorOf(uint32_t block) const {
+    IRValue value = terminator(block);
+    return value == IR_NONE ? nullptr : &instructions[value];
+}
+
+IRValue IRFunction::terminator(uint32_t block) const {
+    const auto& list = blocks[block].instructions;
+    if (list.empty() || !isTerminator(instructions[list.back()].op)) {
+        return IR_NONE;
+    }
+    return list.back();
+}
+
+void IRFunction::branch(uint32_t from, uint32_t to) {
+    append(from, IROp::BRANCH, Type::Kind::VOID);
+    blocks[from].successors[0] = to;
+    blocks[from].successors[1] = IR_NONE;
+    blocks[to].predecessors.push_back(from);
+}
+
+void IRFunction::condBranch(uint32_t from, IRValue condition, uint32_t ifTrue, uint32_t ifFalse, uint32_t hint) {
+    IRValue value = append(from, IROp::COND_BRANCH, Type::Kind::VOID, {condition});
+    instructions[value].aux = hint;
+    blocks[from].successors[0] = ifTrue;
+    blocks[from].successors[1] = ifFalse;
+    blocks[ifTrue].predecessors.push_back(from);
+    blocks[ifFalse].predecessors.push_back(from);
+}
+
+uint32_t IRFunction::internName(const std::string& name) {
+    if (name.empty()) {
+        return 0;
+    }
+    auto it = std::find(names.begin(), names.end(), name);
+    if (it != names.end()) {
+        return static_cast<uint32_t>(it - names.begin());
+    }
+    names.push_back(name);
+    return static_cast<uint32_t>(names.size() - 1);
+}
+
+void IRFunction::replaceAllUses(IRValue from, IRValue to) {
+    for (const auto& block : blocks) {
+        for (IRValue value : block.instructions) {
+            IRValue* args = operandsOf(value);
+            for (uint32_t i = 0; i < instructions[value].operandCount; ++i) {
+                if (args[i] == from) {
+                    args[i] = to;
+                }
+            }
+        }
+    }
+}
+
+std::vector<uint32_t> IRFunction::useCounts() const {
+    std::vector<uint32_t> counts(instructions.size(), 0);
+    for (const auto& block : blocks) {
+        for (IRValue value : block.instructions) {
+            const IRValue* args = operandsOf(value);
+            for (uint32_t i = 0; i < instructions[value].operandCount; ++i) {
+                ++counts[args[i]];
+            }
+        }
+    }
+    return counts;
+}
+
+uint32_t IRModule::constant(Type::Kind type, const std::vector<double>& components) {
+    std::vector<uint64_t> bits(components.size());
+    for (size_t i = 0; i < components.size(); ++i) {
+        // -0.0 and 0.0 stay distinct; every NaN of the same pattern is one constant
+        std::memcpy(&bits[i], &components[i], sizeof(double));
+    }
+    
+    auto key = std::make_pair(type, std::move(bits));
+    auto it = constantIndex_.find(key);
+    if (it != constantIndex_.end()) {
+        return it->second;
+    }
+    
+    constants.push_back({type, components});
+    uint32_t index = static_cast<uint32_t>(constants.size() - 1);
+    constantIndex_.emplace(std::move(key), index);
+    return index;
+}
+
+bool isTerminator(IROp op) {
+    return op == IROp::BRANCH || op == IROp::COND_BRANCH || op == IROp::RETURN;
+}
+
+const char* irOpName(IROp op) {
+    switch (op) {
+        case IROp::CONSTANT: return "const";
+        case IROp::PARAMETER: return "param";
+        case IROp::LOAD: return "load";
+        case IROp::PHI: return "phi";
+        case IROp::ADD: return "add";
+        case IROp::SUB: return "sub";
+        case IROp::MUL: return "mul";
+        case IROp::DIV: return "div";
+        case IROp::MOD: return "mod";
+        case IROp::NEG: return "neg";
+        case IROp::EQ: return "eq";
+        case IROp::NE: return "ne";
+        case IROp::LT: return "lt";
+        case IROp::LE: return "le";
+        case IROp::GT: return "gt";
+        case IROp::GE: return "ge";
+        case IROp::AND: return "and";
+        case IROp::OR: return "or";
+        case IROp::NOT: return "not";
+        case IROp::SELECT: return "select";
+        case IROp::CONSTRUCT: return "construct";
+        case IROp::EXTRACT: return "extract";
+        case IROp::SWIZZLE: return "swizzle";
+        case IROp::INSERT: return "insert";
+        case IROp::BUILTIN: return "builtin";
+        case IROp::CALL: return "call";
+        case IROp::STORE: return "store";
+        case IROp::BRANCH: return "br";
+        case IROp::COND_BRANCH: return "condbr";
+        case IROp::RETURN: return "ret";
+    }
+    return "?";
+}
+
+uint32_t packSwizzle(const std::vector<int>& components) {
+    uint32_t packed = static_cast<uint32_t>(components.size());
+    for (size_t i = 0; i < components.size() && i < 4; ++i) {
+        packed |= static_cast<uint32_t>(components[i] & 3) << (3 + 2 * i);
+    }
+    return packed;
+}
+
+int swizzleCount(uint32_t swizzle) {
+    return static_cast<int>(swizzle & 7);
+}
+
+int swizzleComponent(uint32_t swizzle, int index) {
+    return static_cast<int>((swizzle >> (3 + 2 * index)) & 3);
+}
+
+std::vector<unsigned> functionEffects(const IRModule& module) {
+    std::vector<unsigned> effects(module.functions.size(), Effect::NONE);
+    
+    // Calls pull in the callee's effects; repeat until nothing grows
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t f = 0; f < module.functions.size(); ++f) {
+            const IRFunction& function = module.functions[f];
+            unsigned found = effects[f];
+            for (const auto& block : function.blocks) {
+                for (IRValue value : block.instructions) {
+                    const IRInstruction& inst = function.instructions[value];
+                    if (inst.op == IROp::LOAD || inst.op == IROp::STORE) {
+                        auto qualifier = module.globals[inst.imm].qualifier;
+                        if (inst.op == IROp::STORE) {
+                            found |= qualifier == VariableDeclaration::Qualifier::OUT ? Effect::WRITES_OUTPUTS
+                                                                                       : Effect::WRITES_GLOBALS;
+                        } else if (qualifier == VariableDeclaration::Qualifier::UNIFORM) {
+                            found |= Effect::READS_UNIFORMS;
+                        } else if (qualifier == VariableDeclaration::Qualifier::IN) {
+                            found |= Effect::READS_INPUTS;
+                        } else if (qualifier != VariableDeclaration::Qualifier::CONST) {
+                            found |= Effect::READS_MUTABLE;
+                        }
+                    } else if (inst.op == IROp::BUILTIN) {
+                        if (const BuiltinInfo* info = builtinInfo(static_cast<BuiltinId>(inst.imm))) {
+                            found |= info->effects;
+                        }
+                    } else if (inst.op == IROp::CALL) {
+                        found |= effects[inst.imm];
+                    }
+                }
+            }
+            if (found != effects[f]) {
+                effects[f] = found;
+                changed = true;
+            }
+        }
+    }
+    return effects;
+}
+
+int operationCount(const IRFunction& function, IRValue value) {
+    const IRInstruction& inst = function.instructions[value];
+    switch (inst.op) {
+        case IROp::CONSTANT:
+        case IROp::PARAMETER:
+        case IROp::PHI:
+        case IROp::BRANCH:
+        case IROp::SWIZZLE:
+        case IROp::EXTRACT:
+            return 0;
+        case IROp::CONSTRUCT:
+        case IROp::INSERT:
+        case IROp::LOAD:
+        case IROp::STORE:
+        case IROp::COND_BRANCH:
+        case IROp::RETURN:
+            return 1;
+        case IROp::CALL:
+            return 1 + static_cast<int>(inst.operandCount);
+        case IROp::BUILTIN: {
+            const BuiltinInfo* info = builtinInfo(static_cast<BuiltinId>(inst.imm));
+            int components = inst.operandCount > 0
+                ? std::max(1, componentCount(function.instructions[function.operand(value, 0)].type))
+                : 1;
+            const BuiltinCost& cost = info->cost;
+            return (cost.aluPerComponent + cost.transcendentalPerComponent) * components + cost.aluFixed +
+                   cost.transcendentalFixed + cost.textureFetches;
+        }
+        default: {
+            int components = std::max(1, componentCount(inst.type));
+            if (inst.op == IROp::MUL && inst.operandCount == 2 &&
+                isMatrix(function.instructions[function.operand(value, 0)].type)) {
+                components *= matrixDimension(function.instructions[function.operand(value, 0)].type);
+            }
+            return components;
+        }
+    }
+}
+
+std::vector<uint32_t> reversePostorder(const IRFunction& function) {
+    std::vector<uint32_t> order;
+    if (function.blocks.empty()) {
+        return order;
+    }
+    
+    // Iterative DFS; the second field is the next successor to visit
+    std::vector<bool> visited(function.blocks.size(), false);
+    std::vector<std::pair<uint32_t, int>> stack{{0, 0}};
+    visited[0] = true;
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (top.second < 2) {
+            uint32_t succ = function.blocks[top.first].successors[top.second++];
+            if (succ != IR_NONE && !visited[succ]) {
+                visited[succ] = true;
+                stack.emplace_back(succ, 0);
+            }
+            continue;
+        }
+        order.push_back(top.first);
+        stack.pop_back();
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+std::vector<uint32_t> immediateDominators(const IRFunction& function) {
+    // Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+    std::vector<uint32_t> order = reversePostorder(function);
+    std::vector<uint32_t> position(function.blocks.size(), IR_NONE);
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        position[order[i]] = i;
+    }
+    
+    std::vector<uint32_t> idom(function.blocks.size(), IR_NONE);
+    if (order.empty()) {
+        return idom;
+    }
+    idom[0] = 0;
+    auto intersect = [&](uint32_t a, uint32_t b) {
+        while (a != b) {
+            while (position[a] > position[b]) a = idom[a];
+            while (position[b] > position[a]) b = idom[b];
+        }
+        return a;
+    };
+    
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < order.size(); ++i) {
+            uint32_t block = order[i];
+            uint32_t dominator = IR_NONE;
+            for (uint32_t pred : function.blocks[block].predecessors) {
+                if (idom[pred] == IR_NONE) {
+                    continue; // Not processed yet, or unreachable
+                }
+                dominator = dominator == IR_NONE ? pred : intersect(pred, dominator);
+            }
+            if (dominator != idom[block]) {
+                idom[block] = dominator;
+                changed = true;
+            }
+        }
+    }
+    idom[0] = IR_NONE;
+    return idom;
+}
+
+void removeUnreachableBlocks(IRFunction& function) {
+    if (function.blocks.empty()) {
+        return;
+    }
+    
+    std::vector<bool> reachable(function.blocks.size(), false);
+    std::vector<uint32_t> worklist{0};
+    reachable[0] = true;
+    while (!worklist.empty()) {
+        uint32_t block = worklist.back();
+        worklist.pop_back();
+        for (uint32_t succ : function.blocks[block].successors) {
+            if (succ != IR_NONE && !reachable[succ]) {
+                reachable[succ] = true;
+                worklist.push_back(succ);
+            }
+        }
+    }
+    
+    std::vector<uint32_t> renumbered(function.blocks.size(), IR_NONE);
+    uint32_t next = 0;
+    for (size_t b = 0; b < function.blocks.size(); ++b) {
+        if (reachable[b]) {
+            renumbered[b] = next++;
+        }
+    }
+    if (next == function.blocks.size()) {
+        return;
+    }
+    
+    auto remap = [&](uint32_t block) { return block == IR_NONE ? IR_NONE : renumbered[block]; };
+    
+    std::vector<IRBlock> kept;
+    kept.reserve(next);
+    for (size_t b = 0; b < function.blocks.size(); ++b) {
+        IRBlock& block = function.blocks[b];
+        if (!reachable[b]) {
+            for (IRValue value : block.instructions) {
+                function.instructions[value].block = IR_NONE;
+            }
+            continue;
+        }
+        
+        // Drop incoming edges from removed blocks, with their phi operands
+        std::vector<size_t> live;
+        for (size_t i = 0; i < block.predecessors.size(); ++i) {
+            if (reachable[block.predecessors[i]]) {
+                live.push_back(i);
+            }
+        }
+        if (live.size() != block.predecessors.size()) {
+            for (IRValue value : block.instructions) {
+                if (function.instructions[value].op != IROp::PHI) {
+                    continue;
+                }
+                std::vector<IRValue> args;
+                for (size_t i : live) {
+                    args.push_back(function.operand(value, i));
+                }
+                function.setOperands(value, args);
+            }
+        }
+        std::vector<uint32_t> preds;
+        for (size_t i : live) {
+            preds.push_back(renumbered[block.predecessors[i]]);
+        }
+        block.predecessors = std::move(preds);
+        
+        for (uint32_t& succ : block.successors) {
+            succ = remap(succ);
+        }
+        block.merge = remap(block.merge);
+        block.continueTarget = remap(block.continueTarget);
+        if (block.structure == IRStructure::LOOP && block.continueTarget == IR_NONE) {
+            block.structure = IRStructure::SELECTION;
+        }
+        
+        for (IRValue value : block.instructions) {
+            function.instructions[value].block = renumbered[b];
+        }
+        kept.push_back(std::move(block));
+    }
+    function.blocks = std::move(kept);
+}
+
+void removeTrivialPhis(IRFunction& function) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto& block : function.blocks) {
+            std::vector<IRValue> phis;
+            for (IRValue value : block.instructions) {
+                if (function.instructions[value].op == IROp::PHI) {
+                    phis.push_back(value);
+                }
+            }
+            
+            for (IRValue phi : phis) {
+                IRValue same = IR_NONE;
+                bool trivial = true;
+                for (uint32_t i = 0; i < function.instructions[phi].operandCount; ++i) {
+                    IRValue arg = function.operand(phi, i);
+                    if (arg == phi || arg == same) {
+                        continue;
+                    }
+                    if (same != IR_NONE) {
+                        trivial = false;
+                        break;
+                    }
+                    same = arg;
+                }
+                if (!trivial || same == IR_NONE) {
+                    continue;
+                }
+                
+                if (function.instructions[same].name == 0) {
+                    function.instructions[same].name = function.instructions[phi].name;
+                }
+                function.remove(phi);
+                function.replaceAllUses(phi, same);
+                changed = true;
+            }
+        }
+    }
+}
+
+IRValue appendToPreshader(IRModule& module, uint32_t shader, IROp op, Type::Kind type,
+                          const std::vector<IRValue>& args, uint32_t imm, uint32_t aux) {
+    IRFunction& preshader = module.shaders[shader].preshader;
+    if (preshader.blocks.empty()) {
+        preshader.name = module.shaders[shader].name + "_preshader";
+        preshader.shader = shader;
+        preshader.append(preshader.addBlock(), IROp::RETURN, Type::Kind::VOID);
+    }
+    
+    // The preshader is one straight-line block that never reads back a
+    // uniform it stores, so any equal computation already in it can serve
+    if (op != IROp::STORE) {
+        for (IRValue existing : preshader.blocks[0].instructions) {
+            const IRInstruction& i = preshader.instructions[existing];
+            if (i.op == op && i.type == type && i.imm == imm && i.aux == aux && i.operandCount == args.size() &&
+                std::equal(args.begin(), args.end(), preshader.operands.begin() + i.firstOperand)) {
+                return existing;
+            }
+        }
+    }
+    IRValue value = preshader.create(op, type, args, imm);
+    preshader.instructions[value].aux = aux;
+    preshader.insert(0, preshader.blocks[0].instructions.size() - 1, value);
+    return value;
+}
+
+namespace {
+
+// Longest name built from an expression before falling back to a numbered one
+constexpr size_t kMaxExpressionName = 48;
+
+// The distinct uniforms and builtins a preshader value combines, once each in
+// first-seen order, such as normalize_lightPosition or projectionMatrix_viewMatrix
+std::string expressionName(const IRModule& module, const IRFunction& preshader, IRValue value) {
+    std::vector<bool> visited(preshader.instructions.size(), false);
+    std::unordered_set<std::string> seen;
+    std::string name;
+    std::vector<IRValue> stack = {value};
+    while (!stack.empty() && name.size() <= kMaxExpressionName) {
+        IRValue v = stack.back();
+        stack.pop_back();
+        if (visited[v]) {
+            continue;
+        }
+        visited[v] = true;
+        
+        const IRInstruction& i = preshader.instructions[v];
+        std::string part = i.op == IROp::LOAD      ? module.globals[i.imm].name
+                           : i.op == IROp::BUILTIN ? builtinInfo(static_cast<BuiltinId>(i.imm))->name
+                                                   : "";
+        if (!part.empty() && seen.insert(part).second) {
+            name += (name.empty() ? "" : "_") + part;
+        }
+        // Pushed in reverse so the first operand is named first
+        for (uint32_t k = i.operandCount; k-- > 0;) {
+            stack.push_back(preshader.operand(v, k));
+        }
+    }
+    return name;
+}
+
+} // anonymous namespace
+
+uint32_t addDerivedUniform(IRModule& module, uint32_t shader, const std::string& name, IRValue value) {
+    const IRFunction& preshader = module.shaders[shader].preshader;
+    for (IRValue existing : preshader.blocks[0].instructions) {
+        const IRInstruction& i = preshader.instructions[existing];
+        if (i.op == IROp::STORE && preshader.operand(existing, 0) == value) {
+            return i.imm;
+        }
+    }
+    
+    std::string base = name.empty() ? expressionName(module, module.shaders[shader].preshader, value) : name;
+    bool numbered = base.empty() || base.size() > kMaxExpressionName;
+    if (numbered) {
+        base = module.shaders[shader].name + "_derived_";
+    }
+    std::string unique = numbered ? base + "1" : base;
+    for (int suffix = 2; std::any_of(module.globals.begin(), module.globals.end(),
+                                     [&](const IRGlobal& global) { return global.name == unique; });
+         ++suffix) {
+        unique = base + std::to_string(suffix);
+    }
+    
+    IRGlobal global;
+    global.name = unique;
+    global.type = module.shaders[shader].preshader.instructions[value].type;
+    global.qualifier = VariableDeclaration::Qualifier::UNIFORM;
+    global.shader = shader;
+    uint32_t index = static_cast<uint32_t>(module.globals.size());
+    module.globals.push_back(global);
+    appendToPreshader(module, shader, IROp::STORE, Type::Kind::VOID, {value}, index);
+    
+    auto& items = module.shaders[shader].items;
+    auto after = items.begin();
+    for (auto it = items.begin(); it != items.end(); ++it) {
+        if (it->kind == IRItem::Kind::GLOBAL &&
+            module.globals[it->index].qualifier == VariableDeclaration::Qualifier::UNIFORM) {
+            after = it + 1;
+        }
+    }
+    items.insert(after, IRItem{IRItem::Kind::GLOBAL, index});
+    return index;
+}
+
+int specializeConstant(IRModule& module, const std::string& name, double value) {
+    int changed = 0;
+    for (size_t g = 0; g < module.globals.size(); ++g) {
+        IRGlobal& global = module.globals[g];
+        bool scalar = global.type == Type::Kind::BOOL || global.type == Type::Kind::INT ||
+                      global.type == Type::Kind::FLOAT;
+        if (global.name != name || global.qualifier != VariableDeclaration::Qualifier::CONST || !scalar) {
+            continue;
+        }
+        
+        double converted = global.type == Type::Kind::BOOL  ? (value != 0 ? 1.0 : 0.0)
+                           : global.type == Type::Kind::INT ? std::trunc(value)
+                                                            : static_cast<double>(static_cast<float>(value));
+        uint32_t constant = module.constant(global.type, {converted});
+        if (global.initializer == IR_NONE) {
+            IRFunction function;
+            function.name = name + "_init";
+            function.returnType = global.type;
+            function.shader = global.shader;
+            function.initializer = true;
+            global.initializer = static_cast<uint32_t>(module.functions.size());
+            module.functions.push_back(std::move(function));
+        }
+        
+        // The initializer becomes `return constant;`
+        IRFunction& initializer = module.functions[global.initializer];
+        initializer.instructions.clear();
+        initializer.operands.clear();
+        initializer.blocks.clear();
+        uint32_t block = initializer.addBlock();
+        IRValue result = initializer.append(block, IROp::CONSTANT, global.type, {}, constant);
+        initializer.append(block, IROp::RETURN, Type::Kind::VOID, {result});
+        ++changed;
+    }
+    return changed;
+}
+
+namespace {
+
+std::string verifyFunction(const IRModule& module, const IRFunction& function) {
+    auto where = [&](size_t block) {
+        return function.name + ", block " + std::to_string(block) + ": ";
+    };
+    
+    if (function.blocks.empty()) {
+        return function.name + ": no entry block";
+    }
+    
+    for (size_t b = 0; b < function.blocks.size(); ++b) {
+        const IRBlock& block = function.blocks[b];
+        if (block.instructions.empty() || function.terminator(static_cast<uint32_t>(b)) == IR_NONE) {
+            return where(b) + "missing terminator";
+        }
+        
+        bool pastPhis = false;
+        for (size_t i = 0; i < block.instructions.size(); ++i) {
+            IRValue value = block.instructions[i];
+            if (value >= function.instructions.size()) {
+                return where(b) + "instruction index out of range";
+            }
+            const IRInstruction& inst = function.instructions[value];
+            if (inst.block != b) {
+                return where(b) + "%" + std::to_string(value) + " records block " + std::to_string(inst.block);
+            }
+            if (isTerminator(inst.op) && i + 1 != block.instructions.size()) {
+                return where(b) + "terminator before the end of the block";
+            }
+            if (inst.op == IROp::PHI) {
+                if (pastPhis) {
+                    return where(b) + "phi after other instructions";
+                }
+                if (inst.operandCount != block.predecessors.size()) {
+                    return where(b) + "phi %" + std::to_string(value) + " has " + std::to_string(inst.operandCount) +
+                           " operands for " + std::to_string(block.predecessors.size()) + " predecessors";
+                }
+            } else {
+                pastPhis = true;
+            }
+            
+            for (uint32_t k = 0; k < inst.operandCount; ++k) {
+                IRValue arg = function.operand(value, k);
+                if (arg >= function.instructions.size() || function.instructions[arg].block == IR_NONE) {
+                    return where(b) + "%" + std::to_string(value) + " uses a removed or unknown value";
+                }
+            }
+            
+            bool badIndex = false;
+            switch (inst.op) {
+                case IROp::CONSTANT: badIndex = inst.imm >= module.constants.size(); break;
+                case IROp::PARAMETER: badIndex = inst.imm >= function.parameters.size(); break;
+                case IROp::LOAD:
+                case IROp::STORE: badIndex = inst.imm >= module.globals.size(); break;
+                case IROp::CALL: badIndex = inst.imm >= module.functions.size(); break;
+                case IROp::BUILTIN: badIndex = !builtinInfo(static_cast<BuiltinId>(inst.imm)); break;
+                default: break;
+            }
+            if (badIndex) {
+                return where(b) + "%" + std::to_string(value) + " refers to an unknown " + irOpName(inst.op) + " target";
+            }
+        }
+        
+        // Edges must be recorded on both ends
+        const IRInstruction* term = function.terminatorOf(static_cast<uint32_t>(b));
+        size_t edges = term->op == IROp::BRANCH ? 1 : term->op == IROp::COND_BRANCH ? 2 : 0;
+        for (size_t s = 0; s < 2; ++s) {
+            uint32_t succ = block.successors[s];
+            if ((s < edges) != (succ != IR_NONE)) {
+                return where(b) + "successors do not match the terminator";
+            }
+            if (succ == IR_NONE) {
+                continue;
+            }
+            if (succ >= function.blocks.size()) {
+                return where(b) + "successor out of range";
+            }
+            const auto& preds = function.blocks[succ].predecessors;
+            if (std::find(preds.begin(), preds.end(), b) == preds.end()) {
+                return where(b) + "missing from the predecessors of block " + std::to_string(succ);
+            }
+        }
+        
+        if ((block.structure != IRStructure::NONE) != (term->op == IROp::COND_BRANCH)) {
+            return where(b) + "conditional branches must open a selection or loop";
+        }
+        if (block.structure == IRStructure::LOOP &&
+            (block.continueTarget == IR_NONE || block.merge == IR_NONE)) {
+            return where(b) + "loop header without latch or exit";
+        }
+    }
+    return "";
+}
+
+// `exact` spells every component so that it reads back unchanged
+std::string constantText(const IRConstant& constant, bool exact) {
+    std::ostringstream text;
+    if (exact) {
+        text.precision(17);
+    }
+    text << typeName(constant.type) << "(";
+    for (size_t i = 0; i < constant.components.size(); ++i) {
+        if (i > 0) text << ", ";
+        if (constant.type == Type::Kind::BOOL) {
+            text << (constant.components[i] != 0.0 ? "true" : "false");
+        } else {
+            text << constant.components[i];
+        }
+    }
+    text << ")";
+    return text.str();
+}
+
+std::string swizzleText(uint32_t swizzle) {
+    std::string text = ".";
+    for (int i = 0; i < swizzleCount(swizzle); ++i) {
+        text += "xyzw"[swizzleComponent(swizzle, i)];
+    }
+    return text;
+}
+
+// Listing of a function. `canonical` numbers values in block order and
+// spells constants exactly, so equal code lists the same.
+std::string dumpFunction(const IRModule& module, const IRFunction& function, bool canonical) {
+    std::vector<uint32_t> numbering;
+    if (canonical) {
+        numbering.assign(function.instructions.size(), IR_NONE);
+        uint32_t next = 0;
+        for (const auto& block : function.blocks) {
+            for (IRValue value : block.instructions) {
+                numbering[value] = next++;
+            }
+        }
+    }
+    auto number = [&](IRValue value) { return canonical ? numbering[value] : value; };
+    
+    std::ostringstream out;
+    out << "function " << typeName(function.returnType) << " " << function.name << "(";
+    for (size_t i = 0; i < function.parameters.size(); ++i) {
+        if (i > 0) out << ", ";
+        out << typeName(function.parameters[i].type) << " " << function.parameters[i].name;
+    }
+    out << ")";
+    if (function.shader != IR_NONE) {
+        out << " [" << module.shaders[function.shader].name << "]";
+    }
+    if (function.inlineHint != IRInlineHint::DEFAULT) {
+        out << (function.inlineHint == IRInlineHint::ALWAYS ? " inline" : " noinline");
+    }
+    if (function.fastMath) {
+        out << " fast";
+    }
+    out << "\n";
+    
+    for (size_t b = 0; b < function.blocks.size(); ++b) {
+        const IRBlock& block = function.blocks[b];
+        out << "  block " << b << ":";
+        if (!block.predecessors.empty()) {
+            out << " preds";
+            for (uint32_t pred : block.predecessors) {
+                out << " " << pred;
+            }
+        }
+        if (block.structure == IRStructure::SELECTION) {
+            out << " selection merge " << (block.merge == IR_NONE ? std::string("none") : std::to_string(block.merge));
+        } else if (block.structure == IRStructure::LOOP) {
+            out << " loop merge " << block.merge << " continue " << block.continueTarget;
+            if (block.unroll) {
+                out << " unroll " << block.unroll;
+            }
+        }
+        out << "\n";
+        
+        for (IRValue value : block.instructions) {
+            const IRInstruction& inst = function.instructions[value];
+            out << "    ";
+            if (inst.type != Type::Kind::VOID) {
+                out << "%" << number(value) << " = " << typeName(inst.type) << " ";
+            }
+            out << irOpName(inst.op);
+            
+            switch (inst.op) {
+                case IROp::CONSTANT: out << " " << constantText(module.constants[inst.imm], canonical); break;
+                case IROp::PARAMETER: out << " " << function.parameters[inst.imm].name; break;
+                case IROp::LOAD:
+                case IROp::STORE: out << " @" << module.globals[inst.imm].name; break;
+                case IROp::EXTRACT: out << " [" << inst.imm << "]"; break;
+                case IROp::SWIZZLE:
+                case IROp::INSERT: out << " " << swizzleText(inst.imm); break;
+                case IROp::BUILTIN: out << " " << builtinInfo(static_cast<BuiltinId>(inst.imm))->name; break;
+                case IROp::CALL: out << " @" << module.functions[inst.imm].name; break;
+                default: break;
+            }
+            if (inst.op == IROp::STORE && inst.aux != 0) {
+                out << swizzleText(inst.aux);
+            }
+            
+            for (uint32_t i = 0; i < inst.operandCount; ++i) {
+                out << (i == 0 ? " " : ", ") << "%" << number(function.operand(value, i));
+            }
+            
+            if (inst.op == IROp::BRANCH) {
+                out << " " << block.successors[0];
+            } else if (inst.op == IROp::COND_BRANCH) {
+                out << " " << block.successors[0] << ", " << block.successors[1];
+                if (inst.aux == BRANCH_UNIFORM) {
+                    out << " uniform";
+                } else if (inst.aux == BRANCH_DIVERGENT) {
+                    out << " divergent";
+                }
+                if (inst.imm == static_cast<uint32_t>(IRBranchControl::BRANCH)) {
+                    out << " [[branch]]";
+                } else if (inst.imm == static_cast<uint32_t>(IRBranchControl::FLATTEN)) {
+                    out << " [[flatten]]";
+                }
+            }
+            if (inst.precision == IRPrecision::MEDIUM) {
+                out << " mediump";
+            }
+            if (inst.name != 0) {
+                out << "  ; " << function.names[inst.name];
+            }
+            out << "\n";
+        }
+    }
+    return out.str();
+}
+
+std::string globalText(const IRModule& module, const IRGlobal& global) {
+    std::ostringstream out;
+    out << "global " << typeName(global.type) << " @" << global.name;
+    switch (global.qualifier) {
+        case VariableDeclaration::Qualifier::IN: out << " in"; break;
+        case VariableDeclaration::Qualifier::OUT: out << " out"; break;
+        case VariableDeclaration::Qualifier::UNIFORM: out << " uniform"; break;
+        case VariableDeclaration::Qualifier::CONST: out << " const"; break;
+        default: break;
+    }
+    if (global.builtin) {
+        out << " builtin";
+    }
+    if (global.shader != IR_NONE) {
+        out << " [" << module.shaders[global.shader].name << "]";
+    }
+    if (global.initializer != IR_NONE) {
+        out << " = @" << module.functions[global.initializer].name;
+    }
+    return out.str();
+}
+
+} // anonymous namespace
+
+std::string verifyIR(const IRModule& module) {
+    for (const auto& function : module.functions) {
+        std::string problem = verifyFunction(module, function);
+        if (!problem.empty()) {
+            return problem;
+        }
+    }
+    for (const auto& shader : module.shaders) {
+        std::string problem = shader.preshader.blocks.empty() ? "" : verifyFunction(module, shader.preshader);
+        if (!problem.empty()) {
+            return problem;
+        }
+    }
+    return "";
+}
+
+std::string dumpIR(const IRModule& module, const IRFunction& function) {
+    return dumpFunction(module, function, false);
+}
+
+std::string dumpIR(const IRModule& module) {
+    std::ostringstream out;
+    for (size_t g = 0; g < module.globals.size(); ++g) {
+        out << globalText(module, module.globals[g]) << "\n";
+    }
+    for (const auto& function : module.functions) {
+        out << dumpIR(module, function);
+    }
+    for (const auto& shader : module.shaders) {
+        if (!shader.preshader.blocks.empty()) {
+            out << dumpIR(module, shader.preshader);
+        }
+    }
+    return out.str();
+}
+
+uint64_t hashIR(const IRModule& module) {
+    std::ostringstream out;
+    auto print = [&](const IRItem& item) {
+        if (item.kind == IRItem::Kind::FUNCTION) {
+            out << dumpFunction(module, module.functions[item.index], true);
+            return;
+        }
+        const IRGlobal& global = module.globals[item.index];
+        out << globalText(module, global) << "\n";
+        if (global.initializer != IR_NONE) {
+            out << dumpFunction(module, module.functions[global.initializer], true);
+        }
+    };
+    for (const IRItem& item : module.items) {
+        if (item.kind != IRItem::Kind::SHADER) {
+            print(item);
+            continue;
+        }
+        const IRShader& shader = module.shaders[item.index];
+        out << "shader " << shader.name << " " << static_cast<int>(shader.stage) << "\n";
+        for (const IRItem& member : shader.items) {
+            print(member);
+        }
+        if (shader.entryPoint != IR_NONE) {
+            out << "entry @" << module.functions[shader.entryPoint].name << "\n";
+        }
+        if (!shader.preshader.blocks.empty()) {
+            out << dumpFunction(module, shader.preshader, true);
+        }
+    }
+    
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : out.str()) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    return hash;
+}
+
+} // namespace sdl
@@ -0,0 +1,402 @@
+#include "ir/passes.h"
+#include "semantic/types.h"
+#include <algorithm>
+#include <map>
+
+namespace sdl {
+
+namespace {
+
+constexpr unsigned WRITES = Effect::WRITES_OUTPUTS | Effect::WRITES_GLOBALS | Effect::WRITES_ARGUMENTS;
+
+// Most operations hoisted from a block that may not run at all: an if inside
+// the loop body, or any of the body when the loop may run zero times. Costlier
+// code on every iteration's path is hoisted under the loop's entry test.
+constexpr int SPECULATION_LIMIT = 4;
+
+class LoopInvariantMotion {
+public:
+    LoopInvariantMotion(IRFunction& function, IRModule& module, const std::vector<unsigned>& effects,
+                        PassContext& context)
+        : function_(function), module_(module), effects_(effects), context_(context) {}
+    
+    bool run() {
+        if (function_.blocks.empty()) {
+            return false;
+        }
+        idom_ = immediateDominators(function_);
+        
+        // Inner loops first: what leaves an inner loop lands in its
+        // preheader, from where the outer loop may hoist it further
+        bool changed = false;
+        std::vector<uint32_t> order = reversePostorder(function_);
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            if (function_.blocks[*it].structure == IRStructure::LOOP) {
+                changed |= hoist(*it);
+            }
+        }
+        return changed;
+    }
+    
+private:
+    IRFunction& function_;
+    IRModule& module_;
+    const std::vector<unsigned>& effects_;
+    PassContext& context_;
+    std::vector<uint32_t> idom_;
+    std::vector<bool> inLoop_;   // Blocks of the loop being processed
+    std::vector<bool> invariant_; // Values of the loop found invariant so far
+    std::vector<bool> guarded_;   // Invariant values hoisted under the entry test
+    std::vector<bool> stored_;    // Globals the loop writes
+    bool writesAll_ = false;      // The loop calls a function writing globals
+    
+    const IRInstruction& inst(IRValue value) const { return function_.instructions[value]; }
+    
+    bool dominates(uint32_t a, uint32_t b) const {
+        while (b != IR_NONE && b != a) {
+            b = idom_[b];
+        }
+        return b == a;
+    }
+    
+    bool hoist(uint32_t header) {
+        const IRBlock& block = function_.blocks[header];
+        uint32_t latch = block.continueTarget;
+        if (block.predecessors.size() != 2 || latch == IR_NONE) {
+            return false;
+        }
+        uint32_t latchIndex = block.predecessors[0] == latch ? 0 : 1;
+        uint32_t preheader = block.predecessors[1 - latchIndex];
+        if (inst(function_.terminator(preheader)).op != IROp::BRANCH) {
+            return false;
+        }
+        
+        // The loop: the header and every block reaching the latch without
+        // passing through it
+        inLoop_.assign(function_.blocks.size(), false);
+        inLoop_[header] = true;
+        std::vector<uint32_t> worklist{latch};
+        while (!worklist.empty()) {
+            uint32_t b = worklist.back();
+            worklist.pop_back();
+            if (inLoop_[b]) {
+                continue;
+            }
+            inLoop_[b] = true;
+            for (uint32_t pred : function_.blocks[b].predecessors) {
+                worklist.push_back(pred);
+            }
+        }
+        
+        stored_.assign(module_.globals.size(), false);
+        writesAll_ = false;
+        for (uint32_t b = 0; b < function_.blocks.size(); ++b) {
+            if (!inLoop_[b]) {
+                continue;
+            }
+            for (IRValue value : function_.blocks[b].instructions) {
+                if (inst(value).op == IROp::STORE) {
+                    stored_[inst(value).imm] = true;
+                } else if (inst(value).op == IROp::CALL && (effects_[inst(value).imm] & WRITES) != 0) {
+                    writesAll_ = true;
+                }
+            }
+        }
+        
+        bool entered = runsAtLeastOnce(header, latchIndex);
+        bool testable = entryTestable(header);
+        invariant_.assign(function_.instructions.size(), false);
+        guarded_.assign(function_.instructions.size(), false);
+        std::vector<IRValue> hoisted;
+        std::vector<IRValue> guarded;
+        std::vector<uint32_t> order = reversePostorder(function_);
+        for (uint32_t b : order) {
+            if (!inLoop_[b]) {
+                continue;
+            }
+            // The header runs whenever the loop is reached. A block on every
+            // path to the latch runs once per iteration, so it runs at all
+            // only if the loop is entered; other blocks only some iterations.
+            bool everyIteration = b == header || dominates(b, latch);
+            bool guaranteed = b == header || (entered && everyIteration);
+            for (IRValue value : function_.blocks[b].instructions) {
+                if (!isInvariant(value)) {
+                    continue;
+                }
+                if (!dependsOnGuarded(value) && (guaranteed || speculatable(value))) {
+                    hoisted.push_back(value);
+                    if (!guaranteed) {
+                        ++context_.statistics["licm.speculated"];
+                    }
+                } else if (everyIteration && testable && guardable(value)) {
+                    guarded.push_back(value);
+                    guarded_[value] = true;
+                } else {
+                    continue;
+                }
+                invariant_[value] = true;
+            }
+        }
+        
+        // In the order found, which has operands before their uses
+        for (IRValue value : hoisted) {
+            moveBeforeTerminator(value, preheader);
+        }
+        if (!guarded.empty()) {
+            guard(header, latchIndex, preheader, guarded);
+        }
+        context_.statistics["licm.hoisted"] += static_cast<int>(hoisted.size() + guarded.size());
+        context_.statistics["licm.guarded"] += static_cast<int>(guarded.size());
+        return !hoisted.empty() || !guarded.empty();
+    }
+    
+    void moveBeforeTerminator(IRValue value, uint32_t block) {
+        function_.remove(value);
+        auto& list = function_.blocks[block].instructions;
+        function_.insert(block, std::find(list.begin(), list.end(), function_.terminator(block)) - list.begin(),
+                         value);
+    }
+    
+    bool dependsOnGuarded(IRValue value) const {
+        for (uint32_t k = 0; k < inst(value).operandCount; ++k) {
+            if (guarded_[function_.operand(value, k)]) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // Values the loop body needs only once it runs, so a placeholder may
+    // stand in for them when it does not
+    bool guardable(IRValue value) const {
+        Type::Kind type = inst(value).type;
+        return inst(value).op != IROp::CALL && (type == Type::Kind::BOOL || isNumeric(type));
+    }
+    
+    // Whether the header's test can be evaluated before the loop: it must be
+    // computed in the header from its phis and values defined before it
+    bool entryTestable(uint32_t header) const {
+        if (inst(function_.terminator(header)).op != IROp::COND_BRANCH) {
+            return false;
+        }
+        std::vector<IRValue> worklist{function_.operand(function_.terminator(header), 0)};
+        while (!worklist.empty()) {
+            IRValue value = worklist.back();
+            worklist.pop_back();
+            const IRInstruction& i = inst(value);
+            if (i.block == header && i.op == IROp::PHI) {
+                continue;
+            }
+            if (inLoop_[i.block] && (i.block != header || i.op == IROp::CALL || i.op == IROp::STORE)) {
+                return false;
+            }
+            if (!inLoop_[i.block]) {
+                continue;
+            }
+            for (uint32_t k = 0; k < i.operandCount; ++k) {
+                worklist.push_back(function_.operand(value, k));
+            }
+        }
+        return true;
+    }
+    
+    // The header's test on the values the loop is entered with, computed at
+    // the end of the preheader
+    IRValue entryTest(IRValue value, uint32_t header, uint32_t latchIndex, uint32_t preheader,
+                      std::map<IRValue, IRValue>& copies) {
+        if (inst(value).block != header) {
+            return value;
+        }
+        if (inst(value).op == IROp::PHI) {
+            return function_.operand(value, 1 - latchIndex);
+        }
+        auto it = copies.find(value);
+        if (it != copies.end()) {
+            return it->second;
+        }
+        std::vector<IRValue> args;
+        for (uint32_t k = 0; k < inst(value).operandCount; ++k) {
+            args.push_back(entryTest(function_.operand(value, k), header, latchIndex, preheader, copies));
+        }
+        IRValue copy = function_.create(inst(value).op, inst(value).type, args, inst(value).imm);
+        function_.instructions[copy].aux = inst(value).aux;
+        auto& list = function_.blocks[preheader].instructions;
+        function_.insert(preheader, std::find(list.begin(), list.end(), function_.terminator(preheader)) -
+                                        list.begin(), copy);
+        return copies[value] = copy;
+    }
+    
+    // Rewrites preheader -> header into
+    //   preheader: if (entry test) { guard: the values }  merge: phis -> header
+    // where the phis give the loop the values, or zero when it never runs
+    void guard(uint32_t header, uint32_t latchIndex, uint32_t preheader, const std::vector<IRValue>& values) {
+        IRValue headerTest = function_.terminator(header);
+        std::map<IRValue, IRValue> copies;
+        IRValue test = entryTest(function_.operand(headerTest, 0), header, latchIndex, preheader, copies);
+        if (function_.blocks[header].successors[0] == function_.blocks[header].merge) {
+            test = function_.append(preheader, IROp::NOT, Type::Kind::BOOL, {test});
+            moveBeforeTerminator(test, preheader);
+        }
+        uint32_t hint = function_.instructions[headerTest].aux;
+        
+        uint32_t body = function_.addBlock();
+        uint32_t merge = function_.addBlock();
+        function_.remove(function_.terminator(preheader));
+        function_.condBranch(preheader, test, body, merge, hint);
+        function_.instructions[function_.terminator(preheader)].imm = static_cast<uint32_t>(IRBranchControl::BRANCH);
+        function_.blocks[preheader].structure = IRStructure::SELECTION;
+        function_.blocks[preheader].merge = merge;
+        for (IRValue value : values) {
+            function_.remove(value);
+            function_.insert(body, function_.blocks[body].instructions.size(), value);
+        }
+        function_.branch(body, merge);
+        
+        // The merge takes the preheader's place as the header's predecessor
+        auto& preds = function_.blocks[header].predecessors;
+        std::replace(preds.begin(), preds.end(), preheader, merge);
+        for (IRValue value : values) {
+            Type::Kind type = inst(value).type;
+            IRValue zero = function_.create(IROp::CONSTANT, type, {},
+                                            module_.constant(type, std::vector<double>(componentCount(type), 0.0)));
+            moveBeforeTerminator(zero, preheader);
+            IRValue phi = function_.append(merge, IROp::PHI, type, {zero, value});
+            function_.instructions[phi].name = inst(value).name;
+            for (uint32_t b = 0; b < inLoop_.size(); ++b) {
+                if (!inLoop_[b]) {
+                    continue;
+                }
+                for (IRValue user : function_.blocks[b].instructions) {
+                    replaceOperand(user, value, phi);
+                }
+            }
+        }
+        function_.append(merge, IROp::BRANCH, Type::Kind::VOID);
+        function_.blocks[merge].successors[0] = header;
+        idom_ = immediateDominators(function_);
+    }
+    
+    void replaceOperand(IRValue user, IRValue from, IRValue to) {
+        std::vector<IRValue> args(function_.operandsOf(user), function_.operandsOf(user) + inst(user).operandCount);
+        if (std::find(args.begin(), args.end(), from) != args.end()) {
+            std::replace(args.begin(), args.end(), from, to);
+            function_.setOperands(user, args);
+        }
+    }
+    
+    // Evaluates the header's test on the values the loop is entered with
+    bool runsAtLeastOnce(uint32_t header, uint32_t latchIndex) const {
+        const IRBlock& block = function_.blocks[header];
+        IRValue condition = function_.operand(function_.terminator(header), 0);
+        double operands[2];
+        if (inst(condition).operandCount != 2) {
+            return false;
+        }
+        for (int i = 0; i < 2; ++i) {
+            IRValue value = function_.operand(condition, i);
+            if (inst(value).op == IROp::PHI && inst(value).block == header) {
+                value = function_.operand(value, 1 - latchIndex);
+            }
+            if (inst(value).op != IROp::CONSTANT || !isScalar(inst(value).type)) {
+                return false;
+            }
+            operands[i] = module_.constants[inst(value).imm].components[0];
+        }
+        
+        bool result;
+        switch (inst(condition).op) {
+            case IROp::LT: result = operands[0] < operands[1]; break;
+            case IROp::LE: result = operands[0] <= operands[1]; break;
+            case IROp::GT: result = operands[0] > operands[1]; break;
+            case IROp::GE: result = operands[0] >= operands[1]; break;
+            case IROp::EQ: result = operands[0] == operands[1]; break;
+            case IROp::NE: result = operands[0] != operands[1]; break;
+            default: return false;
+        }
+        bool exitOnTrue = block.successors[0] == block.merge;
+        return result != exitOnTrue;
+    }
+    
+    // Pure, and computed from values defined outside the loop or invariant
+    bool isInvariant(IRValue value) const {
+        const IRInstruction& i = inst(value);
+        switch (i.op) {
+            case IROp::CONSTANT:
+            case IROp::PARAMETER:
+            case IROp::PHI:
+            case IROp::STORE:
+            case IROp::BRANCH:
+            case IROp::COND_BRANCH:
+            case IROp::RETURN:
+                return false;
+            case IROp::LOAD: {
+                // Nothing stores uniforms, inputs and constants; a call may
+                // store any other global
+                VariableDeclaration::Qualifier qualifier = module_.globals[i.imm].qualifier;
+                if (stored_[i.imm] || (writesAll_ && (qualifier == VariableDeclaration::Qualifier::NONE ||
+                                                      qualifier == VariableDeclaration::Qualifier::OUT))) {
+                    return false;
+                }
+                break;
+            }
+            case IROp::CALL:
+                if ((effects_[i.imm] & (WRITES | Effect::READS_MUTABLE)) != 0) {
+                    return false;
+                }
+                break;
+            case IROp::BUILTIN: {
+                const BuiltinInfo* info = builtinInfo(static_cast<BuiltinId>(i.imm));
+                if (!info || (info->effects & WRITES) != 0) {
+                    return false;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        for (uint32_t k = 0; k < i.operandCount; ++k) {
+            IRValue operand = function_.operand(value, k);
+            if (inLoop_[inst(operand).block] && !invariant_[operand]) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // Whether the instruction may run where it would not have: it must not
+    // fault, and it must be cheap, since every entry to the loop now pays for
+    // it even when no iteration would have
+    bool speculatable(IRValue value) const {
+        const IRInstruction& i = inst(value);
+        if ((i.op == IROp::DIV || i.op == IROp::MOD) && i.type == Type::Kind::INT) {
+            IRValue divisor = function_.operand(value, 1);
+            if (inst(divisor).op != IROp::CONSTANT || module_.constants[inst(divisor).imm].components[0] == 0) {
+                return false;
+            }
+        }
+        if (i.op == IROp::CALL) {
+            return false;
+        }
+        if (i.op == IROp::BUILTIN) {
+            const BuiltinInfo* info = builtinInfo(static_cast<BuiltinId>(i.imm));
+            if (info->cost.textureFetches > 0 || info->cost.transcendentalPerComponent > 0 ||
+                info->cost.transcendentalFixed > 0) {
+                return false;
+            }
+        }
+        return operationCount(function_, value) <= SPECULATION_LIMIT;
+    }
+};
+
+} // anonymous namespace
+
+bool hoistLoopInvariants(IRModule& module, PassContext& context) {
+    std::vector<unsigned> effects = functionEffects(module);
+    bool changed = false;
+    for (auto& function : module.functions) {
+        changed |= LoopInvariantMotion(function, module, effects, context).run();
+    }
+    return changed;
+}
+
+} // namespace sdl
@@ -0,0 +1,529 @@
+#include "ir/passes.h"
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace sdl {
+
+namespace {
+
+constexpr int MAX_TRIP_COUNT = 1024; // Loops running longer are not simulated
+
+// How much unrolling each level allows, in operations (see operationCount)
+struct UnrollLimits {
+    int fullTrips;  // Most iterations unrolled completely
+    int fullSize;   // Operations of the completely unrolled loop
+    int partialSize; // Operations of one partially unrolled iteration
+};
+
+UnrollLimits unrollLimits(OptimizationLevel level) {
+    switch (level) {
+        case OptimizationLevel::O3: return {64, 1024, 256};
+        case OptimizationLevel::OS: return {1, 0, 0}; // Only loops running at most once
+        default: return {32, 256, 64};
+    }
+}
+
+struct Loop {
+    uint32_t header;
+    uint32_t latch;
+    uint32_t latchIndex;          // Of the latch among the header's predecessors
+    uint32_t body;                // First block of the body
+    std::vector<uint32_t> blocks; // The body, header excluded
+    int tripCount = -1;           // -1 when not a known constant
+    IRValue counter = IR_NONE;    // The header's phi the test compares, when it is
+    int32_t start = 0;            // Its value entering the loop
+    int32_t step = 0;             // And what each iteration adds
+    int size = 0;                 // Operations of one iteration
+};
+
+class LoopUnroller {
+public:
+    LoopUnroller(IRFunction& function, IRModule& module, PassContext& context)
+        : function_(function), module_(module), context_(context), limits_(unrollLimits(context.level)) {}
+    
+    bool run() {
+        bool changed = false;
+        bool restart = true;
+        while (restart) {
+            restart = false;
+            // Inner loops first, so an outer loop is weighed with them unrolled
+            std::vector<uint32_t> order = reversePostorder(function_);
+            for (auto it = order.rbegin(); it != order.rend() && !restart; ++it) {
+                const IRBlock& block = function_.blocks[*it];
+                IRValue term = function_.terminator(*it);
+                // Copies of a loop are weighed again: unrolling the loop
+                // around them may have made their trip count constant
+                if (block.structure != IRStructure::LOOP || !decided_.insert(term).second) {
+                    continue;
+                }
+                Loop loop;
+                if (!analyze(*it, loop)) {
+                    continue;
+                }
+                switch (decide(loop)) {
+                    case Decision::FULL:
+                        unrollFully(loop);
+                        ++context_.statistics["unroll.full"];
+                        restart = changed = true; // Blocks were renumbered
+                        break;
+                    case Decision::PARTIAL:
+                        unrollPartially(loop, factor_);
+                        ++context_.statistics["unroll.partial"];
+                        restart = changed = true; // The copies hold loops not yet seen
+                        break;
+                    case Decision::DEFERRED:
+                        if (function_.blocks[loop.header].unroll == 0) {
+                            function_.blocks[loop.header].unroll = static_cast<uint32_t>(factor_);
+                            ++context_.statistics["unroll.deferred"];
+                            changed = true;
+                        }
+                        break;
+                    case Decision::NONE:
+                        break;
+                }
+            }
+        }
+        return changed;
+    }
+    
+private:
+    enum class Decision { NONE, FULL, PARTIAL, DEFERRED };
+    
+    IRFunction& function_;
+    IRModule& module_;
+    PassContext& context_;
+    UnrollLimits limits_;
+    std::set<IRValue> decided_; // Terminators of the loop headers already considered
+    int factor_ = 0;            // Of the last PARTIAL or DEFERRED decision
+    
+    const IRInstruction& inst(IRValue value) const { return function_.instructions[value]; }
+    
+    // An int constant, or sums and products of them: the counters of a fully
+    // unrolled loop are left unfolded until fold-constants runs
+    bool intConstant(IRValue value, int32_t& result) const {
+        const IRInstruction& i = inst(value);
+        if (i.type != Type::Kind::INT) {
+            return false;
+        }
+        if (i.op == IROp::CONSTANT) {
+            result = static_cast<int32_t>(module_.constants[i.imm].components[0]);
+            return true;
+        }
+        int32_t a;
+        int32_t b;
+        if ((i.op != IROp::ADD && i.op != IROp::SUB && i.op != IROp::MUL) || i.operandCount != 2 ||
+            !intConstant(function_.operand(value, 0), a) || !intConstant(function_.operand(value, 1), b)) {
+            return false;
+        }
+        uint32_t x = static_cast<uint32_t>(a);
+        uint32_t y = static_cast<uint32_t>(b);
+        result = static_cast<int32_t>(i.op == IROp::ADD ? x + y : i.op == IROp::SUB ? x - y : x * y);
+        return true;
+    }
+    
+    bool analyze(uint32_t header, Loop& loop) const {
+        const IRBlock& block = function_.blocks[header];
+        if (block.merge == IR_NONE || block.predecessors.size() != 2) {
+            return false;
+        }
+        if (inst(function_.terminator(block.continueTarget)).op != IROp::BRANCH) {
+            return false;
+        }
+        loop.header = header;
+        loop.latch = block.continueTarget;
+        loop.latchIndex = block.predecessors[0] == loop.latch ? 0 : 1;
+        if (block.predecessors[loop.latchIndex] != loop.latch) {
+            return false;
+        }
+        loop.body = block.successors[0] == block.merge ? block.successors[1] : block.successors[0];
+        
+        // Without break or return, everything the body reaches before coming
+        // back to the header is the body
+        std::vector<bool> seen(function_.blocks.size(), false);
+        std::vector<uint32_t> worklist{loop.body};
+        seen[loop.body] = true;
+        while (!worklist.empty()) {
+            uint32_t b = worklist.back();
+            worklist.pop_back();
+            if (b == block.merge || inst(function_.terminator(b)).op == IROp::RETURN) {
+                return false;
+            }
+            loop.blocks.push_back(b);
+            for (uint32_t succ : function_.blocks[b].successors) {
+                if (succ == header) {
+                    if (b != loop.latch) {
+                        return false;
+                    }
+                } else if (succ != IR_NONE && !seen[succ]) {
+                    seen[succ] = true;
+                    worklist.push_back(succ);
+                }
+            }
+        }
+        std::sort(loop.blocks.begin(), loop.blocks.end());
+        
+        for (IRValue value : block.instructions) {
+            loop.size += operationCount(function_, value);
+        }
+        for (uint32_t b : loop.blocks) {
+            for (IRValue value : function_.blocks[b].instructions) {
+                loop.size += operationCount(function_, value);
+            }
+        }
+        loop.tripCount = tripCount(loop);
+        return true;
+    }
+    
+    // Whether `next` is `counter` plus a constant
+    bool constantStep(IRValue counter, IRValue next, int32_t& step) const {
+        const IRInstruction& update = inst(next);
+        if (update.op == IROp::ADD && function_.operand(next, 0) == counter) {
+            return intConstant(function_.operand(next, 1), step);
+        }
+        if (update.op == IROp::ADD && function_.operand(next, 1) == counter) {
+            return intConstant(function_.operand(next, 0), step);
+        }
+        if (update.op == IROp::SUB && function_.operand(next, 0) == counter &&
+            intConstant(function_.operand(next, 1), step)) {
+            step = static_cast<int32_t>(0u - static_cast<uint32_t>(step));
+            return true;
+        }
+        return false;
+    }
+    
+    // Runs the header's test on an int counter stepped by a constant
+    int tripCount(Loop& loop) const {
+        const IRBlock& block = function_.blocks[loop.header];
+        IRValue condition = function_.operand(function_.terminator(loop.header), 0);
+        const IRInstruction& test = inst(condition);
+        switch (test.op) {
+            case IROp::LT: case IROp::LE: case IROp::GT: case IROp::GE: case IROp::EQ: case IROp::NE:
+                break;
+            default:
+                return -1;
+        }
+        
+        IRValue counter = function_.operand(condition, 0);
+        int32_t bound;
+        bool counterFirst = true;
+        if (!intConstant(function_.operand(condition, 1), bound)) {
+            counter = function_.operand(condition, 1);
+            counterFirst = false;
+            if (!intConstant(function_.operand(condition, 0), bound)) {
+                return -1;
+            }
+        }
+        if (inst(counter).op != IROp::PHI || inst(counter).block != loop.header) {
+            return -1;
+        }
+        
+        int32_t start;
+        int32_t step;
+        if (!intConstant(function_.operand(counter, 1 - loop.latchIndex), start) ||
+            !constantStep(counter, function_.operand(counter, loop.latchIndex), step)) {
+            return -1;
+        }
+        loop.counter = counter;
+        loop.start = start;
+        loop.step = step;
+        
+        bool exitOnTrue = block.successors[0] == block.merge;
+        int32_t value = start;
+        for (int trips = 0; trips <= MAX_TRIP_COUNT; ++trips) {
+            int32_t a = counterFirst ? value : bound;
+            int32_t b = counterFirst ? bound : value;
+            bool result = false;
+            switch (test.op) {
+                case IROp::LT: result = a < b; break;
+                case IROp::LE: result = a <= b; break;
+                case IROp::GT: result = a > b; break;
+                case IROp::GE: result = a >= b; break;
+                case IROp::EQ: result = a == b; break;
+                default: result = a != b; break;
+            }
+            if (result == exitOnTrue) {
+                return trips;
+            }
+            value = static_cast<int32_t>(static_cast<uint32_t>(value) + static_cast<uint32_t>(step));
+        }
+        return -1;
+    }
+    
+    Decision decide(const Loop& loop) {
+        if (loop.tripCount >= 0 && loop.tripCount <= limits_.fullTrips &&
+            (loop.tripCount <= 1 || loop.tripCount * loop.size <= limits_.fullSize)) {
+            return Decision::FULL;
+        }
+        
+        // The widest body that still fits. The target compiler unrolls loops
+        // whose trip count is not known here, remainder included.
+        for (int factor : {8, 4, 2}) {
+            if ((loop.tripCount < 0 || factor < loop.tripCount) && factor * loop.size <= limits_.partialSize) {
+                factor_ = factor;
+                return loop.tripCount < 0 ? Decision::DEFERRED : Decision::PARTIAL;
+            }
+        }
+        return Decision::NONE;
+    }
+    
+    // Copies the header's computations and the body for one iteration.
+    // `values` maps the header's phis to their values in this iteration and
+    // receives every copied instruction. Returns the first block of the copy
+    // and the copy of the latch, which branches to the header.
+    std::pair<uint32_t, uint32_t> cloneIteration(const Loop& loop, std::map<IRValue, IRValue>& values) {
+        uint32_t entry = function_.addBlock();
+        std::map<uint32_t, uint32_t> blocks;
+        for (uint32_t b : loop.blocks) {
+            blocks[b] = function_.addBlock();
+        }
+        auto target = [&](uint32_t b) {
+            auto it = blocks.find(b);
+            return it == blocks.end() ? b : it->second;
+        };
+        
+        std::vector<std::pair<IRValue, IRValue>> copies;
+        auto copy = [&](uint32_t to, IRValue value) {
+            const IRInstruction& source = inst(value);
+            IRValue result = function_.append(to, source.op, source.type,
+                                              std::vector<IRValue>(source.operandCount, IR_NONE), source.imm);
+            function_.instructions[result].aux = inst(value).aux;
+            function_.instructions[result].line = inst(value).line;
+            function_.instructions[result].column = inst(value).column;
+            function_.instructions[result].name = inst(value).name;
+            values[value] = result;
+            copies.emplace_back(value, result);
+        };
+        
+        for (IRValue value : function_.blocks[loop.header].instructions) {
+            if (inst(value).op != IROp::PHI && !isTerminator(inst(value).op)) {
+                copy(entry, value);
+            }
+        }
+        function_.append(entry, IROp::BRANCH, Type::Kind::VOID);
+        function_.blocks[entry].successors[0] = blocks.at(loop.body);
+        
+        for (uint32_t b : loop.blocks) {
+            uint32_t to = blocks[b];
+            IRBlock source = function_.blocks[b];
+            IRBlock& block = function_.blocks[to];
+            for (uint32_t pred : source.predecessors) {
+                block.predecessors.push_back(pred == loop.header ? entry : target(pred));
+            }
+            block.successors[0] = b == loop.latch ? loop.header : target(source.successors[0]);
+            block.successors[1] = target(source.successors[1]);
+            block.structure = source.structure;
+            block.merge = target(source.merge);
+            block.continueTarget = target(source.continueTarget);
+            block.unroll = source.unroll;
+            for (IRValue value : source.instructions) {
+                copy(to, value);
+            }
+        }
+        
+        for (const auto& pair : copies) {
+            std::vector<IRValue> operands(function_.operandsOf(pair.first),
+                                          function_.operandsOf(pair.first) + inst(pair.first).operandCount);
+            for (IRValue& operand : operands) {
+                auto it = values.find(operand);
+                if (it != values.end()) {
+                    operand = it->second;
+                }
+            }
+            function_.setOperands(pair.second, operands);
+        }
+        return {entry, blocks.at(loop.latch)};
+    }
+    
+    std::vector<IRValue> headerPhis(const Loop& loop) const {
+        std::vector<IRValue> phis;
+        for (IRValue value : function_.blocks[loop.header].instructions) {
+            if (inst(value).op == IROp::PHI) {
+                phis.push_back(value);
+            }
+        }
+        return phis;
+    }
+    
+    // Chains `count` copies of the iteration after `from`, whose branch to
+    // the header now enters the first copy. `incoming` holds the values of
+    // the header's phis entering the first copy and on return those leaving
+    // the last. Returns the copy of the latch ending the chain.
+    uint32_t chainIterations(const Loop& loop, int count, uint32_t from, std::vector<IRValue>& incoming) {
+        std::vector<IRValue> phis = headerPhis(loop);
+        for (int i = 0; i < count; ++i) {
+            std::map<IRValue, IRValue> values;
+            for (size_t p = 0; p < phis.size(); ++p) {
+                values[phis[p]] = incoming[p];
+            }
+            auto copy = cloneIteration(loop, values);
+            
+            IRBlock& source = function_.blocks[from];
+            std::replace(std::begin(source.successors), std::end(source.successors), loop.header, copy.first);
+            function_.blocks[copy.first].predecessors.push_back(from);
+            
+            for (size_t p = 0; p < phis.size(); ++p) {
+                IRValue next = function_.operand(phis[p], loop.latchIndex);
+                auto it = values.find(next);
+                incoming[p] = it == values.end() ? next : it->second;
+            }
+            from = copy.second;
+        }
+        return from;
+    }
+    
+    // The iterations run one after another; what is left of the header runs
+    // once at the end and leaves the loop
+    void unrollFully(const Loop& loop) {
+        std::vector<IRValue> phis = headerPhis(loop);
+        std::vector<IRValue> incoming;
+        for (IRValue phi : phis) {
+            incoming.push_back(function_.operand(phi, 1 - loop.latchIndex));
+        }
+        uint32_t preheader = function_.blocks[loop.header].predecessors[1 - loop.latchIndex];
+        uint32_t last = chainIterations(loop, loop.tripCount, preheader, incoming);
+        
+        for (size_t p = 0; p < phis.size(); ++p) {
+            function_.remove(phis[p]);
+            function_.replaceAllUses(phis[p], incoming[p]);
+        }
+        function_.remove(function_.terminator(loop.header));
+        function_.append(loop.header, IROp::BRANCH, Type::Kind::VOID);
+        IRBlock& header = function_.blocks[loop.header];
+        header.predecessors = {last};
+        header.successors[0] = header.merge;
+        header.successors[1] = IR_NONE;
+        header.structure = IRStructure::NONE;
+        header.merge = header.continueTarget = IR_NONE;
+        header.unroll = 0;
+        removeUnreachableBlocks(function_);
+    }
+    
+    // The last `count` iterations run one after another once the loop
+    // leaves, which then stops that many iterations early
+    void peelRemainder(const Loop& loop, int count) {
+        uint32_t exit = function_.blocks[loop.header].merge;
+        size_t blockCount = function_.blocks.size();
+        std::vector<bool> inside(blockCount, false);
+        inside[loop.header] = true;
+        for (uint32_t b : loop.blocks) {
+            inside[b] = true;
+        }
+        
+        uint32_t entry = function_.addBlock();
+        function_.append(entry, IROp::BRANCH, Type::Kind::VOID);
+        function_.blocks[entry].successors[0] = loop.header;
+        std::vector<IRValue> phis = headerPhis(loop);
+        std::vector<IRValue> incoming = phis;
+        uint32_t last = chainIterations(loop, count, entry, incoming);
+        
+        // What is left of the header runs once at the end, and the code after
+        // the loop uses its values from there
+        std::map<IRValue, IRValue> values;
+        for (size_t p = 0; p < phis.size(); ++p) {
+            values[phis[p]] = incoming[p];
+        }
+        uint32_t tail = function_.addBlock();
+        for (IRValue value : function_.blocks[loop.header].instructions) {
+            const IRInstruction& source = inst(value);
+            if (source.op == IROp::PHI || isTerminator(source.op)) {
+                continue;
+            }
+            std::vector<IRValue> operands(function_.operandsOf(value),
+                                          function_.operandsOf(value) + source.operandCount);
+            for (IRValue& operand : operands) {
+                auto it = values.find(operand);
+                if (it != values.end()) {
+                    operand = it->second;
+                }
+            }
+            IRValue copy = function_.append(tail, source.op, source.type, operands, source.imm);
+            function_.instructions[copy].aux = inst(value).aux;
+            function_.instructions[copy].line = inst(value).line;
+            function_.instructions[copy].column = inst(value).column;
+            function_.instructions[copy].name = inst(value).name;
+            values[value] = copy;
+        }
+        IRBlock& source = function_.blocks[last];
+        std::replace(std::begin(source.successors), std::end(source.successors), loop.header, tail);
+        function_.blocks[tail].predecessors.push_back(last);
+        function_.append(tail, IROp::BRANCH, Type::Kind::VOID);
+        function_.blocks[tail].successors[0] = exit;
+        auto& exitPreds = function_.blocks[exit].predecessors;
+        std::replace(exitPreds.begin(), exitPreds.end(), loop.header, tail);
+        for (uint32_t b = 0; b < blockCount; ++b) {
+            if (inside[b]) {
+                continue;
+            }
+            for (IRValue user : function_.blocks[b].instructions) {
+                std::vector<IRValue> operands(function_.operandsOf(user),
+                                              function_.operandsOf(user) + inst(user).operandCount);
+                bool replaced = false;
+                for (IRValue& operand : operands) {
+                    auto it = values.find(operand);
+                    if (it != values.end()) {
+                        operand = it->second;
+                        replaced = true;
+                    }
+                }
+                if (replaced) {
+                    function_.setOperands(user, operands);
+                }
+            }
+        }
+        
+        // The loop now leaves where the counter reaches the remainder
+        IRBlock& header = function_.blocks[loop.header];
+        std::replace(std::begin(header.successors), std::end(header.successors), exit, entry);
+        function_.blocks[entry].predecessors.push_back(loop.header);
+        header.merge = entry;
+        bool exitOnTrue = header.successors[0] == entry;
+        uint32_t trips = static_cast<uint32_t>(loop.tripCount - count);
+        auto end = static_cast<int32_t>(static_cast<uint32_t>(loop.start) + trips * static_cast<uint32_t>(loop.step));
+        IRValue bound = function_.create(IROp::CONSTANT, Type::Kind::INT, {},
+                                         module_.constant(Type::Kind::INT, {static_cast<double>(end)}));
+        IRValue test = function_.create(exitOnTrue ? IROp::EQ : IROp::NE, Type::Kind::BOOL, {loop.counter, bound});
+        IRValue terminator = function_.terminator(loop.header);
+        size_t index = function_.blocks[loop.header].instructions.size() - 1;
+        function_.insert(loop.header, index, bound);
+        function_.insert(loop.header, index + 1, test);
+        function_.setOperands(terminator, {test});
+    }
+    
+    // The body runs `factor` times per trip through the header; the trips
+    // the factor does not divide run after the loop
+    void unrollPartially(const Loop& loop, int factor) {
+        if (loop.tripCount % factor != 0) {
+            peelRemainder(loop, loop.tripCount % factor);
+        }
+        function_.blocks[loop.header].unroll = 0;
+        std::vector<IRValue> phis = headerPhis(loop);
+        std::vector<IRValue> incoming;
+        for (IRValue phi : phis) {
+            incoming.push_back(function_.operand(phi, loop.latchIndex));
+        }
+        uint32_t last = chainIterations(loop, factor - 1, loop.latch, incoming);
+        
+        IRBlock& header = function_.blocks[loop.header];
+        header.predecessors[loop.latchIndex] = last;
+        header.continueTarget = last;
+        for (size_t p = 0; p < phis.size(); ++p) {
+            std::vector<IRValue> operands(function_.operandsOf(phis[p]),
+                                          function_.operandsOf(phis[p]) + inst(phis[p]).operandCount);
+            operands[loop.latchIndex] = incoming[p];
+            function_.setOperands(phis[p], operands);
+        }
+    }
+};
+
+} // anonymous namespace
+
+bool unrollLoops(IRModule& module, PassContext& context) {
+    bool changed = false;
+    for (auto& function : module.functions) {
+        changed |= LoopUnroller(function, module, context).run();
+    }
+    return changed;
+}
+
+} // namespace sdl
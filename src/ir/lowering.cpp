@@ -0,0 +1,737 @@
+#include "ir/lowering.h"
+#include "analysis/function_lookup.h"
+#include "analysis/name_resolution.h"
+#include "analysis/purity.h"
+#include "analysis/uniformity.h"
+#include "analysis/value_range.h"
+#include "semantic/types.h"
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace sdl {
+
+namespace {
+
+// Thrown for constructs the IR cannot express; lower() reports the message
+struct Unsupported : std::runtime_error {
+    explicit Unsupported(const std::string& what) : std::runtime_error(what) {}
+};
+
+bool isFloatBased(Type::Kind kind) {
+    return kind == Type::Kind::FLOAT || isFloatVector(kind) || isMatrix(kind);
+}
+
+Type::Kind kindOf(const Type* type) {
+    if (!type) {
+        return Type::Kind::VOID;
+    }
+    if (type->kind == Type::Kind::STRUCT || type->kind == Type::Kind::ARRAY) {
+        throw Unsupported("struct and array types");
+    }
+    return type->kind;
+}
+
+// Components named by a swizzle ("xy", "rgb") or an index ("[2]")
+std::vector<int> componentsOf(const std::string& member) {
+    std::vector<int> components;
+    if (!member.empty() && member[0] == '[') {
+        components.push_back(std::atoi(member.c_str() + 1));
+        return components;
+    }
+    for (char c : member) {
+        switch (c) {
+            case 'x': case 'r': case 's': components.push_back(0); break;
+            case 'y': case 'g': case 't': components.push_back(1); break;
+            case 'z': case 'b': case 'p': components.push_back(2); break;
+            case 'w': case 'a': case 'q': components.push_back(3); break;
+            default: throw Unsupported("member '" + member + "'");
+        }
+    }
+    return components;
+}
+
+bool isBuiltinOutput(const std::string& name) {
+    return name == "gl_Position" || name == "gl_PointSize" || name == "gl_FragDepth";
+}
+
+class Lowerer {
+public:
+    Lowerer(Program& program, IRModule& module, const UniformityAnalysis* uniformity)
+        : program_(program), module_(module), uniformity_(uniformity),
+          noShader_("", ShaderDeclaration::ShaderType::VERTEX) {}
+    
+    void run() {
+        names_.resolve(program_);
+        purity_.analyze(program_);
+        programLookup_ = std::make_unique<FunctionLookup>(program_, noShader_);
+        
+        // Declare everything first so calls can refer to functions defined later
+        std::vector<std::pair<FunctionDeclaration*, const FunctionLookup*>> bodies;
+        std::vector<std::unique_ptr<FunctionLookup>> lookups;
+        for (auto& decl : program_.declarations) {
+            if (auto var = dynamic_cast<VariableDeclaration*>(decl.get())) {
+                module_.items.push_back({IRItem::Kind::GLOBAL, declareGlobal(*var, IR_NONE)});
+            } else if (auto func = dynamic_cast<FunctionDeclaration*>(decl.get())) {
+                module_.items.push_back({IRItem::Kind::FUNCTION, declareFunction(*func, IR_NONE)});
+                bodies.emplace_back(func, programLookup_.get());
+            } else if (auto shader = dynamic_cast<ShaderDeclaration*>(decl.get())) {
+                uint32_t index = static_cast<uint32_t>(module_.shaders.size());
+                IRShader ir;
+                ir.name = shader->name;
+                ir.stage = shader->shaderType;
+                module_.shaders.push_back(ir);
+                module_.items.push_back({IRItem::Kind::SHADER, index});
+                lookups.push_back(std::make_unique<FunctionLookup>(program_, *shader));
+                
+                for (auto& stmt : shader->body) {
+                    if (auto var = dynamic_cast<VariableDeclaration*>(stmt.get())) {
+                        module_.shaders[index].items.push_back({IRItem::Kind::GLOBAL, declareGlobal(*var, index)});
+                    } else if (auto func = dynamic_cast<FunctionDeclaration*>(stmt.get())) {
+                        uint32_t f = declareFunction(*func, index);
+                        module_.shaders[index].items.push_back({IRItem::Kind::FUNCTION, f});
+                        if (func == lookups.back()->entryPoint()) {
+                            module_.shaders[index].entryPoint = f;
+                            module_.functions[f].entryPoint = true;
+                        }
+                        bodies.emplace_back(func, lookups.back().get());
+                    }
+                }
+            }
+        }
+        
+        for (auto& body : bodies) {
+            lowerFunction(*body.first, body.second);
+        }
+        for (auto& init : initializers_) {
+            lowerInitializer(*init.first, init.second);
+        }
+        
+        for (auto& function : module_.functions) {
+            removeUnreachableBlocks(function);
+            removeTrivialPhis(function);
+        }
+    }
+    
+private:
+    Program& program_;
+    IRModule& module_;
+    const UniformityAnalysis* uniformity_;
+    NameResolution names_;
+    PurityAnalysis purity_; // Short-circuit operands that write cannot be evaluated eagerly
+    
+    ShaderDeclaration noShader_; // Lookup scope of program-level functions
+    std::unique_ptr<FunctionLookup> programLookup_;
+    
+    std::unordered_map<const VariableDeclaration*, uint32_t> globals_;
+    std::map<std::pair<uint32_t, std::string>, uint32_t> builtinGlobals_; // (shader, name)
+    std::unordered_map<const FunctionDeclaration*, uint32_t> functions_;
+    std::vector<std::pair<VariableDeclaration*, uint32_t>> initializers_; // (declaration, global)
+    
+    // Per-function state
+    IRFunction* function_ = nullptr;
+    uint32_t shader_ = IR_NONE;
+    const FunctionLookup* lookup_ = nullptr;
+    uint32_t block_ = 0;
+    std::vector<std::unordered_map<const VariableDeclaration*, IRValue>> definitions_; // Per block
+    std::vector<bool> sealed_;
+    std::vector<std::vector<std::pair<const VariableDeclaration*, IRValue>>> incompletePhis_;
+    std::unordered_map<uint32_t, IRValue> constants_; // Module constant -> value in the entry block
+    
+    uint32_t declareGlobal(VariableDeclaration& var, uint32_t shader) {
+        uint32_t index = static_cast<uint32_t>(module_.globals.size());
+        module_.globals.push_back({var.name, kindOf(var.type.get()), var.qualifier, shader, false, IR_NONE});
+        ValueRange range = annotatedRange(var);
+        module_.globals.back().rangeLow = range.low;
+        module_.globals.back().rangeHigh = range.high;
+        globals_[&var] = index;
+        if (var.initializer) {
+            initializers_.emplace_back(&var, index);
+        }
+        return index;
+    }
+    
+    uint32_t declareFunction(FunctionDeclaration& func, uint32_t shader) {
+        IRFunction function;
+        function.name = func.name;
+        function.returnType = kindOf(func.returnType.get());
+        function.shader = shader;
+        if (func.findAttribute("inline")) {
+            function.inlineHint = IRInlineHint::ALWAYS;
+        } else if (func.findAttribute("noinline")) {
+            function.inlineHint = IRInlineHint::NEVER;
+        }
+        function.fastMath = func.findAttribute("fast") != nullptr;
+        for (auto& param : func.parameters) {
+            if (param->qualifier == VariableDeclaration::Qualifier::OUT) {
+                throw Unsupported("out parameter '" + param->name + "' of " + func.name + "()");
+            }
+            function.parameters.push_back({param->name, kindOf(param->type.get())});
+        }
+        module_.functions.push_back(std::move(function));
+        
+        uint32_t index = static_cast<uint32_t>(module_.functions.size() - 1);
+        functions_[&func] = index;
+        return index;
+    }
+    
+    uint32_t builtinGlobal(const std::string& name, Type::Kind type) {
+        auto key = std::make_pair(shader_, name);
+        auto it = builtinGlobals_.find(key);
+        if (it != builtinGlobals_.end()) {
+            return it->second;
+        }
+        auto qualifier = isBuiltinOutput(name) ? VariableDeclaration::Qualifier::OUT : VariableDeclaration::Qualifier::IN;
+        module_.globals.push_back({name, type, qualifier, shader_, true, IR_NONE});
+        uint32_t index = static_cast<uint32_t>(module_.globals.size() - 1);
+        builtinGlobals_.emplace(key, index);
+        return index;
+    }
+    
+    void begin(IRFunction& function, const FunctionLookup* lookup) {
+        function_ = &function;
+        shader_ = function.shader;
+        lookup_ = lookup;
+        definitions_.clear();
+        sealed_.clear();
+        incompletePhis_.clear();
+        constants_.clear();
+        block_ = newBlock();
+        seal(block_);
+    }
+    
+    void lowerFunction(FunctionDeclaration& func, const FunctionLookup* lookup) {
+        IRFunction& function = module_.functions[functions_.at(&func)];
+        begin(function, lookup);
+        
+        for (size_t i = 0; i < func.parameters.size(); ++i) {
+            IRValue param = function.append(block_, IROp::PARAMETER, function.parameters[i].type, {},
+                                            static_cast<uint32_t>(i));
+            function.instructions[param].name = function.internName(func.parameters[i]->name);
+            writeVariable(func.parameters[i].get(), block_, param);
+        }
+        
+        lowerStatements(func.body);
+        
+        // Falling off the end of a non-void function returns an unspecified value
+        if (!terminated()) {
+            if (function.returnType == Type::Kind::VOID) {
+                function.append(block_, IROp::RETURN, Type::Kind::VOID);
+            } else {
+                function.append(block_, IROp::RETURN, Type::Kind::VOID, {zero(function.returnType)});
+            }
+        }
+    }
+    
+    void lowerInitializer(VariableDeclaration& var, uint32_t global) {
+        IRFunction function;
+        function.name = var.name + "_init";
+        function.returnType = module_.globals[global].type;
+        function.shader = module_.globals[global].shader;
+        function.initializer = true;
+        module_.functions.push_back(std::move(function));
+        
+        uint32_t index = static_cast<uint32_t>(module_.functions.size() - 1);
+        module_.globals[global].initializer = index;
+        
+        const FunctionLookup* lookup = programLookup_.get();
+        std::unique_ptr<FunctionLookup> shaderLookup;
+        if (module_.globals[global].shader != IR_NONE) {
+            for (auto& decl : program_.declarations) {
+                auto shader = dynamic_cast<ShaderDeclaration*>(decl.get());
+                if (shader && shader->name == module_.shaders[module_.globals[global].shader].name) {
+                    shaderLookup = std::make_unique<FunctionLookup>(program_, *shader);
+                    lookup = shaderLookup.get();
+                    break;
+                }
+            }
+        }
+        
+        begin(module_.functions[index], lookup);
+        IRValue value = convert(lowerExpression(var.initializer.get()), module_.globals[global].type);
+        function_->append(block_, IROp::RETURN, Type::Kind::VOID, {value});
+    }
+    
+    // --- SSA construction ---------------------------------------------------
+    
+    uint32_t newBlock() {
+        definitions_.emplace_back();
+        sealed_.push_back(false);
+        incompletePhis_.emplace_back();
+        return function_->addBlock();
+    }
+    
+    bool terminated() const {
+        return function_->terminator(block_) != IR_NONE;
+    }
+    
+    void writeVariable(const VariableDeclaration* var, uint32_t block, IRValue value) {
+        definitions_[block][var] = value;
+    }
+    
+    IRValue readVariable(const VariableDeclaration* var, uint32_t block) {
+        auto it = definitions_[block].find(var);
+        if (it != definitions_[block].end()) {
+            return it->second;
+        }
+        
+        IRValue value;
+        const auto& preds = function_->blocks[block].predecessors;
+        Type::Kind type = kindOf(var->type.get());
+        if (!sealed_[block]) {
+            value = newPhi(block, type, var);
+            incompletePhis_[block].emplace_back(var, value);
+        } else if (preds.empty()) {
+            // Read before any assignment; the value is unspecified
+            value = zero(type);
+        } else if (preds.size() == 1) {
+            value = readVariable(var, preds[0]);
+        } else {
+            value = newPhi(block, type, var);
+            writeVariable(var, block, value); // Breaks cycles through loops
+            addPhiOperands(var, value);
+        }
+        writeVariable(var, block, value);
+        return value;
+    }
+    
+    IRValue newPhi(uint32_t block, Type::Kind type, const VariableDeclaration* var) {
+        IRValue phi = function_->create(IROp::PHI, type);
+        function_->instructions[phi].name = function_->internName(var->name);
+        
+        size_t position = 0;
+        const auto& list = function_->blocks[block].instructions;
+        while (position < list.size() && function_->instructions[list[position]].op == IROp::PHI) {
+            ++position;
+        }
+        function_->insert(block, position, phi);
+        return phi;
+    }
+    
+    void addPhiOperands(const VariableDeclaration* var, IRValue phi) {
+        uint32_t block = function_->instructions[phi].block;
+        std::vector<IRValue> args;
+        for (uint32_t pred : function_->blocks[block].predecessors) {
+            args.push_back(readVariable(var, pred));
+        }
+        function_->setOperands(phi, args);
+    }
+    
+    void seal(uint32_t block) {
+        auto pending = std::move(incompletePhis_[block]);
+        incompletePhis_[block].clear();
+        for (auto& entry : pending) {
+            addPhiOperands(entry.first, entry.second);
+        }
+        sealed_[block] = true;
+    }
+    
+    // --- Values -------------------------------------------------------------
+    
+    IRValue constant(Type::Kind type, const std::vector<double>& components) {
+        uint32_t index = module_.constant(type, components);
+        auto it = constants_.find(index);
+        if (it != constants_.end()) {
+            return it->second;
+        }
+        // Constants live at the top of the entry block so they dominate every use
+        IRValue value = function_->create(IROp::CONSTANT, type, {}, index);
+        function_->insert(0, 0, value);
+        constants_.emplace(index, value);
+        return value;
+    }
+    
+    IRValue zero(Type::Kind type) {
+        return constant(type, std::vector<double>(static_cast<size_t>(componentCount(type)), 0.0));
+    }
+    
+    IRValue emit(IROp op, Type::Kind type, const std::vector<IRValue>& args, uint32_t imm = 0) {
+        return function_->append(block_, op, type, args, imm);
+    }
+    
+    Type::Kind typeOf(IRValue value) const {
+        return function_->instructions[value].type;
+    }
+    
+    IRValue toFloat(IRValue value) {
+        if (typeOf(value) != Type::Kind::INT) {
+            return value;
+        }
+        const IRInstruction& inst = function_->instructions[value];
+        if (inst.op == IROp::CONSTANT) {
+            return constant(Type::Kind::FLOAT, module_.constants[inst.imm].components);
+        }
+        return emit(IROp::CONSTRUCT, Type::Kind::FLOAT, {value});
+    }
+    
+    // Applies the implicit conversions of assignment (int to float)
+    IRValue convert(IRValue value, Type::Kind type) {
+        return type == Type::Kind::FLOAT ? toFloat(value) : value;
+    }
+    
+    void nameValue(IRValue value, const std::string& name) {
+        IRInstruction& inst = function_->instructions[value];
+        if (inst.name == 0 && inst.op != IROp::CONSTANT && inst.op != IROp::PARAMETER && inst.op != IROp::LOAD) {
+            inst.name = function_->internName(name);
+        }
+    }
+    
+    uint32_t hint(const Statement& stmt) const {
+        if (!uniformity_) {
+            return BRANCH_UNKNOWN;
+        }
+        return uniformity_->isUniformBranch(&stmt) ? BRANCH_UNIFORM : BRANCH_DIVERGENT;
+    }
+    
+    // --- Statements ---------------------------------------------------------
+    
+    void lowerStatements(std::vector<StatementPtr>& statements) {
+        for (auto& stmt : statements) {
+            if (terminated()) {
+                break; // Unreachable after a return
+            }
+            lowerStatement(stmt.get());
+        }
+    }
+    
+    void lowerStatement(Statement* stmt) {
+        if (!stmt) {
+            return;
+        }
+        
+        if (auto expr = dynamic_cast<ExpressionStatement*>(stmt)) {
+            lowerExpression(expr->expression.get());
+        } else if (auto assignment = dynamic_cast<AssignmentStatement*>(stmt)) {
+            assign(assignment->target.get(), lowerExpression(assignment->value.get()));
+        } else if (auto var = dynamic_cast<VariableDeclaration*>(stmt)) {
+            Type::Kind type = kindOf(var->type.get());
+            IRValue value = var->initializer ? convert(lowerExpression(var->initializer.get()), type) : zero(type);
+            nameValue(value, var->name);
+            writeVariable(var, block_, value);
+        } else if (auto block = dynamic_cast<BlockStatement*>(stmt)) {
+            lowerStatements(block->statements);
+        } else if (auto ifStmt = dynamic_cast<IfStatement*>(stmt)) {
+            lowerIf(*ifStmt);
+        } else if (auto forStmt = dynamic_cast<ForStatement*>(stmt)) {
+            lowerStatement(forStmt->initialization.get());
+            lowerLoop(*forStmt, forStmt->condition.get(), forStmt->body.get(), forStmt->update.get());
+        } else if (auto whileStmt = dynamic_cast<WhileStatement*>(stmt)) {
+            lowerLoop(*whileStmt, whileStmt->condition.get(), whileStmt->body.get(), nullptr);
+        } else if (auto ret = dynamic_cast<ReturnStatement*>(stmt)) {
+            if (ret->value) {
+                IRValue value = convert(lowerExpression(ret->value.get()), function_->returnType);
+                emit(IROp::RETURN, Type::Kind::VOID, {value});
+            } else {
+                emit(IROp::RETURN, Type::Kind::VOID, {});
+            }
+        } else {
+            throw Unsupported("nested declaration");
+        }
+    }
+    
+    void lowerIf(IfStatement& stmt) {
+        IRValue condition = lowerExpression(stmt.condition.get());
+        uint32_t header = block_;
+        uint32_t thenBlock = newBlock();
+        uint32_t elseBlock = stmt.elseStatement ? newBlock() : IR_NONE;
+        uint32_t merge = newBlock();
+        
+        function_->condBranch(header, condition, thenBlock, stmt.elseStatement ? elseBlock : merge, hint(stmt));
+        IRBranchControl control = stmt.findAttribute("flatten")  ? IRBranchControl::FLATTEN
+                                  : stmt.findAttribute("branch") ? IRBranchControl::BRANCH
+                                                                 : IRBranchControl::DEFAULT;
+        function_->instructions[function_->terminator(header)].imm = static_cast<uint32_t>(control);
+        function_->blocks[header].structure = IRStructure::SELECTION;
+        function_->blocks[header].merge = merge;
+        
+        seal(thenBlock);
+        block_ = thenBlock;
+        lowerStatement(stmt.thenStatement.get());
+        if (!terminated()) {
+            function_->branch(block_, merge);
+        }
+        
+        if (stmt.elseStatement) {
+            seal(elseBlock);
+            block_ = elseBlock;
+            lowerStatement(stmt.elseStatement.get());
+            if (!terminated()) {
+                function_->branch(block_, merge);
+            }
+        }
+        
+        // With both arms returning, code after the if is unreachable and
+        // removed after lowering
+        seal(merge);
+        block_ = merge;
+    }
+    
+    // preheader -> header (condition) -> body -> latch (update) -> header, exiting from the header
+    void lowerLoop(Statement& stmt, Expression* condition, Statement* body, Statement* update) {
+        uint32_t header = newBlock();
+        uint32_t bodyBlock = newBlock();
+        uint32_t latch = newBlock();
+        uint32_t exit = newBlock();
+        function_->branch(block_, header);
+        
+        block_ = header;
+        IRValue test = condition ? lowerExpression(condition) : constant(Type::Kind::BOOL, {1.0});
+        if (block_ != header) {
+            throw Unsupported("control flow in a loop condition");
+        }
+        function_->condBranch(header, test, bodyBlock, exit, hint(stmt));
+        function_->blocks[header].structure = IRStructure::LOOP;
+        function_->blocks[header].merge = exit;
+        function_->blocks[header].continueTarget = latch;
+        
+        seal(bodyBlock);
+        block_ = bodyBlock;
+        lowerStatement(body);
+        if (!terminated()) {
+            function_->branch(block_, latch);
+        }
+        
+        seal(latch);
+        block_ = latch;
+        lowerStatement(update);
+        function_->branch(latch, header);
+        
+        seal(header);
+        seal(exit);
+        block_ = exit;
+    }
+    
+    // --- Expressions --------------------------------------------------------
+    
+    Type::Kind resultKind(Expression* expr) {
+        if (!expr->resultType) {
+            throw Unsupported("expression without a type at line " + std::to_string(expr->line));
+        }
+        return kindOf(expr->resultType.get());
+    }
+    
+    IRValue lowerExpression(Expression* expr) {
+        Type::Kind type = resultKind(expr);
+        
+        if (auto ident = dynamic_cast<IdentifierExpression*>(expr)) {
+            const VariableDeclaration* var = names_.find(*ident);
+            if (var && names_.isLocal(var)) {
+                return readVariable(var, block_);
+            }
+            if (var) {
+                return emit(IROp::LOAD, type, {}, globals_.at(var));
+            }
+            if (ident->name == "true" || ident->name == "false") {
+                return constant(Type::Kind::BOOL, {ident->name == "true" ? 1.0 : 0.0});
+            }
+            return emit(IROp::LOAD, type, {}, builtinGlobal(ident->name, type));
+        }
+        
+        if (auto literal = dynamic_cast<LiteralExpression*>(expr)) {
+            switch (literal->literalType) {
+                case LiteralExpression::LiteralType::INT:
+                case LiteralExpression::LiteralType::FLOAT:
+                    return constant(type, {std::stod(literal->value)});
+                case LiteralExpression::LiteralType::BOOL:
+                    return constant(Type::Kind::BOOL, {literal->value == "true" ? 1.0 : 0.0});
+                case LiteralExpression::LiteralType::STRING:
+                    throw Unsupported("string literal");
+            }
+        }
+        
+        if (auto binary = dynamic_cast<BinaryExpression*>(expr)) {
+            return lowerBinary(*binary, type);
+        }
+        
+        if (auto unary = dynamic_cast<UnaryExpression*>(expr)) {
+            IRValue operand = lowerExpression(unary->operand.get());
+            return emit(unary->op == UnaryExpression::Operator::MINUS ? IROp::NEG : IROp::NOT, type, {operand});
+        }
+        
+        if (auto call = dynamic_cast<FunctionCallExpression*>(expr)) {
+            return lowerCall(*call, type);
+        }
+        
+        if (auto member = dynamic_cast<MemberAccessExpression*>(expr)) {
+            IRValue object = lowerExpression(member->object.get());
+            Type::Kind objectType = typeOf(object);
+            std::vector<int> components = componentsOf(member->member);
+            if (isMatrix(objectType) && member->member[0] == '[') {
+                return emit(IROp::EXTRACT, type, {object}, static_cast<uint32_t>(components[0]));
+            }
+            if (!isFloatVector(objectType)) {
+                throw Unsupported("member access on " + typeName(objectType));
+            }
+            return emit(IROp::SWIZZLE, type, {object}, packSwizzle(components));
+        }
+        
+        throw Unsupported("expression at line " + std::to_string(expr->line));
+    }
+    
+    IRValue lowerBinary(BinaryExpression& binary, Type::Kind type) {
+        using Op = BinaryExpression::Operator;
+        
+        if (binary.op == Op::ASSIGN) {
+            IRValue value = lowerExpression(binary.right.get());
+            return assign(binary.left.get(), value);
+        }
+        
+        IRValue left = lowerExpression(binary.left.get());
+        if ((binary.op == Op::LOGICAL_AND || binary.op == Op::LOGICAL_OR) && hasSideEffects(binary.right.get())) {
+            throw Unsupported("short-circuit operand with side effects at line " + std::to_string(binary.line));
+        }
+        IRValue right = lowerExpression(binary.right.get());
+        
+        IROp op;
+        switch (binary.op) {
+            case Op::ADD: op = IROp::ADD; break;
+            case Op::SUBTRACT: op = IROp::SUB; break;
+            case Op::MULTIPLY: op = IROp::MUL; break;
+            case Op::DIVIDE: op = IROp::DIV; break;
+            case Op::MODULO: op = IROp::MOD; break;
+            case Op::EQUAL: op = IROp::EQ; break;
+            case Op::NOT_EQUAL: op = IROp::NE; break;
+            case Op::LESS_THAN: op = IROp::LT; break;
+            case Op::LESS_EQUAL: op = IROp::LE; break;
+            case Op::GREATER_THAN: op = IROp::GT; break;
+            case Op::GREATER_EQUAL: op = IROp::GE; break;
+            case Op::LOGICAL_AND: op = IROp::AND; break;
+            default: op = IROp::OR; break;
+        }
+        
+        // int operands meet float ones as float
+        bool mixed = isFloatBased(typeOf(left)) != isFloatBased(typeOf(right));
+        if (isFloatBased(type) || (type == Type::Kind::BOOL && mixed)) {
+            left = toFloat(left);
+            right = toFloat(right);
+        }
+        return emit(op, type, {left, right});
+    }
+    
+    IRValue lowerCall(FunctionCallExpression& call, Type::Kind type) {
+        std::vector<IRValue> args;
+        for (auto& arg : call.arguments) {
+            args.push_back(lowerExpression(arg.get()));
+        }
+        
+        if (FunctionDeclaration* callee = lookup_->resolve(call)) {
+            for (size_t i = 0; i < args.size() && i < callee->parameters.size(); ++i) {
+                args[i] = convert(args[i], kindOf(callee->parameters[i]->type.get()));
+            }
+            return emit(IROp::CALL, type, args, functions_.at(callee));
+        }
+        
+        if (call.builtin != BuiltinId::NONE) {
+            if (isFloatBased(type)) {
+                for (IRValue& arg : args) {
+                    arg = toFloat(arg);
+                }
+            }
+            IRValue value = emit(IROp::BUILTIN, type, args, static_cast<uint32_t>(call.builtin));
+            function_->instructions[value].line = static_cast<uint32_t>(call.line);
+            function_->instructions[value].column = static_cast<uint32_t>(call.column);
+            return value;
+        }
+        
+        Type::Kind constructed;
+        if (typeFromName(call.functionName, constructed)) {
+            return emit(IROp::CONSTRUCT, type, args);
+        }
+        throw Unsupported("call to unknown function '" + call.functionName + "'");
+    }
+    
+    bool hasSideEffects(Expression* expr) const {
+        if (!expr) {
+            return false;
+        }
+        if (auto binary = dynamic_cast<BinaryExpression*>(expr)) {
+            return binary->op == BinaryExpression::Operator::ASSIGN || hasSideEffects(binary->left.get()) ||
+                   hasSideEffects(binary->right.get());
+        }
+        if (auto unary = dynamic_cast<UnaryExpression*>(expr)) {
+            return hasSideEffects(unary->operand.get());
+        }
+        if (auto member = dynamic_cast<MemberAccessExpression*>(expr)) {
+            return hasSideEffects(member->object.get());
+        }
+        if (auto call = dynamic_cast<FunctionCallExpression*>(expr)) {
+            if (!PurityAnalysis::isRemovable(purity_.effectsOf(*call))) {
+                return true;
+            }
+            for (auto& arg : call->arguments) {
+                if (hasSideEffects(arg.get())) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+    
+    // Writes `value` to an assignable expression; returns the converted value
+    IRValue assign(Expression* target, IRValue value) {
+        value = convert(value, resultKind(target));
+        
+        if (auto ident = dynamic_cast<IdentifierExpression*>(target)) {
+            const VariableDeclaration* var = names_.find(*ident);
+            if (var && names_.isLocal(var)) {
+                nameValue(value, var->name);
+                writeVariable(var, block_, value);
+            } else {
+                uint32_t global = var ? globals_.at(var) : builtinGlobal(ident->name, resultKind(target));
+                emit(IROp::STORE, Type::Kind::VOID, {value}, global);
+            }
+            return value;
+        }
+        
+        auto member = dynamic_cast<MemberAccessExpression*>(target);
+        if (!member) {
+            throw Unsupported("assignment target at line " + std::to_string(target->line));
+        }
+        
+        Type::Kind objectType = resultKind(member->object.get());
+        if (!isFloatVector(objectType)) {
+            throw Unsupported("assignment into a " + typeName(objectType) + " component");
+        }
+        uint32_t mask = packSwizzle(componentsOf(member->member));
+        
+        // Partial writes of globals store just the components
+        if (auto ident = dynamic_cast<IdentifierExpression*>(member->object.get())) {
+            const VariableDeclaration* var = names_.find(*ident);
+            if (!var || !names_.isLocal(var)) {
+                uint32_t global = var ? globals_.at(var) : builtinGlobal(ident->name, objectType);
+                IRValue store = emit(IROp::STORE, Type::Kind::VOID, {value}, global);
+                function_->instructions[store].aux = mask;
+                return value;
+            }
+        }
+        
+        IRValue object = lowerExpression(member->object.get());
+        IRValue updated = emit(IROp::INSERT, objectType, {object, value}, mask);
+        assign(member->object.get(), updated);
+        return value;
+    }
+};
+
+} // anonymous namespace
+
+bool IRLowering::lower(Program& program, IRModule& module, const UniformityAnalysis* uniformity) {
+    error_.clear();
+    module = IRModule();
+    try {
+        Lowerer lowerer(program, module, uniformity);
+        lowerer.run();
+    } catch (const Unsupported& e) {
+        error_ = "IR lowering does not support " + std::string(e.what());
+        return false;
+    }
+    
+    std::string problem = verifyIR(module);
+    if (!problem.empty()) {
+        error_ = "invalid IR: " + problem;
+        return false;
+    }
+    return true;
+}
+
+} // namespace sdl
@@ -0,0 +1,212 @@
+#include "ir/passes.h"
+#include "semantic/types.h"
+#include <algorithm>
+#include <map>
+
+namespace sdl {
+
+namespace {
+
+// (shader, factors) to the uniform of that shader holding their product
+using ProductCache = std::map<std::pair<uint32_t, std::vector<uint32_t>>, uint32_t>;
+
+class MatrixChains {
+public:
+    MatrixChains(IRFunction& function, IRModule& module, PassContext& context,
+                 ProductCache& products)
+        : function_(function), module_(module), context_(context), products_(products) {}
+    
+    bool run() {
+        analyze();
+        bool changed = false;
+        for (uint32_t b = 0; b < function_.blocks.size(); ++b) {
+            for (IRValue value : std::vector<IRValue>(function_.blocks[b].instructions)) {
+                if (function_.instructions[value].block != IR_NONE && isRoot(value)) {
+                    changed |= rewrite(value);
+                }
+            }
+        }
+        return changed;
+    }
+    
+private:
+    IRFunction& function_;
+    IRModule& module_;
+    PassContext& context_;
+    ProductCache& products_;
+    std::vector<uint32_t> uses_;
+    std::vector<bool> chained_; // Operand of a product
+    
+    const IRInstruction& inst(IRValue value) const { return function_.instructions[value]; }
+    bool matrix(IRValue value) const { return isMatrix(inst(value).type); }
+    
+    // Linear-algebra product: matrix by matrix or matrix and vector; a
+    // scalar factor scales componentwise
+    bool product(IRValue value) const {
+        if (inst(value).op != IROp::MUL) {
+            return false;
+        }
+        Type::Kind left = inst(function_.operand(value, 0)).type;
+        Type::Kind right = inst(function_.operand(value, 1)).type;
+        return (isMatrix(left) && (isMatrix(right) || isFloatVector(right))) ||
+               (isFloatVector(left) && isMatrix(right));
+    }
+    
+    // A matrix product only the next product of its chain uses. Products
+    // used more than once stay, so no work is repeated.
+    bool interior(IRValue value) const {
+        return product(value) && matrix(value) && uses_[value] == 1;
+    }
+    
+    // Interior products are rewritten with the chain they end up in
+    bool isRoot(IRValue value) const {
+        return product(value) && !(interior(value) && chained_[value]);
+    }
+    
+    void analyze() {
+        uses_ = function_.useCounts();
+        chained_.assign(function_.instructions.size(), false);
+        for (const auto& block : function_.blocks) {
+            for (IRValue value : block.instructions) {
+                if (product(value)) {
+                    chained_[function_.operand(value, 0)] = true;
+                    chained_[function_.operand(value, 1)] = true;
+                }
+            }
+        }
+    }
+    
+    void flatten(IRValue value, std::vector<IRValue>& factors, std::vector<IRValue>& products) const {
+        if (!interior(value)) {
+            factors.push_back(value);
+            return;
+        }
+        products.push_back(value);
+        flatten(function_.operand(value, 0), factors, products);
+        flatten(function_.operand(value, 1), factors, products);
+    }
+    
+    // The uniform a factor loads, or IR_NONE
+    uint32_t uniformOf(IRValue value) const {
+        if (!matrix(value) || inst(value).op != IROp::LOAD) {
+            return IR_NONE;
+        }
+        const IRGlobal& global = module_.globals[inst(value).imm];
+        bool uniform = global.qualifier == VariableDeclaration::Qualifier::UNIFORM && !global.builtin;
+        return uniform ? inst(value).imm : IR_NONE;
+    }
+    
+    bool rewrite(IRValue root) {
+        std::vector<IRValue> factors;
+        std::vector<IRValue> products{root};
+        flatten(function_.operand(root, 0), factors, products);
+        flatten(function_.operand(root, 1), factors, products);
+        bool vectorLast = !matrix(factors.back());
+        bool vectorFirst = !matrix(factors.front());
+        
+        // Runs of two or more uniforms become one uniform the host multiplies
+        bool folded = false;
+        if (context_.foldUniformProducts && function_.shader != IR_NONE && !function_.initializer) {
+            std::vector<IRValue> merged;
+            for (size_t n = 0; n < factors.size();) {
+                size_t end = n;
+                while (end < factors.size() && uniformOf(factors[end]) != IR_NONE) {
+                    ++end;
+                }
+                if (end - n >= 2) {
+                    std::vector<uint32_t> uniforms;
+                    for (size_t k = n; k < end; ++k) {
+                        uniforms.push_back(uniformOf(factors[k]));
+                    }
+                    merged.push_back(function_.create(IROp::LOAD, inst(factors[n]).type, {}, productOf(uniforms)));
+                    context_.statistics["reassociate-matrices.folded"] += static_cast<int>(end - n) - 1;
+                    folded = true;
+                    n = end;
+                } else {
+                    merged.push_back(factors[n++]);
+                }
+            }
+            factors = merged;
+        }
+        
+        // A chain applied to a vector is cheaper as matrix-vector products,
+        // n^2 operations per factor against n^3 for a matrix product
+        bool reassociate = (vectorLast || vectorFirst) && factors.size() > 2;
+        if (!reassociate && !folded) {
+            return false;
+        }
+        
+        auto& list = function_.blocks[inst(root).block].instructions;
+        size_t position = std::find(list.begin(), list.end(), root) - list.begin();
+        uint32_t block = inst(root).block;
+        auto place = [&](IRValue value) { function_.insert(block, position++, value); };
+        for (IRValue value : factors) {
+            if (inst(value).block == IR_NONE) {
+                place(value);
+            }
+        }
+        
+        IRValue result;
+        if (vectorLast) {
+            result = factors.back();
+            for (size_t n = factors.size() - 1; n-- > 0;) {
+                result = function_.create(IROp::MUL, inst(root).type, {factors[n], result});
+                place(result);
+            }
+        } else {
+            result = factors.front();
+            for (size_t n = 1; n < factors.size(); ++n) {
+                result = function_.create(IROp::MUL, inst(root).type, {result, factors[n]});
+                place(result);
+            }
+        }
+        
+        function_.instructions[result].name = inst(root).name;
+        function_.replaceAllUses(root, result);
+        for (IRValue product : products) {
+            function_.remove(product);
+        }
+        if (reassociate) {
+            ++context_.statistics["reassociate-matrices.chains"];
+        }
+        analyze();
+        return true;
+    }
+    
+    // The uniform the shader's preshader multiplies the given ones into,
+    // added on first use
+    uint32_t productOf(const std::vector<uint32_t>& uniforms) {
+        uint32_t shader = function_.shader;
+        auto known = products_.find({shader, uniforms});
+        if (known != products_.end()) {
+            return known->second;
+        }
+        
+        IRValue product = IR_NONE;
+        for (uint32_t index : uniforms) {
+            const IRGlobal& global = module_.globals[index];
+            IRValue factor = appendToPreshader(module_, shader, IROp::LOAD, global.type, {}, index);
+            if (product == IR_NONE) {
+                product = factor;
+            } else {
+                product = appendToPreshader(module_, shader, IROp::MUL, global.type, {product, factor});
+            }
+        }
+        return products_[{shader, uniforms}] = addDerivedUniform(module_, shader, "", product);
+    }
+};
+
+} // anonymous namespace
+
+bool reassociateMatrixChains(IRModule& module, PassContext& context) {
+    ProductCache products;
+    bool changed = false;
+    for (auto& function : module.functions) {
+        if (!function.blocks.empty()) {
+            changed |= MatrixChains(function, module, context, products).run();
+        }
+    }
+    return changed;
+}
+
+} // namespace sdl
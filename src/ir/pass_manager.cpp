@@ -0,0 +1,208 @@
+#include "ir/pass_manager.h"
+#include "ir/passes.h"
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+namespace sdl {
+
+namespace {
+
+struct PassInfo {
+    const char* name;
+    bool (*run)(IRModule&, PassContext&);
+    const char* description;
+};
+
+const PassInfo passTable[] = {
+#define SDL_IR_PASS(name, function, description) {name, function, description},
+#include "ir/passes.def"
+#undef SDL_IR_PASS
+};
+
+const PassInfo* findPass(const std::string& name) {
+    for (const auto& pass : passTable) {
+        if (name == pass.name) {
+            return &pass;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<std::string> splitPasses(const std::string& passes) {
+    std::vector<std::string> names;
+    std::stringstream stream(passes);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        if (!name.empty()) {
+            names.push_back(name);
+        }
+    }
+    return names;
+}
+
+void measure(const IRModule& module, size_t& instructions, size_t& blocks) {
+    instructions = 0;
+    blocks = 0;
+    for (const auto& function : module.functions) {
+        blocks += function.blocks.size();
+        for (const auto& block : function.blocks) {
+            instructions += block.instructions.size();
+        }
+    }
+}
+
+std::string formatDelta(size_t before, size_t after) {
+    long long delta = static_cast<long long>(after) - static_cast<long long>(before);
+    return std::to_string(before) + " -> " + std::to_string(after) +
+           (delta > 0 ? " (+" + std::to_string(delta) + ")" : delta < 0 ? " (" + std::to_string(delta) + ")" : "");
+}
+
+} // anonymous namespace
+
+const char* PassManager::pipeline(OptimizationLevel level) {
+    switch (level) {
+        case OptimizationLevel::O0: return "";
+        case OptimizationLevel::O1:
+            return "fold-constants,simplify-algebra,simplify-cfg,licm,dce,strip-globals";
+        // Inlining and unrolling expose constant arguments, constant loop
+        // counters and repeated work to the passes after them. Precision is
+        // inferred last, on the code that gets printed.
+        case OptimizationLevel::O2:
+            return "fold-constants,simplify-cfg,inline,fold-constants,simplify-cfg,unroll,"
+                   "fold-constants,simplify-algebra,reassociate-matrices,simplify-cfg,if-convert,simplify-cfg,licm,"
+                   "hoist-to-vertex,gvn,extract-preshader,dce,strip-globals,infer-precision";
+        // Hoisting and merging leave expressions the algebra rules may
+        // simplify further, so they run once more
+        case OptimizationLevel::O3:
+            return "fold-constants,simplify-cfg,inline,fold-constants,simplify-cfg,unroll,"
+                   "fold-constants,simplify-algebra,reassociate-matrices,simplify-cfg,if-convert,simplify-cfg,licm,"
+                   "hoist-to-vertex,gvn,extract-preshader,fold-constants,simplify-algebra,gvn,dce,strip-globals,"
+                   "infer-precision";
+        // No unrolling, which only grows the code
+        case OptimizationLevel::OS:
+            return "fold-constants,simplify-cfg,inline,fold-constants,simplify-cfg,"
+                   "simplify-algebra,reassociate-matrices,simplify-cfg,if-convert,simplify-cfg,licm,"
+                   "hoist-to-vertex,gvn,extract-preshader,dce,strip-globals,infer-precision";
+    }
+    return "";
+}
+
+std::vector<std::string> PassManager::passNames() {
+    std::vector<std::string> names;
+    for (const auto& pass : passTable) {
+        names.push_back(pass.name);
+    }
+    return names;
+}
+
+PassManager::PassManager(OptimizationLevel level) : pipeline_(splitPasses(pipeline(level))) {
+    context_.level = level;
+}
+
+bool PassManager::checkPassName(const std::string& pass) {
+    if (findPass(pass)) {
+        return true;
+    }
+    error_ = "Unknown pass '" + pass + "'; available passes:";
+    for (const auto& name : passNames()) {
+        error_ += " " + name;
+    }
+    return false;
+}
+
+bool PassManager::setPipeline(const std::string& passes) {
+    std::vector<std::string> names = splitPasses(passes);
+    for (const auto& name : names) {
+        if (!checkPassName(name)) {
+            return false;
+        }
+    }
+    pipeline_ = std::move(names);
+    return true;
+}
+
+bool PassManager::setPrintBefore(const std::string& pass) {
+    if (pass != "all" && !checkPassName(pass)) {
+        return false;
+    }
+    printBefore_ = pass;
+    return true;
+}
+
+bool PassManager::setPrintAfter(const std::string& pass) {
+    if (pass != "all" && !checkPassName(pass)) {
+        return false;
+    }
+    printAfter_ = pass;
+    return true;
+}
+
+bool PassManager::run(IRModule& module) {
+    timings_.clear();
+    dumps_.clear();
+    context_.statistics.clear();
+    error_.clear();
+    
+    for (const auto& name : pipeline_) {
+        const PassInfo* pass = findPass(name);
+        if (printBefore_ == "all" || printBefore_ == name) {
+            dumps_ += "*** IR before " + name + " ***\n" + dumpIR(module);
+        }
+        
+        PassTiming timing;
+        timing.pass = name;
+        measure(module, timing.instructionsBefore, timing.blocksBefore);
+        auto start = std::chrono::steady_clock::now();
+        timing.changed = pass->run(module, context_);
+        auto end = std::chrono::steady_clock::now();
+        timing.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+        measure(module, timing.instructionsAfter, timing.blocksAfter);
+        if (timing_) {
+            timings_.push_back(timing);
+        }
+        
+        if (printAfter_ == "all" || printAfter_ == name) {
+            dumps_ += "*** IR after " + name + " ***\n" + dumpIR(module);
+        }
+        
+        std::string problem = verifyIR(module);
+        if (!problem.empty()) {
+            error_ = "pass " + name + " produced invalid IR: " + problem;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string PassManager::formatTimings() const {
+    std::ostringstream text;
+    text << "Pass timings:\n";
+    double total = 0.0;
+    for (const auto& timing : timings_) {
+        char milliseconds[32];
+        std::snprintf(milliseconds, sizeof(milliseconds), "%9.3f ms", timing.milliseconds);
+        text << "  " << timing.pass << std::string(timing.pass.size() < 24 ? 24 - timing.pass.size() : 1, ' ')
+             << milliseconds << "  instructions " << formatDelta(timing.instructionsBefore, timing.instructionsAfter)
+             << ", blocks " << formatDelta(timing.blocksBefore, timing.blocksAfter) << "\n";
+        total += timing.milliseconds;
+    }
+    char milliseconds[32];
+    std::snprintf(milliseconds, sizeof(milliseconds), "%9.3f ms", total);
+    text << "  total" << std::string(19, ' ') << milliseconds << "\n";
+    text << formatStatistics();
+    return text.str();
+}
+
+std::string PassManager::formatStatistics() const {
+    std::ostringstream text;
+    for (const auto& counter : context_.statistics) {
+        if (counter.second != 0) {
+            text << (text.tellp() == 0 ? "Pass statistics:\n" : "") << "  " << counter.first << ": "
+                 << counter.second << "\n";
+        }
+    }
+    return text.str();
+}
+
+} // namespace sdl
@@ -0,0 +1,292 @@
+#include "ir/passes.h"
+#include "analysis/value_range.h"
+#include "semantic/types.h"
+#include <cmath>
+
+namespace sdl {
+
+namespace {
+
+// Half-precision values stay below this magnitude: the range GLSL ES
+// guarantees for mediump, well inside the 65504 an IEEE half holds
+constexpr double HALF_LIMIT = 16384.0;
+
+// A phi whose range keeps growing after this many updates is widened to
+// unbounded, which is where accumulators across iterations end up
+constexpr int MAX_WIDENINGS = 4;
+
+bool isFloat(Type::Kind type) {
+    return type == Type::Kind::FLOAT || isFloatVector(type);
+}
+
+// Arguments whose absolute error matters, not just their leading bits: a
+// half of 1000 is off by up to 0.25, which fract() or sin() turn into noise,
+// and a texture coordinate needs more than 11 bits to address a large texture
+bool sensitiveArgument(BuiltinId id, uint32_t index) {
+    switch (id) {
+        case BuiltinId::SIN:
+        case BuiltinId::COS:
+        case BuiltinId::TAN:
+        case BuiltinId::FLOOR:
+        case BuiltinId::CEIL:
+        case BuiltinId::FRACT:
+        case BuiltinId::MOD:
+        case BuiltinId::EXP:
+        case BuiltinId::EXP2:
+        case BuiltinId::DFDX:
+        case BuiltinId::DFDY:
+        case BuiltinId::FWIDTH:
+            return true;
+        case BuiltinId::POW:
+            return index == 1;
+        case BuiltinId::TEXTURE:
+        case BuiltinId::TEXTURE_LOD:
+            return index >= 1;
+        default:
+            return false;
+    }
+}
+
+class PrecisionInference {
+public:
+    PrecisionInference(IRFunction& function, const IRModule& module) : function_(function), module_(module) {}
+    
+    // Number of values lowered to MEDIUM; sets `changed` if any precision moved
+    int run(bool& changed) {
+        computeRanges();
+        computeDemand();
+        
+        int lowered = 0;
+        for (const auto& block : function_.blocks) {
+            for (IRValue value : block.instructions) {
+                IRInstruction& i = function_.instructions[value];
+                IRPrecision precision = halfSuffices(value) ? IRPrecision::MEDIUM : IRPrecision::HIGH;
+                changed |= i.precision != precision;
+                i.precision = precision;
+                lowered += precision == IRPrecision::MEDIUM;
+            }
+        }
+        return lowered;
+    }
+    
+private:
+    IRFunction& function_;
+    const IRModule& module_;
+    std::vector<ValueRange> ranges_;
+    std::vector<bool> demanded_; // Feeds something that needs full precision
+    
+    const IRInstruction& inst(IRValue value) const { return function_.instructions[value]; }
+    
+    bool halfSuffices(IRValue value) const {
+        const IRInstruction& i = inst(value);
+        // Leaves and calls keep the precision they are declared with
+        if (!isFloat(i.type) || i.op == IROp::CONSTANT || i.op == IROp::PARAMETER || i.op == IROp::LOAD ||
+            i.op == IROp::CALL) {
+            return false;
+        }
+        if (demanded_[value] || !ranges_[value].within(-HALF_LIMIT, HALF_LIMIT)) {
+            return false;
+        }
+        // Half arithmetic converts its operands to half as well, including
+        // full-precision ones, so they must fit too
+        bool arithmetic = i.op == IROp::ADD || i.op == IROp::SUB || i.op == IROp::MUL || i.op == IROp::DIV ||
+                          i.op == IROp::NEG;
+        for (uint32_t k = 0; arithmetic && k < i.operandCount; ++k) {
+            IRValue operand = function_.operand(value, k);
+            if (isFloat(inst(operand).type) && !ranges_[operand].within(-HALF_LIMIT, HALF_LIMIT)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // --- Ranges -------------------------------------------------------------
+    
+    void computeRanges() {
+        ranges_.assign(function_.instructions.size(), ValueRange::empty());
+        std::vector<int> growth(function_.instructions.size(), 0);
+        std::vector<uint32_t> order = reversePostorder(function_);
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (uint32_t b : order) {
+                for (IRValue value : function_.blocks[b].instructions) {
+                    ValueRange range = evaluate(value);
+                    if (range == ranges_[value]) {
+                        continue;
+                    }
+                    if (inst(value).op == IROp::PHI && ++growth[value] > MAX_WIDENINGS) {
+                        range = ValueRange::full();
+                    }
+                    changed = true;
+                    ranges_[value] = range;
+                }
+            }
+        }
+    }
+    
+    ValueRange operandRange(IRValue value, size_t index) const {
+        return ranges_[function_.operand(value, index)];
+    }
+    
+    // Unbounded ranges make no promise for a half: the analysis takes 0 * inf
+    // as 0 and sqrt of a negative as 0, where the hardware gives NaN
+    bool finite(const ValueRange& range) const {
+        return range.isEmpty() || (std::isfinite(range.low) && std::isfinite(range.high));
+    }
+    
+    ValueRange joinOperands(IRValue value, uint32_t first) const {
+        ValueRange result = ValueRange::empty();
+        for (uint32_t k = first; k < inst(value).operandCount; ++k) {
+            result = result.join(operandRange(value, k));
+        }
+        result.unit = false;
+        return result;
+    }
+    
+    ValueRange evaluate(IRValue value) const {
+        const IRInstruction& i = inst(value);
+        if (i.type == Type::Kind::BOOL) {
+            return ValueRange::between(0.0, 1.0);
+        }
+        bool integer = i.type == Type::Kind::INT;
+        switch (i.op) {
+            case IROp::CONSTANT: {
+                ValueRange result = ValueRange::empty();
+                for (double component : module_.constants[i.imm].components) {
+                    result = result.join(ValueRange::exactly(component));
+                }
+                return result;
+            }
+            case IROp::LOAD: {
+                const IRGlobal& global = module_.globals[i.imm];
+                return ValueRange::between(global.rangeLow, global.rangeHigh);
+            }
+            case IROp::PHI:
+            case IROp::INSERT:
+                return joinOperands(value, 0);
+            case IROp::SELECT:
+                return joinOperands(value, 1);
+            case IROp::EXTRACT:
+            case IROp::SWIZZLE: {
+                ValueRange result = operandRange(value, 0);
+                result.unit = false;
+                return result;
+            }
+            case IROp::ADD: return operandRange(value, 0) + operandRange(value, 1);
+            case IROp::SUB: return operandRange(value, 0) - operandRange(value, 1);
+            case IROp::NEG: return -operandRange(value, 0);
+            case IROp::MUL:
+                // The linear-algebra product sums several terms
+                if (isMatrix(inst(function_.operand(value, 0)).type) || isMatrix(inst(function_.operand(value, 1)).type)) {
+                    return ValueRange::full();
+                }
+                if (!finite(operandRange(value, 0)) || !finite(operandRange(value, 1))) {
+                    return ValueRange::full();
+                }
+                return operandRange(value, 0) * operandRange(value, 1);
+            case IROp::DIV:
+                // Integer division truncates, which may leave the real quotient's range
+                return integer ? ValueRange::full() : operandRange(value, 0) / operandRange(value, 1);
+            case IROp::CONSTRUCT:
+                return integer ? ValueRange::full() : joinOperands(value, 0);
+            case IROp::BUILTIN: {
+                BuiltinId id = static_cast<BuiltinId>(i.imm);
+                // Float and HDR textures hold any value, so a fetch is only
+                // bounded by a [[range]] on its sampler
+                if (builtinInfo(id)->has(BuiltinFlag::TEXTURE_FETCH)) {
+                    ValueRange result = operandRange(value, 0);
+                    result.unit = false;
+                    return result;
+                }
+                std::vector<ValueRange> args;
+                for (uint32_t k = 0; k < i.operandCount; ++k) {
+                    args.push_back(operandRange(value, k));
+                }
+                if (id == BuiltinId::SQRT && args[0].low < 0.0) {
+                    return ValueRange::full();
+                }
+                int components = i.operandCount > 0 ? componentCount(inst(function_.operand(value, 0)).type) : 0;
+                return builtinRange(id, args, components);
+            }
+            default:
+                return ValueRange::full();
+        }
+    }
+    
+    // --- Demand -------------------------------------------------------------
+    
+    // Uses that need the operand at full precision. Calls, returns and
+    // private globals hand the value to code this analysis does not see.
+    bool demands(IRValue user, uint32_t index) const {
+        const IRInstruction& i = inst(user);
+        switch (i.op) {
+            case IROp::EQ:
+            case IROp::NE:
+            case IROp::LT:
+            case IROp::LE:
+            case IROp::GT:
+            case IROp::GE:
+            case IROp::CALL:
+            case IROp::RETURN:
+                return true;
+            case IROp::CONSTRUCT:
+                return !isFloat(i.type) && !isMatrix(i.type);
+            case IROp::STORE: {
+                const IRGlobal& global = module_.globals[i.imm];
+                return global.builtin || global.qualifier != VariableDeclaration::Qualifier::OUT;
+            }
+            case IROp::BUILTIN:
+                return sensitiveArgument(static_cast<BuiltinId>(i.imm), index);
+            default:
+                return false;
+        }
+    }
+    
+    void computeDemand() {
+        demanded_.assign(function_.instructions.size(), false);
+        std::vector<IRValue> worklist;
+        for (const auto& block : function_.blocks) {
+            for (IRValue value : block.instructions) {
+                for (uint32_t k = 0; k < inst(value).operandCount; ++k) {
+                    if (demands(value, k)) {
+                        worklist.push_back(function_.operand(value, k));
+                    }
+                }
+            }
+        }
+        
+        // Whatever a full-precision value is computed from needs full
+        // precision too
+        while (!worklist.empty()) {
+            IRValue value = worklist.back();
+            worklist.pop_back();
+            if (demanded_[value]) {
+                continue;
+            }
+            demanded_[value] = true;
+            for (uint32_t k = 0; k < inst(value).operandCount; ++k) {
+                worklist.push_back(function_.operand(value, k));
+            }
+        }
+    }
+};
+
+} // anonymous namespace
+
+bool inferPrecision(IRModule& module, PassContext& context) {
+    bool changed = false;
+    for (auto& function : module.functions) {
+        // Vertex positions need full precision, and program-level functions
+        // may run in any stage
+        bool relaxed = function.shader != IR_NONE && !function.initializer &&
+                       module.shaders[function.shader].stage != ShaderDeclaration::ShaderType::VERTEX;
+        if (!relaxed || function.blocks.empty()) {
+            continue;
+        }
+        context.statistics["infer-precision.mediump"] += PrecisionInference(function, module).run(changed);
+    }
+    return changed;
+}
+
+} // namespace sdl
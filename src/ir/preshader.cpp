@@ -0,0 +1,196 @@
+#include "ir/passes.h"
+#include "semantic/types.h"
+#include <algorithm>
+
+namespace sdl {
+
+namespace {
+
+// Builtins ir/host_printer.cpp can print besides those with a CPU template
+bool hostBuiltin(BuiltinId id) {
+    switch (id) {
+        case BuiltinId::DOT:
+        case BuiltinId::LENGTH:
+        case BuiltinId::DISTANCE:
+        case BuiltinId::NORMALIZE:
+        case BuiltinId::CROSS:
+        case BuiltinId::TRANSPOSE:
+        case BuiltinId::INVERSE:
+            return true;
+        default:
+            return builtinInfo(id)->cpu != nullptr;
+    }
+}
+
+class PreshaderExtraction {
+public:
+    PreshaderExtraction(IRFunction& function, IRModule& module, PassContext& context)
+        : function_(function), module_(module), context_(context) {}
+    
+    bool run() {
+        classify();
+        
+        // Uniform-only values something per-invocation consumes are the
+        // roots of maximal uniform-only expressions
+        std::vector<IRValue> roots;
+        for (uint32_t b : reversePostorder(function_)) {
+            for (IRValue value : function_.blocks[b].instructions) {
+                for (uint32_t k = 0; k < inst(value).operandCount; ++k) {
+                    IRValue operand = function_.operand(value, k);
+                    if (!uniformOnly_[value] && uniformOnly_[operand] && worthwhile(operand) &&
+                        std::find(roots.begin(), roots.end(), operand) == roots.end()) {
+                        roots.push_back(operand);
+                    }
+                }
+            }
+        }
+        
+        // All roots are copied before any is replaced, so the preshader
+        // never reads back a uniform it derived
+        std::vector<uint32_t> globals;
+        size_t declared = module_.globals.size();
+        for (IRValue root : roots) {
+            globals.push_back(addDerivedUniform(module_, function_.shader, function_.nameOf(root), copy(root)));
+        }
+        std::vector<bool> counted(function_.instructions.size(), false);
+        for (size_t n = 0; n < roots.size(); ++n) {
+            IRValue root = roots[n];
+            context_.statistics["extract-preshader.operations"] += cost(root, counted);
+            IRValue load = function_.create(IROp::LOAD, inst(root).type, {}, globals[n]);
+            auto& list = function_.blocks[inst(root).block].instructions;
+            function_.insert(inst(root).block, std::find(list.begin(), list.end(), root) - list.begin(), load);
+            function_.replaceAllUses(root, load);
+        }
+        context_.statistics["extract-preshader.uniforms"] += static_cast<int>(module_.globals.size() - declared);
+        return !roots.empty();
+    }
+    
+private:
+    IRFunction& function_;
+    IRModule& module_;
+    PassContext& context_;
+    std::vector<bool> uniformOnly_; // Computable from uniforms and constants alone
+    std::vector<IRValue> copies_;   // Value in the preshader, IR_NONE until copied
+    
+    const IRInstruction& inst(IRValue value) const { return function_.instructions[value]; }
+    
+    bool hostEvaluable(IRValue value) const {
+        const IRInstruction& i = inst(value);
+        if (i.type == Type::Kind::VOID || isSampler(i.type)) {
+            return false;
+        }
+        switch (i.op) {
+            case IROp::CONSTANT:
+                return true;
+            case IROp::LOAD: {
+                const IRGlobal& global = module_.globals[i.imm];
+                return global.qualifier == VariableDeclaration::Qualifier::UNIFORM && !global.builtin;
+            }
+            case IROp::DIV:
+            case IROp::MOD:
+                // Integer division by zero is undefined on the host, not
+                // just a meaningless value
+                if (i.type == Type::Kind::INT) {
+                    const IRInstruction& divisor = inst(function_.operand(value, 1));
+                    return divisor.op == IROp::CONSTANT && module_.constants[divisor.imm].components[0] != 0;
+                }
+                return i.op == IROp::DIV;
+            case IROp::ADD:
+            case IROp::SUB:
+            case IROp::MUL:
+            case IROp::NEG:
+            case IROp::EQ:
+            case IROp::NE:
+            case IROp::LT:
+            case IROp::LE:
+            case IROp::GT:
+            case IROp::GE:
+            case IROp::AND:
+            case IROp::OR:
+            case IROp::NOT:
+            case IROp::SELECT:
+            case IROp::CONSTRUCT:
+            case IROp::EXTRACT:
+            case IROp::SWIZZLE:
+            case IROp::INSERT:
+                return true;
+            case IROp::BUILTIN:
+                return hostBuiltin(static_cast<BuiltinId>(i.imm));
+            default:
+                return false;
+        }
+    }
+    
+    void classify() {
+        uniformOnly_.assign(function_.instructions.size(), false);
+        for (uint32_t b : reversePostorder(function_)) {
+            for (IRValue value : function_.blocks[b].instructions) {
+                bool only = hostEvaluable(value);
+                for (uint32_t k = 0; k < inst(value).operandCount && only; ++k) {
+                    only = uniformOnly_[function_.operand(value, k)];
+                }
+                uniformOnly_[value] = only;
+            }
+        }
+    }
+    
+    // Operations of the expression not yet in `counted`, which the device
+    // no longer runs once the value is a uniform
+    int cost(IRValue value, std::vector<bool>& counted) const {
+        const IRInstruction& i = inst(value);
+        if (counted[value] || i.op == IROp::LOAD || i.op == IROp::CONSTANT) {
+            return 0;
+        }
+        counted[value] = true;
+        int total = operationCount(function_, value);
+        for (uint32_t k = 0; k < i.operandCount; ++k) {
+            total += cost(function_.operand(value, k), counted);
+        }
+        return total;
+    }
+    
+    // A swizzle or a conversion of a uniform costs about what loading a
+    // uniform of its own does
+    bool worthwhile(IRValue value) const {
+        const IRInstruction& i = inst(value);
+        if (i.op == IROp::LOAD || i.op == IROp::CONSTANT || i.op == IROp::SWIZZLE || i.op == IROp::EXTRACT) {
+            return false;
+        }
+        std::vector<bool> counted(function_.instructions.size(), false);
+        return i.op != IROp::CONSTRUCT || cost(value, counted) > 1;
+    }
+    
+    IRValue copy(IRValue value) {
+        copies_.resize(function_.instructions.size(), IR_NONE);
+        if (copies_[value] != IR_NONE) {
+            return copies_[value];
+        }
+        const IRInstruction& i = inst(value);
+        std::vector<IRValue> args;
+        for (uint32_t k = 0; k < i.operandCount; ++k) {
+            args.push_back(copy(function_.operand(value, k)));
+        }
+        IRValue result = appendToPreshader(module_, function_.shader, i.op, i.type, args, i.imm, i.aux);
+        copies_[value] = result;
+        return result;
+    }
+};
+
+} // anonymous namespace
+
+bool extractPreshader(IRModule& module, PassContext& context) {
+    if (!context.extractPreshader) {
+        return false;
+    }
+    bool changed = false;
+    for (auto& function : module.functions) {
+        // Program-level functions may run in several shaders, and
+        // initializers before any uniform is set
+        if (function.shader != IR_NONE && !function.initializer && !function.blocks.empty()) {
+            changed |= PreshaderExtraction(function, module, context).run();
+        }
+    }
+    return changed;
+}
+
+} // namespace sdl
@@ -0,0 +1,895 @@
+#include "ir/printer.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace sdl {
+
+namespace {
+
+// C/GLSL operator precedence, loosest first
+enum Precedence : int {
+    CONDITIONAL = 1,
+    LOGICAL_OR,
+    LOGICAL_AND,
+    EQUALITY,
+    RELATIONAL,
+    ADDITIVE,
+    MULTIPLICATIVE,
+    UNARY,
+    PRIMARY
+};
+
+struct Text {
+    std::string text;
+    int precedence;
+};
+
+// The '|'-separated alternative of a lowering template used for `count` arguments
+std::string alternativeFor(const char* pattern, size_t count, int minArgs) {
+    std::string all = pattern ? pattern : "";
+    size_t begin = 0;
+    for (size_t n = static_cast<size_t>(minArgs); n < count; ++n) {
+        size_t bar = all.find('|', begin);
+        if (bar == std::string::npos) {
+            break;
+        }
+        begin = bar + 1;
+    }
+    size_t end = all.find('|', begin);
+    return all.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+}
+
+// How a template uses argument `index`: how often, and whether every use
+// sits alone in an argument list (so the argument needs no parentheses)
+void templateUses(const std::string& pattern, size_t index, int& count, bool& delimited) {
+    count = 0;
+    delimited = true;
+    for (size_t i = 0; i + 1 < pattern.size(); ++i) {
+        if (pattern[i] != '$') {
+            continue;
+        }
+        bool match = pattern[i + 1] == '*' || (pattern[i + 1] >= '0' && pattern[i + 1] <= '9' &&
+                                               static_cast<size_t>(pattern[i + 1] - '0') == index);
+        if (!match) {
+            continue;
+        }
+        ++count;
+        size_t after = i + 2;
+        while (after < pattern.size() && pattern[after] == ' ') {
+            ++after;
+        }
+        char next = after < pattern.size() ? pattern[after] : ')';
+        size_t back = i;
+        while (back > 0 && pattern[back - 1] == ' ') {
+            --back;
+        }
+        char prev = back > 0 ? pattern[back - 1] : '(';
+        if ((prev != '(' && prev != ',') || (next != ')' && next != ',')) {
+            delimited = false;
+        }
+    }
+}
+
+} // anonymous namespace
+
+// Prints one function body. All decisions (what to inline, where each
+// variable is declared) are made up front from a dry run over the same
+// region walk the printing uses.
+class BodyPrinter {
+public:
+    BodyPrinter(IRPrinter& printer, const IRFunction& function, bool inlineAll)
+        : printer_(printer), module_(*printer.module_), f_(function), inlineAll_(inlineAll) {
+        printer_.function_ = &function;
+        size_t count = f_.instructions.size();
+        uses_ = f_.useCounts();
+        users_.resize(count);
+        position_.assign(count, 0);
+        for (const auto& block : f_.blocks) {
+            for (size_t i = 0; i < block.instructions.size(); ++i) {
+                IRValue value = block.instructions[i];
+                position_[value] = static_cast<uint32_t>(i);
+                for (uint32_t k = 0; k < f_.instructions[value].operandCount; ++k) {
+                    users_[f_.operand(value, k)].emplace_back(value, k);
+                }
+            }
+        }
+        
+        computeScopes();
+        chooseInlined();
+        placeVariables();
+    }
+    
+    void print(int indent) {
+        printHoisted(0, indent);
+        printRegion(0, IR_NONE, indent);
+    }
+    
+    std::string expression(IRValue value) {
+        return ref(value).text;
+    }
+    
+private:
+    IRPrinter& printer_;
+    const IRModule& module_;
+    const IRFunction& f_;
+    bool inlineAll_;
+    
+    std::vector<uint32_t> uses_;
+    std::vector<std::vector<std::pair<IRValue, uint32_t>>> users_; // (user, operand index)
+    std::vector<uint32_t> position_;                               // Index within the block
+    
+    // Scopes are the bodies of braces; 0 is the function body
+    std::vector<int> scopeParent_{-1};
+    std::vector<int> scopeDepth_{0};
+    std::vector<int> blockScope_, structScope_, thenScope_, elseScope_, loopScope_;
+    
+    std::vector<bool> inlined_;
+    std::vector<uint32_t> textPosition_; // Where an inlined value's text ends up in its block
+    std::vector<std::string> names_;
+    std::vector<int> declScope_;
+    std::vector<bool> declareInPlace_; // At the definition, or just before the if/while of a phi
+    std::vector<bool> declared_;
+    std::vector<bool> aliased_; // Writes into the variable of its vector operand
+    std::vector<std::vector<IRValue>> hoisted_; // Declared at the top of a scope
+    std::unordered_set<std::string> taken_;
+    
+    const IRInstruction& inst(IRValue value) const { return f_.instructions[value]; }
+    
+    // --- Scopes -------------------------------------------------------------
+    
+    int newScope(int parent) {
+        scopeParent_.push_back(parent);
+        scopeDepth_.push_back(scopeDepth_[parent] + 1);
+        return static_cast<int>(scopeParent_.size() - 1);
+    }
+    
+    int commonScope(int a, int b) const {
+        while (scopeDepth_[a] > scopeDepth_[b]) a = scopeParent_[a];
+        while (scopeDepth_[b] > scopeDepth_[a]) b = scopeParent_[b];
+        while (a != b) {
+            a = scopeParent_[a];
+            b = scopeParent_[b];
+        }
+        return a;
+    }
+    
+    uint32_t loopBody(uint32_t header) const {
+        const IRBlock& block = f_.blocks[header];
+        return block.successors[1] == block.merge ? block.successors[0] : block.successors[1];
+    }
+    
+    void computeScopes() {
+        size_t count = f_.blocks.size();
+        blockScope_.assign(count, -1);
+        structScope_.assign(count, -1);
+        thenScope_.assign(count, -1);
+        elseScope_.assign(count, -1);
+        loopScope_.assign(count, -1);
+        walkScopes(0, IR_NONE, 0);
+        
+        for (size_t b = 0; b < count; ++b) {
+            if (blockScope_[b] < 0) {
+                throw std::runtime_error(f_.name + ": block " + std::to_string(b) + " is not reached by structured control flow");
+            }
+        }
+    }
+    
+    void walkScopes(uint32_t block, uint32_t stop, int scope) {
+        while (block != stop && block != IR_NONE) {
+            if (blockScope_[block] >= 0) {
+                throw std::runtime_error(f_.name + ": block " + std::to_string(block) + " is reached twice");
+            }
+            const IRBlock& current = f_.blocks[block];
+            if (current.structure == IRStructure::LOOP) {
+                structScope_[block] = scope;
+                int body = newScope(scope);
+                loopScope_[block] = body;
+                blockScope_[block] = body;
+                walkScopes(loopBody(block), block, body);
+                block = current.merge;
+                continue;
+            }
+            
+            blockScope_[block] = scope;
+            const IRInstruction* term = f_.terminatorOf(block);
+            if (term->op == IROp::COND_BRANCH) {
+                if (current.structure != IRStructure::SELECTION) {
+                    throw std::runtime_error(f_.name + ": conditional branch outside a selection or loop");
+                }
+                structScope_[block] = scope;
+                thenScope_[block] = newScope(scope);
+                elseScope_[block] = newScope(scope);
+                if (current.successors[0] != current.merge) {
+                    walkScopes(current.successors[0], current.merge, thenScope_[block]);
+                }
+                if (current.successors[1] != current.merge) {
+                    walkScopes(current.successors[1], current.merge, elseScope_[block]);
+                }
+                block = current.merge;
+            } else if (term->op == IROp::BRANCH) {
+                block = current.successors[0];
+            } else {
+                block = IR_NONE;
+            }
+        }
+    }
+    
+    // --- Inlining -----------------------------------------------------------
+    
+    bool isReadOnlyGlobal(uint32_t global) const {
+        auto qualifier = module_.globals[global].qualifier;
+        return qualifier == VariableDeclaration::Qualifier::UNIFORM ||
+               qualifier == VariableDeclaration::Qualifier::CONST || qualifier == VariableDeclaration::Qualifier::IN;
+    }
+    
+    // Names and literals: cheap to repeat and valid anywhere in the function
+    bool alwaysInline(IRValue value) const {
+        const IRInstruction& i = inst(value);
+        return i.op == IROp::CONSTANT || i.op == IROp::PARAMETER || (i.op == IROp::LOAD && isReadOnlyGlobal(i.imm));
+    }
+    
+    bool writes(IRValue value) const {
+        const IRInstruction& i = inst(value);
+        if (i.op == IROp::STORE) {
+            return true;
+        }
+        const unsigned writesAnything = Effect::WRITES_OUTPUTS | Effect::WRITES_GLOBALS | Effect::WRITES_ARGUMENTS;
+        return i.op == IROp::CALL && (printer_.effects_[i.imm] & writesAnything);
+    }
+    
+    bool readsMutable(IRValue value) const {
+        const IRInstruction& i = inst(value);
+        if (i.op == IROp::LOAD) {
+            return !isReadOnlyGlobal(i.imm);
+        }
+        return i.op == IROp::CALL && (printer_.effects_[i.imm] & Effect::READS_MUTABLE);
+    }
+    
+    bool isStatement(IRValue value) const {
+        const IRInstruction& i = inst(value);
+        return isTerminator(i.op) || i.op == IROp::STORE || i.op == IROp::INSERT || i.op == IROp::PHI ||
+               i.type == Type::Kind::VOID;
+    }
+    
+    void chooseInlined() {
+        inlined_.assign(f_.instructions.size(), false);
+        textPosition_.assign(f_.instructions.size(), 0);
+        
+        for (size_t b = 0; b < f_.blocks.size(); ++b) {
+            const auto& list = f_.blocks[b].instructions;
+            // Users come after their operands, so walk backwards to know where each user's text lands
+            for (size_t n = list.size(); n-- > 0;) {
+                IRValue value = list[n];
+                if (isStatement(value)) {
+                    continue;
+                }
+                if (alwaysInline(value) || inlineAll_) {
+                    inlined_[value] = true;
+                    continue;
+                }
+                if (writes(value) || uses_[value] != 1) {
+                    continue;
+                }
+                
+                IRValue user = users_[value][0].first;
+                uint32_t operand = users_[value][0].second;
+                uint32_t useBlock;
+                uint32_t usePosition;
+                if (inst(user).op == IROp::PHI) {
+                    // Copied at the end of the incoming edge
+                    useBlock = f_.blocks[inst(user).block].predecessors[operand];
+                    usePosition = static_cast<uint32_t>(f_.blocks[useBlock].instructions.size() - 1);
+                } else {
+                    if (printer_.needsName(inst(user), operand)) {
+                        continue;
+                    }
+                    useBlock = inst(user).block;
+                    usePosition = inlined_[user] ? textPosition_[user] : position_[user];
+                }
+                if (useBlock != b) {
+                    continue;
+                }
+                
+                if (readsMutable(value)) {
+                    bool written = false;
+                    for (uint32_t p = position_[value] + 1; p < usePosition && !written; ++p) {
+                        written = writes(list[p]);
+                    }
+                    if (written) {
+                        continue;
+                    }
+                }
+                
+                inlined_[value] = true;
+                textPosition_[value] = usePosition;
+            }
+        }
+    }
+    
+    // --- Variables ----------------------------------------------------------
+    
+    std::string uniqueName(const std::string& base) {
+        std::string stem = base.empty() ? "t" : base;
+        std::string name = stem;
+        for (int n = 1; taken_.count(name) || printer_.isReserved(name); ++n) {
+            name = stem + "_" + std::to_string(n);
+        }
+        taken_.insert(name);
+        return name;
+    }
+    
+    // Scope of the statement the value's text is written in
+    int useScope(IRValue user, uint32_t operand) const {
+        if (inst(user).op == IROp::PHI) {
+            return blockScope_[f_.blocks[inst(user).block].predecessors[operand]];
+        }
+        return blockScope_[inst(user).block];
+    }
+    
+    bool isExpressionStatement(IRValue value) const {
+        const IRInstruction& i = inst(value);
+        return uses_[value] == 0 && i.name == 0 && i.op != IROp::INSERT && i.op != IROp::PHI;
+    }
+    
+    void placeVariables() {
+        size_t count = f_.instructions.size();
+        names_.assign(count, "");
+        declScope_.assign(count, -1);
+        declareInPlace_.assign(count, false);
+        declared_.assign(count, false);
+        aliased_.assign(count, false);
+        hoisted_.assign(scopeParent_.size(), {});
+        
+        for (const auto& global : module_.globals) {
+            taken_.insert(global.name);
+        }
+        for (const auto& function : module_.functions) {
+            taken_.insert(function.name);
+        }
+        for (const auto& param : f_.parameters) {
+            taken_.insert(param.name);
+        }
+        
+        for (size_t b = 0; b < f_.blocks.size(); ++b) {
+            for (IRValue value : f_.blocks[b].instructions) {
+                const IRInstruction& i = inst(value);
+                bool variable = i.op == IROp::PHI ? uses_[value] > 0
+                                                  : !inlined_[value] && !isStatement(value) && !isExpressionStatement(value);
+                if (i.op == IROp::INSERT) {
+                    variable = true;
+                }
+                if (!variable) {
+                    continue;
+                }
+                
+                // Where it is defined, or for a phi where its if/while starts
+                int home = blockScope_[b];
+                if (i.op == IROp::PHI) {
+                    home = f_.blocks[b].structure == IRStructure::LOOP ? structScope_[b] : blockScope_[b];
+                }
+                int scope = home;
+                for (const auto& use : users_[value]) {
+                    scope = commonScope(scope, useScope(use.first, use.second));
+                }
+                if (i.op == IROp::PHI) {
+                    for (uint32_t pred : f_.blocks[b].predecessors) {
+                        scope = commonScope(scope, blockScope_[pred]);
+                    }
+                }
+                
+                // vec.x = ...: keep writing the vector's own variable when nothing else reads the old value
+                if (i.op == IROp::INSERT && scope == home) {
+                    IRValue vector = f_.operand(value, 0);
+                    bool single = uses_[vector] == 1;
+                    bool local = inst(vector).op == IROp::PARAMETER ||
+                                 (!inlined_[vector] && inst(vector).op != IROp::PHI && inst(vector).block == b);
+                    if (single && local) {
+                        names_[value] = inst(vector).op == IROp::PARAMETER ? f_.parameters[inst(vector).imm].name
+                                                                           : names_[vector];
+                        aliased_[value] = true;
+                        continue;
+                    }
+                }
+                
+                names_[value] = uniqueName(f_.nameOf(value));
+                declScope_[value] = scope;
+                declareInPlace_[value] = scope == home;
+                if (scope != home) {
+                    hoisted_[scope].push_back(value);
+                }
+            }
+        }
+    }
+    
+    void printHoisted(int scope, int indent) {
+        for (IRValue value : hoisted_[scope]) {
+            printer_.writeLine(indent, printer_.variableType(f_, value) + " " + names_[value] + ";");
+            declared_[value] = true;
+        }
+    }
+    
+    // --- Expressions --------------------------------------------------------
+    
+    // `half` asks for the value as an operand of half-precision arithmetic
+    Text ref(IRValue value, bool half = false) {
+        Text text = inlined_[value] ? generate(value) : Text{names_[value], PRIMARY};
+        if (printer_.halfArithmetic(f_, value) != half) {
+            return {printer_.halfConversion(text.text, inst(value).type, half), PRIMARY};
+        }
+        return text;
+    }
+    
+    std::string operand(IRValue value, int precedence, bool half = false) {
+        Text text = ref(value, half);
+        if (text.precedence < precedence) {
+            return "(" + text.text + ")";
+        }
+        return text.text;
+    }
+    
+    std::vector<std::string> arguments(IRValue value) {
+        std::vector<std::string> args;
+        for (uint32_t k = 0; k < inst(value).operandCount; ++k) {
+            args.push_back(ref(f_.operand(value, k)).text);
+        }
+        return args;
+    }
+    
+    Text binary(IRValue value, const char* op, int precedence) {
+        bool half = printer_.halfArithmetic(f_, value);
+        std::string left = operand(f_.operand(value, 0), precedence, half);
+        std::string right = operand(f_.operand(value, 1), precedence + 1, half);
+        return {left + " " + op + " " + right, precedence};
+    }
+    
+    Text generate(IRValue value) {
+        const IRInstruction& i = inst(value);
+        switch (i.op) {
+            case IROp::CONSTANT: {
+                std::string text = printer_.constant(module_.constants[i.imm]);
+                return {text, text[0] == '-' ? UNARY : PRIMARY};
+            }
+            case IROp::PARAMETER: return {f_.parameters[i.imm].name, PRIMARY};
+            case IROp::LOAD: return {module_.globals[i.imm].name, PRIMARY};
+            case IROp::ADD: return binary(value, "+", ADDITIVE);
+            case IROp::SUB: return binary(value, "-", ADDITIVE);
+            case IROp::MUL: return binary(value, "*", MULTIPLICATIVE);
+            case IROp::DIV: return division(value);
+            case IROp::MOD: return binary(value, "%", MULTIPLICATIVE);
+            case IROp::EQ: return binary(value, "==", EQUALITY);
+            case IROp::NE: return binary(value, "!=", EQUALITY);
+            case IROp::LT: return binary(value, "<", RELATIONAL);
+            case IROp::LE: return binary(value, "<=", RELATIONAL);
+            case IROp::GT: return binary(value, ">", RELATIONAL);
+            case IROp::GE: return binary(value, ">=", RELATIONAL);
+            case IROp::AND: return binary(value, "&&", LOGICAL_AND);
+            case IROp::OR: return binary(value, "||", LOGICAL_OR);
+            case IROp::NEG: {
+                std::string text = operand(f_.operand(value, 0), UNARY, printer_.halfArithmetic(f_, value));
+                return {text[0] == '-' ? "-(" + text + ")" : "-" + text, UNARY};
+            }
+            case IROp::NOT: return {"!" + operand(f_.operand(value, 0), UNARY), UNARY};
+            case IROp::SELECT: {
+                std::string condition = operand(f_.operand(value, 0), LOGICAL_OR);
+                std::string ifTrue = operand(f_.operand(value, 1), LOGICAL_OR);
+                std::string ifFalse = operand(f_.operand(value, 2), CONDITIONAL);
+                return {condition + " ? " + ifTrue + " : " + ifFalse, CONDITIONAL};
+            }
+            case IROp::CONSTRUCT:
+                if (i.operandCount == 1 && inst(f_.operand(value, 0)).type == i.type) {
+                    return ref(f_.operand(value, 0)); // vec2(v) of a vec2
+                }
+                return {printer_.construct(i.type, arguments(value)), PRIMARY};
+            case IROp::EXTRACT:
+                return {operand(f_.operand(value, 0), PRIMARY) + "[" + std::to_string(i.imm) + "]", PRIMARY};
+            case IROp::SWIZZLE: return {printer_.swizzle(operand(f_.operand(value, 0), PRIMARY), i.imm), PRIMARY};
+            case IROp::BUILTIN: return builtinCall(value);
+            case IROp::CALL: {
+                std::vector<std::string> args = arguments(value);
+                for (auto& extra : printer_.extraArguments(i.imm)) {
+                    args.push_back(extra);
+                }
+                std::string text = module_.functions[i.imm].name + "(";
+                for (size_t a = 0; a < args.size(); ++a) {
+                    text += (a > 0 ? ", " : "") + args[a];
+                }
+                return {text + ")", PRIMARY};
+            }
+            default:
+                return {names_[value], PRIMARY};
+        }
+    }
+    
+    Text builtinCall(IRValue value) {
+        const BuiltinInfo* info = builtinInfo(static_cast<BuiltinId>(inst(value).imm));
+        return expand(value, printer_.templateFor(inst(value)), info->minArgs);
+    }
+    
+    Text division(IRValue value) {
+        const char* pattern = nullptr;
+        if (f_.fastMath) {
+            pattern = printer_.fastDivisionTemplate(inst(f_.operand(value, 0)).type, inst(f_.operand(value, 1)).type);
+        }
+        return pattern ? expand(value, pattern, 2) : binary(value, "/", MULTIPLICATIVE);
+    }
+    
+    Text expand(IRValue value, const char* pattern, int minArgs) {
+        std::string chosen = alternativeFor(pattern, inst(value).operandCount, minArgs);
+        std::vector<std::string> args;
+        for (uint32_t k = 0; k < inst(value).operandCount; ++k) {
+            int count;
+            bool delimited;
+            templateUses(chosen, k, count, delimited);
+            args.push_back(operand(f_.operand(value, k), delimited ? CONDITIONAL : PRIMARY));
+        }
+        // Templates are calls or fully parenthesized
+        return {lowerBuiltin(pattern, args, minArgs), PRIMARY};
+    }
+    
+    // --- Statements ---------------------------------------------------------
+    
+    std::string declaration(IRValue value) {
+        if (declared_[value]) {
+            return names_[value] + " = ";
+        }
+        declared_[value] = true;
+        return printer_.variableType(f_, value) + " " + names_[value] + " = ";
+    }
+    
+    void printInstructions(uint32_t block, int indent) {
+        for (IRValue value : f_.blocks[block].instructions) {
+            const IRInstruction& i = inst(value);
+            if (i.op == IROp::PHI || isTerminator(i.op) || inlined_[value]) {
+                continue;
+            }
+            
+            if (i.op == IROp::STORE) {
+                const std::string& target = module_.globals[i.imm].name;
+                std::string stored = ref(f_.operand(value, 0)).text;
+                printer_.writeLine(indent, i.aux == 0 ? target + " = " + stored + ";"
+                                                      : printer_.assignComponents(target, i.aux, stored));
+            } else if (i.op == IROp::INSERT) {
+                if (!aliased_[value]) {
+                    printer_.writeLine(indent, declaration(value) + ref(f_.operand(value, 0)).text + ";");
+                }
+                printer_.writeLine(indent, printer_.assignComponents(names_[value], i.imm, ref(f_.operand(value, 1)).text));
+            } else if (i.type == Type::Kind::VOID || isExpressionStatement(value)) {
+                printer_.writeLine(indent, generate(value).text + ";");
+            } else {
+                printer_.writeLine(indent, declaration(value) + generate(value).text + ";");
+            }
+        }
+    }
+    
+    bool dependsOn(IRValue value, IRValue phi) const {
+        if (value == phi) {
+            return true;
+        }
+        if (!inlined_[value]) {
+            return false;
+        }
+        for (uint32_t k = 0; k < inst(value).operandCount; ++k) {
+            if (dependsOn(f_.operand(value, k), phi)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // Phi assignments for the edge from -> to, as one parallel copy
+    void printCopies(uint32_t from, uint32_t to, int indent) {
+        const IRBlock& target = f_.blocks[to];
+        size_t edge = 0;
+        while (edge < target.predecessors.size() && target.predecessors[edge] != from) {
+            ++edge;
+        }
+        
+        std::vector<std::pair<IRValue, IRValue>> copies; // (phi, source)
+        for (IRValue value : target.instructions) {
+            if (inst(value).op != IROp::PHI) {
+                break;
+            }
+            IRValue source = f_.operand(value, edge);
+            if (uses_[value] > 0 && source != value) {
+                copies.emplace_back(value, source);
+            }
+        }
+        
+        std::vector<std::string> sources;
+        for (size_t c = 0; c < copies.size(); ++c) {
+            sources.push_back(ref(copies[c].second).text);
+            // A source reading a phi assigned before it must see the old value
+            bool clobbered = false;
+            for (size_t earlier = 0; earlier < c && !clobbered; ++earlier) {
+                clobbered = dependsOn(copies[c].second, copies[earlier].first);
+            }
+            if (clobbered) {
+                std::string temp = uniqueName(names_[copies[c].first] + "_next");
+                printer_.writeLine(indent, printer_.variableType(f_, copies[c].first) + " " + temp + " = " +
+                                               sources[c] + ";");
+                sources[c] = temp;
+            }
+        }
+        for (size_t c = 0; c < copies.size(); ++c) {
+            printer_.writeLine(indent, declaration(copies[c].first) + sources[c] + ";");
+        }
+    }
+    
+    bool hasCopies(uint32_t to) const {
+        if (to == IR_NONE) {
+            return false;
+        }
+        for (IRValue value : f_.blocks[to].instructions) {
+            if (inst(value).op == IROp::PHI && uses_[value] > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    std::string negate(IRValue condition) {
+        if (inlined_[condition] && inst(condition).op == IROp::NOT) {
+            return ref(f_.operand(condition, 0)).text;
+        }
+        return "!" + operand(condition, UNARY);
+    }
+    
+    void printArm(uint32_t header, uint32_t entry, int scope, int indent) {
+        printHoisted(scope, indent);
+        uint32_t merge = f_.blocks[header].merge;
+        if (entry == merge) {
+            printCopies(header, merge, indent);
+        } else {
+            printRegion(entry, merge, indent);
+        }
+    }
+    
+    void printRegion(uint32_t block, uint32_t stop, int indent) {
+        while (block != stop && block != IR_NONE) {
+            const IRBlock& current = f_.blocks[block];
+            if (current.structure == IRStructure::LOOP) {
+                printLoop(block, indent);
+                block = current.merge;
+                continue;
+            }
+            
+            printInstructions(block, indent);
+            IRValue term = f_.terminator(block);
+            const IRInstruction& i = inst(term);
+            
+            if (i.op == IROp::COND_BRANCH) {
+                // Variables merging the arms are declared before the if
+                if (current.merge != IR_NONE) {
+                    for (IRValue value : f_.blocks[current.merge].instructions) {
+                        if (inst(value).op == IROp::PHI && !declared_[value] && declareInPlace_[value] &&
+                            uses_[value] > 0) {
+                            printer_.writeLine(indent, printer_.variableType(f_, value) + " " + names_[value] + ";");
+                            declared_[value] = true;
+                        }
+                    }
+                }
+                
+                IRValue condition = f_.operand(term, 0);
+                uint32_t merge = current.merge;
+                bool thenEmpty = current.successors[0] == merge && !hasCopies(merge);
+                bool elseEmpty = current.successors[1] == merge && !hasCopies(merge);
+                std::string comment = printer_.branchComment(i.aux);
+                
+                if (thenEmpty && !elseEmpty) {
+                    printer_.writeLine(indent, "if (" + negate(condition) + ") {" + comment);
+                    printArm(block, current.successors[1], elseScope_[block], indent + 1);
+                    printer_.writeLine(indent, "}");
+                } else if (!thenEmpty) {
+                    printer_.writeLine(indent, "if (" + ref(condition).text + ") {" + comment);
+                    printArm(block, current.successors[0], thenScope_[block], indent + 1);
+                    if (!elseEmpty) {
+                        printer_.writeLine(indent, "} else {");
+                        printArm(block, current.successors[1], elseScope_[block], indent + 1);
+                    }
+                    printer_.writeLine(indent, "}");
+                }
+                block = merge;
+            } else if (i.op == IROp::BRANCH) {
+                printCopies(block, current.successors[0], indent);
+                block = current.successors[0];
+            } else {
+                if (i.operandCount) {
+                    printer_.writeLine(indent, "return " + ref(f_.operand(term, 0)).text + ";");
+                } else if (blockScope_[block] != 0) {
+                    printer_.writeLine(indent, "return;"); // Implicit at the end of the function
+                }
+                block = IR_NONE;
+            }
+        }
+    }
+    
+    void printLoop(uint32_t header, int indent) {
+        const IRBlock& block = f_.blocks[header];
+        IRValue term = f_.terminator(header);
+        IRValue condition = f_.operand(term, 0);
+        bool exitOnTrue = block.successors[0] == block.merge;
+        int scope = loopScope_[header];
+        
+        // The condition is re-evaluated each iteration, so it can only be
+        // written into while (...) when the header computes nothing else
+        bool simple = true;
+        for (IRValue value : block.instructions) {
+            if (inst(value).op != IROp::PHI && !isTerminator(inst(value).op) && !inlined_[value]) {
+                simple = false;
+            }
+        }
+        
+        std::string comment = printer_.branchComment(inst(term).aux);
+        std::string pragma = printer_.loopPragma(block.unroll);
+        if (!pragma.empty()) {
+            printer_.writeLine(indent, pragma);
+        }
+        if (simple) {
+            std::string test = exitOnTrue ? negate(condition) : ref(condition).text;
+            printer_.writeLine(indent, "while (" + test + ") {" + comment);
+            printHoisted(scope, indent + 1);
+        } else {
+            printer_.writeLine(indent, "while (true) {" + comment);
+            printHoisted(scope, indent + 1);
+            printInstructions(header, indent + 1);
+            std::string exit = exitOnTrue ? ref(condition).text : negate(condition);
+            printer_.writeLine(indent + 1, "if (" + exit + ") {");
+            printer_.writeLine(indent + 2, "break;");
+            printer_.writeLine(indent + 1, "}");
+        }
+        printRegion(loopBody(header), header, indent + 1);
+        printer_.writeLine(indent, "}");
+    }
+};
+
+std::string IRPrinter::print(const IRModule& module) {
+    module_ = &module;
+    effects_ = functionEffects(module);
+    out_.str("");
+    out_.clear();
+    printModule();
+    return out_.str();
+}
+
+void IRPrinter::writeLine(int indent, const std::string& line) {
+    if (!line.empty()) {
+        out_ << std::string(static_cast<size_t>(indent) * 4, ' ') << line;
+    }
+    out_ << "\n";
+}
+
+void IRPrinter::printBody(const IRFunction& function, int indent) {
+    BodyPrinter body(*this, function, false);
+    body.print(indent);
+}
+
+std::string IRPrinter::initializerExpression(const IRGlobal& global) {
+    const IRFunction& function = module_->functions[global.initializer];
+    BodyPrinter body(*this, function, true);
+    IRValue ret = function.terminator(static_cast<uint32_t>(function.blocks.size() - 1));
+    for (size_t b = 0; b < function.blocks.size(); ++b) {
+        IRValue term = function.terminator(static_cast<uint32_t>(b));
+        if (function.instructions[term].op == IROp::RETURN) {
+            ret = term;
+        }
+    }
+    return body.expression(function.operand(ret, 0));
+}
+
+std::string IRPrinter::variableType(const IRFunction& function, IRValue value) const {
+    return typeName(function.instructions[value].type);
+}
+
+bool IRPrinter::halfArithmetic(const IRFunction&, IRValue) const {
+    return false;
+}
+
+std::string IRPrinter::halfConversion(const std::string& value, Type::Kind, bool) const {
+    return value;
+}
+
+std::string IRPrinter::swizzle(const std::string& value, uint32_t swizzle) const {
+    return value + swizzleSuffix(swizzle);
+}
+
+std::string IRPrinter::assignComponents(const std::string& target, uint32_t mask, const std::string& value) const {
+    return target + swizzleSuffix(mask) + " = " + value + ";";
+}
+
+const char* IRPrinter::templateFor(const IRInstruction& inst) const {
+    const BuiltinInfo* info = builtinInfo(static_cast<BuiltinId>(inst.imm));
+    if (function_ && function_->fastMath && inst.operandCount > 0) {
+        Type::Kind argument = function_->instructions[function_->operands[inst.firstOperand]].type;
+        if (const char* fast = fastBuiltinTemplate(*info, argument)) {
+            return fast;
+        }
+    }
+    return builtinTemplate(*info);
+}
+
+const char* IRPrinter::fastBuiltinTemplate(const BuiltinInfo&, Type::Kind) const {
+    return nullptr;
+}
+
+const char* IRPrinter::fastDivisionTemplate(Type::Kind, Type::Kind) const {
+    return nullptr;
+}
+
+bool IRPrinter::needsName(const IRInstruction& inst, size_t operand) const {
+    // Arguments a builtin template repeats, such as the coordinate of tex2D
+    if (inst.op == IROp::BUILTIN) {
+        const BuiltinInfo* info = builtinInfo(static_cast<BuiltinId>(inst.imm));
+        std::string chosen = alternativeFor(templateFor(inst), inst.operandCount, info->minArgs);
+        int count;
+        bool delimited;
+        templateUses(chosen, operand, count, delimited);
+        return count > 1;
+    }
+    return false;
+}
+
+std::vector<std::string> IRPrinter::extraArguments(uint32_t) const {
+    return {};
+}
+
+std::string IRPrinter::branchComment(uint32_t) const {
+    return "";
+}
+
+std::string IRPrinter::loopPragma(uint32_t) const {
+    return "";
+}
+
+bool IRPrinter::isReserved(const std::string&) const {
+    return false;
+}
+
+std::string IRPrinter::formatFloat(double value) {
+    if (std::isnan(value)) {
+        return "(0.0 / 0.0)";
+    }
+    if (std::isinf(value)) {
+        return value > 0 ? "(1.0 / 0.0)" : "(-1.0 / 0.0)";
+    }
+    
+    // Values that are exact floats read back as floats; the rest need double digits
+    bool single = static_cast<double>(static_cast<float>(value)) == value;
+    char buffer[40];
+    for (int digits = 1; digits <= 17; ++digits) {
+        std::snprintf(buffer, sizeof(buffer), "%.*g", digits, value);
+        bool exact = single ? std::strtof(buffer, nullptr) == static_cast<float>(value)
+                            : std::strtod(buffer, nullptr) == value;
+        if (exact) {
+            break;
+        }
+    }
+    
+    std::string text = buffer;
+    if (text.find_first_of(".e") == std::string::npos) {
+        text += ".0";
+    }
+    return text;
+}
+
+std::string IRPrinter::formatInt(double value) {
+    long long integer = static_cast<long long>(value);
+    if (integer == INT32_MIN) {
+        return "(-2147483647 - 1)";
+    }
+    return std::to_string(integer);
+}
+
+std::string IRPrinter::swizzleSuffix(uint32_t swizzle) {
+    std::string text = ".";
+    for (int i = 0; i < swizzleCount(swizzle); ++i) {
+        text += "xyzw"[swizzleComponent(swizzle, i)];
+    }
+    return text;
+}
+
+} // namespace sdl
@@ -0,0 +1,147 @@
+#include "ir/passes.h"
+#include <algorithm>
+
+namespace sdl {
+
+namespace {
+
+// Removes one edge from -> to, with the phi operands it carried
+void removeEdge(IRFunction& function, uint32_t from, uint32_t to) {
+    IRBlock& block = function.blocks[to];
+    auto it = std::find(block.predecessors.begin(), block.predecessors.end(), from);
+    size_t index = static_cast<size_t>(it - block.predecessors.begin());
+    block.predecessors.erase(it);
+    
+    for (IRValue value : block.instructions) {
+        if (function.instructions[value].op != IROp::PHI) {
+            continue;
+        }
+        std::vector<IRValue> args(function.operandsOf(value),
+                                  function.operandsOf(value) + function.instructions[value].operandCount);
+        args.erase(args.begin() + static_cast<std::ptrdiff_t>(index));
+        function.setOperands(value, args);
+    }
+}
+
+int foldConstantBranches(const IRModule& module, IRFunction& function) {
+    int folded = 0;
+    for (uint32_t b = 0; b < function.blocks.size(); ++b) {
+        IRValue term = function.terminator(b);
+        if (term == IR_NONE || function.instructions[term].op != IROp::COND_BRANCH) {
+            continue;
+        }
+        const IRInstruction& condition = function.instructions[function.operand(term, 0)];
+        if (condition.op != IROp::CONSTANT) {
+            continue;
+        }
+        
+        IRBlock& block = function.blocks[b];
+        bool taken = module.constants[condition.imm].components[0] != 0.0;
+        // while (true) stays a loop: the back edge is only structured under a loop header
+        if (block.structure == IRStructure::LOOP && taken) {
+            continue;
+        }
+        
+        uint32_t target = block.successors[taken ? 0 : 1];
+        removeEdge(function, b, block.successors[taken ? 1 : 0]);
+        function.remove(term);
+        function.append(b, IROp::BRANCH, Type::Kind::VOID);
+        block.successors[0] = target;
+        block.successors[1] = IR_NONE;
+        block.structure = IRStructure::NONE;
+        block.merge = IR_NONE;
+        block.continueTarget = IR_NONE;
+        ++folded;
+    }
+    return folded;
+}
+
+// Appends a block to its only predecessor when that predecessor branches
+// nowhere else. Blocks a construct names as its merge or latch stay separate
+// so the structure keeps pointing at them.
+bool mergeStraightLines(IRFunction& function) {
+    std::vector<bool> named(function.blocks.size(), false);
+    for (const auto& block : function.blocks) {
+        if (block.merge != IR_NONE) named[block.merge] = true;
+        if (block.continueTarget != IR_NONE) named[block.continueTarget] = true;
+    }
+    
+    bool changed = false;
+    for (uint32_t b = 0; b < function.blocks.size(); ++b) {
+        while (true) {
+            IRBlock& block = function.blocks[b];
+            IRValue term = function.terminator(b);
+            if (term == IR_NONE || function.instructions[term].op != IROp::BRANCH) {
+                break;
+            }
+            uint32_t next = block.successors[0];
+            IRBlock& successor = function.blocks[next];
+            if (next == b || named[next] || successor.predecessors.size() != 1) {
+                break;
+            }
+            
+            function.remove(term);
+            for (IRValue value : std::vector<IRValue>(successor.instructions)) {
+                function.remove(value);
+                if (function.instructions[value].op == IROp::PHI) {
+                    function.replaceAllUses(value, function.operand(value, 0));
+                    continue;
+                }
+                function.insert(b, block.instructions.size(), value);
+            }
+            
+            for (uint32_t succ : successor.successors) {
+                if (succ != IR_NONE) {
+                    auto& preds = function.blocks[succ].predecessors;
+                    std::replace(preds.begin(), preds.end(), next, b);
+                }
+            }
+            block.successors[0] = successor.successors[0];
+            block.successors[1] = successor.successors[1];
+            block.structure = successor.structure;
+            block.merge = successor.merge;
+            block.continueTarget = successor.continueTarget;
+            
+            successor.predecessors.clear();
+            successor.successors[0] = successor.successors[1] = IR_NONE;
+            successor.structure = IRStructure::NONE;
+            successor.merge = successor.continueTarget = IR_NONE;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+size_t placedInstructions(const IRFunction& function) {
+    size_t count = 0;
+    for (const auto& block : function.blocks) {
+        count += block.instructions.size();
+    }
+    return count;
+}
+
+} // anonymous namespace
+
+bool simplifyCFG(IRModule& module, PassContext& context) {
+    bool changed = false;
+    for (auto& function : module.functions) {
+        size_t blocks = function.blocks.size();
+        size_t instructions = placedInstructions(function);
+        
+        int folded = foldConstantBranches(module, function);
+        context.statistics["simplify-cfg.branches-folded"] += folded;
+        changed |= folded > 0;
+        removeUnreachableBlocks(function);
+        removeTrivialPhis(function);
+        if (mergeStraightLines(function)) {
+            removeUnreachableBlocks(function);
+            changed = true;
+        }
+        
+        context.statistics["simplify-cfg.blocks-removed"] += static_cast<int>(blocks - function.blocks.size());
+        changed |= function.blocks.size() != blocks || placedInstructions(function) != instructions;
+    }
+    return changed;
+}
+
+} // namespace sdl
@@ -0,0 +1,491 @@
+#include "ir/passes.h"
+#include "semantic/types.h"
+#include <algorithm>
+
+namespace sdl {
+
+namespace {
+
+// Interpolator locations every GLSL ES 3.00 and GLSL 3.30 implementation
+// provides (gl_MaxVaryingVectors, gl_MaxVaryingComponents / 4)
+constexpr int INTERPOLATOR_SLOTS = 15;
+// Per-fragment cost of interpolating one component: a multiply-add per
+// barycentric coordinate
+constexpr double INTERPOLATION_OPS = 2.0;
+// Fragments a vertex is assumed to cover when weighing work moved from one
+// to the other
+constexpr double FRAGMENTS_PER_VERTEX = 8.0;
+
+int slotsFor(Type::Kind type) {
+    return isMatrix(type) ? matrixDimension(type) : 1;
+}
+
+bool isFloatType(Type::Kind type) {
+    return type == Type::Kind::FLOAT || isFloatVector(type) || isMatrix(type);
+}
+
+// How a fragment value depends on the vertex outputs. Interpolation is
+// linear, so an affine function of interpolated values equals the
+// interpolated function of the vertex values.
+enum class Degree : uint8_t {
+    UNIFORM, // Same for every fragment of a draw: constants and uniforms
+    AFFINE,  // Sums of varyings scaled by uniforms, plus a uniform offset
+    OTHER
+};
+
+class VaryingHoisting {
+public:
+    VaryingHoisting(IRModule& module, uint32_t vertex, uint32_t fragment, PassContext& context)
+        : module_(module), vertex_(vertex), fragment_(fragment), context_(context),
+          function_(module.functions[module.shaders[fragment].entryPoint]) {}
+    
+    bool run() {
+        bool changed = false;
+        while (hoistBest()) {
+            changed = true;
+        }
+        return changed;
+    }
+    
+private:
+    // What moving a value to the vertex shader does per fragment
+    struct Evaluation {
+        int operations = 0;      // Arithmetic no longer computed by the fragment shader
+        int freedComponents = 0; // Of varyings nothing else reads any more
+        int freedSlots = 0;
+        double profit = 0;
+        std::vector<IRValue> dead; // The root and what only it used
+    };
+    
+    IRModule& module_;
+    uint32_t vertex_;
+    uint32_t fragment_;
+    PassContext& context_;
+    IRFunction& function_; // Fragment entry point
+    std::vector<Degree> degrees_;
+    std::vector<std::vector<IRValue>> users_;
+    std::vector<int> loads_; // Per global, over every function of the fragment shader
+    
+    const IRInstruction& inst(IRValue value) const { return function_.instructions[value]; }
+    
+    // The shader's global of the given name, or IR_NONE
+    uint32_t find(uint32_t shader, const std::string& name) const {
+        for (const IRItem& item : module_.shaders[shader].items) {
+            if (item.kind == IRItem::Kind::GLOBAL && module_.globals[item.index].name == name) {
+                return item.index;
+            }
+        }
+        return IR_NONE;
+    }
+    
+    // The vertex output a fragment input interpolates, or IR_NONE
+    uint32_t outputFor(uint32_t input) const {
+        const IRGlobal& global = module_.globals[input];
+        if (global.qualifier != VariableDeclaration::Qualifier::IN || global.builtin || global.shader != fragment_ ||
+            !isFloatType(global.type)) {
+            return IR_NONE;
+        }
+        uint32_t output = find(vertex_, global.name);
+        bool matches = output != IR_NONE && module_.globals[output].qualifier == VariableDeclaration::Qualifier::OUT &&
+                       module_.globals[output].type == global.type;
+        return matches ? output : IR_NONE;
+    }
+    
+    // Whether the vertex shader can read the uniform: program-level uniforms
+    // are shared, a fragment one is declared again under its name unless the
+    // host derives it for the fragment shader alone
+    bool vertexVisible(uint32_t uniform) const {
+        const IRGlobal& global = module_.globals[uniform];
+        if (global.qualifier != VariableDeclaration::Qualifier::UNIFORM || global.builtin || isSampler(global.type)) {
+            return false;
+        }
+        if (global.shader == IR_NONE) {
+            return true;
+        }
+        const IRFunction& preshader = module_.shaders[fragment_].preshader;
+        for (const auto& block : preshader.blocks) {
+            for (IRValue value : block.instructions) {
+                if (preshader.instructions[value].op == IROp::STORE && preshader.instructions[value].imm == uniform) {
+                    return false;
+                }
+            }
+        }
+        uint32_t existing = find(vertex_, global.name);
+        if (existing == IR_NONE) {
+            return global.initializer == IR_NONE;
+        }
+        return module_.globals[existing].qualifier == VariableDeclaration::Qualifier::UNIFORM &&
+               module_.globals[existing].type == global.type;
+    }
+    
+    uint32_t vertexUniform(uint32_t uniform) {
+        const IRGlobal& global = module_.globals[uniform];
+        if (global.shader == IR_NONE) {
+            return uniform;
+        }
+        uint32_t existing = find(vertex_, global.name);
+        if (existing != IR_NONE) {
+            return existing;
+        }
+        IRGlobal copy = global;
+        copy.shader = vertex_;
+        return declare(copy, VariableDeclaration::Qualifier::UNIFORM);
+    }
+    
+    // Adds a global to the shader of `global`, after the last global there
+    // with the same qualifier
+    uint32_t declare(const IRGlobal& global, VariableDeclaration::Qualifier after) {
+        uint32_t index = static_cast<uint32_t>(module_.globals.size());
+        module_.globals.push_back(global);
+        auto& items = module_.shaders[global.shader].items;
+        auto position = items.begin();
+        for (auto it = items.begin(); it != items.end(); ++it) {
+            if (it->kind == IRItem::Kind::GLOBAL && module_.globals[it->index].qualifier == after) {
+                position = it + 1;
+            }
+        }
+        items.insert(position, IRItem{IRItem::Kind::GLOBAL, index});
+        return index;
+    }
+    
+    Degree degreeOf(IRValue value) const {
+        const IRInstruction& i = inst(value);
+        auto operand = [&](uint32_t k) { return degrees_[function_.operand(value, k)]; };
+        Degree highest = Degree::UNIFORM;
+        for (uint32_t k = 0; k < i.operandCount; ++k) {
+            highest = std::max(highest, operand(k));
+        }
+        
+        Degree degree = Degree::OTHER;
+        switch (i.op) {
+            case IROp::CONSTANT:
+                return Degree::UNIFORM;
+            case IROp::LOAD:
+                if (outputFor(i.imm) != IR_NONE) {
+                    return Degree::AFFINE;
+                }
+                return vertexVisible(i.imm) ? Degree::UNIFORM : Degree::OTHER;
+            case IROp::ADD:
+            case IROp::SUB:
+            case IROp::NEG:
+            case IROp::CONSTRUCT:
+            case IROp::EXTRACT:
+            case IROp::SWIZZLE:
+            case IROp::INSERT:
+                degree = highest;
+                break;
+            case IROp::MUL:
+                // One factor must be uniform; this covers a uniform matrix
+                // times an interpolated vector
+                degree = operand(0) == Degree::AFFINE && operand(1) == Degree::AFFINE ? Degree::OTHER : highest;
+                break;
+            case IROp::DIV:
+                degree = operand(1) == Degree::UNIFORM ? operand(0) : Degree::OTHER;
+                break;
+            case IROp::MOD:
+            case IROp::EQ:
+            case IROp::NE:
+            case IROp::LT:
+            case IROp::LE:
+            case IROp::GT:
+            case IROp::GE:
+            case IROp::AND:
+            case IROp::OR:
+            case IROp::NOT:
+            case IROp::SELECT:
+                degree = highest == Degree::UNIFORM ? Degree::UNIFORM : Degree::OTHER;
+                break;
+            case IROp::BUILTIN: {
+                const BuiltinInfo* info = builtinInfo(static_cast<BuiltinId>(i.imm));
+                bool pure = info->effects == 0 && !info->has(BuiltinFlag::TEXTURE_FETCH | BuiltinFlag::DERIVATIVE);
+                degree = pure && highest == Degree::UNIFORM ? Degree::UNIFORM : Degree::OTHER;
+                break;
+            }
+            default:
+                return Degree::OTHER;
+        }
+        // Truncation to int is not affine
+        return degree == Degree::AFFINE && !isFloatType(i.type) ? Degree::OTHER : degree;
+    }
+    
+    void analyze() {
+        degrees_.assign(function_.instructions.size(), Degree::OTHER);
+        users_.assign(function_.instructions.size(), {});
+        for (uint32_t b : reversePostorder(function_)) {
+            for (IRValue value : function_.blocks[b].instructions) {
+                degrees_[value] = degreeOf(value);
+                for (uint32_t k = 0; k < inst(value).operandCount; ++k) {
+                    users_[function_.operand(value, k)].push_back(value);
+                }
+            }
+        }
+        
+        loads_.assign(module_.globals.size(), 0);
+        for (const auto& function : module_.functions) {
+            if (function.shader != fragment_) {
+                continue;
+            }
+            for (const auto& block : function.blocks) {
+                for (IRValue value : block.instructions) {
+                    if (function.instructions[value].op == IROp::LOAD) {
+                        ++loads_[function.instructions[value].imm];
+                    }
+                }
+            }
+        }
+    }
+    
+    // Interpolator locations the vertex shader writes
+    int slotsInUse() const {
+        int slots = 0;
+        for (const IRItem& item : module_.shaders[vertex_].items) {
+            const IRGlobal& global = module_.globals[item.index];
+            if (item.kind == IRItem::Kind::GLOBAL && global.qualifier == VariableDeclaration::Qualifier::OUT &&
+                !global.builtin) {
+                slots += slotsFor(global.type);
+            }
+        }
+        return slots;
+    }
+    
+    // The expression under `value`, each value after all its users in it
+    void collect(IRValue value, std::vector<IRValue>& order, std::vector<bool>& seen) const {
+        if (seen[value]) {
+            return;
+        }
+        seen[value] = true;
+        if (inst(value).op != IROp::LOAD) {
+            for (uint32_t k = 0; k < inst(value).operandCount; ++k) {
+                collect(function_.operand(value, k), order, seen);
+            }
+        }
+        order.push_back(value);
+    }
+    
+    Evaluation evaluate(IRValue root) const {
+        std::vector<IRValue> order;
+        std::vector<bool> seen(function_.instructions.size(), false);
+        collect(root, order, seen);
+        std::reverse(order.begin(), order.end());
+        
+        // What dies with the root: values all of whose users die
+        std::vector<bool> dead(function_.instructions.size(), false);
+        dead[root] = true;
+        std::vector<int> deadLoads(module_.globals.size(), 0);
+        Evaluation result;
+        for (IRValue value : order) {
+            dead[value] = dead[value] || std::all_of(users_[value].begin(), users_[value].end(),
+                                                     [&](IRValue user) { return dead[user]; });
+            if (!dead[value]) {
+                continue;
+            }
+            result.dead.push_back(value);
+            if (arithmetic(value)) {
+                result.operations += operationCount(function_, value);
+            }
+            if (inst(value).op == IROp::LOAD) {
+                ++deadLoads[inst(value).imm];
+            }
+        }
+        for (size_t g = 0; g < deadLoads.size(); ++g) {
+            if (deadLoads[g] > 0 && deadLoads[g] == loads_[g] && outputFor(static_cast<uint32_t>(g)) != IR_NONE) {
+                result.freedComponents += componentCount(module_.globals[g].type);
+                result.freedSlots += slotsFor(module_.globals[g].type);
+            }
+        }
+        
+        // The operations now run per vertex, and the value is interpolated
+        // in place of the varyings it frees. Moving no arithmetic only
+        // renames an interpolated value, however the varyings are packed.
+        if (result.operations > 0) {
+            result.profit = result.operations * (1.0 - 1.0 / FRAGMENTS_PER_VERTEX) +
+                            INTERPOLATION_OPS * (result.freedComponents - componentCount(inst(root).type));
+        }
+        return result;
+    }
+    
+    // Loads, swizzles and constructs only regroup interpolated components
+    bool arithmetic(IRValue value) const {
+        switch (inst(value).op) {
+            case IROp::LOAD:
+            case IROp::CONSTRUCT:
+            case IROp::EXTRACT:
+            case IROp::SWIZZLE:
+            case IROp::INSERT:
+                return false;
+            default:
+                return true;
+        }
+    }
+    
+    bool candidate(IRValue value) const {
+        Type::Kind type = inst(value).type;
+        return degrees_[value] == Degree::AFFINE && inst(value).op != IROp::LOAD &&
+               (type == Type::Kind::FLOAT || isFloatVector(type));
+    }
+    
+    bool hoistBest() {
+        analyze();
+        int slots = slotsInUse();
+        IRValue best = IR_NONE;
+        Evaluation chosen;
+        for (uint32_t b : reversePostorder(function_)) {
+            for (IRValue value : function_.blocks[b].instructions) {
+                if (!candidate(value)) {
+                    continue;
+                }
+                Evaluation evaluation = evaluate(value);
+                if (evaluation.profit > chosen.profit &&
+                    slots + slotsFor(inst(value).type) - evaluation.freedSlots <= INTERPOLATOR_SLOTS) {
+                    best = value;
+                    chosen = evaluation;
+                }
+            }
+        }
+        if (best == IR_NONE) {
+            return false;
+        }
+        hoist(best);
+        for (IRValue value : chosen.dead) {
+            function_.remove(value);
+        }
+        demoteUnreadOutputs();
+        context_.statistics["hoist-to-vertex.operations"] += chosen.operations;
+        ++context_.statistics["hoist-to-vertex.varyings"];
+        return true;
+    }
+    
+    std::string nameFor(IRValue root) const {
+        if (!function_.nameOf(root).empty()) {
+            return function_.nameOf(root);
+        }
+        std::vector<IRValue> order;
+        std::vector<bool> seen(function_.instructions.size(), false);
+        collect(root, order, seen);
+        for (IRValue value : order) {
+            if (inst(value).op == IROp::LOAD && outputFor(inst(value).imm) != IR_NONE) {
+                return module_.globals[inst(value).imm].name + "_interpolated";
+            }
+        }
+        return "interpolated";
+    }
+    
+    // Recomputes a fragment value from the vertex shader's outputs and
+    // uniforms before `before` in the vertex entry point
+    IRValue copy(IRValue value, IRFunction& target, uint32_t block, IRValue before, std::vector<IRValue>& copies) {
+        if (copies[value] != IR_NONE) {
+            return copies[value];
+        }
+        const IRInstruction& i = inst(value);
+        IRValue result;
+        if (i.op == IROp::LOAD) {
+            uint32_t output = outputFor(i.imm);
+            result = target.create(IROp::LOAD, i.type, {}, output != IR_NONE ? output : vertexUniform(i.imm));
+        } else {
+            std::vector<IRValue> args;
+            for (uint32_t k = 0; k < i.operandCount; ++k) {
+                args.push_back(copy(function_.operand(value, k), target, block, before, copies));
+            }
+            result = target.create(i.op, i.type, args, i.imm);
+            target.instructions[result].aux = i.aux;
+        }
+        auto& list = target.blocks[block].instructions;
+        target.insert(block, std::find(list.begin(), list.end(), before) - list.begin(), result);
+        return copies[value] = result;
+    }
+    
+    void hoist(IRValue root) {
+        std::string name = nameFor(root);
+        std::string unique = name;
+        for (int suffix = 2; std::any_of(module_.globals.begin(), module_.globals.end(),
+                                         [&](const IRGlobal& global) { return global.name == unique; });
+             ++suffix) {
+            unique = name + std::to_string(suffix);
+        }
+        
+        IRGlobal varying;
+        varying.name = unique;
+        varying.type = inst(root).type;
+        varying.qualifier = VariableDeclaration::Qualifier::OUT;
+        varying.shader = vertex_;
+        uint32_t output = declare(varying, VariableDeclaration::Qualifier::OUT);
+        varying.qualifier = VariableDeclaration::Qualifier::IN;
+        varying.shader = fragment_;
+        uint32_t input = declare(varying, VariableDeclaration::Qualifier::IN);
+        
+        // The vertex shader computes the value last, from what it wrote
+        IRFunction& target = module_.functions[module_.shaders[vertex_].entryPoint];
+        for (uint32_t b = 0; b < target.blocks.size(); ++b) {
+            IRValue term = target.terminator(b);
+            if (term == IR_NONE || target.instructions[term].op != IROp::RETURN) {
+                continue;
+            }
+            std::vector<IRValue> copies(function_.instructions.size(), IR_NONE);
+            IRValue value = copy(root, target, b, term, copies);
+            IRValue store = target.create(IROp::STORE, Type::Kind::VOID, {value}, output);
+            auto& list = target.blocks[b].instructions;
+            target.insert(b, std::find(list.begin(), list.end(), term) - list.begin(), store);
+        }
+        
+        IRValue load = function_.create(IROp::LOAD, inst(root).type, {}, input);
+        function_.instructions[load].name = inst(root).name;
+        auto& list = function_.blocks[inst(root).block].instructions;
+        function_.insert(inst(root).block, std::find(list.begin(), list.end(), root) - list.begin(), load);
+        function_.replaceAllUses(root, load);
+    }
+    
+    // Outputs whose input the fragment shader stopped reading become
+    // private globals of the vertex shader, which dce and strip-globals
+    // then remove
+    void demoteUnreadOutputs() {
+        analyze();
+        for (const IRItem& item : module_.shaders[fragment_].items) {
+            uint32_t output = item.kind == IRItem::Kind::GLOBAL ? outputFor(item.index) : IR_NONE;
+            if (output != IR_NONE && loads_[item.index] == 0) {
+                module_.globals[output].qualifier = VariableDeclaration::Qualifier::NONE;
+                ++context_.statistics["hoist-to-vertex.demoted"];
+            }
+        }
+    }
+};
+
+} // anonymous namespace
+
+bool hoistToVertexShader(IRModule& module, PassContext& context) {
+    // Each fragment shader reads the closest vertex shader before it, as in
+    // StageInterface. A vertex shader feeding several fragment shaders keeps
+    // its outputs, which are what the others read.
+    std::vector<uint32_t> vertexOf(module.shaders.size(), IR_NONE);
+    std::vector<int> consumers(module.shaders.size(), 0);
+    uint32_t vertex = IR_NONE;
+    for (const IRItem& item : module.items) {
+        if (item.kind != IRItem::Kind::SHADER) {
+            continue;
+        }
+        switch (module.shaders[item.index].stage) {
+            case ShaderDeclaration::ShaderType::VERTEX:
+                vertex = item.index;
+                break;
+            case ShaderDeclaration::ShaderType::FRAGMENT:
+                if (vertex != IR_NONE) {
+                    vertexOf[item.index] = vertex;
+                    ++consumers[vertex];
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    
+    bool changed = false;
+    for (uint32_t fragment = 0; fragment < module.shaders.size(); ++fragment) {
+        uint32_t source = vertexOf[fragment];
+        if (source != IR_NONE && consumers[source] == 1 && module.shaders[source].entryPoint != IR_NONE &&
+            module.shaders[fragment].entryPoint != IR_NONE) {
+            changed |= VaryingHoisting(module, source, fragment, context).run();
+        }
+    }
+    return changed;
+}
+
+} // namespace sdl
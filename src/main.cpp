@@ -1,7 +1,10 @@
 #include "cli/cli_parser.h"
 #include "compiler/compiler.h"
+#include "utils/json.h"
+#include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 using namespace sdl;
 
@@ -32,6 +35,28 @@ int main(int argc, char* argv[]) {
         compilerOptions.includePaths = options.includePaths;
         compilerOptions.defines = options.defines;
         compilerOptions.verbose = options.verbose;
+        compilerOptions.passes = options.passes;
+        compilerOptions.timePasses = options.timePasses;
+        compilerOptions.fastMath = options.fastMath;
+        compilerOptions.glslES = options.glslES;
+        compilerOptions.foldUniforms = options.foldUniforms;
+        compilerOptions.preshader = options.preshader;
+        compilerOptions.printBefore = options.printBefore;
+        compilerOptions.printAfter = options.printAfter;
+        if (options.optimization == "0") {
+            compilerOptions.optimization = OptimizationLevel::O0;
+        } else if (options.optimization == "1") {
+            compilerOptions.optimization = OptimizationLevel::O1;
+        } else if (options.optimization == "3") {
+            compilerOptions.optimization = OptimizationLevel::O3;
+        } else if (options.optimization == "s") {
+            compilerOptions.optimization = OptimizationLevel::OS;
+        }
+        if (options.stats == "json") {
+            compilerOptions.stats = StatsFormat::JSON;
+        } else if (options.stats == "text") {
+            compilerOptions.stats = StatsFormat::TEXT;
+        }
         
         // Parse target languages
         for (const auto& target : options.targets) {
@@ -56,7 +81,21 @@ int main(int argc, char* argv[]) {
             std::cout << "Compiling " << options.inputFile << "...\n";
         }
         
-        bool success = compiler.compile(compilerOptions);
+        bool success;
+        std::vector<Permutation> permutations;
+        if (!options.permutations.empty()) {
+            std::ifstream matrixFile(options.permutations);
+            if (!matrixFile) {
+                std::cerr << "Error: Cannot open permutation matrix '" << options.permutations << "'\n";
+                return 1;
+            }
+            std::stringstream matrix;
+            matrix << matrixFile.rdbuf();
+            permutations = expandPermutations(matrix.str());
+            success = compiler.compilePermutations(compilerOptions, permutations);
+        } else {
+            success = compiler.compile(compilerOptions);
+        }
         
         if (!success) {
             std::cerr << "Compilation failed:\n";
@@ -71,51 +110,125 @@ int main(int argc, char* argv[]) {
             std::cerr << "Warning: " << warning << "\n";
         }
         
+        // IR dumps and timings go to stderr so --stats=json stays parseable
+        std::cerr << compiler.getPassOutput();
+        
         // Write output files
-        for (auto target : compilerOptions.targets) {
-            std::string output;
-            std::string extension;
-            
-            if (target == TargetLanguage::GLSL) {
-                output = compiler.getGLSLOutput();
-                extension = ".glsl";
-            } else if (target == TargetLanguage::CUDA) {
-                output = compiler.getCUDAOutput();
-                extension = ".cu";
+        std::string baseName = compilerOptions.outputFile;
+        if (baseName.empty()) {
+            // Generate output filename from input
+            size_t lastDot = compilerOptions.inputFile.find_last_of('.');
+            if (lastDot != std::string::npos) {
+                baseName = compilerOptions.inputFile.substr(0, lastDot);
+            } else {
+                baseName = compilerOptions.inputFile;
             }
-            
-            std::string outputFile = compilerOptions.outputFile;
-            if (outputFile.empty()) {
-                // Generate output filename from input
-                size_t lastDot = compilerOptions.inputFile.find_last_of('.');
-                if (lastDot != std::string::npos) {
-                    outputFile = compilerOptions.inputFile.substr(0, lastDot);
-                } else {
-                    outputFile = compilerOptions.inputFile;
+        }
+        
+        // Writes the outputs of one compilation next to `base`, adding each
+        // file name to `written`
+        auto writeOutputs = [&](const std::string& base, const std::string& glsl, const std::string& cuda,
+                                const std::string& hostUniforms, std::vector<std::string>& written) {
+            std::vector<std::pair<std::string, const std::string*>> files;
+            for (auto target : compilerOptions.targets) {
+                std::string outputFile = base;
+                if (compilerOptions.targets.size() > 1) {
+                    // Multiple targets, append target name
+                    outputFile += target == TargetLanguage::GLSL ? "_glsl" : "_cuda";
                 }
+                outputFile += target == TargetLanguage::GLSL ? ".glsl" : ".cu";
+                files.emplace_back(outputFile, target == TargetLanguage::GLSL ? &glsl : &cuda);
+            }
+            // The host computes the uniforms --fold-uniforms and --preshader derived
+            if (!hostUniforms.empty()) {
+                files.emplace_back(base + "_uniforms.h", &hostUniforms);
             }
             
-            if (compilerOptions.targets.size() > 1) {
-                // Multiple targets, append target name
-                std::string targetName = (target == TargetLanguage::GLSL) ? "_glsl" : "_cuda";
-                outputFile += targetName;
+            for (const auto& file : files) {
+                std::ofstream outFile(file.first);
+                if (!outFile) {
+                    std::cerr << "Error: Cannot write to output file '" << file.first << "'\n";
+                    return false;
+                }
+                outFile << *file.second;
+                written.push_back(file.first);
+                
+                if (options.verbose) {
+                    std::cout << "Generated " << file.first << "\n";
+                }
+            }
+            return true;
+        };
+        
+        if (permutations.empty()) {
+            std::vector<std::string> written;
+            if (!writeOutputs(baseName, compiler.getGLSLOutput(), compiler.getCUDAOutput(),
+                              compiler.getHostUniformsOutput(), written)) {
+                return 1;
+            }
+        } else {
+            // One set of files per distinct variant, and a manifest mapping
+            // each permutation to its variant
+            const auto& variants = compiler.getVariants();
+            std::vector<std::vector<std::string>> variantFiles(variants.size());
+            for (size_t n = 0; n < variants.size(); ++n) {
+                if (!writeOutputs(baseName + "_" + std::to_string(n), variants[n].glslOutput, variants[n].cudaOutput,
+                                  variants[n].hostUniformsOutput, variantFiles[n])) {
+                    return 1;
+                }
             }
             
-            outputFile += extension;
+            auto writeFiles = [](JsonWriter& json, const std::vector<std::string>& files) {
+                json.beginArray();
+                for (const auto& file : files) {
+                    json.value(file);
+                }
+                json.endArray();
+            };
+            JsonWriter json;
+            json.beginObject();
+            json.key("file").value(compilerOptions.inputFile);
+            json.key("permutations").beginObject();
+            for (size_t i = 0; i < permutations.size(); ++i) {
+                size_t variant = compiler.getPermutationVariants()[i];
+                json.key(permutations[i].key).beginObject();
+                json.key("variant").integer(static_cast<long long>(variant));
+                json.key("outputs");
+                writeFiles(json, variantFiles[variant]);
+                json.endObject();
+            }
+            json.endObject();
+            json.key("variants").beginArray();
+            for (size_t n = 0; n < variants.size(); ++n) {
+                char hash[17];
+                std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(variants[n].hash));
+                json.beginObject();
+                json.key("hash").value(hash);
+                json.key("outputs");
+                writeFiles(json, variantFiles[n]);
+                json.endObject();
+            }
+            json.endArray();
+            json.endObject();
             
-            std::ofstream outFile(outputFile);
-            if (!outFile) {
-                std::cerr << "Error: Cannot write to output file '" << outputFile << "'\n";
+            std::string manifestFile = baseName + "_permutations.json";
+            std::ofstream manifest(manifestFile);
+            if (!manifest) {
+                std::cerr << "Error: Cannot write to output file '" << manifestFile << "'\n";
                 return 1;
             }
-            
-            outFile << output;
+            manifest << json.str() << "\n";
             
             if (options.verbose) {
-                std::cout << "Generated " << outputFile << "\n";
+                std::cout << "Generated " << manifestFile << " (" << permutations.size() << " permutations, "
+                          << variants.size() << " variants)\n";
             }
         }
         
+        if (compilerOptions.stats != StatsFormat::NONE) {
+            std::cout << compiler.getStatsOutput();
+        }
+        
         if (options.verbose) {
             std::cout << "Compilation successful!\n";
         }
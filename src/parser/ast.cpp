@@ -54,6 +54,24 @@ void ShaderDeclaration::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
 
+const Attribute* Statement::findAttribute(const std::string& name) const {
+    for (const Attribute& attribute : attributes) {
+        if (attribute.name == name) {
+            return &attribute;
+        }
+    }
+    return nullptr;
+}
+
+const char* shaderStageName(ShaderDeclaration::ShaderType type) {
+    switch (type) {
+        case ShaderDeclaration::ShaderType::VERTEX: return "vertex";
+        case ShaderDeclaration::ShaderType::FRAGMENT: return "fragment";
+        case ShaderDeclaration::ShaderType::COMPUTE: return "compute";
+    }
+    return "unknown";
+}
+
 void BlockStatement::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
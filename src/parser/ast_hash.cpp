@@ -0,0 +1,198 @@
+#include "parser/ast_hash.h"
+#include "parser/ast_walker.h"
+#include <string>
+
+namespace sdl {
+
+namespace {
+
+enum class NodeTag : uint8_t {
+    TYPE = 1, IDENTIFIER, LITERAL, BINARY, UNARY, CALL, MEMBER,
+    EXPRESSION_STMT, ASSIGNMENT, VARIABLE, FUNCTION, SHADER, BLOCK,
+    IF, FOR, WHILE, RETURN, PROGRAM, ABSENT
+};
+
+class StructuralHasher : public ASTWalker {
+public:
+    uint64_t hash = 14695981039346656037ull; // FNV-1a offset basis
+    
+    void visit(Type& node) override {
+        tag(NodeTag::TYPE);
+        mix(static_cast<uint64_t>(node.kind));
+        mix(node.name);
+        mix(static_cast<uint64_t>(node.arraySize));
+    }
+    
+    void visit(IdentifierExpression& node) override {
+        tag(NodeTag::IDENTIFIER);
+        mix(node.name);
+    }
+    
+    void visit(LiteralExpression& node) override {
+        tag(NodeTag::LITERAL);
+        mix(static_cast<uint64_t>(node.literalType));
+        mix(node.value);
+    }
+    
+    void visit(BinaryExpression& node) override {
+        tag(NodeTag::BINARY);
+        mix(static_cast<uint64_t>(node.op));
+        ASTWalker::visit(node);
+    }
+    
+    void visit(UnaryExpression& node) override {
+        tag(NodeTag::UNARY);
+        mix(static_cast<uint64_t>(node.op));
+        ASTWalker::visit(node);
+    }
+    
+    void visit(FunctionCallExpression& node) override {
+        tag(NodeTag::CALL);
+        mix(node.functionName);
+        mix(node.arguments.size());
+        ASTWalker::visit(node);
+    }
+    
+    void visit(MemberAccessExpression& node) override {
+        tag(NodeTag::MEMBER);
+        mix(node.member);
+        ASTWalker::visit(node);
+    }
+    
+    void visit(ExpressionStatement& node) override {
+        tag(NodeTag::EXPRESSION_STMT);
+        mixAttributes(node);
+        ASTWalker::visit(node);
+    }
+    
+    void visit(AssignmentStatement& node) override {
+        tag(NodeTag::ASSIGNMENT);
+        mixAttributes(node);
+        ASTWalker::visit(node);
+    }
+    
+    void visit(VariableDeclaration& node) override {
+        tag(NodeTag::VARIABLE);
+        mixAttributes(node);
+        mix(static_cast<uint64_t>(node.qualifier));
+        mix(node.name);
+        optional(node.type.get());
+        optional(node.initializer.get());
+    }
+    
+    void visit(FunctionDeclaration& node) override {
+        tag(NodeTag::FUNCTION);
+        mixAttributes(node);
+        mix(node.name);
+        optional(node.returnType.get());
+        mix(node.parameters.size());
+        mix(node.body.size());
+        ASTWalker::visit(node);
+    }
+    
+    void visit(ShaderDeclaration& node) override {
+        tag(NodeTag::SHADER);
+        mixAttributes(node);
+        mix(node.name);
+        mix(static_cast<uint64_t>(node.shaderType));
+        mix(node.body.size());
+        ASTWalker::visit(node);
+    }
+    
+    void visit(BlockStatement& node) override {
+        tag(NodeTag::BLOCK);
+        mixAttributes(node);
+        mix(node.statements.size());
+        ASTWalker::visit(node);
+    }
+    
+    void visit(IfStatement& node) override {
+        tag(NodeTag::IF);
+        mixAttributes(node);
+        optional(node.condition.get());
+        optional(node.thenStatement.get());
+        optional(node.elseStatement.get());
+    }
+    
+    void visit(ForStatement& node) override {
+        tag(NodeTag::FOR);
+        mixAttributes(node);
+        optional(node.initialization.get());
+        optional(node.condition.get());
+        optional(node.update.get());
+        optional(node.body.get());
+    }
+    
+    void visit(WhileStatement& node) override {
+        tag(NodeTag::WHILE);
+        mixAttributes(node);
+        optional(node.condition.get());
+        optional(node.body.get());
+    }
+    
+    void visit(ReturnStatement& node) override {
+        tag(NodeTag::RETURN);
+        mixAttributes(node);
+        optional(node.value.get());
+    }
+    
+    void visit(Program& node) override {
+        tag(NodeTag::PROGRAM);
+        mix(node.declarations.size());
+        ASTWalker::visit(node);
+    }
+    
+private:
+    void mixByte(uint8_t byte) {
+        hash ^= byte;
+        hash *= 1099511628211ull; // FNV-1a prime
+    }
+    
+    void mix(uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            mixByte(static_cast<uint8_t>(value >> (i * 8)));
+        }
+    }
+    
+    void mix(const std::string& text) {
+        mix(text.size());
+        for (char c : text) {
+            mixByte(static_cast<uint8_t>(c));
+        }
+    }
+    
+    void mixAttributes(const Statement& node) {
+        mix(node.attributes.size());
+        for (const Attribute& attribute : node.attributes) {
+            mix(attribute.name);
+            mix(attribute.arguments.size());
+            for (const std::string& argument : attribute.arguments) {
+                mix(argument);
+            }
+        }
+    }
+    
+    void tag(NodeTag t) {
+        mixByte(static_cast<uint8_t>(t));
+    }
+    
+    // Missing children still leave a mark, so a for loop without an
+    // initializer cannot hash the same as one without a condition
+    void optional(ASTNode* node) {
+        if (node) {
+            node->accept(*this);
+        } else {
+            tag(NodeTag::ABSENT);
+        }
+    }
+};
+
+} // namespace
+
+uint64_t structuralHash(ASTNode& node) {
+    StructuralHasher hasher;
+    node.accept(hasher);
+    return hasher.hash;
+}
+
+} // namespace sdl
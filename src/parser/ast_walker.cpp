@@ -0,0 +1,103 @@
+#include "parser/ast_walker.h"
+
+namespace sdl {
+
+void ASTWalker::walk(ASTNode* node) {
+    if (node) {
+        node->accept(*this);
+    }
+}
+
+void ASTWalker::visit(Type&) {
+}
+
+void ASTWalker::visit(IdentifierExpression&) {
+}
+
+void ASTWalker::visit(LiteralExpression&) {
+}
+
+void ASTWalker::visit(BinaryExpression& node) {
+    walk(node.left.get());
+    walk(node.right.get());
+}
+
+void ASTWalker::visit(UnaryExpression& node) {
+    walk(node.operand.get());
+}
+
+void ASTWalker::visit(FunctionCallExpression& node) {
+    for (auto& arg : node.arguments) {
+        walk(arg.get());
+    }
+}
+
+void ASTWalker::visit(MemberAccessExpression& node) {
+    walk(node.object.get());
+}
+
+void ASTWalker::visit(ExpressionStatement& node) {
+    walk(node.expression.get());
+}
+
+void ASTWalker::visit(AssignmentStatement& node) {
+    walk(node.target.get());
+    walk(node.value.get());
+}
+
+void ASTWalker::visit(VariableDeclaration& node) {
+    walk(node.type.get());
+    walk(node.initializer.get());
+}
+
+void ASTWalker::visit(FunctionDeclaration& node) {
+    walk(node.returnType.get());
+    for (auto& param : node.parameters) {
+        walk(param.get());
+    }
+    for (auto& stmt : node.body) {
+        walk(stmt.get());
+    }
+}
+
+void ASTWalker::visit(ShaderDeclaration& node) {
+    for (auto& stmt : node.body) {
+        walk(stmt.get());
+    }
+}
+
+void ASTWalker::visit(BlockStatement& node) {
+    for (auto& stmt : node.statements) {
+        walk(stmt.get());
+    }
+}
+
+void ASTWalker::visit(IfStatement& node) {
+    walk(node.condition.get());
+    walk(node.thenStatement.get());
+    walk(node.elseStatement.get());
+}
+
+void ASTWalker::visit(ForStatement& node) {
+    walk(node.initialization.get());
+    walk(node.condition.get());
+    walk(node.update.get());
+    walk(node.body.get());
+}
+
+void ASTWalker::visit(WhileStatement& node) {
+    walk(node.condition.get());
+    walk(node.body.get());
+}
+
+void ASTWalker::visit(ReturnStatement& node) {
+    walk(node.value.get());
+}
+
+void ASTWalker::visit(Program& node) {
+    for (auto& decl : node.declarations) {
+        walk(decl.get());
+    }
+}
+
+} // namespace sdl
@@ -7,6 +7,11 @@ namespace sdl {
 Parser::Parser(std::vector<Token> tokens) : tokens_(std::move(tokens)), current_(0) {
 }
 
+static void copyLocation(ASTNode& to, const ASTNode& from) {
+    to.line = from.line;
+    to.column = from.column;
+}
+
 std::unique_ptr<Program> Parser::parseProgram() {
     auto program = std::make_unique<Program>();
     
@@ -75,6 +80,15 @@ void Parser::advance() {
 }
 
 StatementPtr Parser::parseDeclaration() {
+    if (check(TokenType::LEFT_BRACKET)) {
+        std::vector<Attribute> attributes = parseAttributes();
+        StatementPtr decl = parseDeclaration();
+        if (decl) {
+            decl->attributes.insert(decl->attributes.begin(), attributes.begin(), attributes.end());
+        }
+        return decl;
+    }
+    
     if (match(TokenType::SHADER)) {
         return parseShaderDeclaration();
     }
@@ -99,6 +113,7 @@ StatementPtr Parser::parseDeclaration() {
             if (check(TokenType::LEFT_PAREN)) {
                 // Function declaration
                 auto func = std::make_unique<FunctionDeclaration>(nameToken.value, std::move(type));
+                setLocation(*func, nameToken);
                 
                 consume(TokenType::LEFT_PAREN, "Expected '('");
                 
@@ -111,6 +126,7 @@ StatementPtr Parser::parseDeclaration() {
                         
                         auto param = std::make_unique<VariableDeclaration>(
                             paramQualifier, std::move(paramType), paramName.value);
+                        setLocation(*param, paramName);
                         func->parameters.push_back(std::move(param));
                     } while (match(TokenType::COMMA));
                 }
@@ -130,18 +146,19 @@ StatementPtr Parser::parseDeclaration() {
                     consume(TokenType::SEMICOLON, "Expected ';' after function declaration");
                 }
                 
-                return std::move(func);
+                return func;
             } else {
                 // Variable declaration
                 auto varDecl = std::make_unique<VariableDeclaration>(
                     qualifier, std::move(type), nameToken.value);
+                setLocation(*varDecl, nameToken);
                 
                 if (match(TokenType::ASSIGN)) {
                     varDecl->initializer = parseExpression();
                 }
                 
                 consume(TokenType::SEMICOLON, "Expected ';' after variable declaration");
-                return std::move(varDecl);
+                return varDecl;
             }
         }
         
@@ -159,10 +176,13 @@ StatementPtr Parser::parseShaderDeclaration() {
     ShaderDeclaration::ShaderType shaderType = parseShaderType();
     
     auto shader = std::make_unique<ShaderDeclaration>(nameToken.value, shaderType);
+    setLocation(*shader, nameToken);
     
     consume(TokenType::LEFT_BRACE, "Expected '{' to begin shader body");
     
     while (!check(TokenType::RIGHT_BRACE) && !isAtEnd()) {
+        std::vector<Attribute> attributes = parseAttributes();
+        
         // Parse declarations within the shader body
         if (check(TokenType::IN) || check(TokenType::OUT) || check(TokenType::UNIFORM) || check(TokenType::CONST)) {
             // Variable declaration with qualifier
@@ -171,6 +191,7 @@ StatementPtr Parser::parseShaderDeclaration() {
             Token varName = consume(TokenType::IDENTIFIER, "Expected variable name");
             
             auto varDecl = std::make_unique<VariableDeclaration>(qualifier, std::move(type), varName.value);
+            setLocation(*varDecl, varName);
             
             if (match(TokenType::ASSIGN)) {
                 varDecl->initializer = parseExpression();
@@ -192,6 +213,7 @@ StatementPtr Parser::parseShaderDeclaration() {
             if (check(TokenType::LEFT_PAREN)) {
                 // Function declaration
                 auto func = std::make_unique<FunctionDeclaration>(name.value, std::move(returnType));
+                setLocation(*func, name);
                 
                 consume(TokenType::LEFT_PAREN, "Expected '('");
                 
@@ -204,6 +226,7 @@ StatementPtr Parser::parseShaderDeclaration() {
                         
                         auto param = std::make_unique<VariableDeclaration>(
                             paramQualifier, std::move(paramType), paramName.value);
+                        setLocation(*param, paramName);
                         func->parameters.push_back(std::move(param));
                     } while (match(TokenType::COMMA));
                 }
@@ -228,6 +251,7 @@ StatementPtr Parser::parseShaderDeclaration() {
                 // Variable declaration without qualifier
                 auto varDecl = std::make_unique<VariableDeclaration>(
                     VariableDeclaration::Qualifier::NONE, std::move(returnType), name.value);
+                setLocation(*varDecl, name);
                 
                 if (match(TokenType::ASSIGN)) {
                     varDecl->initializer = parseExpression();
@@ -241,11 +265,13 @@ StatementPtr Parser::parseShaderDeclaration() {
                                     std::to_string(currentToken().line) + ", column " + 
                                     std::to_string(currentToken().column));
         }
+        
+        shader->body.back()->attributes = std::move(attributes);
     }
     
     consume(TokenType::RIGHT_BRACE, "Expected '}' to end shader body");
     
-    return std::move(shader);
+    return shader;
 }
 
 StatementPtr Parser::parseFunctionDeclaration() {
@@ -260,16 +286,26 @@ StatementPtr Parser::parseVariableDeclaration() {
     
     auto varDecl = std::make_unique<VariableDeclaration>(
         qualifier, std::move(type), nameToken.value);
+    setLocation(*varDecl, nameToken);
     
     if (match(TokenType::ASSIGN)) {
         varDecl->initializer = parseExpression();
     }
     
     consume(TokenType::SEMICOLON, "Expected ';' after variable declaration");
-    return std::move(varDecl);
+    return varDecl;
 }
 
 StatementPtr Parser::parseStatement() {
+    if (check(TokenType::LEFT_BRACKET)) {
+        std::vector<Attribute> attributes = parseAttributes();
+        StatementPtr stmt = parseStatement();
+        if (stmt) {
+            stmt->attributes.insert(stmt->attributes.begin(), attributes.begin(), attributes.end());
+        }
+        return stmt;
+    }
+    
     if (match(TokenType::LEFT_BRACE)) {
         return parseBlockStatement();
     }
@@ -327,24 +363,32 @@ StatementPtr Parser::parseStatement() {
             consume(TokenType::SEMICOLON, "Expected ';' after assignment");
             
             auto leftExpr = std::make_unique<IdentifierExpression>(identName);
-            return std::make_unique<AssignmentStatement>(std::move(leftExpr), std::move(value));
+            setLocation(*leftExpr, identToken);
+            auto assignment = std::make_unique<AssignmentStatement>(std::move(leftExpr), std::move(value));
+            setLocation(*assignment, identToken);
+            return assignment;
         } else {
             // This is an expression statement
             current_ = savePos; // Restore position
             ExpressionPtr expr = parseExpression();
             consume(TokenType::SEMICOLON, "Expected ';' after expression");
-            return std::make_unique<ExpressionStatement>(std::move(expr));
+            auto exprStmt = std::make_unique<ExpressionStatement>(std::move(expr));
+            copyLocation(*exprStmt, *exprStmt->expression);
+            return exprStmt;
         }
     }
     
     // All other statements are expression statements
     ExpressionPtr expr = parseExpression();
     consume(TokenType::SEMICOLON, "Expected ';' after expression");
-    return std::make_unique<ExpressionStatement>(std::move(expr));
+    auto exprStmt = std::make_unique<ExpressionStatement>(std::move(expr));
+    copyLocation(*exprStmt, *exprStmt->expression);
+    return exprStmt;
 }
 
 StatementPtr Parser::parseBlockStatement() {
     auto block = std::make_unique<BlockStatement>();
+    setLocation(*block, tokens_[current_ - 1]);
     
     while (!check(TokenType::RIGHT_BRACE) && !isAtEnd()) {
         auto stmt = parseStatement();
@@ -354,7 +398,7 @@ StatementPtr Parser::parseBlockStatement() {
     }
     
     consume(TokenType::RIGHT_BRACE, "Expected '}'");
-    return std::move(block);
+    return block;
 }
 
 StatementPtr Parser::parseExpressionStatement() {
@@ -368,6 +412,7 @@ StatementPtr Parser::parseAssignmentStatement() {
 }
 
 StatementPtr Parser::parseIfStatement() {
+    Token ifToken = tokens_[current_ - 1];
     consume(TokenType::LEFT_PAREN, "Expected '(' after 'if'");
     ExpressionPtr condition = parseExpression();
     consume(TokenType::RIGHT_PAREN, "Expected ')' after if condition");
@@ -379,11 +424,14 @@ StatementPtr Parser::parseIfStatement() {
         elseStmt = parseStatement();
     }
     
-    return std::make_unique<IfStatement>(
+    auto ifStmt = std::make_unique<IfStatement>(
         std::move(condition), std::move(thenStmt), std::move(elseStmt));
+    setLocation(*ifStmt, ifToken);
+    return ifStmt;
 }
 
 StatementPtr Parser::parseForStatement() {
+    Token forToken = tokens_[current_ - 1];
     consume(TokenType::LEFT_PAREN, "Expected '(' after 'for'");
     
     // Initialization - can be variable declaration or assignment/expression
@@ -400,6 +448,7 @@ StatementPtr Parser::parseForStatement() {
             
             auto varDecl = std::make_unique<VariableDeclaration>(
                 VariableDeclaration::Qualifier::NONE, std::move(type), nameToken.value);
+            setLocation(*varDecl, nameToken);
             
             if (match(TokenType::ASSIGN)) {
                 varDecl->initializer = parseExpression();
@@ -427,26 +476,33 @@ StatementPtr Parser::parseForStatement() {
     if (!check(TokenType::RIGHT_PAREN)) {
         ExpressionPtr updateExpr = parseExpression();
         update = std::make_unique<ExpressionStatement>(std::move(updateExpr));
+        copyLocation(*update, *static_cast<ExpressionStatement&>(*update).expression);
     }
     consume(TokenType::RIGHT_PAREN, "Expected ')' after for clauses");
     
     StatementPtr body = parseStatement();
     
-    return std::make_unique<ForStatement>(
+    auto forStmt = std::make_unique<ForStatement>(
         std::move(init), std::move(condition), std::move(update), std::move(body));
+    setLocation(*forStmt, forToken);
+    return forStmt;
 }
 
 StatementPtr Parser::parseWhileStatement() {
+    Token whileToken = tokens_[current_ - 1];
     consume(TokenType::LEFT_PAREN, "Expected '(' after 'while'");
     ExpressionPtr condition = parseExpression();
     consume(TokenType::RIGHT_PAREN, "Expected ')' after while condition");
     
     StatementPtr body = parseStatement();
     
-    return std::make_unique<WhileStatement>(std::move(condition), std::move(body));
+    auto whileStmt = std::make_unique<WhileStatement>(std::move(condition), std::move(body));
+    setLocation(*whileStmt, whileToken);
+    return whileStmt;
 }
 
 StatementPtr Parser::parseReturnStatement() {
+    Token returnToken = tokens_[current_ - 1];
     ExpressionPtr value = nullptr;
     
     if (!check(TokenType::SEMICOLON)) {
@@ -454,11 +510,29 @@ StatementPtr Parser::parseReturnStatement() {
     }
     
     consume(TokenType::SEMICOLON, "Expected ';' after return statement");
-    return std::make_unique<ReturnStatement>(std::move(value));
+    auto returnStmt = std::make_unique<ReturnStatement>(std::move(value));
+    setLocation(*returnStmt, returnToken);
+    return returnStmt;
 }
 
 ExpressionPtr Parser::parseExpression() {
-    return parseLogicalOr();
+    return parseAssignment();
+}
+
+ExpressionPtr Parser::parseAssignment() {
+    ExpressionPtr expr = parseLogicalOr();
+    
+    // Assignment is right-associative and only valid as a complete expression,
+    // e.g. the update clause of a for loop: for (...; ...; i = i + 1)
+    if (match(TokenType::ASSIGN)) {
+        ExpressionPtr value = parseAssignment();
+        auto assignment = std::make_unique<BinaryExpression>(
+            std::move(expr), BinaryExpression::Operator::ASSIGN, std::move(value));
+        copyLocation(*assignment, *assignment->left);
+        return assignment;
+    }
+    
+    return expr;
 }
 
 ExpressionPtr Parser::parseLogicalOr() {
@@ -467,7 +541,9 @@ ExpressionPtr Parser::parseLogicalOr() {
     while (match(TokenType::LOGICAL_OR)) {
         BinaryExpression::Operator op = BinaryExpression::Operator::LOGICAL_OR;
         ExpressionPtr right = parseLogicalAnd();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        auto binary = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        copyLocation(*binary, *binary->left);
+        expr = std::move(binary);
     }
     
     return expr;
@@ -479,7 +555,9 @@ ExpressionPtr Parser::parseLogicalAnd() {
     while (match(TokenType::LOGICAL_AND)) {
         BinaryExpression::Operator op = BinaryExpression::Operator::LOGICAL_AND;
         ExpressionPtr right = parseEquality();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        auto binary = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        copyLocation(*binary, *binary->left);
+        expr = std::move(binary);
     }
     
     return expr;
@@ -492,7 +570,9 @@ ExpressionPtr Parser::parseEquality() {
         BinaryExpression::Operator op = (tokens_[current_ - 1].type == TokenType::EQUAL) ?
             BinaryExpression::Operator::EQUAL : BinaryExpression::Operator::NOT_EQUAL;
         ExpressionPtr right = parseComparison();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        auto binary = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        copyLocation(*binary, *binary->left);
+        expr = std::move(binary);
     }
     
     return expr;
@@ -516,7 +596,9 @@ ExpressionPtr Parser::parseComparison() {
         }
         
         ExpressionPtr right = parseAddition();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        auto binary = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        copyLocation(*binary, *binary->left);
+        expr = std::move(binary);
     }
     
     return expr;
@@ -529,7 +611,9 @@ ExpressionPtr Parser::parseAddition() {
         BinaryExpression::Operator op = (tokens_[current_ - 1].type == TokenType::PLUS) ?
             BinaryExpression::Operator::ADD : BinaryExpression::Operator::SUBTRACT;
         ExpressionPtr right = parseMultiplication();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        auto binary = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        copyLocation(*binary, *binary->left);
+        expr = std::move(binary);
     }
     
     return expr;
@@ -550,7 +634,9 @@ ExpressionPtr Parser::parseMultiplication() {
         }
         
         ExpressionPtr right = parseUnary();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        auto binary = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+        copyLocation(*binary, *binary->left);
+        expr = std::move(binary);
     }
     
     return expr;
@@ -560,8 +646,11 @@ ExpressionPtr Parser::parseUnary() {
     if (match(TokenType::LOGICAL_NOT) || match(TokenType::MINUS)) {
         UnaryExpression::Operator op = (tokens_[current_ - 1].type == TokenType::LOGICAL_NOT) ?
             UnaryExpression::Operator::LOGICAL_NOT : UnaryExpression::Operator::MINUS;
+        Token opToken = tokens_[current_ - 1];
         ExpressionPtr operand = parseUnary();
-        return std::make_unique<UnaryExpression>(op, std::move(operand));
+        auto unary = std::make_unique<UnaryExpression>(op, std::move(operand));
+        setLocation(*unary, opToken);
+        return unary;
     }
     
     return parsePostfix();
@@ -606,15 +695,22 @@ ExpressionPtr Parser::parsePrimary() {
 }
 
 ExpressionPtr Parser::parsePostfix() {
+    Token startToken = currentToken();
     ExpressionPtr expr = parsePrimary();
+    if (expr->line == 0) {
+        setLocation(*expr, startToken);
+    }
     
     while (true) {
         if (match(TokenType::DOT)) {
             Token member = consume(TokenType::IDENTIFIER, "Expected property name after '.'");
-            expr = std::make_unique<MemberAccessExpression>(std::move(expr), member.value);
+            auto memberAccess = std::make_unique<MemberAccessExpression>(std::move(expr), member.value);
+            copyLocation(*memberAccess, *memberAccess->object);
+            expr = std::move(memberAccess);
         } else if (match(TokenType::LEFT_PAREN)) {
             // Function call
             auto funcCall = std::make_unique<FunctionCallExpression>("");
+            copyLocation(*funcCall, *expr);
             // Set the function name from the identifier expression
             if (auto identExpr = dynamic_cast<IdentifierExpression*>(expr.get())) {
                 funcCall->functionName = identExpr->name;
@@ -630,10 +726,17 @@ ExpressionPtr Parser::parsePostfix() {
             consume(TokenType::RIGHT_PAREN, "Expected ')' after function arguments");
             expr = std::move(funcCall);
         } else if (match(TokenType::LEFT_BRACKET)) {
-            // Array access
+            // Indexing by an integer literal is kept as a member named "[n]";
+            // any other index becomes "[]", which the analyzer rejects
             ExpressionPtr index = parseExpression();
             consume(TokenType::RIGHT_BRACKET, "Expected ']' after array index");
-            expr = std::make_unique<MemberAccessExpression>(std::move(expr), "[" + std::to_string(0) + "]");
+            auto literal = dynamic_cast<LiteralExpression*>(index.get());
+            std::string member = literal && literal->literalType == LiteralExpression::LiteralType::INT
+                                     ? "[" + literal->value + "]"
+                                     : "[]";
+            auto indexAccess = std::make_unique<MemberAccessExpression>(std::move(expr), member);
+            copyLocation(*indexAccess, *indexAccess->object);
+            expr = std::move(indexAccess);
         } else {
             break;
         }
@@ -679,6 +782,44 @@ TypePtr Parser::parseType() {
     throw std::runtime_error("Expected type");
 }
 
+// Zero or more `[[name, name(arg, ...)]]` groups
+std::vector<Attribute> Parser::parseAttributes() {
+    std::vector<Attribute> attributes;
+    while (check(TokenType::LEFT_BRACKET) && peekToken().type == TokenType::LEFT_BRACKET) {
+        advance();
+        advance();
+        
+        do {
+            Token nameToken = consume(TokenType::IDENTIFIER, "Expected attribute name");
+            Attribute attribute;
+            attribute.name = nameToken.value;
+            attribute.line = nameToken.line;
+            attribute.column = nameToken.column;
+            
+            if (match(TokenType::LEFT_PAREN)) {
+                if (!check(TokenType::RIGHT_PAREN)) {
+                    do {
+                        std::string sign = match(TokenType::MINUS) ? "-" : "";
+                        if (!check(TokenType::INTEGER_LITERAL) && !check(TokenType::FLOAT_LITERAL) &&
+                            !check(TokenType::IDENTIFIER)) {
+                            throw std::runtime_error("Expected attribute argument");
+                        }
+                        attribute.arguments.push_back(sign + currentToken().value);
+                        advance();
+                    } while (match(TokenType::COMMA));
+                }
+                consume(TokenType::RIGHT_PAREN, "Expected ')' after attribute arguments");
+            }
+            
+            attributes.push_back(std::move(attribute));
+        } while (match(TokenType::COMMA));
+        
+        consume(TokenType::RIGHT_BRACKET, "Expected ']]' after attribute");
+        consume(TokenType::RIGHT_BRACKET, "Expected ']]' after attribute");
+    }
+    return attributes;
+}
+
 VariableDeclaration::Qualifier Parser::parseQualifier() {
     if (check(TokenType::IN)) {
         advance();
@@ -708,6 +849,11 @@ ShaderDeclaration::ShaderType Parser::parseShaderType() {
     throw std::runtime_error("Expected shader type (vertex, fragment, or compute)");
 }
 
+void Parser::setLocation(ASTNode& node, const Token& token) {
+    node.line = token.line;
+    node.column = token.column;
+}
+
 void Parser::synchronize() {
     advance();
     
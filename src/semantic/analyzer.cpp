@@ -1,11 +1,1283 @@
 #include "semantic/analyzer.h"
+#include "semantic/builtins.h"
+#include "semantic/symbol_table.h"
+#include "semantic/types.h"
 #include "parser/ast.h"
+#include "parser/ast_hash.h"
+#include "parser/ast_walker.h"
+#include "utils/parallel.h"
+#include <algorithm>
+#include <unordered_set>
 
 namespace sdl {
 
-bool SemanticAnalyzer::analyze(Program& program) {
-    // Stub implementation
+namespace {
+
+// Where an attribute may be written
+enum class AttributeTarget {
+    VARIABLE,
+    FUNCTION,
+    BRANCH,
+    LOOP
+};
+
+struct AttributeSignature {
+    const char* name;
+    AttributeTarget target;
+    size_t arguments;
+};
+
+const AttributeSignature* findAttributeSignature(const std::string& name) {
+    static const AttributeSignature attributes[] = {
+        {"range", AttributeTarget::VARIABLE, 2},
+        {"inline", AttributeTarget::FUNCTION, 0},
+        {"noinline", AttributeTarget::FUNCTION, 0},
+        {"fast", AttributeTarget::FUNCTION, 0},
+        {"branch", AttributeTarget::BRANCH, 0},
+        {"flatten", AttributeTarget::BRANCH, 0},
+    };
+    
+    for (const auto& attribute : attributes) {
+        if (name == attribute.name) {
+            return &attribute;
+        }
+    }
+    return nullptr;
+}
+
+bool appliesTo(AttributeTarget target, const Statement& node) {
+    switch (target) {
+        case AttributeTarget::VARIABLE: return dynamic_cast<const VariableDeclaration*>(&node) != nullptr;
+        case AttributeTarget::FUNCTION: return dynamic_cast<const FunctionDeclaration*>(&node) != nullptr;
+        case AttributeTarget::BRANCH: return dynamic_cast<const IfStatement*>(&node) != nullptr;
+        case AttributeTarget::LOOP:
+            return dynamic_cast<const ForStatement*>(&node) || dynamic_cast<const WhileStatement*>(&node);
+    }
+    return false;
+}
+
+const char* attributeTargetName(AttributeTarget target) {
+    switch (target) {
+        case AttributeTarget::VARIABLE: return "variable declarations";
+        case AttributeTarget::FUNCTION: return "functions";
+        case AttributeTarget::BRANCH: return "if statements";
+        case AttributeTarget::LOOP: return "loops";
+    }
+    return "";
+}
+
+bool parseNumber(const std::string& text, double& value) {
+    try {
+        size_t used = 0;
+        value = std::stod(text, &used);
+        return used == text.size();
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+std::string operatorSpelling(BinaryExpression::Operator op) {
+    switch (op) {
+        case BinaryExpression::Operator::ASSIGN: return "=";
+        case BinaryExpression::Operator::ADD: return "+";
+        case BinaryExpression::Operator::SUBTRACT: return "-";
+        case BinaryExpression::Operator::MULTIPLY: return "*";
+        case BinaryExpression::Operator::DIVIDE: return "/";
+        case BinaryExpression::Operator::MODULO: return "%";
+        case BinaryExpression::Operator::EQUAL: return "==";
+        case BinaryExpression::Operator::NOT_EQUAL: return "!=";
+        case BinaryExpression::Operator::LESS_THAN: return "<";
+        case BinaryExpression::Operator::LESS_EQUAL: return "<=";
+        case BinaryExpression::Operator::GREATER_THAN: return ">";
+        case BinaryExpression::Operator::GREATER_EQUAL: return ">=";
+        case BinaryExpression::Operator::LOGICAL_AND: return "&&";
+        case BinaryExpression::Operator::LOGICAL_OR: return "||";
+        default: return "?";
+    }
+}
+
+// int converts implicitly to float, as in GLSL 1.20+
+bool isAssignable(Type::Kind target, Type::Kind value) {
+    return target == value || (target == Type::Kind::FLOAT && value == Type::Kind::INT);
+}
+
+Symbol makeVariableSymbol(Type::Kind type, VariableDeclaration::Qualifier qualifier,
+                          const VariableDeclaration* declaration = nullptr) {
+    Symbol symbol;
+    symbol.kind = declaration ? Symbol::Kind::VARIABLE : Symbol::Kind::BUILTIN_VARIABLE;
+    symbol.type = type;
+    symbol.qualifier = qualifier;
+    symbol.variable = declaration;
+    return symbol;
+}
+
+void declareBuiltinVariables(SymbolTable& symbols) {
+    symbols.define("true", makeVariableSymbol(Type::Kind::BOOL, VariableDeclaration::Qualifier::CONST));
+    symbols.define("false", makeVariableSymbol(Type::Kind::BOOL, VariableDeclaration::Qualifier::CONST));
+}
+
+// Stage inputs are read-only (IN), stage outputs are writable (OUT)
+void declareStageVariables(SymbolTable& symbols, ShaderDeclaration::ShaderType stage) {
+    using Q = VariableDeclaration::Qualifier;
+    switch (stage) {
+        case ShaderDeclaration::ShaderType::VERTEX:
+            symbols.define("gl_Position", makeVariableSymbol(Type::Kind::VEC4, Q::OUT));
+            symbols.define("gl_PointSize", makeVariableSymbol(Type::Kind::FLOAT, Q::OUT));
+            symbols.define("gl_VertexID", makeVariableSymbol(Type::Kind::INT, Q::IN));
+            symbols.define("gl_InstanceID", makeVariableSymbol(Type::Kind::INT, Q::IN));
+            break;
+        case ShaderDeclaration::ShaderType::FRAGMENT:
+            symbols.define("gl_FragCoord", makeVariableSymbol(Type::Kind::VEC4, Q::IN));
+            symbols.define("gl_FrontFacing", makeVariableSymbol(Type::Kind::BOOL, Q::IN));
+            symbols.define("gl_FragDepth", makeVariableSymbol(Type::Kind::FLOAT, Q::OUT));
+            break;
+        case ShaderDeclaration::ShaderType::COMPUTE:
+            // Invocation IDs are unsigned in GLSL; the DSL has no unsigned
+            // vectors, so they are modelled as vec3 for swizzling/conversion
+            symbols.define("gl_GlobalInvocationID", makeVariableSymbol(Type::Kind::VEC3, Q::IN));
+            symbols.define("gl_LocalInvocationID", makeVariableSymbol(Type::Kind::VEC3, Q::IN));
+            symbols.define("gl_WorkGroupID", makeVariableSymbol(Type::Kind::VEC3, Q::IN));
+            // Thread indices declared by the CUDA kernel prologue
+            symbols.define("idx", makeVariableSymbol(Type::Kind::INT, Q::IN));
+            symbols.define("idy", makeVariableSymbol(Type::Kind::INT, Q::IN));
+            break;
+    }
+}
+
+// Dependency-graph key and structural hash of a declaration in the current program
+struct DeclarationInfo {
+    std::string key;
+    uint64_t hash = 0;
+};
+
+using DeclarationIndex = std::unordered_map<const ASTNode*, DeclarationInfo>;
+
+class ExpressionCollector : public ASTWalker {
+public:
+    std::vector<Expression*> expressions;
+    
+    void visit(IdentifierExpression& node) override { add(node); }
+    void visit(LiteralExpression& node) override { add(node); }
+    void visit(BinaryExpression& node) override { add(node); ASTWalker::visit(node); }
+    void visit(UnaryExpression& node) override { add(node); ASTWalker::visit(node); }
+    void visit(FunctionCallExpression& node) override { add(node); ASTWalker::visit(node); }
+    void visit(MemberAccessExpression& node) override { add(node); ASTWalker::visit(node); }
+    
+private:
+    void add(Expression& expr) { expressions.push_back(&expr); }
+};
+
+std::vector<Expression*> collectExpressions(ASTNode& node) {
+    ExpressionCollector collector;
+    node.accept(collector);
+    return std::move(collector.expressions);
+}
+
+// Points every call at the builtin its name refers to. Runs over the whole
+// program, since declarations reused from the last analysis are not re-checked
+class BuiltinResolver : public ASTWalker {
+public:
+    void visit(FunctionCallExpression& node) override {
+        node.builtin = findBuiltinId(node.functionName);
+        ASTWalker::visit(node);
+    }
+};
+
+class TypeChecker : public ASTVisitor {
+public:
+    // `previous` holds the results of the last analysis (may be null); one
+    // DeclarationRecord per checked or reused declaration is appended to `records`
+    TypeChecker(SymbolTable& symbols, std::vector<Diagnostic>& diagnostics,
+                std::vector<DeclarationRecord>& records, const DependencyGraph* previous,
+                const DeclarationIndex* outerIndex = nullptr)
+        : symbols_(symbols), diagnostics_(diagnostics), records_(records),
+          previous_(previous), outerIndex_(outerIndex) {}
+    
+    // Declarations are entered in a first pass so that overloads and names
+    // resolve against the whole scope, then checked in a second pass. The
+    // printers emit them in source order without prototypes, so a use of
+    // one that appears later (including a recursive call) is still an error
+    void declareAll(const std::vector<StatementPtr>& declarations);
+    void checkAll(const std::vector<StatementPtr>& declarations);
+    
+    const DeclarationIndex& index() const { return index_; }
+    size_t reusedCount() const { return reusedCount_; }
+    size_t checkedCount() const { return checkedCount_; }
+    
+    void visit(Type&) override {}
+    void visit(IdentifierExpression& node) override;
+    void visit(LiteralExpression& node) override;
+    void visit(BinaryExpression& node) override;
+    void visit(UnaryExpression& node) override;
+    void visit(FunctionCallExpression& node) override;
+    void visit(MemberAccessExpression& node) override;
+    void visit(ExpressionStatement& node) override;
+    void visit(AssignmentStatement& node) override;
+    void visit(VariableDeclaration& node) override;
+    void visit(FunctionDeclaration& node) override;
+    void visit(ShaderDeclaration& node) override;
+    void visit(BlockStatement& node) override;
+    void visit(IfStatement& node) override;
+    void visit(ForStatement& node) override;
+    void visit(WhileStatement& node) override;
+    void visit(ReturnStatement& node) override;
+    void visit(Program&) override {}
+    
+private:
+    SymbolTable& symbols_;
+    std::vector<Diagnostic>& diagnostics_;
+    const FunctionDeclaration* currentFunction_ = nullptr;
+    
+    // Incremental analysis state
+    std::vector<DeclarationRecord>& records_;
+    const DependencyGraph* previous_;
+    const DeclarationIndex* outerIndex_;
+    DeclarationIndex index_;
+    std::unordered_map<std::string, int> keyCounts_;
+    std::string scopeName_;
+    const ASTNode* currentDeclaration_ = nullptr;
+    size_t declarationDepth_ = 0;
+    std::vector<std::string> referencedNames_;
+    size_t reusedCount_ = 0;
+    size_t checkedCount_ = 0;
+    
+    void indexDeclaration(Statement& decl);
+    const DeclarationInfo* findInfo(const ASTNode* decl) const;
+    void recordReference(const std::string& name, const Symbol* symbol);
+    Dependency resolve(const std::string& name) const;
+    bool declaredLater(const ASTNode* decl) const;
+    bool tryReuse(ASTNode& decl, const DeclarationInfo& info);
+    void checkDeclaration(ASTNode& decl, const DeclarationInfo& info);
+    
+    void error(const ASTNode& node, const std::string& message);
+    void checkAttributes(const Statement& node);
+    void setType(Expression& expr, Type::Kind kind);
+    // Checks expr and reports its type; false if it could not be typed
+    // (an error has already been reported in that case)
+    bool check(Expression* expr, Type::Kind& kind);
+    void checkCondition(Expression* condition, const char* construct);
+    void checkLValue(Expression& target);
+    bool isParameter(const VariableDeclaration* variable) const;
+    void declareVariable(VariableDeclaration& node);
+    void declareFunction(FunctionDeclaration& node);
+    void checkInitializer(VariableDeclaration& node);
+    bool checkConstructor(FunctionCallExpression& node, Type::Kind target,
+                          const std::vector<Type::Kind>& args);
+    bool checkBuiltin(FunctionCallExpression& node, const BuiltinInfo& builtin,
+                      const std::vector<Type::Kind>& args);
+    bool binaryResultType(BinaryExpression::Operator op, Type::Kind left, Type::Kind right,
+                          Type::Kind& result);
+};
+
+void TypeChecker::error(const ASTNode& node, const std::string& message) {
+    diagnostics_.emplace_back(Diagnostic::Severity::ERROR, message, node.line, node.column);
+}
+
+void TypeChecker::checkAttributes(const Statement& node) {
+    for (const Attribute& attribute : node.attributes) {
+        const AttributeSignature* signature = findAttributeSignature(attribute.name);
+        if (!signature) {
+            diagnostics_.emplace_back(Diagnostic::Severity::WARNING,
+                                      "Unknown attribute '" + attribute.name + "' ignored",
+                                      attribute.line, attribute.column);
+            continue;
+        }
+        if (!appliesTo(signature->target, node)) {
+            diagnostics_.emplace_back(Diagnostic::Severity::ERROR,
+                                      "Attribute '" + attribute.name + "' only applies to " +
+                                      attributeTargetName(signature->target),
+                                      attribute.line, attribute.column);
+            continue;
+        }
+        if (attribute.arguments.size() != signature->arguments) {
+            diagnostics_.emplace_back(Diagnostic::Severity::ERROR,
+                                      "Attribute '" + attribute.name + "' takes " +
+                                      std::to_string(signature->arguments) + " argument(s)",
+                                      attribute.line, attribute.column);
+            continue;
+        }
+        
+        if (attribute.name == "noinline" && node.findAttribute("inline")) {
+            diagnostics_.emplace_back(Diagnostic::Severity::ERROR,
+                                      "Attributes 'inline' and 'noinline' contradict each other",
+                                      attribute.line, attribute.column);
+        }
+        if (attribute.name == "flatten" && node.findAttribute("branch")) {
+            diagnostics_.emplace_back(Diagnostic::Severity::ERROR,
+                                      "Attributes 'branch' and 'flatten' contradict each other",
+                                      attribute.line, attribute.column);
+        }
+        
+        if (attribute.name == "range") {
+            auto& var = static_cast<const VariableDeclaration&>(node);
+            Type::Kind type = var.type ? var.type->kind : Type::Kind::VOID;
+            double low = 0.0, high = 0.0;
+            if (var.qualifier != VariableDeclaration::Qualifier::UNIFORM &&
+                var.qualifier != VariableDeclaration::Qualifier::IN) {
+                diagnostics_.emplace_back(Diagnostic::Severity::ERROR,
+                                          "Attribute 'range' only applies to uniform and in variables",
+                                          attribute.line, attribute.column);
+            } else if ((!isNumeric(type) || isMatrix(type)) && !isSampler(type)) {
+                diagnostics_.emplace_back(Diagnostic::Severity::ERROR,
+                                          "Attribute 'range' needs a scalar, vector or sampler variable, '" +
+                                          var.name + "' is " + typeName(type),
+                                          attribute.line, attribute.column);
+            } else if (!parseNumber(attribute.arguments[0], low) || !parseNumber(attribute.arguments[1], high) ||
+                       low > high) {
+                diagnostics_.emplace_back(Diagnostic::Severity::ERROR,
+                                          "Attribute 'range' needs two numbers with min <= max",
+                                          attribute.line, attribute.column);
+            }
+        }
+    }
+}
+
+void TypeChecker::setType(Expression& expr, Type::Kind kind) {
+    expr.resultType = std::make_unique<Type>(kind);
+}
+
+bool TypeChecker::check(Expression* expr, Type::Kind& kind) {
+    if (!expr) {
+        return false;
+    }
+    expr->accept(*this);
+    if (!expr->resultType) {
+        return false;
+    }
+    kind = expr->resultType->kind;
+    return true;
+}
+
+void TypeChecker::checkCondition(Expression* condition, const char* construct) {
+    Type::Kind kind;
+    if (check(condition, kind) && kind != Type::Kind::BOOL) {
+        error(*condition, std::string("Condition of '") + construct + "' must be bool, got " + typeName(kind));
+    }
+}
+
+void TypeChecker::checkLValue(Expression& target) {
+    if (auto member = dynamic_cast<MemberAccessExpression*>(&target)) {
+        if (member->object) {
+            checkLValue(*member->object);
+        }
+        return;
+    }
+    
+    auto ident = dynamic_cast<IdentifierExpression*>(&target);
+    if (!ident) {
+        error(target, "Left side of assignment is not assignable");
+        return;
+    }
+    
+    const Symbol* symbol = symbols_.lookup(ident->name);
+    if (!symbol || symbol->kind == Symbol::Kind::FUNCTION) {
+        return; // Already reported while checking the target
+    }
+    
+    switch (symbol->qualifier) {
+        case VariableDeclaration::Qualifier::UNIFORM:
+            error(target, "Cannot assign to uniform '" + ident->name + "'");
+            break;
+        case VariableDeclaration::Qualifier::CONST:
+            error(target, "Cannot assign to constant '" + ident->name + "'");
+            break;
+        case VariableDeclaration::Qualifier::IN:
+            // 'in' parameters are copies and may be modified freely
+            if (!isParameter(symbol->variable)) {
+                error(target, "Cannot assign to input '" + ident->name + "'");
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+bool TypeChecker::isParameter(const VariableDeclaration* variable) const {
+    if (!currentFunction_ || !variable) {
+        return false;
+    }
+    for (auto& param : currentFunction_->parameters) {
+        if (param.get() == variable) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TypeChecker::declareAll(const std::vector<StatementPtr>& declarations) {
+    for (auto& decl : declarations) {
+        if (auto var = dynamic_cast<VariableDeclaration*>(decl.get())) {
+            declareVariable(*var);
+        } else if (auto func = dynamic_cast<FunctionDeclaration*>(decl.get())) {
+            declareFunction(*func);
+        } else {
+            continue;
+        }
+        indexDeclaration(*decl);
+    }
+}
+
+void TypeChecker::checkAll(const std::vector<StatementPtr>& declarations) {
+    declarationDepth_ = symbols_.depth();
+    
+    for (auto& decl : declarations) {
+        if (!decl || dynamic_cast<ShaderDeclaration*>(decl.get())) {
+            continue;
+        }
+        
+        auto info = index_.find(decl.get());
+        if (info == index_.end()) {
+            error(*decl, "Expected a declaration at this scope");
+            continue;
+        }
+        
+        currentDeclaration_ = decl.get();
+        if (!tryReuse(*decl, info->second)) {
+            checkDeclaration(*decl, info->second);
+        }
+    }
+    currentDeclaration_ = nullptr;
+}
+
+void TypeChecker::indexDeclaration(Statement& decl) {
+    std::string key = scopeName_ + "::";
+    if (auto var = dynamic_cast<VariableDeclaration*>(&decl)) {
+        key += var->name;
+    } else if (auto func = dynamic_cast<FunctionDeclaration*>(&decl)) {
+        key += func->name + "(";
+        for (size_t i = 0; i < func->parameters.size(); ++i) {
+            if (i > 0) key += ",";
+            key += func->parameters[i]->type ? typeName(func->parameters[i]->type->kind) : "?";
+        }
+        key += ")";
+    }
+    
+    // Redefinitions are errors, but still need distinct keys
+    int occurrence = keyCounts_[key]++;
+    if (occurrence > 0) {
+        key += "#" + std::to_string(occurrence);
+    }
+    
+    index_[&decl] = DeclarationInfo{key, structuralHash(decl)};
+}
+
+const DeclarationInfo* TypeChecker::findInfo(const ASTNode* decl) const {
+    auto it = index_.find(decl);
+    if (it != index_.end()) {
+        return &it->second;
+    }
+    if (outerIndex_) {
+        auto outer = outerIndex_->find(decl);
+        if (outer != outerIndex_->end()) {
+            return &outer->second;
+        }
+    }
+    return nullptr;
+}
+
+void TypeChecker::recordReference(const std::string& name, const Symbol* symbol) {
+    // Locals belong to the declaration being checked and are covered by its own hash
+    if (!symbol || symbol->depth <= declarationDepth_) {
+        referencedNames_.push_back(name);
+    }
+}
+
+// Whether `decl` is a program- or shader-level declaration that the one being
+// checked cannot use: itself, or one after it in the source
+bool TypeChecker::declaredLater(const ASTNode* decl) const {
+    if (!currentDeclaration_ || !decl || !findInfo(decl)) {
+        return false;
+    }
+    const ASTNode& current = *currentDeclaration_;
+    return decl == &current || decl->line > current.line ||
+           (decl->line == current.line && decl->column > current.column);
+}
+
+Dependency TypeChecker::resolve(const std::string& name) const {
+    Dependency dependency;
+    dependency.name = name;
+    
+    const Symbol* symbol = symbols_.lookup(name);
+    if (!symbol) {
+        return dependency;
+    }
+    
+    switch (symbol->kind) {
+        case Symbol::Kind::BUILTIN_VARIABLE:
+            dependency.key = "<builtin>::" + name;
+            dependency.hash = static_cast<uint64_t>(symbol->type) + 1;
+            break;
+        case Symbol::Kind::VARIABLE:
+            if (const DeclarationInfo* info = findInfo(symbol->variable)) {
+                dependency.key = info->key;
+                dependency.hash = info->hash + (declaredLater(symbol->variable) ? 1 : 0);
+            }
+            break;
+        case Symbol::Kind::FUNCTION:
+            // A call resolves against the whole overload set
+            for (const FunctionDeclaration* overload : symbol->overloads) {
+                if (const DeclarationInfo* info = findInfo(overload)) {
+                    if (dependency.key.empty()) {
+                        dependency.key = info->key;
+                    }
+                    dependency.hash = dependency.hash * 31 + info->hash + (declaredLater(overload) ? 1 : 0);
+                }
+            }
+            break;
+    }
+    return dependency;
+}
+
+bool TypeChecker::tryReuse(ASTNode& decl, const DeclarationInfo& info) {
+    if (!previous_) {
+        return false;
+    }
+    
+    const DeclarationRecord* record = previous_->find(info.key);
+    if (!record || record->hash != info.hash) {
+        return false;
+    }
+    
+    // Re-resolve every name the declaration used: a changed, removed or
+    // newly shadowing declaration makes the cached result stale
+    for (const Dependency& dependency : record->dependencies) {
+        Dependency current = resolve(dependency.name);
+        if (current.key != dependency.key || current.hash != dependency.hash) {
+            return false;
+        }
+    }
+    
+    std::vector<Expression*> expressions = collectExpressions(decl);
+    if (expressions.size() != record->expressionTypes.size()) {
+        return false;
+    }
+    
+    for (size_t i = 0; i < expressions.size(); ++i) {
+        if (record->expressionTypes[i]) {
+            setType(*expressions[i], *record->expressionTypes[i]);
+        }
+    }
+    
+    // The declaration may have moved; diagnostics follow it
+    DeclarationRecord reused = *record;
+    long shift = static_cast<long>(decl.line) - static_cast<long>(record->line);
+    for (Diagnostic& diagnostic : reused.diagnostics) {
+        if (diagnostic.line != 0) {
+            diagnostic.line = static_cast<size_t>(static_cast<long>(diagnostic.line) + shift);
+        }
+        diagnostics_.push_back(diagnostic);
+    }
+    reused.line = decl.line;
+    records_.push_back(std::move(reused));
+    ++reusedCount_;
+    return true;
+}
+
+void TypeChecker::checkDeclaration(ASTNode& decl, const DeclarationInfo& info) {
+    size_t firstDiagnostic = diagnostics_.size();
+    referencedNames_.clear();
+    
+    if (auto var = dynamic_cast<VariableDeclaration*>(&decl)) {
+        checkAttributes(*var);
+        checkInitializer(*var);
+    } else {
+        decl.accept(*this);
+    }
+    
+    DeclarationRecord record;
+    record.key = info.key;
+    record.hash = info.hash;
+    record.line = decl.line;
+    
+    std::sort(referencedNames_.begin(), referencedNames_.end());
+    referencedNames_.erase(std::unique(referencedNames_.begin(), referencedNames_.end()),
+                           referencedNames_.end());
+    for (const std::string& name : referencedNames_) {
+        record.dependencies.push_back(resolve(name));
+    }
+    
+    record.diagnostics.assign(diagnostics_.begin() + firstDiagnostic, diagnostics_.end());
+    for (Expression* expr : collectExpressions(decl)) {
+        if (expr->resultType) {
+            record.expressionTypes.push_back(expr->resultType->kind);
+        } else {
+            record.expressionTypes.push_back(std::nullopt);
+        }
+    }
+    
+    records_.push_back(std::move(record));
+    ++checkedCount_;
+}
+
+void TypeChecker::declareVariable(VariableDeclaration& node) {
+    Type::Kind type = node.type ? node.type->kind : Type::Kind::VOID;
+    if (type == Type::Kind::VOID) {
+        error(node, "Variable '" + node.name + "' cannot have type void");
+    }
+    
+    if (!symbols_.define(node.name, makeVariableSymbol(type, node.qualifier, &node))) {
+        error(node, "Redefinition of '" + node.name + "'");
+    }
+}
+
+void TypeChecker::declareFunction(FunctionDeclaration& node) {
+    Symbol* existing = symbols_.lookupCurrentScope(node.name);
+    if (existing && existing->kind != Symbol::Kind::FUNCTION) {
+        error(node, "Redefinition of '" + node.name + "' as a function");
+        return;
+    }
+    
+    if (existing) {
+        for (const FunctionDeclaration* overload : existing->overloads) {
+            if (overload->parameters.size() != node.parameters.size()) {
+                continue;
+            }
+            bool sameSignature = true;
+            for (size_t i = 0; i < node.parameters.size(); ++i) {
+                if (overload->parameters[i]->type->kind != node.parameters[i]->type->kind) {
+                    sameSignature = false;
+                    break;
+                }
+            }
+            if (sameSignature) {
+                error(node, "Redefinition of function '" + node.name + "'");
+                return;
+            }
+        }
+        existing->overloads.push_back(&node);
+        return;
+    }
+    
+    Symbol symbol;
+    symbol.kind = Symbol::Kind::FUNCTION;
+    symbol.type = node.returnType ? node.returnType->kind : Type::Kind::VOID;
+    symbol.overloads.push_back(&node);
+    symbols_.define(node.name, symbol);
+}
+
+void TypeChecker::checkInitializer(VariableDeclaration& node) {
+    if (!node.initializer) {
+        if (node.qualifier == VariableDeclaration::Qualifier::CONST) {
+            error(node, "Constant '" + node.name + "' must be initialized");
+        }
+        return;
+    }
+    
+    if (node.qualifier == VariableDeclaration::Qualifier::IN ||
+        node.qualifier == VariableDeclaration::Qualifier::OUT ||
+        node.qualifier == VariableDeclaration::Qualifier::UNIFORM) {
+        error(node, "Interface variable '" + node.name + "' cannot have an initializer");
+    }
+    
+    Type::Kind valueType;
+    if (check(node.initializer.get(), valueType) && node.type &&
+        !isAssignable(node.type->kind, valueType)) {
+        error(*node.initializer, "Cannot initialize '" + node.name + "' of type " +
+              typeName(node.type->kind) + " with a value of type " + typeName(valueType));
+    }
+}
+
+void TypeChecker::visit(IdentifierExpression& node) {
+    const Symbol* symbol = symbols_.lookup(node.name);
+    recordReference(node.name, symbol);
+    if (!symbol) {
+        error(node, "Undeclared identifier '" + node.name + "'");
+        return;
+    }
+    if (symbol->kind == Symbol::Kind::FUNCTION) {
+        error(node, "Function '" + node.name + "' used as a value");
+        return;
+    }
+    if (symbol->kind == Symbol::Kind::VARIABLE && declaredLater(symbol->variable)) {
+        error(node, "'" + node.name + "' is used before its declaration");
+        return;
+    }
+    setType(node, symbol->type);
+}
+
+void TypeChecker::visit(LiteralExpression& node) {
+    switch (node.literalType) {
+        case LiteralExpression::LiteralType::INT: setType(node, Type::Kind::INT); break;
+        case LiteralExpression::LiteralType::FLOAT: setType(node, Type::Kind::FLOAT); break;
+        case LiteralExpression::LiteralType::BOOL: setType(node, Type::Kind::BOOL); break;
+        case LiteralExpression::LiteralType::STRING:
+            error(node, "String literals are not allowed in shader code");
+            break;
+    }
+}
+
+bool TypeChecker::binaryResultType(BinaryExpression::Operator op, Type::Kind left,
+                                   Type::Kind right, Type::Kind& result) {
+    using Op = BinaryExpression::Operator;
+    switch (op) {
+        case Op::LOGICAL_AND:
+        case Op::LOGICAL_OR:
+            result = Type::Kind::BOOL;
+            return left == Type::Kind::BOOL && right == Type::Kind::BOOL;
+        
+        case Op::EQUAL:
+        case Op::NOT_EQUAL:
+            result = Type::Kind::BOOL;
+            return isAssignable(left, right) || isAssignable(right, left);
+        
+        case Op::LESS_THAN:
+        case Op::LESS_EQUAL:
+        case Op::GREATER_THAN:
+        case Op::GREATER_EQUAL:
+            result = Type::Kind::BOOL;
+            return (left == Type::Kind::INT || left == Type::Kind::FLOAT) &&
+                   (right == Type::Kind::INT || right == Type::Kind::FLOAT);
+        
+        case Op::ADD:
+        case Op::SUBTRACT:
+        case Op::MULTIPLY:
+        case Op::DIVIDE:
+        case Op::MODULO:
+            break;
+        
+        default:
+            return false;
+    }
+    
+    if (!isNumeric(left) || !isNumeric(right)) {
+        return false;
+    }
+    
+    bool leftScalar = left == Type::Kind::INT || left == Type::Kind::FLOAT;
+    bool rightScalar = right == Type::Kind::INT || right == Type::Kind::FLOAT;
+    
+    if (leftScalar && rightScalar) {
+        result = (left == Type::Kind::FLOAT || right == Type::Kind::FLOAT) ?
+            Type::Kind::FLOAT : Type::Kind::INT;
+        return true;
+    }
+    
+    // Scalars broadcast over vectors and matrices
+    if (leftScalar) {
+        result = right;
+        return true;
+    }
+    if (rightScalar) {
+        result = left;
+        return true;
+    }
+    
+    if (op == Op::MULTIPLY) {
+        int leftDim = matrixDimension(left);
+        int rightDim = matrixDimension(right);
+        if (leftDim && rightDim) {
+            result = left;
+            return leftDim == rightDim;
+        }
+        if (leftDim) {
+            result = right;
+            return componentCount(right) == leftDim;
+        }
+        if (rightDim) {
+            result = left;
+            return componentCount(left) == rightDim;
+        }
+    }
+    
+    // Component-wise on vectors, and +/- on matrices
+    result = left;
+    return left == right && (op != Op::MODULO || isFloatVector(left));
+}
+
+void TypeChecker::visit(BinaryExpression& node) {
+    Type::Kind left = Type::Kind::VOID, right = Type::Kind::VOID;
+    bool leftOk = check(node.left.get(), left);
+    bool rightOk = check(node.right.get(), right);
+    if (!leftOk || !rightOk) {
+        return;
+    }
+    
+    if (node.op == BinaryExpression::Operator::ASSIGN) {
+        checkLValue(*node.left);
+        if (!isAssignable(left, right)) {
+            error(node, "Cannot assign a value of type " + typeName(right) + " to " + typeName(left));
+            return;
+        }
+        setType(node, left);
+        return;
+    }
+    
+    Type::Kind result;
+    if (!binaryResultType(node.op, left, right, result)) {
+        error(node, "Invalid operands to binary '" + operatorSpelling(node.op) + "': " +
+              typeName(left) + " and " + typeName(right));
+        return;
+    }
+    setType(node, result);
+}
+
+void TypeChecker::visit(UnaryExpression& node) {
+    Type::Kind operand;
+    if (!check(node.operand.get(), operand)) {
+        return;
+    }
+    
+    if (node.op == UnaryExpression::Operator::LOGICAL_NOT) {
+        if (operand != Type::Kind::BOOL) {
+            error(node, "Operand of '!' must be bool, got " + typeName(operand));
+            return;
+        }
+    } else if (!isNumeric(operand)) {
+        error(node, "Operand of unary '-' must be numeric, got " + typeName(operand));
+        return;
+    }
+    setType(node, operand);
+}
+
+bool TypeChecker::checkConstructor(FunctionCallExpression& node, Type::Kind target,
+                                   const std::vector<Type::Kind>& args) {
+    if (args.empty()) {
+        error(node, "Constructor '" + typeName(target) + "' requires arguments");
+        return false;
+    }
+    
+    int provided = 0;
+    for (Type::Kind arg : args) {
+        if (componentCount(arg) == 0) {
+            error(node, "Invalid argument of type " + typeName(arg) + " to constructor '" +
+                  typeName(target) + "'");
+            return false;
+        }
+        provided += componentCount(arg);
+    }
+    
+    // Conversions and splats take a single argument of any size:
+    // float(v) takes the first component, vec3(1.0) splats, vec3(v4) truncates
+    if (args.size() == 1) {
+        bool fromMatrix = isMatrix(args[0]);
+        if (fromMatrix && !isMatrix(target)) {
+            error(node, "Cannot construct " + typeName(target) + " from " + typeName(args[0]));
+            return false;
+        }
+        return true;
+    }
+    
+    int expected = componentCount(target);
+    if (provided != expected) {
+        error(node, "Constructor '" + typeName(target) + "' expects " + std::to_string(expected) +
+              " components, got " + std::to_string(provided));
+        return false;
+    }
     return true;
 }
 
+bool TypeChecker::checkBuiltin(FunctionCallExpression& node, const BuiltinInfo& builtin,
+                               const std::vector<Type::Kind>& args) {
+    int count = static_cast<int>(args.size());
+    if (count < builtin.minArgs || count > builtin.maxArgs) {
+        std::string expected = std::to_string(builtin.minArgs);
+        if (builtin.maxArgs != builtin.minArgs) {
+            expected += " to " + std::to_string(builtin.maxArgs);
+        }
+        error(node, "'" + node.functionName + "' expects " + expected + " arguments, got " +
+              std::to_string(count));
+        return false;
+    }
+    
+    bool isTextureLookup = builtin.has(BuiltinFlag::TEXTURE_FETCH);
+    for (int i = 0; i < count; ++i) {
+        bool wantsSampler = isTextureLookup && i == 0;
+        if (wantsSampler != isSampler(args[i]) || (!wantsSampler && !isNumeric(args[i]))) {
+            error(*node.arguments[i], "Invalid argument " + std::to_string(i + 1) + " of type " +
+                  typeName(args[i]) + " to '" + node.functionName + "'");
+            return false;
+        }
+    }
+    
+    switch (builtin.rule) {
+        case ResultRule::SAME_AS_FIRST: setType(node, args.front()); break;
+        case ResultRule::SAME_AS_LAST: setType(node, args.back()); break;
+        case ResultRule::FLOAT: setType(node, Type::Kind::FLOAT); break;
+        case ResultRule::VEC3: setType(node, Type::Kind::VEC3); break;
+        case ResultRule::VEC4: setType(node, Type::Kind::VEC4); break;
+    }
+    
+    // int arguments to float functions produce float results
+    if (node.resultType->kind == Type::Kind::INT && builtin.rule != ResultRule::FLOAT &&
+        !builtin.has(BuiltinFlag::INT_RESULT)) {
+        setType(node, Type::Kind::FLOAT);
+    }
+    return true;
+}
+
+void TypeChecker::visit(FunctionCallExpression& node) {
+    std::vector<Type::Kind> args;
+    bool argsOk = true;
+    for (auto& arg : node.arguments) {
+        Type::Kind kind;
+        if (check(arg.get(), kind)) {
+            args.push_back(kind);
+        } else {
+            argsOk = false;
+        }
+    }
+    
+    if (node.functionName.empty()) {
+        error(node, "Expression is not callable");
+        return;
+    }
+    if (!argsOk) {
+        return;
+    }
+    
+    Type::Kind constructed;
+    if (typeFromName(node.functionName, constructed)) {
+        if (checkConstructor(node, constructed, args)) {
+            setType(node, constructed);
+        }
+        return;
+    }
+    
+    const Symbol* symbol = symbols_.lookup(node.functionName);
+    recordReference(node.functionName, symbol);
+    if (symbol && symbol->kind == Symbol::Kind::FUNCTION) {
+        for (const FunctionDeclaration* overload : symbol->overloads) {
+            if (overload->parameters.size() != args.size()) {
+                continue;
+            }
+            bool matches = true;
+            for (size_t i = 0; i < args.size(); ++i) {
+                if (!isAssignable(overload->parameters[i]->type->kind, args[i])) {
+                    matches = false;
+                    break;
+                }
+            }
+            if (!matches) {
+                continue;
+            }
+            if (overload == currentDeclaration_) {
+                error(node, "Recursive call to '" + node.functionName + "' is not allowed");
+            } else if (declaredLater(overload)) {
+                error(node, "Function '" + node.functionName + "' is called before its declaration");
+            } else {
+                setType(node, overload->returnType ? overload->returnType->kind : Type::Kind::VOID);
+            }
+            return;
+        }
+        
+        std::string argList;
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (i > 0) argList += ", ";
+            argList += typeName(args[i]);
+        }
+        error(node, "No matching function for call to '" + node.functionName + "(" + argList + ")'");
+        return;
+    }
+    
+    if (symbol) {
+        error(node, "'" + node.functionName + "' is not a function");
+        return;
+    }
+    
+    if (const BuiltinInfo* builtin = builtinInfo(node.builtin)) {
+        checkBuiltin(node, *builtin, args);
+        return;
+    }
+    
+    error(node, "Undeclared function '" + node.functionName + "'");
+}
+
+void TypeChecker::visit(MemberAccessExpression& node) {
+    Type::Kind object;
+    if (!check(node.object.get(), object)) {
+        return;
+    }
+    
+    // Indexing (parsed as a member named "[n]", or "[]" when the index is
+    // not an integer literal)
+    if (!node.member.empty() && node.member.front() == '[') {
+        int size = isFloatVector(object) ? componentCount(object) : isMatrix(object) ? matrixDimension(object) : 0;
+        double index = 0;
+        if (size == 0) {
+            error(node, "Cannot index a value of type " + typeName(object));
+        } else if (!parseNumber(node.member.substr(1, node.member.size() - 2), index)) {
+            error(node, "Index into " + typeName(object) + " must be an integer literal");
+        } else if (index >= size) {
+            error(node, "Index " + node.member.substr(1, node.member.size() - 2) + " is out of range for " +
+                  typeName(object));
+        } else {
+            setType(node, isMatrix(object) ? floatVectorType(size) : Type::Kind::FLOAT);
+        }
+        return;
+    }
+    
+    if (!isFloatVector(object)) {
+        error(node, "Type " + typeName(object) + " has no member '" + node.member + "'");
+        return;
+    }
+    
+    static const char* componentSets[] = {"xyzw", "rgba", "stpq"};
+    int components = componentCount(object);
+    bool valid = node.member.size() >= 1 && node.member.size() <= 4;
+    
+    if (valid) {
+        valid = false;
+        for (const char* set : componentSets) {
+            std::string letters(set, components);
+            if (node.member.find_first_not_of(letters) == std::string::npos) {
+                valid = true;
+                break;
+            }
+        }
+    }
+    
+    if (!valid) {
+        error(node, "Invalid swizzle '" + node.member + "' on " + typeName(object));
+        return;
+    }
+    setType(node, floatVectorType(static_cast<int>(node.member.size())));
+}
+
+void TypeChecker::visit(ExpressionStatement& node) {
+    checkAttributes(node);
+    Type::Kind kind;
+    check(node.expression.get(), kind);
+}
+
+void TypeChecker::visit(AssignmentStatement& node) {
+    checkAttributes(node);
+    Type::Kind target, value;
+    bool targetOk = check(node.target.get(), target);
+    bool valueOk = check(node.value.get(), value);
+    if (!targetOk) {
+        return;
+    }
+    
+    checkLValue(*node.target);
+    if (valueOk && !isAssignable(target, value)) {
+        error(node, "Cannot assign a value of type " + typeName(value) + " to " + typeName(target));
+    }
+}
+
+void TypeChecker::visit(VariableDeclaration& node) {
+    checkAttributes(node);
+    // Local declaration: the initializer is checked before the name is in scope
+    checkInitializer(node);
+    declareVariable(node);
+}
+
+void TypeChecker::visit(FunctionDeclaration& node) {
+    checkAttributes(node);
+    if (currentFunction_) {
+        error(node, "Nested function '" + node.name + "' is not allowed");
+        return;
+    }
+    
+    currentFunction_ = &node;
+    symbols_.enterScope();
+    
+    for (auto& param : node.parameters) {
+        if (param->type && isSampler(param->type->kind) &&
+            param->qualifier == VariableDeclaration::Qualifier::OUT) {
+            error(*param, "Sampler parameter '" + param->name + "' cannot be 'out'");
+        }
+        if (param->qualifier == VariableDeclaration::Qualifier::UNIFORM) {
+            error(*param, "Parameter '" + param->name + "' cannot be 'uniform'");
+        }
+        declareVariable(*param);
+    }
+    
+    for (auto& stmt : node.body) {
+        if (stmt) {
+            stmt->accept(*this);
+        }
+    }
+    
+    symbols_.exitScope();
+    currentFunction_ = nullptr;
+}
+
+void TypeChecker::visit(ShaderDeclaration& node) {
+    checkAttributes(node);
+    scopeName_ = node.name;
+    symbols_.enterScope();
+    declareStageVariables(symbols_, node.shaderType);
+    
+    symbols_.enterScope();
+    declareAll(node.body);
+    checkAll(node.body);
+    
+    bool hasMain = false;
+    for (auto& decl : node.body) {
+        if (auto func = dynamic_cast<FunctionDeclaration*>(decl.get())) {
+            hasMain = hasMain || func->name == "main";
+        }
+    }
+    if (!hasMain && !node.body.empty()) {
+        diagnostics_.emplace_back(Diagnostic::Severity::WARNING,
+                                  "Shader '" + node.name + "' has no main() function",
+                                  node.line, node.column);
+    }
+    
+    symbols_.exitScope();
+    symbols_.exitScope();
+}
+
+void TypeChecker::visit(BlockStatement& node) {
+    checkAttributes(node);
+    symbols_.enterScope();
+    for (auto& stmt : node.statements) {
+        if (stmt) {
+            stmt->accept(*this);
+        }
+    }
+    symbols_.exitScope();
+}
+
+void TypeChecker::visit(IfStatement& node) {
+    checkAttributes(node);
+    checkCondition(node.condition.get(), "if");
+    if (node.thenStatement) {
+        node.thenStatement->accept(*this);
+    }
+    if (node.elseStatement) {
+        node.elseStatement->accept(*this);
+    }
+}
+
+void TypeChecker::visit(ForStatement& node) {
+    checkAttributes(node);
+    symbols_.enterScope();
+    if (node.initialization) {
+        node.initialization->accept(*this);
+    }
+    if (node.condition) {
+        checkCondition(node.condition.get(), "for");
+    }
+    if (node.update) {
+        node.update->accept(*this);
+    }
+    if (node.body) {
+        node.body->accept(*this);
+    }
+    symbols_.exitScope();
+}
+
+void TypeChecker::visit(WhileStatement& node) {
+    checkAttributes(node);
+    checkCondition(node.condition.get(), "while");
+    if (node.body) {
+        node.body->accept(*this);
+    }
+}
+
+void TypeChecker::visit(ReturnStatement& node) {
+    checkAttributes(node);
+    if (!currentFunction_) {
+        error(node, "'return' outside of a function");
+        return;
+    }
+    
+    Type::Kind expected = currentFunction_->returnType ?
+        currentFunction_->returnType->kind : Type::Kind::VOID;
+    
+    if (!node.value) {
+        if (expected != Type::Kind::VOID) {
+            error(node, "Function '" + currentFunction_->name + "' must return a value of type " +
+                  typeName(expected));
+        }
+        return;
+    }
+    
+    Type::Kind actual;
+    if (!check(node.value.get(), actual)) {
+        return;
+    }
+    if (expected == Type::Kind::VOID) {
+        error(node, "Void function '" + currentFunction_->name + "' cannot return a value");
+    } else if (!isAssignable(expected, actual)) {
+        error(node, "Cannot return a value of type " + typeName(actual) + " from function '" +
+              currentFunction_->name + "' returning " + typeName(expected));
+    }
+}
+
+} // namespace
+
+bool SemanticAnalyzer::analyze(Program& program) {
+    diagnostics_.clear();
+    
+    BuiltinResolver resolver;
+    program.accept(resolver);
+    
+    DependencyGraph previous = std::move(graph_);
+    graph_ = DependencyGraph();
+    const DependencyGraph* reusable = incremental_ ? &previous : nullptr;
+    
+    // Builtins live in the outermost scope, program-level declarations one
+    // level in, so a shader may shadow either
+    SymbolTable globals;
+    declareBuiltinVariables(globals);
+    globals.enterScope();
+    
+    std::vector<Diagnostic> globalDiagnostics;
+    std::vector<DeclarationRecord> globalRecords;
+    TypeChecker globalChecker(globals, globalDiagnostics, globalRecords, reusable);
+    globalChecker.declareAll(program.declarations);
+    globalChecker.checkAll(program.declarations);
+    
+    std::vector<ShaderDeclaration*> shaders;
+    std::unordered_set<std::string> shaderNames;
+    for (auto& decl : program.declarations) {
+        if (auto shader = dynamic_cast<ShaderDeclaration*>(decl.get())) {
+            if (!shaderNames.insert(shader->name).second) {
+                globalDiagnostics.emplace_back(Diagnostic::Severity::ERROR,
+                                               "Redefinition of shader '" + shader->name + "'",
+                                               shader->line, shader->column);
+            }
+            shaders.push_back(shader);
+        }
+    }
+    
+    // Nothing below may modify the global scope: every worker reads the same snapshot
+    std::shared_ptr<const FrozenScope> frozenGlobals = globals.freeze();
+    
+    std::vector<std::vector<Diagnostic>> shaderDiagnostics(shaders.size());
+    std::vector<std::vector<DeclarationRecord>> shaderRecords(shaders.size());
+    std::vector<size_t> shaderReused(shaders.size(), 0);
+    std::vector<size_t> shaderChecked(shaders.size(), 0);
+    Parallel::forEach(shaders.size(), threadCount_, [&](size_t i) {
+        SymbolTable symbols(frozenGlobals);
+        TypeChecker checker(symbols, shaderDiagnostics[i], shaderRecords[i], reusable,
+                            &globalChecker.index());
+        shaders[i]->accept(checker);
+        shaderReused[i] = checker.reusedCount();
+        shaderChecked[i] = checker.checkedCount();
+    });
+    
+    reusedCount_ = globalChecker.reusedCount();
+    reanalyzedCount_ = globalChecker.checkedCount();
+    for (auto& record : globalRecords) {
+        graph_.add(std::move(record));
+    }
+    for (size_t i = 0; i < shaders.size(); ++i) {
+        reusedCount_ += shaderReused[i];
+        reanalyzedCount_ += shaderChecked[i];
+        for (auto& record : shaderRecords[i]) {
+            graph_.add(std::move(record));
+        }
+    }
+    
+    diagnostics_ = std::move(globalDiagnostics);
+    for (auto& buffer : shaderDiagnostics) {
+        diagnostics_.insert(diagnostics_.end(), buffer.begin(), buffer.end());
+    }
+    ErrorHandler::sortBySourceOrder(diagnostics_);
+    
+    return !hasErrors();
+}
+
+bool SemanticAnalyzer::hasErrors() const {
+    for (const auto& diagnostic : diagnostics_) {
+        if (diagnostic.severity == Diagnostic::Severity::ERROR) {
+            return true;
+        }
+    }
+    return false;
+}
+
 } // namespace sdl
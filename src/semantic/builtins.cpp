@@ -0,0 +1,145 @@
+#include "semantic/builtins.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace sdl {
+
+namespace {
+
+constexpr float PI = 3.14159265358979323846f;
+
+// Folds evaluate in single precision, as the GPU would; constants are stored
+// as double
+float arg(const double* a, size_t index) { return static_cast<float>(a[index]); }
+
+double foldRadians(const double* a, size_t) { return arg(a, 0) * (PI / 180.0f); }
+double foldDegrees(const double* a, size_t) { return arg(a, 0) * (180.0f / PI); }
+double foldSin(const double* a, size_t) { return std::sin(arg(a, 0)); }
+double foldCos(const double* a, size_t) { return std::cos(arg(a, 0)); }
+double foldTan(const double* a, size_t) { return std::tan(arg(a, 0)); }
+double foldAsin(const double* a, size_t) { return std::asin(arg(a, 0)); }
+double foldAcos(const double* a, size_t) { return std::acos(arg(a, 0)); }
+double foldAtan(const double* a, size_t n) { return n == 2 ? std::atan2(arg(a, 0), arg(a, 1)) : std::atan(arg(a, 0)); }
+double foldPow(const double* a, size_t) { return std::pow(arg(a, 0), arg(a, 1)); }
+double foldExp(const double* a, size_t) { return std::exp(arg(a, 0)); }
+double foldLog(const double* a, size_t) { return std::log(arg(a, 0)); }
+double foldExp2(const double* a, size_t) { return std::exp2(arg(a, 0)); }
+double foldLog2(const double* a, size_t) { return std::log2(arg(a, 0)); }
+double foldSqrt(const double* a, size_t) { return std::sqrt(arg(a, 0)); }
+double foldInversesqrt(const double* a, size_t) { return 1.0f / std::sqrt(arg(a, 0)); }
+double foldAbs(const double* a, size_t) { return std::fabs(a[0]); }
+double foldSign(const double* a, size_t) { return a[0] > 0.0 ? 1.0 : a[0] < 0.0 ? -1.0 : 0.0; }
+double foldFloor(const double* a, size_t) { return std::floor(a[0]); }
+double foldCeil(const double* a, size_t) { return std::ceil(a[0]); }
+double foldFract(const double* a, size_t) { return arg(a, 0) - std::floor(arg(a, 0)); }
+double foldMod(const double* a, size_t) { return arg(a, 0) - arg(a, 1) * std::floor(arg(a, 0) / arg(a, 1)); }
+double foldMin(const double* a, size_t) { return std::min(a[0], a[1]); }
+double foldMax(const double* a, size_t) { return std::max(a[0], a[1]); }
+double foldClamp(const double* a, size_t) { return std::min(std::max(a[0], a[1]), a[2]); }
+double foldSaturate(const double* a, size_t) { return std::min(std::max(a[0], 0.0), 1.0); }
+double foldMix(const double* a, size_t) { return arg(a, 0) * (1.0f - arg(a, 2)) + arg(a, 1) * arg(a, 2); }
+double foldStep(const double* a, size_t) { return a[1] < a[0] ? 0.0 : 1.0; }
+
+double foldSmoothstep(const double* a, size_t) {
+    float t = std::min(std::max((arg(a, 2) - arg(a, 0)) / (arg(a, 1) - arg(a, 0)), 0.0f), 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+#define COST(...) {__VA_ARGS__}
+#define SDL_BUILTIN(id, name, minArgs, maxArgs, rule, flags, cost, effects, fold, glsl, cuda, cpu) \
+    {BuiltinId::id, name, minArgs, maxArgs, ResultRule::rule, flags, cost, effects, fold, glsl, cuda, cpu},
+
+constexpr BuiltinInfo BUILTINS[] = {
+#include "semantic/builtins.def"
+};
+
+#undef SDL_BUILTIN
+#undef COST
+
+constexpr size_t BUILTIN_COUNT = sizeof(BUILTINS) / sizeof(BUILTINS[0]);
+
+// builtinInfo() indexes the table by id, so entry i must be id i + 1
+constexpr bool tableIsValid() {
+    for (size_t i = 0; i < BUILTIN_COUNT; ++i) {
+        const BuiltinInfo& info = BUILTINS[i];
+        if (static_cast<size_t>(info.id) != i + 1 || info.minArgs > info.maxArgs ||
+            !info.glsl || !info.cuda) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(tableIsValid(), "builtins.def entries must be in id order with GLSL and CUDA lowerings");
+
+const char* alternativeEnd(const char* p) {
+    while (*p && *p != '|') {
+        ++p;
+    }
+    return p;
+}
+
+} // anonymous namespace
+
+BuiltinId findBuiltinId(const std::string& name) {
+    static const std::unordered_map<std::string, BuiltinId> ids = [] {
+        std::unordered_map<std::string, BuiltinId> result;
+        for (const BuiltinInfo& info : BUILTINS) {
+            result.emplace(info.name, info.id);
+        }
+        return result;
+    }();
+    
+    auto it = ids.find(name);
+    return it != ids.end() ? it->second : BuiltinId::NONE;
+}
+
+const BuiltinInfo* builtinInfo(BuiltinId id) {
+    size_t index = static_cast<size_t>(id);
+    if (index == 0 || index > BUILTIN_COUNT) {
+        return nullptr;
+    }
+    return &BUILTINS[index - 1];
+}
+
+std::string lowerBuiltin(const char* pattern, const std::vector<std::string>& args, int minArgs) {
+    if (!pattern) {
+        return "";
+    }
+    
+    // Skip to the alternative for this argument count
+    const char* begin = pattern;
+    for (int count = minArgs; count < static_cast<int>(args.size()); ++count) {
+        const char* end = alternativeEnd(begin);
+        if (!*end) {
+            break;
+        }
+        begin = end + 1;
+    }
+    const char* end = alternativeEnd(begin);
+    
+    std::string result;
+    for (const char* p = begin; p < end; ++p) {
+        if (*p != '$' || p + 1 >= end) {
+            result += *p;
+        } else if (p[1] == '*') {
+            for (size_t i = 0; i < args.size(); ++i) {
+                if (i > 0) result += ", ";
+                result += args[i];
+            }
+            ++p;
+        } else if (p[1] >= '0' && p[1] <= '9') {
+            size_t index = static_cast<size_t>(p[1] - '0');
+            if (index < args.size()) {
+                result += args[index];
+            }
+            ++p;
+        } else {
+            result += *p;
+        }
+    }
+    return result;
+}
+
+} // namespace sdl
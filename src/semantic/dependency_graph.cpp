@@ -0,0 +1,30 @@
+#include "semantic/dependency_graph.h"
+#include <algorithm>
+
+namespace sdl {
+
+void DependencyGraph::add(DeclarationRecord record) {
+    std::string key = record.key;
+    records_[key] = std::move(record);
+}
+
+const DeclarationRecord* DependencyGraph::find(const std::string& key) const {
+    auto it = records_.find(key);
+    return it != records_.end() ? &it->second : nullptr;
+}
+
+std::vector<std::string> DependencyGraph::dependents(const std::string& key) const {
+    std::vector<std::string> result;
+    for (const auto& entry : records_) {
+        for (const auto& dependency : entry.second.dependencies) {
+            if (dependency.key == key) {
+                result.push_back(entry.first);
+                break;
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+} // namespace sdl
@@ -2,21 +2,75 @@
 
 namespace sdl {
 
+const Symbol* FrozenScope::lookup(const std::string& name) const {
+    auto it = symbols_.find(name);
+    if (it != symbols_.end()) {
+        return &it->second;
+    }
+    return parent_ ? parent_->lookup(name) : nullptr;
+}
+
+SymbolTable::SymbolTable() {
+    enterScope();
+}
+
+SymbolTable::SymbolTable(std::shared_ptr<const FrozenScope> base) : base_(std::move(base)) {
+    enterScope();
+}
+
 void SymbolTable::enterScope() {
-    // Stub implementation
+    scopes_.emplace_back();
 }
 
 void SymbolTable::exitScope() {
-    // Stub implementation
+    if (scopes_.size() > 1) {
+        scopes_.pop_back();
+    }
+}
+
+bool SymbolTable::define(const std::string& name, const Symbol& symbol) {
+    auto& scope = scopes_.back();
+    if (scope.count(name)) {
+        return false;
+    }
+    
+    Symbol defined = symbol;
+    defined.depth = depth();
+    scope.emplace(name, std::move(defined));
+    return true;
 }
 
-void SymbolTable::define(const std::string& name, const std::string& type) {
-    // Stub implementation
+const Symbol* SymbolTable::lookup(const std::string& name) const {
+    for (auto it = scopes_.rbegin(); it != scopes_.rend(); ++it) {
+        auto found = it->find(name);
+        if (found != it->end()) {
+            return &found->second;
+        }
+    }
+    return base_ ? base_->lookup(name) : nullptr;
 }
 
-bool SymbolTable::lookup(const std::string& name) {
-    // Stub implementation
-    return true;
+Symbol* SymbolTable::lookupCurrentScope(const std::string& name) {
+    auto found = scopes_.back().find(name);
+    return found != scopes_.back().end() ? &found->second : nullptr;
+}
+
+size_t SymbolTable::depth() const {
+    size_t baseDepth = base_ ? base_->depth() : 0;
+    return baseDepth + scopes_.size() - 1;
+}
+
+std::shared_ptr<const FrozenScope> SymbolTable::freeze() const {
+    std::unordered_map<std::string, Symbol> flattened;
+    
+    // Outer scopes first so that inner definitions shadow them
+    for (const auto& scope : scopes_) {
+        for (const auto& entry : scope) {
+            flattened[entry.first] = entry.second;
+        }
+    }
+    
+    return std::make_shared<const FrozenScope>(std::move(flattened), depth() + 1, base_);
 }
 
 } // namespace sdl
@@ -0,0 +1,106 @@
+#include "semantic/types.h"
+
+namespace sdl {
+
+int componentCount(Type::Kind kind) {
+    switch (kind) {
+        case Type::Kind::BOOL:
+        case Type::Kind::INT:
+        case Type::Kind::FLOAT: return 1;
+        case Type::Kind::VEC2: return 2;
+        case Type::Kind::VEC3: return 3;
+        case Type::Kind::VEC4: return 4;
+        case Type::Kind::MAT2: return 4;
+        case Type::Kind::MAT3: return 9;
+        case Type::Kind::MAT4: return 16;
+        default: return 0;
+    }
+}
+
+int matrixDimension(Type::Kind kind) {
+    switch (kind) {
+        case Type::Kind::MAT2: return 2;
+        case Type::Kind::MAT3: return 3;
+        case Type::Kind::MAT4: return 4;
+        default: return 0;
+    }
+}
+
+bool isScalar(Type::Kind kind) {
+    return kind == Type::Kind::BOOL || kind == Type::Kind::INT || kind == Type::Kind::FLOAT;
+}
+
+bool isNumeric(Type::Kind kind) {
+    return kind == Type::Kind::INT || kind == Type::Kind::FLOAT ||
+           isFloatVector(kind) || isMatrix(kind);
+}
+
+bool isFloatVector(Type::Kind kind) {
+    return kind == Type::Kind::VEC2 || kind == Type::Kind::VEC3 || kind == Type::Kind::VEC4;
+}
+
+bool isMatrix(Type::Kind kind) {
+    return matrixDimension(kind) != 0;
+}
+
+bool isSampler(Type::Kind kind) {
+    return kind == Type::Kind::SAMPLER2D || kind == Type::Kind::SAMPLER3D ||
+           kind == Type::Kind::SAMPLERCUBE;
+}
+
+Type::Kind floatVectorType(int components) {
+    switch (components) {
+        case 1: return Type::Kind::FLOAT;
+        case 2: return Type::Kind::VEC2;
+        case 3: return Type::Kind::VEC3;
+        case 4: return Type::Kind::VEC4;
+        default: return Type::Kind::VOID;
+    }
+}
+
+Type::Kind matrixType(int dimension) {
+    switch (dimension) {
+        case 2: return Type::Kind::MAT2;
+        case 3: return Type::Kind::MAT3;
+        case 4: return Type::Kind::MAT4;
+        default: return Type::Kind::VOID;
+    }
+}
+
+std::string typeName(Type::Kind kind) {
+    switch (kind) {
+        case Type::Kind::VOID: return "void";
+        case Type::Kind::BOOL: return "bool";
+        case Type::Kind::INT: return "int";
+        case Type::Kind::FLOAT: return "float";
+        case Type::Kind::VEC2: return "vec2";
+        case Type::Kind::VEC3: return "vec3";
+        case Type::Kind::VEC4: return "vec4";
+        case Type::Kind::MAT2: return "mat2";
+        case Type::Kind::MAT3: return "mat3";
+        case Type::Kind::MAT4: return "mat4";
+        case Type::Kind::SAMPLER2D: return "sampler2D";
+        case Type::Kind::SAMPLER3D: return "sampler3D";
+        case Type::Kind::SAMPLERCUBE: return "samplerCube";
+        case Type::Kind::STRUCT: return "struct";
+        case Type::Kind::ARRAY: return "array";
+        default: return "unknown";
+    }
+}
+
+bool typeFromName(const std::string& name, Type::Kind& kind) {
+    static const Type::Kind kinds[] = {
+        Type::Kind::BOOL, Type::Kind::INT, Type::Kind::FLOAT,
+        Type::Kind::VEC2, Type::Kind::VEC3, Type::Kind::VEC4,
+        Type::Kind::MAT2, Type::Kind::MAT3, Type::Kind::MAT4
+    };
+    for (Type::Kind candidate : kinds) {
+        if (typeName(candidate) == name) {
+            kind = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace sdl
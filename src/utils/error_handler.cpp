@@ -1,9 +1,25 @@
 #include "utils/error_handler.h"
+#include <algorithm>
 
 namespace sdl {
 
+std::string Diagnostic::format() const {
+    if (line == 0) {
+        return message;
+    }
+    return "line " + std::to_string(line) + ", column " + std::to_string(column) + ": " + message;
+}
+
 void ErrorHandler::report(const std::string& message) {
     // Stub implementation
 }
 
+void ErrorHandler::sortBySourceOrder(std::vector<Diagnostic>& diagnostics) {
+    std::stable_sort(diagnostics.begin(), diagnostics.end(),
+                     [](const Diagnostic& a, const Diagnostic& b) {
+                         if (a.line != b.line) return a.line < b.line;
+                         return a.column < b.column;
+                     });
+}
+
 } // namespace sdl
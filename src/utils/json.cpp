@@ -0,0 +1,302 @@
+#include "utils/json.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace sdl {
+
+JsonWriter& JsonWriter::beginObject() {
+    beginValue();
+    out_ << "{";
+    hasElements_.push_back(false);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    bool nonEmpty = hasElements_.back();
+    hasElements_.pop_back();
+    if (nonEmpty) {
+        newline();
+    }
+    out_ << "}";
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+    beginValue();
+    out_ << "[";
+    hasElements_.push_back(false);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    bool nonEmpty = hasElements_.back();
+    hasElements_.pop_back();
+    if (nonEmpty) {
+        newline();
+    }
+    out_ << "]";
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(const std::string& name) {
+    beginValue();
+    out_ << "\"" << escape(name) << "\": ";
+    afterKey_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const std::string& text) {
+    beginValue();
+    out_ << "\"" << escape(text) << "\"";
+    return *this;
+}
+
+JsonWriter& JsonWriter::number(double value) {
+    beginValue();
+    if (!std::isfinite(value)) {
+        out_ << "null";
+        return *this;
+    }
+    
+    // Shortest spelling that round-trips
+    char buffer[32];
+    for (int precision = 1; precision <= 17; ++precision) {
+        std::snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+        if (std::strtod(buffer, nullptr) == value) {
+            break;
+        }
+    }
+    out_ << buffer;
+    return *this;
+}
+
+JsonWriter& JsonWriter::integer(long long value) {
+    beginValue();
+    out_ << value;
+    return *this;
+}
+
+JsonWriter& JsonWriter::boolean(bool value) {
+    beginValue();
+    out_ << (value ? "true" : "false");
+    return *this;
+}
+
+JsonWriter& JsonWriter::null() {
+    beginValue();
+    out_ << "null";
+    return *this;
+}
+
+void JsonWriter::beginValue() {
+    // A value directly after its key stays on the key's line
+    if (afterKey_) {
+        afterKey_ = false;
+        return;
+    }
+    if (hasElements_.empty()) {
+        return;
+    }
+    
+    if (hasElements_.back()) {
+        out_ << ",";
+    }
+    hasElements_.back() = true;
+    newline();
+}
+
+void JsonWriter::newline() {
+    out_ << "\n" << std::string(hasElements_.size() * 2, ' ');
+}
+
+std::string JsonWriter::escape(const std::string& text) {
+    std::string result;
+    for (char c : text) {
+        switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    result += buffer;
+                } else {
+                    result += c;
+                }
+        }
+    }
+    return result;
+}
+
+namespace {
+
+class JsonReader {
+public:
+    explicit JsonReader(const std::string& text) : text_(text) {}
+    
+    JsonValue document() {
+        JsonValue result = value();
+        skipSpace();
+        if (pos_ != text_.size()) {
+            fail("unexpected text after the document");
+        }
+        return result;
+    }
+    
+private:
+    const std::string& text_;
+    size_t pos_ = 0;
+    
+    [[noreturn]] void fail(const std::string& message) const {
+        int line = 1 + static_cast<int>(std::count(text_.begin(), text_.begin() + pos_, '\n'));
+        throw std::runtime_error("JSON line " + std::to_string(line) + ": " + message);
+    }
+    
+    void skipSpace() {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+            ++pos_;
+        }
+    }
+    
+    bool consume(char c) {
+        skipSpace();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+    
+    void expect(char c) {
+        if (!consume(c)) {
+            fail(std::string("expected '") + c + "'");
+        }
+    }
+    
+    bool keyword(const char* word) {
+        size_t length = std::strlen(word);
+        if (text_.compare(pos_, length, word) == 0) {
+            pos_ += length;
+            return true;
+        }
+        return false;
+    }
+    
+    JsonValue value() {
+        skipSpace();
+        if (pos_ == text_.size()) {
+            fail("unexpected end of input");
+        }
+        JsonValue result;
+        char c = text_[pos_];
+        if (c == '{') {
+            ++pos_;
+            result.kind = JsonValue::Kind::OBJECT;
+            if (!consume('}')) {
+                do {
+                    skipSpace();
+                    if (pos_ == text_.size() || text_[pos_] != '"') {
+                        fail("expected a member name");
+                    }
+                    result.keys.push_back(string());
+                    expect(':');
+                    result.elements.push_back(value());
+                } while (consume(','));
+                expect('}');
+            }
+        } else if (c == '[') {
+            ++pos_;
+            result.kind = JsonValue::Kind::ARRAY;
+            if (!consume(']')) {
+                do {
+                    result.elements.push_back(value());
+                } while (consume(','));
+                expect(']');
+            }
+        } else if (c == '"') {
+            result.kind = JsonValue::Kind::STRING;
+            result.text = string();
+        } else if (keyword("true")) {
+            result.kind = JsonValue::Kind::BOOLEAN;
+            result.boolean = true;
+        } else if (keyword("false")) {
+            result.kind = JsonValue::Kind::BOOLEAN;
+        } else if (keyword("null")) {
+            result.kind = JsonValue::Kind::NULL_VALUE;
+        } else {
+            const char* start = text_.c_str() + pos_;
+            char* end = nullptr;
+            result.number = std::strtod(start, &end);
+            if (end == start || !(c == '-' || std::isdigit(static_cast<unsigned char>(c)))) {
+                fail("unexpected character");
+            }
+            result.kind = JsonValue::Kind::NUMBER;
+            pos_ += end - start;
+        }
+        return result;
+    }
+    
+    // The string literal at pos_, unescaped; \u escapes past ASCII become UTF-8
+    std::string string() {
+        ++pos_;
+        std::string result;
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            char c = text_[pos_++];
+            if (c != '\\') {
+                result += c;
+                continue;
+            }
+            if (pos_ == text_.size()) {
+                break;
+            }
+            char escape = text_[pos_++];
+            switch (escape) {
+                case 'n': result += '\n'; break;
+                case 't': result += '\t'; break;
+                case 'r': result += '\r'; break;
+                case 'b': result += '\b'; break;
+                case 'f': result += '\f'; break;
+                case 'u': {
+                    if (pos_ + 4 > text_.size()) {
+                        fail("truncated \\u escape");
+                    }
+                    unsigned code = static_cast<unsigned>(std::strtoul(text_.substr(pos_, 4).c_str(), nullptr, 16));
+                    pos_ += 4;
+                    if (code < 0x80) {
+                        result += static_cast<char>(code);
+                    } else if (code < 0x800) {
+                        result += static_cast<char>(0xC0 | (code >> 6));
+                        result += static_cast<char>(0x80 | (code & 0x3F));
+                    } else {
+                        result += static_cast<char>(0xE0 | (code >> 12));
+                        result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                        result += static_cast<char>(0x80 | (code & 0x3F));
+                    }
+                    break;
+                }
+                default: result += escape; break;
+            }
+        }
+        if (pos_ == text_.size()) {
+            fail("unterminated string");
+        }
+        ++pos_;
+        return result;
+    }
+};
+
+} // anonymous namespace
+
+JsonValue parseJson(const std::string& text) {
+    return JsonReader(text).document();
+}
+
+} // namespace sdl
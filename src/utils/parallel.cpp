@@ -0,0 +1,63 @@
+#include "utils/parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sdl {
+
+unsigned Parallel::defaultThreadCount() {
+    unsigned hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+void Parallel::forEach(size_t count, unsigned maxThreads,
+                       const std::function<void(size_t)>& task) {
+    if (maxThreads == 0) {
+        maxThreads = defaultThreadCount();
+    }
+    
+    size_t workerCount = std::min<size_t>(maxThreads, count);
+    if (workerCount <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            task(i);
+        }
+        return;
+    }
+    
+    std::atomic<size_t> next{0};
+    std::exception_ptr firstError;
+    std::mutex errorMutex;
+    
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            try {
+                task(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!firstError) {
+                    firstError = std::current_exception();
+                }
+            }
+        }
+    };
+    
+    std::vector<std::thread> workers;
+    workers.reserve(workerCount - 1);
+    for (size_t i = 1; i < workerCount; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker(); // The calling thread takes part as well
+    
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    
+    if (firstError) {
+        std::rethrow_exception(firstError);
+    }
+}
+
+} // namespace sdl
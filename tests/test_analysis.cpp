@@ -0,0 +1,483 @@
+#include <gtest/gtest.h>
+#include "analysis/stage_interface.h"
+#include "analysis/cost_model.h"
+#include "analysis/liveness.h"
+#include "analysis/purity.h"
+#include "analysis/uniformity.h"
+#include "analysis/value_range.h"
+#include "semantic/analyzer.h"
+#include "codegen/glsl_generator.h"
+#include "codegen/cuda_generator.h"
+#include "parser/parser.h"
+#include "lexer/lexer.h"
+
+using namespace sdl;
+
+class AnalysisTest : public ::testing::Test {
+protected:
+    std::unique_ptr<Program> analyzeString(const std::string& source) {
+        Lexer lexer(source);
+        auto tokens = lexer.tokenize();
+        Parser parser(std::move(tokens));
+        auto program = parser.parseProgram();
+        
+        SemanticAnalyzer analyzer;
+        EXPECT_TRUE(analyzer.analyze(*program));
+        return program;
+    }
+};
+
+TEST_F(AnalysisTest, PacksVaryingsIntoVec4Slots) {
+    auto program = analyzeString(R"(
+        shader vs : vertex {
+            in vec3 position;
+            out vec2 uv;
+            out vec2 uv2;
+            out float fog;
+            void main() {
+                uv = position.xy;
+                uv2 = position.zy;
+                fog = position.z;
+                gl_Position = vec4(position, 1.0);
+            }
+        }
+        shader fs : fragment {
+            in vec2 uv;
+            in vec2 uv2;
+            in float fog;
+            out vec4 color;
+            void main() { color = vec4(uv.yx, uv2.x * fog, 1.0); }
+        }
+    )");
+    
+    StageInterface stageInterface;
+    ASSERT_TRUE(stageInterface.link(*program));
+    stageInterface.optimize();
+    
+    const StageLink& link = stageInterface.getLinks().at(0);
+    EXPECT_EQ(link.slotsBefore, 3);
+    EXPECT_EQ(link.slotsAfter, 2);
+    
+    GLSLGenerator generator;
+    std::string output = generator.generate(*program);
+    EXPECT_NE(output.find("out vec4 packedVarying0;"), std::string::npos);
+    EXPECT_NE(output.find("in vec4 packedVarying0;"), std::string::npos);
+    EXPECT_NE(output.find("packedVarying0.zw = position.zy;"), std::string::npos);
+    EXPECT_NE(output.find("vec4(packedVarying0.yx, (packedVarying0.z * fog), 1.0)"), std::string::npos);
+    EXPECT_EQ(output.find("out vec2 uv;"), std::string::npos);
+}
+
+TEST_F(AnalysisTest, DropsOutputsNoFragmentReads) {
+    auto program = analyzeString(R"(
+        shader vs : vertex {
+            out vec3 unused;
+            out vec4 tint;
+            void main() {
+                unused = vec3(1.0);
+                tint = vec4(unused, 1.0);
+            }
+        }
+        shader fs : fragment {
+            in vec3 unused;
+            in vec4 tint;
+            out vec4 color;
+            void main() { color = tint; }
+        }
+    )");
+    
+    StageInterface stageInterface;
+    ASSERT_TRUE(stageInterface.link(*program));
+    stageInterface.optimize();
+    
+    const StageLink& link = stageInterface.getLinks().at(0);
+    EXPECT_EQ(link.dropped, std::vector<std::string>{"unused"});
+    EXPECT_EQ(link.slotsAfter, 1);
+    
+    // The vertex shader still reads what it wrote, so the value stays as a global
+    GLSLGenerator generator;
+    std::string output = generator.generate(*program);
+    EXPECT_NE(output.find("\nvec3 unused;"), std::string::npos);
+    EXPECT_EQ(output.find("in vec3 unused;"), std::string::npos);
+}
+
+TEST_F(AnalysisTest, ReportsMismatchedStageInterface) {
+    auto program = analyzeString(R"(
+        shader vs : vertex {
+            out vec3 normal;
+            void main() { normal = vec3(0.0); }
+        }
+        shader fs : fragment {
+            in vec2 normal;
+            in float depth;
+            out vec4 color;
+            void main() { color = vec4(normal, depth, 1.0); }
+        }
+    )");
+    
+    StageInterface stageInterface;
+    EXPECT_FALSE(stageInterface.link(*program));
+    
+    const auto& diagnostics = stageInterface.getDiagnostics();
+    ASSERT_EQ(diagnostics.size(), 2);
+    EXPECT_NE(diagnostics[0].message.find("has type vec2 but vertex shader 'vs' outputs vec3"),
+              std::string::npos);
+    EXPECT_NE(diagnostics[1].message.find("'depth' of shader 'fs' is not an output"), std::string::npos);
+}
+
+TEST_F(AnalysisTest, EstimatesShaderCost) {
+    auto program = analyzeString(R"(
+        float wave(float x) { return sin(x) * 0.5; }
+        shader fs : fragment {
+            in vec2 uv;
+            uniform sampler2D tex;
+            out vec4 color;
+            void main() {
+                vec4 sum = vec4(0.0);
+                for (int i = 0; i < 4; i = i + 1) {
+                    sum = sum + texture(tex, uv);
+                }
+                color = sum * wave(uv.x);
+            }
+        }
+    )");
+    
+    auto glsl = CostModel(TargetLanguage::GLSL).analyze(*program);
+    auto cuda = CostModel(TargetLanguage::CUDA).analyze(*program);
+    ASSERT_EQ(glsl.size(), 1);
+    
+    const ShaderCost& shader = glsl[0];
+    EXPECT_EQ(shader.cost.textureFetches, 4);
+    EXPECT_EQ(shader.cost.transcendentalOps, 1);
+    EXPECT_EQ(shader.cost.branches, 4);
+    // 4 x (compare + vec4 add + counter add), vec4 multiply, scalar multiply in wave()
+    EXPECT_EQ(shader.cost.aluOps, 4 * 6 + 4 + 1);
+    EXPECT_GT(cuda[0].cost.cycles, shader.cost.cycles);
+    
+    // main() plus the program-level function it calls
+    ASSERT_EQ(shader.functions.size(), 2);
+    EXPECT_EQ(shader.functions[0].name, "wave");
+    ASSERT_EQ(shader.functions[1].loops.size(), 1);
+    EXPECT_EQ(shader.functions[1].loops[0].tripCount, 4);
+}
+
+TEST_F(AnalysisTest, WritesCostReportAsJSON) {
+    ShaderCost shader;
+    shader.name = "fs";
+    shader.stage = ShaderDeclaration::ShaderType::FRAGMENT;
+    shader.cost.aluOps = 3;
+    shader.cost.cycles = 4.5;
+    
+    JsonWriter json;
+    json.beginObject();
+    CostModel::writeJSON(json, shader);
+    json.endObject();
+    EXPECT_EQ(json.str(),
+              "{\n"
+              "  \"name\": \"fs\",\n"
+              "  \"stage\": \"fragment\",\n"
+              "  \"cost\": {\n"
+              "    \"alu\": 3,\n"
+              "    \"transcendental\": 0,\n"
+              "    \"texture\": 0,\n"
+              "    \"branches\": 0,\n"
+              "    \"cycles\": 4.5\n"
+              "  },\n"
+              "  \"functions\": []\n"
+              "}");
+}
+
+TEST_F(AnalysisTest, ReportsPeakRegisterPressure) {
+    auto program = analyzeString(R"(
+        float shade(vec3 n) {
+            vec3 l = normalize(vec3(1.0, 2.0, 3.0));
+            return dot(n, l);
+        }
+        shader fs : fragment {
+            in vec3 normal;
+            out vec4 color;
+            void main() {
+                vec4 base = vec4(0.5);
+                vec3 n = normalize(normal);
+                float lit = shade(n);
+                vec4 tint = vec4(lit);
+                color = base * tint;
+            }
+        }
+    )");
+    
+    auto pressure = LivenessAnalysis().analyze(*program);
+    ASSERT_EQ(pressure.size(), 1);
+    
+    // base (4) is live across the call, which itself needs n and l (6)
+    EXPECT_EQ(pressure[0].peakScalars, 10);
+    EXPECT_EQ(pressure[0].peakLine, 12);
+    
+    ASSERT_EQ(pressure[0].functions.size(), 2);
+    EXPECT_EQ(pressure[0].functions[0].name, "shade");
+    EXPECT_EQ(pressure[0].functions[0].peakScalars, 6);
+}
+
+TEST_F(AnalysisTest, LoopCarriedValuesStayLive) {
+    auto program = analyzeString(R"(
+        shader fs : fragment {
+            out vec4 color;
+            void main() {
+                vec4 acc = vec4(0.0);
+                vec4 unusedAfterLoop = vec4(1.0);
+                for (int i = 0; i < 4; i = i + 1) {
+                    acc = acc + unusedAfterLoop;
+                }
+                color = acc;
+            }
+        }
+    )");
+    
+    auto pressure = LivenessAnalysis().analyze(*program);
+    ASSERT_EQ(pressure.size(), 1);
+    EXPECT_EQ(pressure[0].peakScalars, 9);
+    EXPECT_DOUBLE_EQ(LivenessAnalysis::estimatedCudaOccupancy(LivenessAnalysis::estimatedCudaRegisters(9)), 1.0);
+    EXPECT_DOUBLE_EQ(LivenessAnalysis::estimatedCudaOccupancy(128), 0.25);
+}
+
+TEST_F(AnalysisTest, ClassifiesBranchUniformity) {
+    auto program = analyzeString(R"(
+        float scale(float x) {
+            return x * 2.0;
+        }
+        shader k : compute {
+            uniform float threshold;
+            void main() {
+                float limit = scale(threshold);
+                if (limit > 1.0) {
+                    limit = 1.0;
+                }
+                float lane = scale(float(idx));
+                if (lane > limit) {
+                    limit = 0.0;
+                }
+                if (limit > 0.5) {
+                    limit = 0.5;
+                }
+            }
+        }
+    )");
+    
+    UniformityAnalysis uniformity;
+    uniformity.analyze(*program);
+    
+    auto shader = dynamic_cast<ShaderDeclaration*>(program->declarations[1].get());
+    auto main = dynamic_cast<FunctionDeclaration*>(shader->body[1].get());
+    ASSERT_NE(main, nullptr);
+    
+    // scale() is called with idx, so its result is divergent for every caller
+    EXPECT_FALSE(uniformity.isUniformBranch(main->body[1].get()));
+    EXPECT_FALSE(uniformity.isUniformBranch(main->body[3].get()));
+    // limit is assigned under the divergent branch
+    EXPECT_FALSE(uniformity.isUniformBranch(main->body[4].get()));
+    
+    auto threshold = dynamic_cast<IfStatement*>(main->body[1].get());
+    auto call = dynamic_cast<BinaryExpression*>(threshold->condition.get());
+    EXPECT_TRUE(uniformity.isUniform(call->right.get()));
+    
+    CUDAGenerator generator;
+    generator.setUniformity(&uniformity);
+    std::string output = generator.generate(*program);
+    EXPECT_NE(output.find("if (lane > limit) { // divergent"), std::string::npos);
+    EXPECT_NE(output.find("return x * 2.0;"), std::string::npos);
+}
+
+TEST_F(AnalysisTest, FindsTextureFetchesUnderDivergentControl) {
+    auto program = analyzeString(R"(
+        shader fs : fragment {
+            uniform sampler2D albedo;
+            uniform float mode;
+            in vec2 uv;
+            out vec4 color;
+            void main() {
+                color = texture(albedo, uv);
+                if (mode > 0.5) {
+                    color = texture(albedo, uv * 2.0);
+                }
+                if (uv.x > 0.5) {
+                    return;
+                }
+                color = texture(albedo, uv.yx);
+            }
+        }
+    )");
+    
+    UniformityAnalysis uniformity;
+    uniformity.analyze(*program);
+    
+    auto shader = dynamic_cast<ShaderDeclaration*>(program->declarations[0].get());
+    auto main = dynamic_cast<FunctionDeclaration*>(shader->body[4].get());
+    ASSERT_NE(main, nullptr);
+    EXPECT_TRUE(uniformity.isUniformBranch(main->body[1].get()));
+    
+    // Only the fetch after the divergent early return is affected
+    const auto& fetches = uniformity.getDivergentFetches();
+    ASSERT_EQ(fetches.size(), 1);
+    EXPECT_EQ(fetches[0].call->line, 15);
+    EXPECT_EQ(fetches[0].shader, "fs");
+}
+
+TEST_F(AnalysisTest, RemovesClampsOfValuesAlreadyInRange) {
+    auto program = analyzeString(R"(
+        shader fs : fragment {
+            [[range(0.0, 1.0)]] uniform float roughness;
+            uniform float exposure;
+            in vec3 normal;
+            out vec4 color;
+            void main() {
+                vec3 n = normalize(normal);
+                float r = clamp(roughness, 0.0, 1.0);
+                float ndl = max(dot(n, n) * 0.5 + 0.75, 0.0);
+                float e = clamp(exposure, 0.0, 1.0);
+                float s = saturate(sin(r) * 2.0);
+                color = vec4(r, ndl, e, s);
+            }
+        }
+    )");
+    
+    ValueRangeAnalysis ranges;
+    ranges.analyze(*program);
+    RangeEliminations removed = ranges.eliminateRedundantChecks(*program);
+    EXPECT_EQ(removed.clamps, 2);
+    EXPECT_EQ(removed.decidedBranches, 0);
+    
+    GLSLGenerator generator;
+    std::string output = generator.generate(*program);
+    EXPECT_EQ(output.find("clamp(roughness"), std::string::npos);
+    EXPECT_EQ(output.find("max("), std::string::npos);
+    EXPECT_NE(output.find("clamp(exposure, 0.0, 1.0)"), std::string::npos);
+    EXPECT_NE(output.find("clamp((sin(r) * 2.0), 0.0, 1.0)"), std::string::npos);
+}
+
+TEST_F(AnalysisTest, KeepsClampsOfRoundedUnitVectorProducts) {
+    auto program = analyzeString(R"(
+        shader fs : fragment {
+            in vec3 normal;
+            in vec3 light;
+            out vec4 color;
+            void main() {
+                float d = dot(normalize(normal), normalize(light));
+                float angle = acos(clamp(d, -1.0, 1.0));
+                float wide = clamp(d, -2.0, 2.0);
+                if (d > 1.0) {
+                    angle = 0.0;
+                }
+                color = vec4(angle, wide, length(normalize(normal)), 1.0);
+            }
+        }
+    )");
+    
+    ValueRangeAnalysis ranges;
+    ranges.analyze(*program);
+    RangeEliminations removed = ranges.eliminateRedundantChecks(*program);
+    
+    // A float dot product of unit vectors may land a few ulps past 1
+    EXPECT_EQ(removed.clamps, 1);
+    EXPECT_EQ(removed.decidedBranches, 0);
+    GLSLGenerator generator;
+    std::string output = generator.generate(*program);
+    EXPECT_NE(output.find("clamp(d, -1.0, 1.0)"), std::string::npos);
+    EXPECT_EQ(output.find("clamp(d, -2.0, 2.0)"), std::string::npos);
+    EXPECT_NE(output.find("(d > 1.0)"), std::string::npos);
+}
+
+TEST_F(AnalysisTest, RemovesBoundsChecksOnLoopIndices) {
+    auto program = analyzeString(R"(
+        shader k : compute {
+            uniform float limit;
+            void main() {
+                float sum = 0.0;
+                for (int i = 0; i < 4; i = i + 1) {
+                    if (i >= 0 && i < 4) {
+                        sum = sum + float(i);
+                    }
+                }
+                if (idx < 0) {
+                    sum = 0.0;
+                }
+                if (sum > limit) {
+                    sum = limit;
+                }
+            }
+        }
+    )");
+    
+    ValueRangeAnalysis ranges;
+    ranges.analyze(*program);
+    
+    auto shader = dynamic_cast<ShaderDeclaration*>(program->declarations[0].get());
+    auto main = dynamic_cast<FunctionDeclaration*>(shader->body[1].get());
+    auto loop = dynamic_cast<ForStatement*>(main->body[1].get());
+    ASSERT_NE(loop, nullptr);
+    // The header also sees the exit value
+    EXPECT_FALSE(ranges.decide(loop->condition.get()).has_value());
+    
+    RangeEliminations removed = ranges.eliminateRedundantChecks(*program);
+    EXPECT_EQ(removed.clamps, 0);
+    EXPECT_EQ(removed.decidedBranches, 2);
+    ASSERT_EQ(main->body.size(), 3);
+    EXPECT_NE(dynamic_cast<IfStatement*>(main->body[2].get()), nullptr);
+}
+
+TEST_F(AnalysisTest, ClassifiesFunctionPurity) {
+    auto program = analyzeString(R"(
+        float square(float x) { return x * x; }
+        shader fs : fragment {
+            uniform float gain;
+            uniform sampler2D tex;
+            in vec2 uv;
+            out vec4 color;
+            float counter;
+            float scaled(float x) { return square(x) * gain; }
+            float shade() { return scaled(uv.x); }
+            vec4 fetch() { return texture(tex, uv); }
+            float readCounter() { return counter; }
+            void bump() { counter = counter + 1.0; }
+            void emit(float v) { color = vec4(v); }
+            void split(float v, out float part) { part = v * 0.5; }
+            void main() {
+                float half = 0.0;
+                split(shade(), half);
+                bump();
+                emit(half + readCounter() + fetch().x);
+            }
+        }
+    )");
+    
+    PurityAnalysis purity;
+    purity.analyze(*program);
+    
+    auto shader = dynamic_cast<ShaderDeclaration*>(program->declarations[1].get());
+    auto function = [&](const std::string& name) -> FunctionDeclaration* {
+        for (auto* body : {&program->declarations, &shader->body}) {
+            for (auto& stmt : *body) {
+                auto func = dynamic_cast<FunctionDeclaration*>(stmt.get());
+                if (func && func->name == name) {
+                    return func;
+                }
+            }
+        }
+        return nullptr;
+    };
+    
+    EXPECT_EQ(purity.purityOf(function("square")), Purity::PURE);
+    EXPECT_EQ(purity.purityOf(function("scaled")), Purity::READS_UNIFORMS);
+    EXPECT_EQ(purity.purityOf(function("shade")), Purity::READS_INPUTS);
+    EXPECT_EQ(purity.purityOf(function("fetch")), Purity::SAMPLES_TEXTURES);
+    EXPECT_EQ(purity.purityOf(function("readCounter")), Purity::READS_MUTABLE);
+    EXPECT_EQ(purity.purityOf(function("emit")), Purity::WRITES_OUTPUTS);
+    EXPECT_EQ(purity.purityOf(function("bump")), Purity::SIDE_EFFECTS);
+    EXPECT_EQ(purity.purityOf(function("split")), Purity::SIDE_EFFECTS);
+    
+    // Writing a caller's local through an out parameter is not an effect of the caller
+    auto main = function("main");
+    auto splitCall = dynamic_cast<FunctionCallExpression*>(
+        dynamic_cast<ExpressionStatement*>(main->body[1].get())->expression.get());
+    EXPECT_EQ(purity.purityOf(*splitCall), Purity::SIDE_EFFECTS);
+    EXPECT_EQ(purity.effectsOf(function("main")) & Effect::WRITES_ARGUMENTS, 0u);
+    EXPECT_EQ(purity.purityOf(function("main")), Purity::SIDE_EFFECTS);
+}
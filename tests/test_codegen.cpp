@@ -2,6 +2,9 @@
 #include "codegen/glsl_generator.h"
 #include "codegen/cuda_generator.h"
 #include "parser/ast.h"
+#include "parser/parser.h"
+#include "lexer/lexer.h"
+#include "semantic/analyzer.h"
 
 using namespace sdl;
 
@@ -15,6 +18,12 @@ protected:
         
         return program;
     }
+    
+    std::unique_ptr<Program> parseString(const std::string& source) {
+        Lexer lexer(source);
+        Parser parser(lexer.tokenize());
+        return parser.parseProgram();
+    }
 };
 
 TEST_F(CodegenTest, GLSLGeneration) {
@@ -36,3 +45,30 @@ TEST_F(CodegenTest, CUDAGeneration) {
     EXPECT_FALSE(output.empty());
     EXPECT_NE(output.find("#include <cuda_runtime.h>"), std::string::npos);
 }
+
+TEST_F(CodegenTest, LowersBuiltinsPerTarget) {
+    auto program = parseString(R"(
+        float fract(float x) { return x; }
+        shader fs : fragment {
+            uniform sampler2D albedo;
+            in vec2 uv;
+            out vec4 color;
+            void main() {
+                color = texture(albedo, uv) * saturate(fract(uv.x));
+            }
+        }
+    )");
+    SemanticAnalyzer analyzer;
+    ASSERT_TRUE(analyzer.analyze(*program));
+    
+    GLSLGenerator glsl;
+    std::string glslOutput = glsl.generate(*program);
+    EXPECT_NE(glslOutput.find("texture(albedo, uv)"), std::string::npos);
+    EXPECT_NE(glslOutput.find("clamp(fract(uv.x), 0.0, 1.0)"), std::string::npos);
+    
+    // The program's own fract() hides the builtin
+    CUDAGenerator cuda;
+    std::string cudaOutput = cuda.generate(*program);
+    EXPECT_NE(cudaOutput.find("tex2D<float4>(albedo, uv.x, uv.y)"), std::string::npos);
+    EXPECT_NE(cudaOutput.find("__saturatef(fract(uv.x))"), std::string::npos);
+}
@@ -56,3 +56,201 @@ TEST_F(IntegrationTest, CompileToCUDA) {
     std::string output = compiler.getCUDAOutput();
     EXPECT_FALSE(output.empty());
 }
+
+TEST_F(IntegrationTest, CompilePermutationsCollapsesIdenticalVariants) {
+    std::ofstream file("test_permutations.sdl");
+    file << R"(
+        shader fs : fragment {
+            const bool FOG = false;
+            const int QUALITY = 1;
+            uniform vec4 tint;
+            out vec4 color;
+            void main() {
+                vec4 c = tint;
+                if (FOG) {
+                    c = c * 0.5;
+                }
+                if (QUALITY > 4) {
+                    c = c * c;
+                }
+                color = c;
+            }
+        }
+    )";
+    file.close();
+    
+    std::vector<Permutation> permutations = expandPermutations(R"({"FOG": [false, true], "QUALITY": [1, 2]})");
+    ASSERT_EQ(permutations.size(), 4u);
+    EXPECT_EQ(permutations[1].key, "FOG=false,QUALITY=2");
+    
+    // Keys use one spelling per value, so a value listed twice is an error
+    EXPECT_EQ(expandPermutations(R"({"QUALITY": [1.0, -0.0]})")[1].key, "QUALITY=0");
+    EXPECT_THROW(expandPermutations(R"({"QUALITY": [1, 1.0]})"), std::runtime_error);
+    EXPECT_THROW(expandPermutations(R"({"FOG": [true], "FOG": [false]})"), std::runtime_error);
+    
+    Compiler compiler;
+    CompilerOptions options;
+    options.inputFile = "test_permutations.sdl";
+    options.targets = {TargetLanguage::GLSL};
+    bool success = compiler.compilePermutations(options, permutations);
+    std::remove("test_permutations.sdl");
+    ASSERT_TRUE(success);
+    
+    // QUALITY never exceeds 4, so only FOG tells the variants apart
+    ASSERT_EQ(compiler.getVariants().size(), 2u);
+    EXPECT_EQ(compiler.getPermutationVariants(), (std::vector<size_t>{0, 0, 1, 1}));
+    EXPECT_EQ(compiler.getVariants()[0].glslOutput.find("0.5"), std::string::npos);
+    EXPECT_NE(compiler.getVariants()[1].glslOutput.find("tint * 0.5"), std::string::npos);
+}
+
+TEST_F(IntegrationTest, DefinesMustMatchTheConstType) {
+    std::ofstream file("test_defines.sdl");
+    file << R"(
+        shader fs : fragment {
+            const bool FOG = false;
+            const int MODE = 1;
+            out vec4 color;
+            void main() {
+                color = vec4(0.0);
+                if (FOG) {
+                    color = vec4(float(MODE));
+                }
+            }
+        }
+    )";
+    file.close();
+    
+    CompilerOptions options;
+    options.inputFile = "test_defines.sdl";
+    options.targets = {TargetLanguage::GLSL};
+    
+    Compiler truncated;
+    options.defines = {"MODE=7.9"};
+    EXPECT_FALSE(truncated.compile(options));
+    ASSERT_EQ(truncated.getErrors().size(), 1u);
+    EXPECT_NE(truncated.getErrors()[0].find("MODE"), std::string::npos);
+    
+    Compiler boolean;
+    options.defines = {"FOG=2"};
+    EXPECT_FALSE(boolean.compile(options));
+    ASSERT_EQ(boolean.getErrors().size(), 1u);
+    EXPECT_NE(boolean.getErrors()[0].find("FOG"), std::string::npos);
+    
+    Compiler accepted;
+    options.defines = {"FOG=1", "MODE=3"};
+    EXPECT_TRUE(accepted.compile(options));
+    
+    Compiler permuted;
+    options.defines.clear();
+    bool success = permuted.compilePermutations(options, expandPermutations(R"({"MODE": [1, 1.5]})"));
+    std::remove("test_defines.sdl");
+    EXPECT_FALSE(success);
+    ASSERT_EQ(permuted.getErrors().size(), 1u);
+    EXPECT_EQ(permuted.getErrors()[0].find("MODE=1.5: "), 0u);
+}
+
+TEST_F(IntegrationTest, WarnsOnlyAboutDivergentFetchesThatRemain) {
+    std::ofstream file("test_fetches.sdl");
+    file << R"(
+        shader fs : fragment {
+            uniform sampler2D tex;
+            in vec2 uv;
+            out vec4 color;
+            void main() {
+                vec4 c = vec4(0.0);
+                vec4 unused = vec4(0.0);
+                if (uv.x > 0.5) {
+                    c = texture(tex, uv);
+                }
+                if (uv.y > 0.5) {
+                    unused = texture(tex, uv * 2.0);
+                }
+                color = c;
+            }
+        }
+    )";
+    file.close();
+    
+    CompilerOptions options;
+    options.inputFile = "test_fetches.sdl";
+    options.targets = {TargetLanguage::GLSL};
+    Compiler compiler;
+    bool success = compiler.compile(options);
+    std::remove("test_fetches.sdl");
+    ASSERT_TRUE(success);
+    
+    // dce removes the second fetch, whose result nothing reads
+    std::vector<std::string> warnings = compiler.getWarnings();
+    ASSERT_EQ(warnings.size(), 1u);
+    EXPECT_NE(warnings[0].find("line 10"), std::string::npos);
+}
+
+TEST_F(IntegrationTest, StrippedHelpersDoNotWarnAboutFetches) {
+    std::ofstream file("test_stripped.sdl");
+    file << R"(
+        shader fs : fragment {
+            uniform sampler2D tex;
+            in vec2 uv;
+            out vec4 color;
+            vec4 sample(vec2 p) {
+                vec4 s = vec4(0.0);
+                if (p.x > 0.5) {
+                    s = texture(tex, p);
+                }
+                return s;
+            }
+            void main() {
+                vec4 unused = sample(uv);
+                color = vec4(1.0);
+            }
+        }
+    )";
+    file.close();
+    
+    CompilerOptions options;
+    options.inputFile = "test_stripped.sdl";
+    options.targets = {TargetLanguage::GLSL, TargetLanguage::CUDA};
+    Compiler compiler;
+    bool success = compiler.compile(options);
+    std::remove("test_stripped.sdl");
+    ASSERT_TRUE(success);
+    
+    // sample() is inlined into main, where dce drops the fetch, and
+    // strip-globals then removes sample() itself
+    EXPECT_EQ(compiler.getGLSLOutput().find("texture"), std::string::npos);
+    EXPECT_TRUE(compiler.getWarnings().empty());
+}
+
+TEST_F(IntegrationTest, FlattenedBranchesDoNotWarnAboutFetches) {
+    std::ofstream file("test_flatten.sdl");
+    file << R"(
+        shader fs : fragment {
+            uniform sampler2D tex;
+            in vec2 uv;
+            out vec4 color;
+            void main() {
+                vec4 c = vec4(0.0);
+                [[flatten]] if (uv.x < 0.25) {
+                    c = texture(tex, uv.yx);
+                }
+                color = c;
+            }
+        }
+    )";
+    file.close();
+    
+    CompilerOptions options;
+    options.inputFile = "test_flatten.sdl";
+    options.targets = {TargetLanguage::GLSL};
+    Compiler flattened;
+    EXPECT_TRUE(flattened.compile(options));
+    EXPECT_TRUE(flattened.getWarnings().empty());
+    
+    // Without if-conversion the fetch stays in the divergent branch
+    options.optimization = OptimizationLevel::O0;
+    Compiler branched;
+    EXPECT_TRUE(branched.compile(options));
+    std::remove("test_flatten.sdl");
+    ASSERT_EQ(branched.getWarnings().size(), 1u);
+    EXPECT_NE(branched.getWarnings()[0].find("undefined derivatives"), std::string::npos);
+}
@@ -0,0 +1,1065 @@
+#include <gtest/gtest.h>
+#include "ir/ir.h"
+#include "ir/lowering.h"
+#include "ir/pass_manager.h"
+#include "ir/glsl_printer.h"
+#include "ir/cuda_printer.h"
+#include "ir/host_printer.h"
+#include "semantic/analyzer.h"
+#include "parser/parser.h"
+#include "lexer/lexer.h"
+
+using namespace sdl;
+
+class IRTest : public ::testing::Test {
+protected:
+    std::unique_ptr<Program> analyzeString(const std::string& source) {
+        Lexer lexer(source);
+        Parser parser(lexer.tokenize());
+        auto program = parser.parseProgram();
+        
+        SemanticAnalyzer analyzer;
+        EXPECT_TRUE(analyzer.analyze(*program));
+        return program;
+    }
+    
+    IRModule lowerString(const std::string& source) {
+        auto program = analyzeString(source);
+        IRModule module;
+        IRLowering lowering;
+        EXPECT_TRUE(lowering.lower(*program, module)) << lowering.error();
+        return module;
+    }
+};
+
+static const char* loopShader = R"(
+    shader fs : fragment {
+        uniform float threshold;
+        in vec2 uv;
+        out vec4 color;
+        float weight;
+        void bump() { weight = weight + 1.0; }
+        void main() {
+            float sum = 0.0;
+            for (int i = 0; i < 4; i = i + 1) {
+                if (uv.x > threshold) {
+                    sum = sum + 0.5;
+                }
+            }
+            bump();
+            color = vec4(sum * weight);
+        }
+    }
+)";
+
+TEST_F(IRTest, LowersLoopsIntoSSA) {
+    IRModule module = lowerString(loopShader);
+    EXPECT_EQ(verifyIR(module), "");
+    
+    ASSERT_EQ(module.functions.size(), 2u);
+    const IRFunction& main = module.functions[1];
+    EXPECT_EQ(main.name, "main");
+    
+    // One phi per loop-carried variable in the header, one for sum at the merge
+    int phis = 0;
+    bool loop = false;
+    for (const auto& block : main.blocks) {
+        loop |= block.structure == IRStructure::LOOP;
+        for (IRValue value : block.instructions) {
+            phis += main.instructions[value].op == IROp::PHI;
+        }
+    }
+    EXPECT_TRUE(loop);
+    EXPECT_EQ(phis, 3);
+    
+    std::string dump = dumpIR(module, main);
+    EXPECT_NE(dump.find("loop merge"), std::string::npos);
+    EXPECT_NE(dump.find("; sum"), std::string::npos);
+}
+
+TEST_F(IRTest, PrintsStructuredGLSL) {
+    IRModule module = lowerString(loopShader);
+    
+    GLSLPrinter printer;
+    std::string output = printer.print(module);
+    EXPECT_NE(output.find("#version 330 core"), std::string::npos);
+    EXPECT_NE(output.find("while (i < 4) {"), std::string::npos);
+    EXPECT_NE(output.find("if (uv.x > threshold) {"), std::string::npos);
+    EXPECT_NE(output.find("color = vec4(sum * weight);"), std::string::npos);
+    // Void functions end without a redundant return
+    EXPECT_EQ(output.find("return;"), std::string::npos);
+}
+
+TEST_F(IRTest, PassesPerThreadGlobalsToCUDAHelpers) {
+    IRModule module = lowerString(loopShader);
+    
+    CUDAPrinter printer;
+    std::string output = printer.print(module);
+    EXPECT_NE(output.find("__constant__ float threshold;"), std::string::npos);
+    EXPECT_NE(output.find("__device__ void bump(float& weight) {"), std::string::npos);
+    EXPECT_NE(output.find("weight = weight + 1.0f;"), std::string::npos);
+    EXPECT_NE(output.find("bump(weight);"), std::string::npos);
+    EXPECT_NE(output.find("make_float4(sum * weight)"), std::string::npos);
+}
+
+TEST_F(IRTest, RejectsOutParameters) {
+    auto program = analyzeString(R"(
+        void split(vec2 v, out float x) { x = v.x; }
+        shader cs : compute {
+            void main() {
+                float x;
+                split(vec2(1.0, 2.0), x);
+            }
+        }
+    )");
+    
+    IRModule module;
+    IRLowering lowering;
+    EXPECT_FALSE(lowering.lower(*program, module));
+    EXPECT_NE(lowering.error().find("does not support"), std::string::npos);
+}
+
+TEST_F(IRTest, SimplifyCFGFoldsConstantBranches) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            in vec2 uv;
+            out vec4 color;
+            void main() {
+                float a = 1.0;
+                while (false) {
+                    a = a + 1.0;
+                }
+                color = vec4(a * uv.x);
+            }
+        }
+    )");
+    ASSERT_EQ(module.functions.size(), 1u);
+    EXPECT_GT(module.functions[0].blocks.size(), 1u);
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.setPipeline("simplify-cfg"));
+    ASSERT_TRUE(passes.setPrintAfter("simplify-cfg"));
+    passes.setTiming(true);
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    
+    // The loop never runs, so main() is one straight-line block
+    EXPECT_EQ(module.functions[0].blocks.size(), 1u);
+    ASSERT_EQ(passes.getTimings().size(), 1u);
+    const PassTiming& timing = passes.getTimings()[0];
+    EXPECT_TRUE(timing.changed);
+    EXPECT_LT(timing.instructionsAfter, timing.instructionsBefore);
+    EXPECT_EQ(timing.blocksAfter, 1u);
+    EXPECT_NE(passes.getDumps().find("*** IR after simplify-cfg ***"), std::string::npos);
+}
+
+TEST_F(IRTest, RejectsUnknownPasses) {
+    PassManager passes(OptimizationLevel::O0);
+    EXPECT_TRUE(passes.getPipeline().empty());
+    EXPECT_FALSE(passes.setPipeline("simplify-cfg,no-such-pass"));
+    EXPECT_NE(passes.error().find("no-such-pass"), std::string::npos);
+    EXPECT_FALSE(passes.setPrintBefore("also-missing"));
+    EXPECT_TRUE(passes.setPrintBefore("all"));
+}
+
+TEST_F(IRTest, FoldsConstantsInSinglePrecision) {
+    IRModule module = lowerString(R"(
+        const float PI = 3.14159;
+        const float TWO_PI = 2.0 * PI;
+        shader fs : fragment {
+            in vec2 uv;
+            out vec4 color;
+            void main() {
+                vec3 n = normalize(vec3(0, 1, 0));
+                float s = dot(n, vec3(1.0, 2.0, 3.0)) + 0.1;
+                color = vec4(vec3(0.5) * 2.0, s * TWO_PI) * uv.x;
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.setPipeline("fold-constants"));
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    
+    // 2.1 * 6.28318 rounded at each step like a float ALU would
+    float expected = (2.0f + 0.1f) * (2.0f * 3.14159f);
+    GLSLPrinter printer;
+    std::string output = printer.print(module);
+    EXPECT_NE(output.find("const float TWO_PI = 6.28318;"), std::string::npos);
+    EXPECT_NE(output.find("color = vec4(1.0, 1.0, 1.0, "), std::string::npos);
+    
+    bool found = false;
+    for (const auto& constant : module.constants) {
+        found |= constant.type == Type::Kind::VEC4 && constant.components[3] == static_cast<double>(expected);
+    }
+    EXPECT_TRUE(found);
+}
+
+TEST_F(IRTest, PrintsFoldedIntMinAsValidLiteral) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            uniform int n;
+            out vec4 color;
+            void main() {
+                int big = 2147483647;
+                int wrapped = big + 1;
+                color = vec4(float(wrapped + n));
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.setPipeline("fold-constants"));
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    
+    // Ints wrap at 32 bits, and 2147483648 is no int literal to negate
+    for (const std::string& output : {GLSLPrinter().print(module), CUDAPrinter().print(module)}) {
+        EXPECT_EQ(output.find("-2147483648"), std::string::npos);
+        EXPECT_NE(output.find("(-2147483647 - 1)"), std::string::npos);
+    }
+}
+
+TEST_F(IRTest, FoldsIndexedComponents) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            out vec4 color;
+            void main() {
+                mat2 m = mat2(1.0, 2.0, 3.0, 4.0);
+                vec3 v = vec3(5.0, 6.0, 7.0);
+                color = vec4(m[1][0], m[0][1], v[2], 1.0);
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.setPipeline("fold-constants"));
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    
+    // Matrices index by column, then row
+    EXPECT_NE(GLSLPrinter().print(module).find("color = vec4(3.0, 2.0, 7.0, 1.0);"), std::string::npos);
+}
+
+TEST_F(IRTest, GVNReusesDominatingValues) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            uniform vec3 lightDir;
+            in vec3 normal;
+            out vec4 color;
+            float gain;
+            void main() {
+                float diffuse = max(dot(normal, lightDir), 0.0);
+                float wrap = 0.0;
+                if (diffuse > 0.5) {
+                    wrap = dot(lightDir, normal) * 0.5 + gain;
+                }
+                gain = 2.0;
+                color = vec4(diffuse + wrap + gain);
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.setPipeline("gvn"));
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    
+    // The second dot, the second loads of lightDir and normal, and the load
+    // of gain after the store
+    EXPECT_EQ(passes.getStatistics().at("gvn.eliminated"), 4);
+    
+    int dots = 0;
+    for (const auto& block : module.functions[0].blocks) {
+        for (IRValue value : block.instructions) {
+            const IRInstruction& inst = module.functions[0].instructions[value];
+            dots += inst.op == IROp::BUILTIN && static_cast<BuiltinId>(inst.imm) == BuiltinId::DOT;
+        }
+    }
+    EXPECT_EQ(dots, 1);
+    
+    GLSLPrinter printer;
+    EXPECT_NE(printer.print(module).find("color = vec4(diffuse + wrap + 2.0);"), std::string::npos);
+}
+
+TEST_F(IRTest, StripsDeadCodeAndUnusedInterface) {
+    IRModule module = lowerString(R"(
+        float unusedHelper(float x) { return x * 2.0; }
+        shader fs : fragment {
+            uniform float roughness;
+            uniform sampler2D unusedMap;
+            in vec2 uv;
+            in vec3 unusedNormal;
+            out vec4 color;
+            float scratch;
+            void main() {
+                float waste = roughness * 3.0;
+                scratch = uv.x;
+                color = vec4(0.0);
+                color = vec4(roughness);
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.setPipeline("dce,strip-globals"));
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    EXPECT_EQ(passes.getStatistics().at("dce.stores"), 2);
+    EXPECT_EQ(passes.getStatistics().at("strip-globals.functions"), 1);
+    
+    std::vector<std::string> stripped;
+    for (uint32_t global : module.strippedGlobals) {
+        stripped.push_back(module.globals[global].name);
+    }
+    EXPECT_EQ(stripped, (std::vector<std::string>{"unusedMap", "uv", "unusedNormal", "scratch"}));
+    
+    GLSLPrinter printer;
+    std::string output = printer.print(module);
+    EXPECT_EQ(output.find("unusedHelper"), std::string::npos);
+    EXPECT_EQ(output.find("vec4(0.0)"), std::string::npos);
+    EXPECT_EQ(output.find("waste"), std::string::npos);
+    EXPECT_NE(output.find("uniform float roughness;"), std::string::npos);
+    EXPECT_NE(output.find("out vec4 color;"), std::string::npos);
+}
+
+TEST_F(IRTest, RemovesLoopsAndIfsWithoutEffect) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            uniform int count;
+            uniform sampler2D tex;
+            in vec2 uv;
+            out vec4 color;
+            void main() {
+                vec4 sum = vec4(0.0);
+                if (uv.y > 0.5) {
+                    sum = vec4(uv, 0.0, 1.0);
+                }
+                for (int i = 0; i < count; i = i + 1) {
+                    for (int j = 0; j < count; j = j + 1) {
+                        if (uv.x > float(j)) {
+                            sum = sum + texture(tex, uv);
+                        }
+                    }
+                }
+                float live = 0.0;
+                for (int k = 0; k < count; k = k + 1) {
+                    live = live + uv.y;
+                }
+                color = vec4(live);
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.setPipeline("dce"));
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    EXPECT_EQ(passes.getStatistics().at("dce.selections"), 1);
+    EXPECT_EQ(passes.getStatistics().at("dce.loops"), 1);
+    
+    // Nothing reads sum, so the if and the loop nest computing it go, the
+    // inner loop with the outer one; live's loop stays
+    std::string output = GLSLPrinter().print(module);
+    size_t loop = output.find("while");
+    ASSERT_NE(loop, std::string::npos);
+    EXPECT_EQ(output.find("while", loop + 1), std::string::npos);
+    EXPECT_EQ(output.find("texture"), std::string::npos);
+    EXPECT_EQ(output.find("if ("), std::string::npos);
+    EXPECT_NE(output.find("live"), std::string::npos);
+}
+
+TEST_F(IRTest, InlinesSmallAndSingleUseFunctions) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            uniform float exposure;
+            in vec2 uv;
+            out vec4 color;
+            float scale(float x) { return x * 2.0; }
+            [[noinline]] float shade(float x) { return x * exposure; }
+            [[inline]] float tint(float x) {
+                float y = x;
+                if (x > 0.5) {
+                    y = x * 0.5;
+                }
+                return y + exposure;
+            }
+            void main() {
+                float a = scale(uv.x) + scale(uv.y);
+                color = vec4(shade(a), shade(uv.x), tint(a), tint(2.0));
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    EXPECT_EQ(passes.getStatistics().at("inline.calls"), 4);
+    
+    GLSLPrinter printer;
+    std::string output = printer.print(module);
+    EXPECT_EQ(output.find("scale("), std::string::npos);
+    EXPECT_EQ(output.find("tint("), std::string::npos);
+    EXPECT_NE(output.find("float shade(float x)"), std::string::npos);
+    // tint(2.0) folds down to a constant branch and disappears
+    EXPECT_NE(output.find("1.0 + exposure"), std::string::npos);
+}
+
+TEST_F(IRTest, RejectsContradictoryInlineAttributes) {
+    Lexer lexer(R"(
+        [[inline]] [[noinline]] float f(float x) { return x; }
+    )");
+    Parser parser(lexer.tokenize());
+    auto program = parser.parseProgram();
+    
+    SemanticAnalyzer analyzer;
+    EXPECT_FALSE(analyzer.analyze(*program));
+}
+
+TEST_F(IRTest, UnrollsConstantTripCountLoops) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            uniform sampler2D tex;
+            in vec2 uv;
+            out vec4 color;
+            void main() {
+                float weight = 0.0;
+                for (int i = 0; i < 3; i = i + 1) {
+                    weight = weight + float(i * i);
+                }
+                vec4 sum = vec4(0.0);
+                for (int j = 9; j > 0; j = j - 1) {
+                    sum = sum + texture(tex, uv * float(j)) * texture(tex, uv / float(j)) * texture(tex, uv);
+                }
+                color = sum * weight;
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    EXPECT_EQ(passes.getStatistics().at("unroll.full"), 1);
+    EXPECT_EQ(passes.getStatistics().at("unroll.partial"), 1);
+    
+    // The first loop is gone and its counter folded into the weight
+    GLSLPrinter glsl;
+    std::string output = glsl.print(module);
+    EXPECT_EQ(output.find("while (i"), std::string::npos);
+    
+    // Nine trips run as four of two, and the ninth after the loop
+    size_t loop = output.find("while (j != 1) {");
+    ASSERT_NE(loop, std::string::npos);
+    size_t remainder = output.find("}\n", output.find("sum = sum_1;", loop));
+    EXPECT_EQ(output.find("while", loop + 1), std::string::npos);
+    EXPECT_NE(output.find("texture(tex, uv / ", remainder), std::string::npos);
+    CUDAPrinter cuda;
+    EXPECT_EQ(cuda.print(module).find("#pragma unroll"), std::string::npos);
+}
+
+TEST_F(IRTest, SizeLevelKeepsLoops) {
+    const char* source = R"(
+        shader fs : fragment {
+            in vec2 uv;
+            out vec4 color;
+            void main() {
+                float sum = 0.0;
+                for (int i = 0; i < 4; i = i + 1) {
+                    sum = sum + sin(uv.x * float(i));
+                }
+                color = vec4(sum);
+            }
+        }
+    )";
+    EXPECT_NE(std::string(PassManager::pipeline(OptimizationLevel::O2)),
+              PassManager::pipeline(OptimizationLevel::O3));
+    
+    IRModule speed = lowerString(source);
+    PassManager o2;
+    ASSERT_TRUE(o2.run(speed)) << o2.error();
+    GLSLPrinter printer;
+    EXPECT_EQ(printer.print(speed).find("while"), std::string::npos);
+    
+    IRModule size = lowerString(source);
+    PassManager os(OptimizationLevel::OS);
+    ASSERT_TRUE(os.run(size)) << os.error();
+    EXPECT_NE(printer.print(size).find("while"), std::string::npos);
+}
+
+TEST_F(IRTest, UnrollsLoopsExposedByUnrollingTheirParent) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            uniform sampler2D tex;
+            in vec2 uv;
+            out vec4 color;
+            void main() {
+                vec4 sum = vec4(0.0);
+                for (int i = 1; i < 4; i = i + 1) {
+                    for (int k = 0; k < i; k = k + 1) {
+                        sum = sum + texture(tex, uv * float(k + i));
+                    }
+                }
+                color = sum;
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    // The outer loop, then the three copies of the inner one
+    EXPECT_EQ(passes.getStatistics().at("unroll.full"), 4);
+    
+    GLSLPrinter glsl;
+    std::string output = glsl.print(module);
+    EXPECT_EQ(output.find("while"), std::string::npos);
+    EXPECT_NE(output.find("texture(tex, uv * 5.0)"), std::string::npos);
+}
+
+TEST_F(IRTest, HoistsLoopInvariantCode) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            uniform vec3 lightPosition;
+            uniform sampler2D tex;
+            uniform int count;
+            uniform int stride;
+            in vec3 worldPos;
+            in vec2 uv;
+            out vec4 color;
+            void main() {
+                vec3 sum = vec3(0.0);
+                for (int j = 0; j < 4; j = j + 1) {
+                    sum = sum + normalize(lightPosition + worldPos);
+                }
+                for (int i = 0; i < count; i = i + 1) {
+                    vec3 l = normalize(lightPosition - worldPos);
+                    if (uv.x > 0.5) {
+                        sum = sum + texture(tex, uv).xyz + l * 2.0;
+                    }
+                    sum = sum + l * float(count / stride);
+                }
+                color = vec4(sum, 1.0);
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.setPipeline("licm"));
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    
+    GLSLPrinter printer;
+    std::string output = printer.print(module);
+    size_t second = output.find("while", output.find("while") + 1);
+    std::string first = output.substr(0, second);
+    std::string loop = output.substr(second);
+    // The first loop runs and normalizes every iteration, so once before it
+    // is enough
+    EXPECT_LT(first.find("normalize(lightPosition + worldPos)"), first.find("while"));
+    // The second may run zero times, so its costly work moves under the
+    // loop's own entry test; the fetch is conditional and stays inside
+    size_t guard = first.rfind("if (0 < count)");
+    ASSERT_NE(guard, std::string::npos);
+    EXPECT_GT(first.find("normalize(", guard), guard);
+    EXPECT_GT(first.find("count / stride", guard), guard);
+    EXPECT_EQ(loop.find("normalize("), std::string::npos);
+    EXPECT_EQ(loop.find("count / stride"), std::string::npos);
+    EXPECT_NE(loop.find("texture(tex, uv)"), std::string::npos);
+}
+
+static const char* algebraShader = R"(
+    shader fs : fragment {
+        uniform vec3 center;
+        uniform float t;
+        in vec3 position;
+        out vec4 color;
+        void main() {
+            float a = pow(t, 2.0) * 1.0 + 0.0;
+            float b = t / 4.0 + t / 3.0;
+            vec3 n = normalize(normalize(position));
+            float inside = 0.0;
+            if (length(position - center) < 2.0) {
+                inside = 1.0;
+            }
+            color = vec4(mix(n, center, 0.0), a + b + inside);
+        }
+    }
+)";
+
+TEST_F(IRTest, SimplifiesAlgebraExactlyByDefault) {
+    IRModule module = lowerString(algebraShader);
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.setPipeline("simplify-algebra,dce"));
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    EXPECT_EQ(passes.getStatistics().at("simplify-algebra.pow-two"), 1);
+    EXPECT_EQ(passes.getStatistics().count("simplify-algebra.div-reciprocal"), 0u);
+    
+    GLSLPrinter printer;
+    std::string output = printer.print(module);
+    // 1/4 is exact, 1/3 is not; t + 0.0 turns -0.0 into 0.0
+    EXPECT_NE(output.find("t * t + 0.0"), std::string::npos);
+    EXPECT_NE(output.find("t * 0.25 + t / 3.0"), std::string::npos);
+    EXPECT_NE(output.find("normalize(normalize(position))"), std::string::npos);
+    EXPECT_NE(output.find("length("), std::string::npos);
+}
+
+TEST_F(IRTest, FastMathEnablesInexactRules) {
+    IRModule module = lowerString(algebraShader);
+    
+    // As --fast-math does
+    for (auto& function : module.functions) {
+        function.fastMath = true;
+    }
+    PassManager passes;
+    ASSERT_TRUE(passes.setPipeline("simplify-algebra,dce"));
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    
+    GLSLPrinter printer;
+    std::string output = printer.print(module);
+    EXPECT_NE(output.find("t * 0.33333334"), std::string::npos);
+    EXPECT_EQ(output.find("normalize(normalize"), std::string::npos);
+    EXPECT_EQ(output.find("mix("), std::string::npos);
+    EXPECT_EQ(output.find("length("), std::string::npos);
+    EXPECT_NE(output.find("< 4.0"), std::string::npos);
+}
+
+TEST_F(IRTest, FastFunctionsUseApproximateIntrinsics) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            uniform float t;
+            in vec3 normal;
+            out vec4 color;
+            [[fast]] [[noinline]] vec3 shade(vec3 n, float x) {
+                return normalize(n) * (sin(x) / t) * 2.0 * 3.0;
+            }
+            [[noinline]] float exact(float x) { return sin(x) / t; }
+            [[fast]] [[noinline]] float falloff(float d) { return 1.0 / sqrt(d); }
+            void main() {
+                color = vec4(shade(normal, t), exact(t) + falloff(t));
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    EXPECT_EQ(passes.getStatistics().at("simplify-algebra.reassociate-mul"), 1);
+    
+    CUDAPrinter cuda;
+    std::string output = cuda.print(module);
+    std::string fast = output.substr(output.find("shade("), output.find("exact(") - output.find("shade("));
+    EXPECT_NE(fast.find("__fdividef(__sinf(x), t)"), std::string::npos);
+    EXPECT_NE(fast.find("6.0f"), std::string::npos);
+    std::string precise = output.substr(output.find("exact("));
+    EXPECT_NE(precise.find("sin(x) / t"), std::string::npos);
+    EXPECT_EQ(precise.find("__sinf"), std::string::npos);
+    EXPECT_NE(precise.find("return rsqrtf(d);"), std::string::npos);
+    
+    GLSLPrinter glsl;
+    output = glsl.print(module);
+    EXPECT_NE(output.find("n * inversesqrt(dot(n, n))"), std::string::npos);
+    EXPECT_NE(output.find("sin(x) / t"), std::string::npos);
+}
+
+TEST_F(IRTest, InfersHalfPrecisionForBoundedColourMath) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            [[range(0.0, 1.0)]] uniform sampler2D albedo;
+            [[range(0.0, 1.0)]] uniform sampler2D detail;
+            uniform sampler2D sky;
+            in vec2 uv;
+            out vec4 color;
+            void main() {
+                vec4 base = texture(albedo, uv);
+                vec4 radiance = texture(sky, uv);
+                vec2 d = texture(detail, uv * 4.0).xy * 2.0 - 1.0;
+                float shade = base.a * 0.5 + 0.25;
+                color = vec4(base.rgb * shade, 1.0) + texture(albedo, uv + d * 0.01) + radiance * radiance.a;
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    EXPECT_GT(passes.getStatistics().at("infer-precision.mediump"), 0);
+    
+    // The fetched colour is in [0, 1]; d offsets a texture coordinate, and
+    // a sampler without a range may hold HDR values
+    GLSLPrinter glsl(true);
+    std::string output = glsl.print(module);
+    EXPECT_EQ(output.find("#version 300 es\nprecision highp float;"), 0u);
+    EXPECT_NE(output.find("mediump vec4 base = texture(albedo, uv);"), std::string::npos);
+    EXPECT_NE(output.find("    vec4 radiance = texture(sky, uv);"), std::string::npos);
+    EXPECT_EQ(output.find("mediump vec2"), std::string::npos);
+    EXPECT_EQ(GLSLPrinter().print(module).find("mediump"), std::string::npos);
+    
+    CUDAPrinter cuda;
+    output = cuda.print(module);
+    EXPECT_NE(output.find("#include <cuda_fp16.h>"), std::string::npos);
+    EXPECT_NE(output.find("__half2float(__float2half(base.w) * __float2half(0.5f) + __float2half(0.25f))"),
+              std::string::npos);
+}
+
+TEST_F(IRTest, KeepsFullPrecisionWhenOperandsOverflowHalf) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            [[range(0.0, 1000000.0)]] in float k;
+            in float u;
+            out vec4 color;
+            void main() {
+                float w = k * 0.001;
+                float z = 0.0 * u;
+                color = vec4(w, z, 0.0, 1.0);
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.setPipeline("infer-precision"));
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    
+    // w fits a half but k does not; 0 * u is NaN for an infinite u
+    std::string output = CUDAPrinter().print(module);
+    EXPECT_EQ(output.find("__float2half(k)"), std::string::npos);
+    EXPECT_EQ(output.find("__float2half(u)"), std::string::npos);
+    EXPECT_EQ(output.find("__half"), std::string::npos);
+}
+
+TEST_F(IRTest, ConvertsSmallBranchesToSelects) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            uniform sampler2D tex;
+            uniform float threshold;
+            in vec2 uv;
+            out vec4 color;
+            out vec4 glow;
+            void main() {
+                vec2 st = uv;
+                if (uv.x > threshold) {
+                    st = uv * 2.0;
+                } else {
+                    st = uv * 0.5;
+                }
+                [[branch]] if (uv.y > 0.5) {
+                    glow = vec4(st, 0.0, 1.0);
+                }
+                [[flatten]] if (st.x > 0.5) {
+                    color = texture(tex, st);
+                }
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    EXPECT_EQ(passes.getStatistics().at("if-convert.flattened"), 2);
+    
+    CUDAPrinter cuda;
+    std::string output = cuda.print(module);
+    EXPECT_NE(output.find("uv.x > threshold ? uv * 2.0f : uv * 0.5f"), std::string::npos);
+    EXPECT_NE(output.find("if (uv.y > 0.5f) {"), std::string::npos);
+    // The fetch runs either way; color keeps its old value when not taken
+    EXPECT_NE(output.find("color = st.x > 0.5f ? tex2D<float4>(tex, st.x, st.y) : color;"), std::string::npos);
+}
+
+TEST_F(IRTest, RejectsContradictoryBranchAttributes) {
+    Lexer lexer(R"(
+        shader fs : fragment {
+            in float x;
+            out float y;
+            void main() {
+                [[branch]] [[flatten]] if (x > 0.0) { y = 1.0; }
+            }
+        }
+    )");
+    Parser parser(lexer.tokenize());
+    auto program = parser.parseProgram();
+    
+    SemanticAnalyzer analyzer;
+    EXPECT_FALSE(analyzer.analyze(*program));
+}
+
+static const char* matrixChainShader = R"(
+    shader vs : vertex {
+        uniform mat4 projectionMatrix;
+        uniform mat4 viewMatrix;
+        in mat4 boneMatrix;
+        in vec3 position;
+        void main() {
+            gl_Position = projectionMatrix * viewMatrix * boneMatrix * vec4(position, 1.0);
+        }
+    }
+)";
+
+TEST_F(IRTest, ReassociatesMatrixChainsAppliedToVectors) {
+    IRModule module = lowerString(matrixChainShader);
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    EXPECT_EQ(passes.getStatistics().at("reassociate-matrices.chains"), 1);
+    EXPECT_TRUE(module.shaders[0].preshader.blocks.empty());
+    
+    GLSLPrinter printer;
+    std::string output = printer.print(module);
+    EXPECT_NE(output.find("projectionMatrix * (viewMatrix * (boneMatrix * vec4(position, 1.0)))"),
+              std::string::npos);
+}
+
+TEST_F(IRTest, FoldsUniformMatrixProducts) {
+    IRModule module = lowerString(matrixChainShader);
+    
+    PassManager passes;
+    passes.setFoldUniformProducts(true);
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    EXPECT_EQ(passes.getStatistics().at("reassociate-matrices.folded"), 1);
+    EXPECT_EQ(module.strippedGlobals.size(), 2u);
+    
+    GLSLPrinter printer;
+    std::string output = printer.print(module);
+    EXPECT_NE(output.find("uniform mat4 projectionMatrix_viewMatrix;"), std::string::npos);
+    EXPECT_EQ(output.find("uniform mat4 viewMatrix;"), std::string::npos);
+    EXPECT_NE(output.find("projectionMatrix_viewMatrix * (boneMatrix * vec4(position, 1.0))"), std::string::npos);
+    
+    HostPrinter host;
+    std::string preshader = host.print(module);
+    EXPECT_NE(preshader.find("float projectionMatrix[16];"), std::string::npos);
+    EXPECT_NE(preshader.find("in.projectionMatrix[0] * in.viewMatrix[0] + in.projectionMatrix[4] * in.viewMatrix[1] + "
+                             "in.projectionMatrix[8] * in.viewMatrix[2] + in.projectionMatrix[12] * in.viewMatrix[3],"),
+              std::string::npos);
+    EXPECT_NE(preshader.find("out.projectionMatrix_viewMatrix);"), std::string::npos);
+}
+
+TEST_F(IRTest, FoldsSharedUniformProductsPerShader) {
+    IRModule module = lowerString(R"(
+        uniform mat4 proj;
+        uniform mat4 view;
+        shader v1 : vertex {
+            in vec3 position;
+            void main() { gl_Position = proj * view * vec4(position, 1.0); }
+        }
+        shader v2 : vertex {
+            in vec3 position;
+            void main() { gl_Position = proj * view * vec4(position * 2.0, 1.0); }
+        }
+    )");
+    
+    PassManager passes;
+    passes.setFoldUniformProducts(true);
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    
+    // Each shader declares and computes its own product
+    std::string output = GLSLPrinter().print(module);
+    std::string v2 = output.substr(output.find("// Shader: v2"));
+    EXPECT_NE(output.find("uniform mat4 proj_view;"), std::string::npos);
+    EXPECT_NE(v2.find("uniform mat4 proj_view2;"), std::string::npos);
+    EXPECT_NE(v2.find("gl_Position = proj_view2 * "), std::string::npos);
+    
+    std::string preshader = HostPrinter().print(module);
+    EXPECT_NE(preshader.find("inline void v1_preshader("), std::string::npos);
+    EXPECT_NE(preshader.find("inline void v2_preshader("), std::string::npos);
+    EXPECT_NE(preshader.find("out.proj_view2);"), std::string::npos);
+}
+
+TEST_F(IRTest, ExtractsUniformExpressionsIntoPreshader) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            uniform vec3 lightPosition;
+            uniform float roughness;
+            uniform vec3 tint;
+            in vec3 normal;
+            out vec4 color;
+            void main() {
+                float alpha = roughness * roughness;
+                vec3 l = normalize(lightPosition);
+                color = vec4(tint.xyz * max(dot(normal, l), 0.0) * alpha, 1.0);
+            }
+        }
+    )");
+    
+    PassManager passes;
+    passes.setExtractPreshader(true);
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    EXPECT_EQ(passes.getStatistics().at("extract-preshader.uniforms"), 2);
+    
+    GLSLPrinter printer;
+    std::string output = printer.print(module);
+    EXPECT_NE(output.find("uniform float alpha;"), std::string::npos);
+    EXPECT_NE(output.find("uniform vec3 l;"), std::string::npos);
+    EXPECT_EQ(output.find("uniform float roughness;"), std::string::npos);
+    EXPECT_EQ(output.find("normalize("), std::string::npos);
+    // A swizzle alone is not worth a uniform
+    EXPECT_NE(output.find("uniform vec3 tint;"), std::string::npos);
+    
+    HostPrinter host;
+    std::string preshader = host.print(module);
+    EXPECT_NE(preshader.find("inline void fs_preshader(const fs_PreshaderInputs& in, fs_PreshaderOutputs& out)"),
+              std::string::npos);
+    EXPECT_NE(preshader.find("out.alpha = t"), std::string::npos);
+    EXPECT_NE(preshader.find("std::sqrt(in.lightPosition[0] * in.lightPosition[0]"), std::string::npos);
+    EXPECT_EQ(preshader.find("tint"), std::string::npos);
+}
+
+TEST_F(IRTest, PreshaderComputesSharedProductsOnce) {
+    IRModule module = lowerString(R"(
+        shader vs : vertex {
+            uniform mat4 P;
+            uniform mat4 V;
+            in vec3 position;
+            out vec3 eye;
+            [[noinline]] vec4 project(vec3 p) { return P * V * vec4(p, 1.0); }
+            void main() {
+                eye = (inverse(P * V) * vec4(position, 1.0)).xyz;
+                gl_Position = project(position);
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.setPipeline("extract-preshader"));
+    passes.setExtractPreshader(true);
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    EXPECT_EQ(passes.getStatistics().at("extract-preshader.uniforms"), 2);
+    
+    // P * V feeds both derived uniforms but is multiplied out once
+    std::string preshader = HostPrinter().print(module);
+    std::string first = "in.P[0] * in.V[0] + ";
+    size_t product = preshader.find(first);
+    ASSERT_NE(product, std::string::npos);
+    EXPECT_EQ(preshader.find(first, product + 1), std::string::npos);
+}
+
+TEST_F(IRTest, NamesDerivedUniformsAfterTheirExpression) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            uniform vec3 lightPosition;
+            uniform float exposure;
+            uniform float gain;
+            in vec3 normal;
+            out vec4 color;
+            void main() {
+                float shade = max(dot(normal, normalize(lightPosition)), 0.0);
+                color = vec4(vec3(shade * (exposure * gain)), 1.0);
+            }
+        }
+    )");
+    
+    PassManager passes;
+    passes.setExtractPreshader(true);
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    
+    // Values no variable names take the uniforms and builtins they combine
+    GLSLPrinter printer;
+    std::string output = printer.print(module);
+    EXPECT_NE(output.find("uniform vec3 normalize_lightPosition;"), std::string::npos);
+    EXPECT_NE(output.find("uniform float exposure_gain;"), std::string::npos);
+    EXPECT_EQ(output.find("_derived"), std::string::npos);
+}
+
+TEST_F(IRTest, NamesSharedSubexpressionsOnce) {
+    IRModule module = lowerString(R"(
+        shader fs : fragment {
+            uniform float exposure;
+            uniform float gain;
+            uniform float roughness;
+            uniform float ambientOcclusionStrength;
+            uniform float subsurfaceScatteringWidth;
+            uniform float clearcoatRoughness;
+            in vec3 normal;
+            out vec4 color;
+            void main() {
+                color = vec4(normal * ((exposure * gain) * (exposure * gain) + gain), roughness * roughness);
+                color = color * (ambientOcclusionStrength + subsurfaceScatteringWidth + clearcoatRoughness);
+            }
+        }
+    )");
+    
+    PassManager passes;
+    passes.setExtractPreshader(true);
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    
+    // Each uniform appears once however often the expression reads it, and
+    // names too long to read fall back to a numbered one
+    GLSLPrinter printer;
+    std::string output = printer.print(module);
+    EXPECT_NE(output.find("uniform float exposure_gain;"), std::string::npos);
+    EXPECT_NE(output.find("uniform float roughness2;"), std::string::npos);
+    EXPECT_NE(output.find("uniform float fs_derived_1;"), std::string::npos);
+    EXPECT_EQ(output.find("exposure_gain_"), std::string::npos);
+}
+
+TEST_F(IRTest, HoistsAffineFragmentExpressionsToVertexShader) {
+    IRModule module = lowerString(R"(
+        shader vs : vertex {
+            uniform mat4 model;
+            in vec3 position;
+            in vec2 texcoord;
+            out vec3 worldPos;
+            out vec2 uv;
+            out vec3 normal;
+            void main() {
+                vec4 world = model * vec4(position, 1.0);
+                worldPos = world.xyz;
+                uv = texcoord;
+                normal = position;
+                gl_Position = world;
+            }
+        }
+        shader fs : fragment {
+            uniform vec3 cameraPosition;
+            uniform vec2 uvScale;
+            uniform vec2 uvOffset;
+            uniform sampler2D albedo;
+            in vec3 worldPos;
+            in vec2 uv;
+            in vec3 normal;
+            out vec4 color;
+            void main() {
+                vec3 view = worldPos - cameraPosition;
+                vec4 base = texture(albedo, uv * uvScale + uvOffset);
+                color = base * max(dot(normalize(view), normalize(normal)), 0.0);
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    EXPECT_EQ(passes.getStatistics().at("hoist-to-vertex.varyings"), 2);
+    EXPECT_EQ(passes.getStatistics().at("hoist-to-vertex.demoted"), 2);
+    
+    GLSLPrinter printer;
+    std::string output = printer.print(module);
+    size_t fragment = output.find("// Shader: fs");
+    ASSERT_NE(fragment, std::string::npos);
+    std::string vertexCode = output.substr(0, fragment);
+    std::string fragmentCode = output.substr(fragment);
+    EXPECT_NE(vertexCode.find("uniform vec3 cameraPosition;"), std::string::npos);
+    EXPECT_NE(vertexCode.find("out vec3 view;"), std::string::npos);
+    EXPECT_EQ(vertexCode.find("out vec3 worldPos;"), std::string::npos);
+    EXPECT_NE(vertexCode.find("uv_interpolated = texcoord * uvScale + uvOffset;"), std::string::npos);
+    EXPECT_NE(fragmentCode.find("in vec3 view;"), std::string::npos);
+    EXPECT_EQ(fragmentCode.find("cameraPosition"), std::string::npos);
+    EXPECT_EQ(fragmentCode.find("uvScale"), std::string::npos);
+    // normalize() is not affine, so the normal stays interpolated as is
+    EXPECT_NE(fragmentCode.find("in vec3 normal;"), std::string::npos);
+}
+
+TEST_F(IRTest, DoesNotHoistRepackedVaryings) {
+    IRModule module = lowerString(R"(
+        shader vs : vertex {
+            in vec4 position;
+            out vec4 t;
+            out vec2 uv;
+            void main() {
+                t = position;
+                uv = position.xy;
+                gl_Position = position;
+            }
+        }
+        shader fs : fragment {
+            uniform sampler2D albedo;
+            in vec4 t;
+            in vec2 uv;
+            out vec4 color;
+            void main() {
+                vec4 packed = vec4(t.xy, t.zw);
+                color = texture(albedo, uv.yx) * packed;
+            }
+        }
+    )");
+    
+    PassManager passes;
+    ASSERT_TRUE(passes.run(module)) << passes.error();
+    EXPECT_EQ(passes.getStatistics().count("hoist-to-vertex.varyings"), 0u);
+    std::string output = GLSLPrinter().print(module);
+    EXPECT_EQ(output.find("_interpolated"), std::string::npos);
+}
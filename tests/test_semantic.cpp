@@ -0,0 +1,323 @@
+#include <gtest/gtest.h>
+#include "semantic/analyzer.h"
+#include "semantic/builtins.h"
+#include "parser/parser.h"
+#include "lexer/lexer.h"
+
+using namespace sdl;
+
+class SemanticTest : public ::testing::Test {
+protected:
+    std::unique_ptr<Program> parseString(const std::string& source) {
+        Lexer lexer(source);
+        auto tokens = lexer.tokenize();
+        Parser parser(std::move(tokens));
+        return parser.parseProgram();
+    }
+    
+    std::vector<Diagnostic> analyzeString(const std::string& source, unsigned threads = 0) {
+        auto program = parseString(source);
+        SemanticAnalyzer analyzer;
+        analyzer.setThreadCount(threads);
+        analyzer.analyze(*program);
+        return analyzer.getDiagnostics();
+    }
+};
+
+TEST_F(SemanticTest, AcceptsValidShader) {
+    std::string source = R"(
+        shader main : vertex {
+            in vec3 position;
+            uniform mat4 mvp;
+            void main() {
+                gl_Position = mvp * vec4(position, 1.0);
+                for (int i = 0; i < 3; i = i + 1) {
+                    gl_Position = gl_Position * 0.5;
+                }
+            }
+        }
+    )";
+    
+    EXPECT_TRUE(analyzeString(source).empty());
+}
+
+TEST_F(SemanticTest, AnnotatesExpressionTypes) {
+    auto program = parseString(R"(
+        shader main : fragment {
+            in vec3 normal;
+            out vec4 color;
+            void main() {
+                color = vec4(normalize(normal).xy, dot(normal, normal), 1.0);
+            }
+        }
+    )");
+    
+    SemanticAnalyzer analyzer;
+    ASSERT_TRUE(analyzer.analyze(*program));
+    
+    auto& shader = static_cast<ShaderDeclaration&>(*program->declarations[0]);
+    auto& main = static_cast<FunctionDeclaration&>(*shader.body[2]);
+    auto& assignment = static_cast<AssignmentStatement&>(*main.body[0]);
+    auto& call = static_cast<FunctionCallExpression&>(*assignment.value);
+    
+    ASSERT_NE(call.resultType, nullptr);
+    EXPECT_EQ(call.resultType->kind, Type::Kind::VEC4);
+    EXPECT_EQ(call.arguments[0]->resultType->kind, Type::Kind::VEC2);
+    EXPECT_EQ(call.arguments[1]->resultType->kind, Type::Kind::FLOAT);
+}
+
+TEST_F(SemanticTest, ReportsTypeErrors) {
+    auto diagnostics = analyzeString(R"(
+        shader main : vertex {
+            uniform mat4 mvp;
+            void main() {
+                vec3 v = vec4(1.0);
+                mvp = mvp;
+                gl_Position = undefinedValue;
+            }
+        }
+    )");
+    
+    ASSERT_EQ(diagnostics.size(), 3);
+    EXPECT_NE(diagnostics[0].message.find("Cannot initialize 'v'"), std::string::npos);
+    EXPECT_NE(diagnostics[1].message.find("Cannot assign to uniform 'mvp'"), std::string::npos);
+    EXPECT_NE(diagnostics[2].message.find("Undeclared identifier 'undefinedValue'"), std::string::npos);
+}
+
+TEST_F(SemanticTest, RejectsRecursionAndUseBeforeDeclaration) {
+    auto diagnostics = analyzeString(R"(
+        shader main : fragment {
+            out vec4 color;
+            float fact(float n) { return n * fact(n - 1.0); }
+            float even(float n) { return odd(n - 1.0); }
+            float odd(float n) { return even(n - 1.0); }
+            void main() { color = vec4(fact(3.0) + even(2.0) + late); }
+            uniform float late;
+        }
+    )");
+    
+    ASSERT_EQ(diagnostics.size(), 3);
+    EXPECT_NE(diagnostics[0].message.find("Recursive call to 'fact'"), std::string::npos);
+    EXPECT_NE(diagnostics[1].message.find("'odd' is called before its declaration"), std::string::npos);
+    EXPECT_NE(diagnostics[2].message.find("'late' is used before its declaration"), std::string::npos);
+    
+    diagnostics = analyzeString(R"(
+        shader main : fragment { out vec4 color; void main() { color = vec4(scale); } }
+        uniform float scale;
+    )");
+    ASSERT_EQ(diagnostics.size(), 1);
+    EXPECT_NE(diagnostics[0].message.find("'scale' is used before its declaration"), std::string::npos);
+}
+
+TEST_F(SemanticTest, RejectsIndicesThatAreNotInRangeLiterals) {
+    auto diagnostics = analyzeString(R"(
+        shader main : fragment {
+            uniform mat3 basis;
+            uniform int i;
+            out vec4 color;
+            void main() {
+                color = vec4(basis[i], basis[1][3]);
+            }
+        }
+    )");
+    
+    ASSERT_EQ(diagnostics.size(), 2);
+    EXPECT_NE(diagnostics[0].message.find("Index into mat3 must be an integer literal"), std::string::npos);
+    EXPECT_NE(diagnostics[1].message.find("Index 3 is out of range for vec3"), std::string::npos);
+}
+
+TEST_F(SemanticTest, ChecksAttributes) {
+    auto diagnostics = analyzeString(R"(
+        shader main : fragment {
+            [[range(0.0, 1.0)]] uniform float roughness;
+            [[range(1.0, 0.0)]] uniform float metalness;
+            [[range(0, 1)]] uniform mat3 basis;
+            [[shiny]] uniform float gloss;
+            out vec4 color;
+            void main() {
+                [[range(0.0, 1.0)]] float local = roughness;
+                color = vec4(local);
+            }
+        }
+    )");
+    
+    ASSERT_EQ(diagnostics.size(), 4);
+    EXPECT_NE(diagnostics[0].message.find("min <= max"), std::string::npos);
+    EXPECT_NE(diagnostics[1].message.find("scalar, vector or sampler"), std::string::npos);
+    EXPECT_EQ(diagnostics[2].severity, Diagnostic::Severity::WARNING);
+    EXPECT_NE(diagnostics[2].message.find("Unknown attribute 'shiny'"), std::string::npos);
+    EXPECT_NE(diagnostics[3].message.find("uniform and in variables"), std::string::npos);
+}
+
+TEST_F(SemanticTest, TypesBuiltinsFromTheBuiltinTable) {
+    auto program = parseString(R"(
+        shader main : fragment {
+            uniform sampler2D albedo;
+            in vec2 uv;
+            out vec4 color;
+            void main() {
+                color = texture(albedo, uv) * float(abs(-2));
+            }
+        }
+    )");
+    
+    SemanticAnalyzer analyzer;
+    ASSERT_TRUE(analyzer.analyze(*program));
+    
+    auto& shader = static_cast<ShaderDeclaration&>(*program->declarations[0]);
+    auto& main = static_cast<FunctionDeclaration&>(*shader.body[3]);
+    auto& assignment = static_cast<AssignmentStatement&>(*main.body[0]);
+    auto& product = static_cast<BinaryExpression&>(*assignment.value);
+    auto& fetch = static_cast<FunctionCallExpression&>(*product.left);
+    auto& conversion = static_cast<FunctionCallExpression&>(*product.right);
+    auto& absolute = static_cast<FunctionCallExpression&>(*conversion.arguments[0]);
+    
+    EXPECT_EQ(fetch.builtin, BuiltinId::TEXTURE);
+    EXPECT_EQ(conversion.builtin, BuiltinId::NONE);
+    EXPECT_EQ(absolute.builtin, BuiltinId::ABS);
+    EXPECT_EQ(fetch.resultType->kind, Type::Kind::VEC4);
+    EXPECT_EQ(absolute.resultType->kind, Type::Kind::INT);
+    
+    const BuiltinInfo* info = builtinInfo(BuiltinId::TEXTURE);
+    ASSERT_NE(info, nullptr);
+    EXPECT_STREQ(info->name, "texture");
+    EXPECT_TRUE(info->has(BuiltinFlag::TEXTURE_FETCH));
+    EXPECT_EQ(info->effects, static_cast<unsigned>(Effect::SAMPLES_TEXTURES));
+    EXPECT_EQ(findBuiltin("inversesqrt")->id, BuiltinId::INVERSESQRT);
+    EXPECT_EQ(findBuiltin("main"), nullptr);
+    
+    auto diagnostics = analyzeString(R"(
+        shader main : fragment {
+            uniform sampler2D albedo;
+            out vec4 color;
+            void main() {
+                color = texture(1.0, vec2(0.0)) + vec4(clamp(1.0, 0.0));
+            }
+        }
+    )");
+    ASSERT_EQ(diagnostics.size(), 2);
+    EXPECT_NE(diagnostics[0].message.find("Invalid argument 1 of type float to 'texture'"), std::string::npos);
+    EXPECT_NE(diagnostics[1].message.find("'clamp' expects 3 arguments, got 2"), std::string::npos);
+}
+
+TEST_F(SemanticTest, FoldsAndLowersBuiltins) {
+    const double args[] = {-7.0, 3.0, 0.25};
+    EXPECT_DOUBLE_EQ(findBuiltin("mod")->fold(args, 2), 2.0);
+    EXPECT_DOUBLE_EQ(findBuiltin("clamp")->fold(args, 3), 0.25);
+    EXPECT_DOUBLE_EQ(findBuiltin("mix")->fold(args, 3), -4.5);
+    EXPECT_DOUBLE_EQ(findBuiltin("step")->fold(args, 2), 1.0);
+    EXPECT_EQ(findBuiltin("dot")->fold, nullptr);
+    
+    const BuiltinInfo* saturate = findBuiltin("saturate");
+    EXPECT_EQ(lowerBuiltin(saturate->glsl, {"x"}, saturate->minArgs), "clamp(x, 0.0, 1.0)");
+    EXPECT_EQ(lowerBuiltin(saturate->cuda, {"x"}, saturate->minArgs), "__saturatef(x)");
+    
+    const BuiltinInfo* atan = findBuiltin("atan");
+    EXPECT_EQ(lowerBuiltin(atan->cuda, {"y"}, atan->minArgs), "atan(y)");
+    EXPECT_EQ(lowerBuiltin(atan->cuda, {"y", "x"}, atan->minArgs), "atan2(y, x)");
+    EXPECT_EQ(lowerBuiltin(atan->glsl, {"y", "x"}, atan->minArgs), "atan(y, x)");
+    EXPECT_EQ(lowerBuiltin(findBuiltin("dot")->cpu, {"a", "b"}, 2), "");
+}
+
+TEST_F(SemanticTest, SharesFrozenGlobalsAcrossShaders) {
+    std::string source = R"(
+        uniform float scale;
+        float scaled(float x) { return x * scale; }
+        shader a : vertex { void main() { gl_Position = vec4(scaled(1.0)); } }
+        shader b : fragment { out vec4 c; void main() { c = vec4(scaled(2.0)); } }
+        shader d : fragment { out vec4 c; void main() { scale = 1.0; } }
+    )";
+    
+    auto diagnostics = analyzeString(source, 4);
+    ASSERT_EQ(diagnostics.size(), 1);
+    EXPECT_EQ(diagnostics[0].line, 6);
+}
+
+TEST_F(SemanticTest, ParallelDiagnosticsMatchSerialSourceOrder) {
+    std::string source;
+    for (int i = 0; i < 16; ++i) {
+        source += "shader s" + std::to_string(i) + " : fragment {\n"
+                  "    out vec4 c;\n"
+                  "    void main() { c = missing" + std::to_string(i) + "; }\n"
+                  "}\n";
+    }
+    source += "float global = badGlobal;\n";
+    
+    auto serial = analyzeString(source, 1);
+    auto parallel = analyzeString(source, 8);
+    
+    ASSERT_EQ(serial.size(), 17);
+    ASSERT_EQ(parallel.size(), serial.size());
+    for (size_t i = 0; i < serial.size(); ++i) {
+        EXPECT_EQ(parallel[i].format(), serial[i].format());
+        if (i > 0) {
+            EXPECT_LT(parallel[i - 1].line, parallel[i].line);
+        }
+    }
+}
+
+TEST_F(SemanticTest, IncrementalReanalyzesOnlyChangedDeclarationsAndDependents) {
+    std::string before = R"(
+        uniform float scale;
+        float helper(float x) { return x * scale; }
+        float unrelated(float x) { return x + 1.0; }
+        shader main : fragment {
+            out vec4 color;
+            void main() { color = vec4(helper(1.0)); }
+        }
+    )";
+    std::string after = before;
+    after.replace(after.find("x * scale"), 9, "x * scale * 2.0");
+    
+    SemanticAnalyzer analyzer;
+    analyzer.setIncremental(true);
+    auto first = parseString(before);
+    ASSERT_TRUE(analyzer.analyze(*first));
+    EXPECT_EQ(analyzer.getReusedCount(), 0);
+    EXPECT_EQ(analyzer.getReanalyzedCount(), 5);
+    
+    const DeclarationRecord* main = analyzer.getDependencyGraph().find("main::main()");
+    ASSERT_NE(main, nullptr);
+    ASSERT_EQ(main->dependencies.size(), 2);
+    EXPECT_EQ(main->dependencies[1].key, "::helper(float)");
+    
+    // Only helper and main, which calls it, are checked again
+    auto second = parseString(after);
+    ASSERT_TRUE(analyzer.analyze(*second));
+    EXPECT_EQ(analyzer.getReanalyzedCount(), 2);
+    EXPECT_EQ(analyzer.getReusedCount(), 3);
+    
+    auto dependents = analyzer.getDependencyGraph().dependents("::scale");
+    EXPECT_EQ(dependents, std::vector<std::string>{"::helper(float)"});
+}
+
+TEST_F(SemanticTest, IncrementalReuseRestoresTypesAndDiagnostics) {
+    std::string source = R"(
+        float broken() { return missing; }
+        shader main : fragment {
+            out vec4 color;
+            void main() { color = vec4(dot(vec3(1.0), vec3(2.0))); }
+        }
+    )";
+    
+    SemanticAnalyzer analyzer;
+    analyzer.setIncremental(true);
+    auto first = parseString(source);
+    EXPECT_FALSE(analyzer.analyze(*first));
+    
+    // Shifting everything down a line changes positions but not structure
+    auto second = parseString("\n" + source);
+    EXPECT_FALSE(analyzer.analyze(*second));
+    EXPECT_EQ(analyzer.getReanalyzedCount(), 0);
+    
+    ASSERT_EQ(analyzer.getDiagnostics().size(), 1);
+    EXPECT_EQ(analyzer.getDiagnostics()[0].line, 3);
+    
+    auto& shader = static_cast<ShaderDeclaration&>(*second->declarations[1]);
+    auto& main = static_cast<FunctionDeclaration&>(*shader.body[1]);
+    auto& assignment = static_cast<AssignmentStatement&>(*main.body[0]);
+    auto& call = static_cast<FunctionCallExpression&>(*assignment.value);
+    ASSERT_NE(call.resultType, nullptr);
+    EXPECT_EQ(call.resultType->kind, Type::Kind::VEC4);
+    EXPECT_EQ(call.arguments[0]->resultType->kind, Type::Kind::FLOAT);
+}